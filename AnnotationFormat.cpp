@@ -0,0 +1,525 @@
+#include "AnnotationFormat.h"
+#include "JsonStreamReader.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr int FeatureChunkSize = 256;
+
+QPolygonF outline(const MapArea &area)
+{
+    switch (area.shape) {
+    case HotspotShape::Rectangle: {
+        const QRectF r = area.rect.normalized();
+        return QPolygonF({r.topLeft(), r.topRight(), r.bottomRight(), r.bottomLeft()});
+    }
+    case HotspotShape::Circle: {
+        QPolygonF polygon;
+        for (int i = 0; i < AnnotationFormat::CircleSegments; ++i) {
+            const qreal angle = 2 * M_PI * i / AnnotationFormat::CircleSegments;
+            polygon.append(area.center + QPointF(std::cos(angle), std::sin(angle)) * area.radius);
+        }
+        return polygon;
+    }
+    case HotspotShape::Polygon:
+        return area.polygon;
+    }
+    return QPolygonF();
+}
+
+qreal polygonArea(const QPolygonF &polygon)
+{
+    qreal sum = 0;
+    for (int i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        sum += polygon.at(j).x() * polygon.at(i).y() - polygon.at(i).x() * polygon.at(j).y();
+    }
+    return std::abs(sum) / 2;
+}
+
+QString shapeName(HotspotShape shape)
+{
+    switch (shape) {
+    case HotspotShape::Rectangle: return "rect";
+    case HotspotShape::Circle: return "circle";
+    case HotspotShape::Polygon: return "poly";
+    }
+    return "poly";
+}
+
+QByteArray joinFragments(const std::vector<QByteArray> &fragments)
+{
+    qsizetype size = 0;
+    for (const QByteArray &fragment : fragments) {
+        size += fragment.size() + 1;
+    }
+    QByteArray result;
+    result.reserve(size);
+    for (const QByteArray &fragment : fragments) {
+        if (fragment.isEmpty()) {
+            continue;
+        }
+        if (!result.isEmpty()) {
+            result.append(',');
+        }
+        result.append(fragment);
+    }
+    return result;
+}
+
+QByteArray compact(const QJsonObject &object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject cocoAnnotation(const MapArea &area, qint64 id, qint64 imageId)
+{
+    const QPolygonF ring = outline(area);
+    QJsonArray segmentation;
+    for (const QPointF &p : ring) {
+        segmentation.append(p.x());
+        segmentation.append(p.y());
+    }
+    const QRectF bounds = ring.boundingRect();
+
+    QJsonObject attributes;
+    attributes["shape"] = shapeName(area.shape);
+    attributes["url"] = area.url;
+    attributes["alt"] = area.altText;
+    attributes["title"] = area.title;
+    if (area.shape == HotspotShape::Circle) {
+        attributes["center"] = QJsonArray{area.center.x(), area.center.y()};
+        attributes["radius"] = area.radius;
+    }
+
+    QJsonObject annotation;
+    annotation["id"] = id;
+    annotation["image_id"] = imageId;
+    annotation["category_id"] = 1;
+    annotation["iscrowd"] = 0;
+    QJsonArray rings;
+    rings.append(segmentation);
+    annotation["segmentation"] = rings;
+    annotation["bbox"] = QJsonArray{bounds.x(), bounds.y(), bounds.width(), bounds.height()};
+    annotation["area"] = area.shape == HotspotShape::Circle ? M_PI * area.radius * area.radius : polygonArea(ring);
+    annotation["attributes"] = attributes;
+    return annotation;
+}
+
+// Appends the areas of one COCO annotation; circles and rectangles come
+// back from their attributes, other annotations from their polygons
+void appendCocoAreas(const QJsonObject &annotation, const QString &category, QVector<MapArea> *areas)
+{
+    const QJsonObject attributes = annotation["attributes"].toObject();
+    MapArea base;
+    base.url = attributes["url"].toString();
+    base.altText = attributes["alt"].toString();
+    base.title = attributes["title"].toString();
+    // Datasets from other tools have no alt; ours may have an empty one
+    if (!attributes.contains("alt")) {
+        base.altText = category;
+    }
+
+    const QString shape = attributes["shape"].toString();
+    const QJsonArray bbox = annotation["bbox"].toArray();
+    const QJsonArray center = attributes["center"].toArray();
+    if (shape == "circle" && center.size() == 2) {
+        MapArea area = base;
+        area.shape = HotspotShape::Circle;
+        area.center = QPointF(center.at(0).toDouble(), center.at(1).toDouble());
+        area.radius = attributes["radius"].toDouble();
+        areas->append(area);
+        return;
+    }
+
+    // Crowd annotations store a run-length mask instead of polygons
+    const QJsonValue segmentation = annotation["segmentation"];
+    if (shape != "rect" && segmentation.isArray() && !segmentation.toArray().isEmpty()) {
+        for (const QJsonValue &ringValue : segmentation.toArray()) {
+            const QJsonArray ring = ringValue.toArray();
+            if (ring.size() < 6) {
+                continue;
+            }
+            MapArea area = base;
+            area.shape = HotspotShape::Polygon;
+            area.polygon.reserve(ring.size() / 2);
+            for (int i = 0; i + 1 < ring.size(); i += 2) {
+                area.polygon.append(QPointF(ring.at(i).toDouble(), ring.at(i + 1).toDouble()));
+            }
+            areas->append(area);
+        }
+        return;
+    }
+
+    if (bbox.size() == 4) {
+        MapArea area = base;
+        area.shape = HotspotShape::Rectangle;
+        area.rect = QRectF(bbox.at(0).toDouble(), bbox.at(1).toDouble(), bbox.at(2).toDouble(), bbox.at(3).toDouble());
+        areas->append(area);
+    }
+}
+
+QJsonArray closedRing(const QPolygonF &polygon)
+{
+    QJsonArray ring;
+    for (const QPointF &p : polygon) {
+        ring.append(QJsonArray{p.x(), p.y()});
+    }
+    if (!polygon.isEmpty()) {
+        ring.append(QJsonArray{polygon.first().x(), polygon.first().y()});
+    }
+    return ring;
+}
+
+QPolygonF openRing(const QJsonArray &coordinates)
+{
+    QPolygonF polygon;
+    polygon.reserve(coordinates.size());
+    for (const QJsonValue &value : coordinates) {
+        const QJsonArray point = value.toArray();
+        if (point.size() >= 2) {
+            polygon.append(QPointF(point.at(0).toDouble(), point.at(1).toDouble()));
+        }
+    }
+    // GeoJSON rings repeat the first point at the end
+    if (polygon.size() > 1 && polygon.first() == polygon.last()) {
+        polygon.removeLast();
+    }
+    return polygon;
+}
+
+QJsonObject geoJsonFeature(const MapArea &area, int id)
+{
+    QJsonObject properties;
+    properties["shape"] = shapeName(area.shape);
+    properties["url"] = area.url;
+    properties["alt"] = area.altText;
+    properties["title"] = area.title;
+
+    QJsonObject geometry;
+    if (area.shape == HotspotShape::Circle) {
+        geometry["type"] = "Point";
+        geometry["coordinates"] = QJsonArray{area.center.x(), area.center.y()};
+        properties["radius"] = area.radius;
+    } else {
+        geometry["type"] = "Polygon";
+        QJsonArray rings;
+        rings.append(closedRing(outline(area)));
+        geometry["coordinates"] = rings;
+    }
+
+    QJsonObject feature;
+    feature["type"] = "Feature";
+    feature["id"] = id;
+    feature["geometry"] = geometry;
+    feature["properties"] = properties;
+    return feature;
+}
+
+void appendGeoJsonAreas(const QJsonObject &feature, QVector<MapArea> *areas)
+{
+    const QJsonObject properties = feature["properties"].toObject();
+    MapArea base;
+    base.url = properties["url"].toString();
+    base.altText = properties["alt"].toString();
+    if (base.altText.isEmpty()) {
+        base.altText = properties["name"].toString();
+    }
+    base.title = properties["title"].toString();
+
+    const QJsonObject geometry = feature["geometry"].toObject();
+    const QString type = geometry["type"].toString();
+    const QJsonArray coordinates = geometry["coordinates"].toArray();
+
+    if (type == "Point") {
+        if (coordinates.size() >= 2 && properties["radius"].toDouble() > 0) {
+            MapArea area = base;
+            area.shape = HotspotShape::Circle;
+            area.center = QPointF(coordinates.at(0).toDouble(), coordinates.at(1).toDouble());
+            area.radius = properties["radius"].toDouble();
+            areas->append(area);
+        }
+        return;
+    }
+
+    // Outer rings only; image map areas cannot have holes
+    QVector<QPolygonF> rings;
+    if (type == "Polygon" && !coordinates.isEmpty()) {
+        rings.append(openRing(coordinates.at(0).toArray()));
+    } else if (type == "MultiPolygon") {
+        for (const QJsonValue &polygon : coordinates) {
+            const QJsonArray polygonRings = polygon.toArray();
+            if (!polygonRings.isEmpty()) {
+                rings.append(openRing(polygonRings.at(0).toArray()));
+            }
+        }
+    }
+
+    const bool rect = properties["shape"].toString() == "rect";
+    for (const QPolygonF &ring : rings) {
+        if (ring.size() < 3) {
+            continue;
+        }
+        MapArea area = base;
+        if (rect) {
+            area.shape = HotspotShape::Rectangle;
+            area.rect = ring.boundingRect();
+        } else {
+            area.shape = HotspotShape::Polygon;
+            area.polygon = ring;
+        }
+        areas->append(area);
+    }
+}
+
+} // namespace
+
+namespace AnnotationFormat {
+
+Format detect(const QByteArray &data)
+{
+    // Only top-level members count; a COCO member settles it without
+    // scanning the rest of a large dataset
+    JsonStreamReader reader(data);
+    QString key;
+    if (reader.beginObject()) {
+        while (reader.nextKey(&key)) {
+            if (key == "type") {
+                return reader.readString() == "FeatureCollection" ? Format::GeoJson : Format::Coco;
+            }
+            if (key == "images" || key == "annotations" || key == "categories") {
+                return Format::Coco;
+            }
+            reader.skipValue();
+        }
+    }
+    return Format::Coco;
+}
+
+QByteArray writeCoco(const QVector<AnnotatedImage> &images)
+{
+    TRACE_SCOPE("AnnotationFormat::writeCoco");
+
+    const int count = images.size();
+    std::vector<qint64> firstId(count + 1, 1);
+    for (int i = 0; i < count; ++i) {
+        firstId[i + 1] = firstId[i] + images.at(i).areas.size();
+    }
+
+    std::vector<QByteArray> imageJson(count);
+    std::vector<QByteArray> annotationJson(count);
+    parallelFor(count, [&](int i) {
+        const AnnotatedImage &image = images.at(i);
+        QJsonObject entry;
+        entry["id"] = i + 1;
+        entry["file_name"] = image.fileName;
+        entry["width"] = image.size.width();
+        entry["height"] = image.size.height();
+        imageJson[i] = compact(entry);
+
+        std::vector<QByteArray> annotations(image.areas.size());
+        for (int j = 0; j < image.areas.size(); ++j) {
+            annotations[j] = compact(cocoAnnotation(image.areas.at(j), firstId[i] + j, i + 1));
+        }
+        annotationJson[i] = joinFragments(annotations);
+    });
+
+    QByteArray result;
+    result += "{\"info\":{\"description\":\"Image Map Generator export\"},\"images\":[";
+    result += joinFragments(imageJson);
+    result += "],\"annotations\":[";
+    result += joinFragments(annotationJson);
+    result += "],\"categories\":[{\"id\":1,\"name\":\"hotspot\",\"supercategory\":\"hotspot\"}]}\n";
+    return result;
+}
+
+QByteArray writeGeoJson(const AnnotatedImage &image)
+{
+    TRACE_SCOPE("AnnotationFormat::writeGeoJson");
+
+    const int count = image.areas.size();
+    const int chunks = (count + FeatureChunkSize - 1) / FeatureChunkSize;
+    std::vector<QByteArray> features(chunks);
+    parallelFor(chunks, [&](int chunk) {
+        const int end = qMin(count, (chunk + 1) * FeatureChunkSize);
+        std::vector<QByteArray> fragments;
+        fragments.reserve(end - chunk * FeatureChunkSize);
+        for (int i = chunk * FeatureChunkSize; i < end; ++i) {
+            fragments.push_back(compact(geoJsonFeature(image.areas.at(i), i + 1)));
+        }
+        features[chunk] = joinFragments(fragments);
+    });
+
+    // "image" is a foreign member; GeoJSON readers ignore it
+    QJsonObject info;
+    info["file_name"] = image.fileName;
+    info["width"] = image.size.width();
+    info["height"] = image.size.height();
+
+    QByteArray result;
+    result += "{\"type\":\"FeatureCollection\",\"image\":" + compact(info) + ",\"features\":[";
+    result += joinFragments(features);
+    result += "]}\n";
+    return result;
+}
+
+bool readCoco(const QByteArray &data, QVector<AnnotatedImage> *images, QString *error)
+{
+    TRACE_SCOPE("AnnotationFormat::readCoco");
+
+    images->clear();
+    QHash<qint64, int> imageIndex;
+    QHash<qint64, QString> categories;
+    QString key;
+
+    // Images and categories may follow the annotations, so they are read
+    // in a first pass that skips everything else
+    JsonStreamReader header(data);
+    if (header.beginObject()) {
+        while (header.nextKey(&key)) {
+            if (key == "images" && header.beginArray()) {
+                while (header.nextElement()) {
+                    const QJsonObject entry = header.readObject();
+                    AnnotatedImage image;
+                    image.fileName = entry["file_name"].toString();
+                    image.size = QSize(entry["width"].toInt(), entry["height"].toInt());
+                    imageIndex.insert(static_cast<qint64>(entry["id"].toDouble()), images->size());
+                    images->append(image);
+                }
+            } else if (key == "categories" && header.beginArray()) {
+                while (header.nextElement()) {
+                    const QJsonObject entry = header.readObject();
+                    categories.insert(static_cast<qint64>(entry["id"].toDouble()), entry["name"].toString());
+                }
+            } else {
+                header.skipValue();
+            }
+        }
+    }
+    if (header.hasError()) {
+        if (error) {
+            *error = header.errorString();
+        }
+        return false;
+    }
+
+    JsonStreamReader body(data);
+    body.beginObject();
+    while (body.nextKey(&key)) {
+        if (key != "annotations" || !body.beginArray()) {
+            body.skipValue();
+            continue;
+        }
+        while (body.nextElement()) {
+            const QJsonObject annotation = body.readObject();
+            const auto it = imageIndex.constFind(static_cast<qint64>(annotation["image_id"].toDouble()));
+            if (it != imageIndex.constEnd()) {
+                appendCocoAreas(annotation, categories.value(static_cast<qint64>(annotation["category_id"].toDouble())),
+                                &(*images)[it.value()].areas);
+            }
+        }
+    }
+    if (body.hasError()) {
+        if (error) {
+            *error = body.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool readGeoJson(const QByteArray &data, AnnotatedImage *image, QString *error)
+{
+    TRACE_SCOPE("AnnotationFormat::readGeoJson");
+
+    *image = AnnotatedImage();
+    JsonStreamReader reader(data);
+    QString key;
+    bool collection = false;
+    if (reader.beginObject()) {
+        while (reader.nextKey(&key)) {
+            if (key == "type") {
+                collection = reader.readString() == "FeatureCollection";
+            } else if (key == "image") {
+                const QJsonObject info = reader.readObject();
+                image->fileName = info["file_name"].toString();
+                image->size = QSize(info["width"].toInt(), info["height"].toInt());
+            } else if (key == "features" && reader.beginArray()) {
+                while (reader.nextElement()) {
+                    appendGeoJsonAreas(reader.readObject(), &image->areas);
+                }
+            } else {
+                reader.skipValue();
+            }
+        }
+    }
+    if (reader.hasError() || !collection) {
+        if (error) {
+            *error = reader.hasError() ? reader.errorString() : QString("Not a GeoJSON FeatureCollection");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool read(const QString &filePath, QVector<AnnotatedImage> *images, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    // Read straight from the mapped file where possible
+    QByteArray data;
+    const qint64 size = file.size();
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    // A QByteArray holds at most 2 GB before Qt 6
+    if (size > std::numeric_limits<int>::max()) {
+        if (error) {
+            *error = "Files over 2 GB need a build with Qt 6";
+        }
+        return false;
+    }
+#endif
+    uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+    if (mapped) {
+        data = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<qsizetype>(size));
+    } else {
+        data = file.readAll();
+    }
+    const Format format = QFileInfo(filePath).suffix().compare("geojson", Qt::CaseInsensitive) == 0
+                              ? Format::GeoJson
+                              : detect(data);
+
+    bool ok;
+    if (format == Format::GeoJson) {
+        AnnotatedImage image;
+        ok = readGeoJson(data, &image, error);
+        images->clear();
+        if (ok) {
+            images->append(image);
+        }
+    } else {
+        ok = readCoco(data, images, error);
+    }
+
+    if (mapped) {
+        file.unmap(mapped);
+    }
+    return ok;
+}
+
+} // namespace AnnotationFormat
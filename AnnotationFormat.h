@@ -0,0 +1,49 @@
+#ifndef ANNOTATIONFORMAT_H
+#define ANNOTATIONFORMAT_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "MapArea.h"
+
+// Exchange of hotspots with annotation tools: COCO JSON datasets, as used for
+// training data, and GeoJSON feature collections, as used by GIS tools. Both
+// use image pixel coordinates.
+//
+// COCO has no circles, so a circle is written as a polygon and its centre
+// and radius kept in the annotation's attributes, together with the URL,
+// alt text and title. GeoJSON writes circles as a Point with a radius
+// property, the convention of most drawing tools. Reading streams the file,
+// so datasets with millions of annotations never exist as one JSON tree.
+namespace AnnotationFormat {
+
+struct AnnotatedImage {
+    QString fileName;
+    QSize size;
+    QVector<MapArea> areas;
+};
+
+enum class Format {
+    Coco,
+    GeoJson
+};
+
+// GeoJSON if the top-level "type" is FeatureCollection, COCO otherwise
+Format detect(const QByteArray &data);
+
+// Images are serialized in parallel and joined with consecutive ids
+QByteArray writeCoco(const QVector<AnnotatedImage> &images);
+QByteArray writeGeoJson(const AnnotatedImage &image);
+
+// COCO yields every image in the dataset, GeoJSON a single unnamed image.
+// A .geojson file is always read as GeoJSON.
+bool read(const QString &filePath, QVector<AnnotatedImage> *images, QString *error = nullptr);
+bool readCoco(const QByteArray &data, QVector<AnnotatedImage> *images, QString *error = nullptr);
+bool readGeoJson(const QByteArray &data, AnnotatedImage *image, QString *error = nullptr);
+
+constexpr int CircleSegments = 32;
+
+} // namespace AnnotationFormat
+
+#endif // ANNOTATIONFORMAT_H
@@ -0,0 +1,330 @@
+#include "BatchExporter.h"
+#include "GzipWriter.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSet>
+#include <vector>
+
+BatchExporter::Template BatchExporter::makeTemplate(const QVector<MapArea> &areas, const QSize &imageSize,
+                                                    const QSize &outputSize, const QString &mapName,
+                                                    qreal simplifyTolerance, bool minified)
+{
+    TRACE_SCOPE("BatchExporter::makeTemplate");
+
+    Template map;
+    map.imageSize = imageSize;
+    map.outputSize = outputSize;
+    map.mapName = mapName;
+    map.minified = minified;
+
+    // Formatting coords is the expensive part, and the same for every page
+    const int count = areas.size();
+    const int chunks = (count + AREA_CHUNK_SIZE - 1) / AREA_CHUNK_SIZE;
+    std::vector<QString> geometry(count);
+    parallelFor(chunks, [&](int chunk) {
+        const int end = qMin(count, (chunk + 1) * AREA_CHUNK_SIZE);
+        for (int i = chunk * AREA_CHUNK_SIZE; i < end; ++i) {
+            const MapArea &area = areas.at(i);
+            geometry[i] = MapArea::attribute("shape", area.generateShapeName(), minified) + ' '
+                          + MapArea::attribute("coords", area.generateCoords(simplifyTolerance), minified);
+        }
+    });
+
+    map.geometry.reserve(count);
+    map.urls.reserve(count);
+    map.altTexts.reserve(count);
+    map.titles.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        map.geometry.append(geometry[i]);
+        map.urls.append(areas.at(i).url);
+        map.altTexts.append(areas.at(i).altText);
+        map.titles.append(areas.at(i).title);
+    }
+    return map;
+}
+
+bool BatchExporter::readCsv(const QString &filePath, QVector<QStringList> *rows, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    QString text = QString::fromUtf8(file.readAll());
+    if (text.startsWith(QChar(0xFEFF))) {
+        text.remove(0, 1);
+    }
+
+    // RFC 4180: quoted fields may hold commas, line breaks and "" for a quote
+    rows->clear();
+    QStringList row;
+    QString field;
+    bool quoted = false;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (quoted) {
+            if (c != '"') {
+                field += c;
+            } else if (i + 1 < text.size() && text.at(i + 1) == '"') {
+                field += c;
+                ++i;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            row << field;
+            field.clear();
+        } else if (c == '\n' || c == '\r') {
+            if (c == '\r' && i + 1 < text.size() && text.at(i + 1) == '\n') {
+                ++i;
+            }
+            row << field;
+            field.clear();
+            // Blank lines are skipped
+            if (row.size() > 1 || !row.first().isEmpty()) {
+                rows->append(row);
+            }
+            row.clear();
+        } else {
+            field += c;
+        }
+    }
+    if (quoted) {
+        *error = "A quoted field is not closed";
+        return false;
+    }
+    if (!row.isEmpty() || !field.isEmpty()) {
+        row << field;
+        rows->append(row);
+    }
+    if (rows->isEmpty()) {
+        *error = "The file is empty";
+        return false;
+    }
+    return true;
+}
+
+QVector<BatchExporter::Page> BatchExporter::pages(const QStringList &imagePaths, const QVector<QStringList> &csv,
+                                                  QStringList *warnings)
+{
+    // Pages are named after their image, with the extension kept only where
+    // two images would otherwise share a name, and numbered where images in
+    // different folders have the same file name
+    QHash<QString, int> baseNames;
+    for (const QString &path : imagePaths) {
+        ++baseNames[QFileInfo(path).completeBaseName().toLower()];
+    }
+
+    QVector<Page> result(imagePaths.size());
+    QHash<QString, QVector<int>> byFileName;
+    QSet<QString> outputNames;
+    for (int i = 0; i < imagePaths.size(); ++i) {
+        const QFileInfo info(imagePaths.at(i));
+        Page &page = result[i];
+        page.imagePath = info.absoluteFilePath();
+        const QString stem = baseNames.value(info.completeBaseName().toLower()) > 1 ? info.fileName()
+                                                                                  : info.completeBaseName();
+        page.outputName = stem + ".html";
+        for (int n = 2; outputNames.contains(page.outputName.toLower()); ++n) {
+            page.outputName = QString("%1-%2.html").arg(stem).arg(n);
+        }
+        outputNames.insert(page.outputName.toLower());
+        page.values.insert("file", info.completeBaseName());
+        byFileName[info.fileName().toLower()].append(i);
+    }
+    if (csv.isEmpty()) {
+        return result;
+    }
+
+    QStringList header;
+    int imageColumn = -1;
+    for (const QString &name : csv.first()) {
+        if (name.trimmed().compare("image", Qt::CaseInsensitive) == 0 && imageColumn < 0) {
+            imageColumn = header.size();
+        }
+        header << name.trimmed();
+    }
+
+    QVector<bool> matched(imagePaths.size(), false);
+    for (int r = 1; r < csv.size(); ++r) {
+        const QStringList &row = csv.at(r);
+        int index = r - 1;
+        if (imageColumn >= 0) {
+            // A name with folders in it picks one of several images that
+            // share a file name
+            const QString name = QDir::fromNativeSeparators(row.value(imageColumn).trimmed());
+            const QVector<int> candidates = byFileName.value(QFileInfo(name).fileName().toLower());
+            index = -1;
+            for (int candidate : candidates) {
+                if (!name.contains('/')
+                    || result.at(candidate).imagePath.endsWith("/" + name, Qt::CaseInsensitive)) {
+                    index = candidate;
+                    break;
+                }
+            }
+            if (index < 0) {
+                warnings->append(QString("CSV row %1: no image named \"%2\"").arg(r + 1).arg(name));
+                continue;
+            }
+            if (candidates.size() > 1 && !name.contains('/')) {
+                warnings->append(QString("CSV row %1: %2 images are named \"%3\"; the row was used for %4")
+                                     .arg(r + 1).arg(candidates.size()).arg(name)
+                                     .arg(QDir::toNativeSeparators(result.at(index).imagePath)));
+            }
+        } else if (index >= imagePaths.size()) {
+            warnings->append(QString("%1 CSV rows beyond the last image were ignored").arg(csv.size() - r));
+            break;
+        }
+
+        for (int column = 0; column < header.size(); ++column) {
+            if (!header.at(column).isEmpty()) {
+                result[index].values.insert(header.at(column), row.value(column));
+            }
+        }
+        matched[index] = true;
+    }
+
+    for (int i = 0; i < imagePaths.size(); ++i) {
+        if (!matched.at(i)) {
+            warnings->append(QString("%1: no CSV row").arg(QFileInfo(imagePaths.at(i)).fileName()));
+        }
+    }
+    return result;
+}
+
+QString BatchExporter::substitute(const QString &text, const QHash<QString, QString> &values)
+{
+    if (values.isEmpty() || !text.contains('{')) {
+        return text;
+    }
+
+    QString result;
+    result.reserve(text.size());
+    int pos = 0;
+    while (pos < text.size()) {
+        const int open = text.indexOf('{', pos);
+        const int close = open < 0 ? -1 : text.indexOf('}', open + 1);
+        if (close < 0) {
+            break;
+        }
+        auto value = values.constFind(text.mid(open + 1, close - open - 1));
+        if (value == values.constEnd()) {
+            // Keep the brace and look again just after it
+            result += text.mid(pos, open + 1 - pos);
+            pos = open + 1;
+            continue;
+        }
+        result += text.mid(pos, open - pos);
+        result += value.value();
+        pos = close + 1;
+    }
+    result += text.mid(pos);
+    return result;
+}
+
+QString BatchExporter::generateHtml(const Template &map, const Page &page, const QString &imageSource)
+{
+    const bool minified = map.minified;
+    const QString indent = minified ? QString() : QString("  ");
+    const QString mapName = substitute(map.mapName, page.values);
+
+    QStringList html;
+    html.reserve(map.geometry.size() + 3);
+    html << "<img " + QStringList{MapArea::attribute("src", imageSource, minified),
+                                  MapArea::attribute("width", QString::number(map.outputSize.width()), minified),
+                                  MapArea::attribute("height", QString::number(map.outputSize.height()), minified),
+                                  MapArea::attribute("usemap", "#" + mapName, minified),
+                                  MapArea::attribute("alt", "Image Map", minified)}.join(' ') + ">";
+    html << "<map " + MapArea::attribute("name", mapName, minified) + ">";
+
+    // Same attribute order as MapArea::generateAreaTag
+    for (int i = 0; i < map.geometry.size(); ++i) {
+        const QString url = substitute(map.urls.at(i), page.values);
+        const QString title = substitute(map.titles.at(i), page.values);
+        QStringList tag;
+        tag << indent + "<area"
+            << map.geometry.at(i)
+            << MapArea::attribute("href", url.isEmpty() ? "#" : url, minified)
+            << MapArea::attribute("alt", substitute(map.altTexts.at(i), page.values), minified);
+        if (!title.isEmpty()) {
+            tag << MapArea::attribute("title", title, minified);
+        }
+        html << tag.join(' ') + ">";
+    }
+    html << "</map>";
+
+    return html.join(minified ? QString() : QString("\n"));
+}
+
+QStringList BatchExporter::run(const Template &map, const QVector<Page> &pages, const Options &options,
+                               Progress *progress)
+{
+    TRACE_SCOPE("BatchExporter::run");
+
+    const QDir dir(options.directory);
+    if (!dir.exists() && !QDir().mkpath(options.directory)) {
+        return {QString("Cannot create folder %1").arg(options.directory)};
+    }
+
+    std::vector<QString> errors(pages.size());
+    parallelFor(pages.size(), [&](int i) {
+        if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        const Page &page = pages.at(i);
+        const QString fileName = QFileInfo(page.imagePath).fileName();
+        // The header is enough to check the size
+        const QSize size = QImageReader(page.imagePath).size();
+        if (!size.isValid()) {
+            errors[i] = QString("%1: cannot read the image").arg(fileName);
+        } else if (size != map.imageSize) {
+            errors[i] = QString("%1 is %2 × %3 px, the hotspots are for %4 × %5 px")
+                            .arg(fileName)
+                            .arg(size.width())
+                            .arg(size.height())
+                            .arg(map.imageSize.width())
+                            .arg(map.imageSize.height());
+        } else {
+            const QString html = generateHtml(map, page, dir.relativeFilePath(page.imagePath));
+            writePage(dir.filePath(page.outputName), options.document.arg(html).toUtf8(), options.gzip, &errors[i]);
+        }
+
+        if (progress) {
+            progress->done.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    QStringList messages;
+    for (const QString &error : errors) {
+        if (!error.isEmpty()) {
+            messages.append(error);
+        }
+    }
+    return messages;
+}
+
+bool BatchExporter::writePage(const QString &filePath, const QByteArray &bytes, bool gzip, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size()) {
+        *error = QString("%1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+    file.close();
+
+    if (gzip) {
+        GzipWriter writer(filePath + ".gz");
+        if (!writer.open() || !writer.write(bytes) || !writer.close()) {
+            *error = QString("%1.gz: %2").arg(filePath, writer.errorString());
+            return false;
+        }
+    }
+    return true;
+}
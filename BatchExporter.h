@@ -0,0 +1,85 @@
+#ifndef BATCHEXPORTER_H
+#define BATCHEXPORTER_H
+
+#include <QHash>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "MapArea.h"
+
+// Applies one set of hotspots to many images of the same size, such as
+// product shots with the same layout, and writes an HTML page for each.
+//
+// URLs, alt texts, titles and the map name may contain {column} placeholders
+// filled in per image from a CSV file. The geometry is shared: each area's
+// shape and coords attributes are formatted once into the Template and
+// reused as-is by every page, so only the text attributes are built per
+// image. Pages are built and written in parallel, one image per task.
+class BatchExporter
+{
+public:
+    struct Template {
+        QSize imageSize;        // every image must have this size
+        QSize outputSize;       // width and height written to the <img>
+        QString mapName;
+        bool minified = false;
+        QStringList geometry;   // shape and coords attributes of each area
+        QStringList urls;
+        QStringList altTexts;
+        QStringList titles;
+    };
+
+    struct Page {
+        QString imagePath;
+        QString outputName;             // file name of the page
+        QHash<QString, QString> values; // placeholder values
+    };
+
+    struct Options {
+        QString directory;
+        QString document = "%1";  // page around the map, which replaces %1
+        bool gzip = false;        // also write a .gz copy of each page
+    };
+
+    // Shared with the GUI thread while running
+    struct Progress {
+        std::atomic<int> done{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    // Areas in output coordinates, as for a single export
+    static Template makeTemplate(const QVector<MapArea> &areas, const QSize &imageSize, const QSize &outputSize,
+                                 const QString &mapName, qreal simplifyTolerance, bool minified);
+
+    // Reads a CSV file into rows of fields; the first row is the header
+    static bool readCsv(const QString &filePath, QVector<QStringList> *rows, QString *error);
+
+    // One page per image. CSV rows are matched to images by a column named
+    // "image" holding the file name, or else taken in order. Where images in
+    // several folders share a file name, the name may include enough of the
+    // folder path to pick one; output names are kept unique. {file} is the
+    // image's file name without its extension unless the CSV has a column
+    // of that name.
+    static QVector<Page> pages(const QStringList &imagePaths, const QVector<QStringList> &csv,
+                               QStringList *warnings);
+
+    // Replaces {name} with values[name]; unknown placeholders are kept
+    static QString substitute(const QString &text, const QHash<QString, QString> &values);
+
+    // The <img> and <map> for one page
+    static QString generateHtml(const Template &map, const Page &page, const QString &imageSource);
+
+    // Returns error messages, or an empty list if every page was written.
+    // Safe to call off the GUI thread.
+    static QStringList run(const Template &map, const QVector<Page> &pages, const Options &options,
+                           Progress *progress = nullptr);
+
+private:
+    static bool writePage(const QString &filePath, const QByteArray &bytes, bool gzip, QString *error);
+
+    static constexpr int AREA_CHUNK_SIZE = 256;
+};
+
+#endif // BATCHEXPORTER_H
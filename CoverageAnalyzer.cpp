@@ -0,0 +1,288 @@
+#include "CoverageAnalyzer.h"
+#include "Parallel.h"
+#include "Rasterizer.h"
+#include "TraceRecorder.h"
+#include <QPainter>
+#include <QThreadPool>
+#include <QtMath>
+#include <vector>
+
+struct CoverageAnalyzer::Job
+{
+    QVector<MapArea> areas;
+    QSize size;
+    qreal simplifyTolerance = -1;
+    CoverageStats result;
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+};
+
+namespace {
+
+// An area as the browser sees it: coordinates rounded as in the HTML
+struct ExportShape {
+    HotspotShape shape = HotspotShape::Rectangle;
+    QRectF rect;
+    QPointF center;
+    qreal radius = 0;
+    QPolygonF polygon;
+    int top = 0;
+    int bottom = -1;
+};
+
+ExportShape exportShape(const MapArea &area, qreal simplifyTolerance)
+{
+    ExportShape s;
+    s.shape = area.shape;
+    QRectF bounds;
+    switch (area.shape) {
+    case HotspotShape::Rectangle:
+        s.rect = QRectF(QPointF(qRound(area.rect.left()), qRound(area.rect.top())),
+                        QPointF(qRound(area.rect.right()), qRound(area.rect.bottom()))).normalized();
+        bounds = s.rect;
+        break;
+    case HotspotShape::Circle:
+        s.center = QPointF(qRound(area.center.x()), qRound(area.center.y()));
+        s.radius = qRound(area.radius);
+        bounds = QRectF(s.center - QPointF(s.radius, s.radius), QSizeF(2 * s.radius, 2 * s.radius));
+        break;
+    case HotspotShape::Polygon:
+        for (const QPoint &p : area.exportPolygon(simplifyTolerance)) {
+            s.polygon.append(QPointF(p));
+        }
+        bounds = s.polygon.boundingRect();
+        break;
+    }
+    s.top = qFloor(bounds.top());
+    s.bottom = qCeil(bounds.bottom());
+    return s;
+}
+
+void fillShape(const ExportShape &s, const QRect &clip, const Rasterizer::SpanFunction &span)
+{
+    switch (s.shape) {
+    case HotspotShape::Rectangle:
+        Rasterizer::fillRect(s.rect, clip, span);
+        break;
+    case HotspotShape::Circle:
+        Rasterizer::fillCircle(s.center, s.radius, clip, span);
+        break;
+    case HotspotShape::Polygon:
+        Rasterizer::fillPolygon(s.polygon, clip, span);
+        break;
+    }
+}
+
+} // namespace
+
+CoverageAnalyzer::CoverageAnalyzer(QObject *parent)
+    : QObject(parent)
+{
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(m_pollTimer, &QTimer::timeout, this, &CoverageAnalyzer::pollJob);
+}
+
+CoverageAnalyzer::~CoverageAnalyzer()
+{
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+    }
+}
+
+CoverageStats CoverageAnalyzer::compute(const QVector<MapArea> &areas, const QSize &size,
+                                        qreal simplifyTolerance, const std::atomic<bool> *cancelled)
+{
+    TRACE_SCOPE("CoverageAnalyzer::compute");
+
+    CoverageStats stats;
+    stats.size = size;
+    stats.areas.resize(areas.size());
+    if (size.isEmpty()) {
+        return stats;
+    }
+
+    const int width = size.width();
+    const int height = size.height();
+    const int count = areas.size();
+
+    std::vector<ExportShape> shapes(count);
+    parallelFor(count, [&](int i) {
+        shapes[i] = exportShape(areas.at(i), simplifyTolerance);
+    });
+
+    // Bands are whole heatmap cells high, so each cell is written by one band
+    static_assert(BAND_HEIGHT % HeatmapCell == 0, "bands must align with heatmap cells");
+    const int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::vector<std::vector<int>> bandAreas(bandCount);
+    for (int i = 0; i < count; ++i) {
+        if (shapes[i].bottom < 0 || shapes[i].top >= height) {
+            continue;
+        }
+        const int first = qMax(0, shapes[i].top) / BAND_HEIGHT;
+        const int last = qMin(height - 1, shapes[i].bottom) / BAND_HEIGHT;
+        for (int band = first; band <= last; ++band) {
+            bandAreas[band].push_back(i);
+        }
+    }
+
+    std::unique_ptr<std::atomic<qint64>[]> areaPixels(new std::atomic<qint64>[count]());
+    std::unique_ptr<std::atomic<qint64>[]> areaOverlap(new std::atomic<qint64>[count]());
+    std::atomic<qint64> covered{0};
+    std::atomic<qint64> overlap{0};
+
+    const int cellsX = (width + HeatmapCell - 1) / HeatmapCell;
+    const int cellsY = (height + HeatmapCell - 1) / HeatmapCell;
+    std::vector<quint32> uncoveredCells(static_cast<size_t>(cellsX) * cellsY, 0);
+
+    parallelFor(bandCount, [&](int band) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        const int y0 = band * BAND_HEIGHT;
+        const int rows = qMin(BAND_HEIGHT, height - y0);
+        const QRect clip(0, y0, width, rows);
+        std::vector<quint16> counts(static_cast<size_t>(width) * rows, 0);
+
+        // First pass counts how many areas cover each pixel...
+        for (int i : bandAreas[band]) {
+            qint64 pixels = 0;
+            fillShape(shapes[i], clip, [&](int y, int x0, int x1) {
+                quint16 *row = counts.data() + static_cast<size_t>(y - y0) * width;
+                for (int x = x0; x < x1; ++x) {
+                    if (row[x] < 0xffff) {
+                        ++row[x];
+                    }
+                }
+                pixels += x1 - x0;
+            });
+            areaPixels[i].fetch_add(pixels, std::memory_order_relaxed);
+        }
+
+        // ...the second finds each area's pixels that another area covers too
+        for (int i : bandAreas[band]) {
+            qint64 shared = 0;
+            fillShape(shapes[i], clip, [&](int y, int x0, int x1) {
+                const quint16 *row = counts.data() + static_cast<size_t>(y - y0) * width;
+                for (int x = x0; x < x1; ++x) {
+                    shared += row[x] > 1;
+                }
+            });
+            areaOverlap[i].fetch_add(shared, std::memory_order_relaxed);
+        }
+
+        qint64 bandCovered = 0;
+        qint64 bandOverlap = 0;
+        for (int y = 0; y < rows; ++y) {
+            const quint16 *row = counts.data() + static_cast<size_t>(y) * width;
+            quint32 *cells = uncoveredCells.data() + static_cast<size_t>((y0 + y) / HeatmapCell) * cellsX;
+            for (int x = 0; x < width; ++x) {
+                if (row[x] == 0) {
+                    ++cells[x / HeatmapCell];
+                } else {
+                    ++bandCovered;
+                    bandOverlap += row[x] > 1;
+                }
+            }
+        }
+        covered.fetch_add(bandCovered, std::memory_order_relaxed);
+        overlap.fetch_add(bandOverlap, std::memory_order_relaxed);
+    });
+
+    stats.coveredPixels = covered.load();
+    stats.overlapPixels = overlap.load();
+    for (int i = 0; i < count; ++i) {
+        stats.areas[i].pixels = areaPixels[i].load();
+        stats.areas[i].overlapPixels = areaOverlap[i].load();
+    }
+
+    stats.uncovered = QImage(cellsX, cellsY, QImage::Format_Grayscale8);
+    for (int cy = 0; cy < cellsY; ++cy) {
+        uchar *row = stats.uncovered.scanLine(cy);
+        const int cellHeight = qMin(HeatmapCell, height - cy * HeatmapCell);
+        for (int cx = 0; cx < cellsX; ++cx) {
+            const int cellWidth = qMin(HeatmapCell, width - cx * HeatmapCell);
+            const quint32 uncovered = uncoveredCells[static_cast<size_t>(cy) * cellsX + cx];
+            row[cx] = static_cast<uchar>(uncovered * 255 / (cellWidth * cellHeight));
+        }
+    }
+    return stats;
+}
+
+QImage CoverageAnalyzer::renderHeatmap(const CoverageStats &stats, const QImage &background)
+{
+    const QSize size = background.isNull() ? stats.size : background.size();
+    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+    if (size.isEmpty()) {
+        return result;
+    }
+
+    QPainter painter(&result);
+    if (background.isNull()) {
+        result.fill(QColor(45, 45, 48));
+    } else {
+        painter.drawImage(0, 0, background);
+        painter.fillRect(result.rect(), QColor(0, 0, 0, 140));
+    }
+
+    QImage overlay(stats.uncovered.size(), QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < overlay.height(); ++y) {
+        const uchar *source = stats.uncovered.constScanLine(y);
+        QRgb *row = reinterpret_cast<QRgb*>(overlay.scanLine(y));
+        for (int x = 0; x < overlay.width(); ++x) {
+            const int alpha = source[x] * 200 / 255;
+            row[x] = qPremultiply(qRgba(230, 40, 40, alpha));
+        }
+    }
+    // Blocky on purpose: each block is one heatmap cell
+    painter.drawImage(QRectF(result.rect()), overlay);
+    painter.end();
+    return result;
+}
+
+void CoverageAnalyzer::request(const QVector<MapArea> &areas, const QSize &size, qreal simplifyTolerance)
+{
+    auto job = std::make_shared<Job>();
+    job->areas = areas;
+    job->size = size;
+    job->simplifyTolerance = simplifyTolerance;
+    m_pending = job;
+
+    // A running job is out of date; let it stop early and start the new one
+    // once it has
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+    } else {
+        startJob();
+    }
+}
+
+void CoverageAnalyzer::startJob()
+{
+    if (!m_pending) {
+        return;
+    }
+    std::shared_ptr<Job> job = std::move(m_pending);
+    m_job = job;
+    QThreadPool::globalInstance()->start([job]() {
+        job->result = compute(job->areas, job->size, job->simplifyTolerance, &job->cancelled);
+        job->done.store(true, std::memory_order_release);
+    });
+    m_pollTimer->start();
+}
+
+void CoverageAnalyzer::pollJob()
+{
+    if (!m_job || !m_job->done.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::shared_ptr<Job> job = std::move(m_job);
+    m_pollTimer->stop();
+
+    if (!job->cancelled.load(std::memory_order_relaxed)) {
+        m_stats = job->result;
+        emit statsReady();
+    }
+    startJob();
+}
@@ -0,0 +1,81 @@
+#ifndef COVERAGEANALYZER_H
+#define COVERAGEANALYZER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "MapArea.h"
+
+// How much of the image the exported map makes clickable
+struct CoverageStats
+{
+    QSize size;                 // output pixels
+    qint64 coveredPixels = 0;   // inside at least one area
+    qint64 overlapPixels = 0;   // inside two or more areas
+
+    struct Area {
+        qint64 pixels = 0;
+        qint64 overlapPixels = 0; // shared with another area
+    };
+    QVector<Area> areas;        // same order as the analysed areas
+
+    // Uncovered share of each HeatmapCell x HeatmapCell block, 0..255
+    QImage uncovered;
+
+    qint64 totalPixels() const { return static_cast<qint64>(size.width()) * size.height(); }
+    qreal coveredFraction() const { return totalPixels() > 0 ? qreal(coveredPixels) / totalPixels() : 0; }
+};
+
+// Rasterizes every area of a map into a per-pixel coverage count and derives
+// the statistics from it. Areas are rasterized as exported (rounded, and
+// simplified if requested). The image is cut into horizontal bands that are
+// filled in parallel, each only touching the areas that cross it.
+//
+// As a QObject it recomputes in the background on request, dropping stale
+// results, so it can follow every edit.
+class CoverageAnalyzer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int HeatmapCell = 8;
+
+    explicit CoverageAnalyzer(QObject *parent = nullptr);
+    ~CoverageAnalyzer() override;
+
+    static CoverageStats compute(const QVector<MapArea> &areas, const QSize &size,
+                                 qreal simplifyTolerance = -1,
+                                 const std::atomic<bool> *cancelled = nullptr);
+
+    // Uncovered blocks in red over a dimmed copy of the background, at the
+    // background's size (or the analysed size without one)
+    static QImage renderHeatmap(const CoverageStats &stats, const QImage &background = QImage());
+
+    // Starts a background computation; newer requests replace older ones
+    void request(const QVector<MapArea> &areas, const QSize &size, qreal simplifyTolerance = -1);
+    bool isBusy() const { return m_job != nullptr; }
+    const CoverageStats &stats() const { return m_stats; }
+
+signals:
+    void statsReady();
+
+private:
+    struct Job;
+
+    void startJob();
+    void pollJob();
+
+    CoverageStats m_stats;
+    std::shared_ptr<Job> m_job;
+    std::shared_ptr<Job> m_pending;
+    QTimer *m_pollTimer;
+
+    static constexpr int BAND_HEIGHT = 64;
+    static constexpr int POLL_INTERVAL_MS = 30;
+};
+
+#endif // COVERAGEANALYZER_H
@@ -0,0 +1,177 @@
+#include "CropExporter.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QDir>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPainter>
+#include <QPainterPath>
+#include <QTextStream>
+#include <vector>
+
+QList<QByteArray> CropExporter::supportedFormats()
+{
+    const QList<QByteArray> writable = QImageWriter::supportedImageFormats();
+    QList<QByteArray> formats;
+    for (const QByteArray &format : {QByteArray("png"), QByteArray("jpg"), QByteArray("webp")}) {
+        if (writable.contains(format)) {
+            formats.append(format);
+        }
+    }
+    return formats;
+}
+
+QString CropExporter::fileName(int index, int size, const QByteArray &format)
+{
+    QString name = QString("area-%1").arg(index + 1, 4, 10, QChar('0'));
+    if (size > 0) {
+        name += QString("-%1").arg(size);
+    }
+    return name + "." + QString::fromLatin1(format);
+}
+
+QRectF CropExporter::bounds(const MapArea &area)
+{
+    switch (area.shape) {
+    case HotspotShape::Rectangle:
+        return area.rect.normalized();
+    case HotspotShape::Circle:
+        return QRectF(area.center - QPointF(area.radius, area.radius), QSizeF(2 * area.radius, 2 * area.radius));
+    case HotspotShape::Polygon:
+        return area.polygon.boundingRect();
+    }
+    return QRectF();
+}
+
+QImage CropExporter::crop(const QImage &image, const QString &imagePath, const QRect &rect)
+{
+    // Copying from the decoded image is always cheaper than reading again;
+    // a clip rectangle read is only worth it when nothing is in memory, and
+    // even then a JPEG decoder still has to run through every row above it
+    if (!image.isNull()) {
+        return image.copy(rect);
+    }
+
+    QImageReader reader(imagePath);
+    if (reader.supportsOption(QImageIOHandler::ClipRect)) {
+        reader.setClipRect(rect);
+        return reader.read();
+    }
+    return reader.read().copy(rect);
+}
+
+QImage CropExporter::masked(const QImage &crop, const MapArea &area, const QPoint &origin)
+{
+    QImage result = crop.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QPainterPath shape;
+    if (area.shape == HotspotShape::Circle) {
+        shape.addEllipse(area.center, area.radius, area.radius);
+    } else {
+        shape.addPolygon(area.polygon);
+        shape.closeSubpath();
+    }
+    shape.translate(-origin);
+
+    QPainter painter(&result);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+    painter.fillPath(shape, Qt::black);
+    painter.end();
+    return result;
+}
+
+QImage CropExporter::flattened(const QImage &crop)
+{
+    QImage result(crop.size(), QImage::Format_RGB32);
+    result.fill(Qt::white);
+    QPainter painter(&result);
+    painter.drawImage(0, 0, crop);
+    painter.end();
+    return result;
+}
+
+QStringList CropExporter::run(const QImage &image, const QString &imagePath, const QVector<MapArea> &areas,
+                              const Options &options, Progress *progress)
+{
+    TRACE_SCOPE("CropExporter::run");
+
+    const QDir dir(options.directory);
+    if (!dir.exists() && !QDir().mkpath(options.directory)) {
+        return {QString("Cannot create folder %1").arg(options.directory)};
+    }
+
+    const bool opaque = options.format == "jpg" || options.format == "jpeg";
+    // Without a loaded image the header is enough for the bounds
+    const QRect imageRect = image.isNull() ? QRect(QPoint(), QImageReader(imagePath).size()) : image.rect();
+    std::vector<QString> errors(areas.size());
+
+    parallelFor(areas.size(), [&](int i) {
+        if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        const MapArea &area = areas.at(i);
+        const QRect rect = bounds(area).toAlignedRect().intersected(imageRect);
+        if (rect.isEmpty()) {
+            errors[i] = QString("Area %1 lies outside the image").arg(i + 1);
+        } else if (QImage cropped = crop(image, imagePath, rect); cropped.isNull()) {
+            errors[i] = QString("Area %1: cannot read %2").arg(i + 1).arg(imagePath);
+        } else {
+            if (options.mask && area.shape != HotspotShape::Rectangle) {
+                cropped = masked(cropped, area, rect.topLeft());
+            }
+            // Formats without alpha get a white background
+            if (opaque && cropped.hasAlphaChannel()) {
+                cropped = flattened(cropped);
+            }
+
+            for (int size : options.sizes) {
+                QImage thumbnail = cropped;
+                // Only ever scaled down
+                if (size > 0 && qMax(cropped.width(), cropped.height()) > size) {
+                    thumbnail = cropped.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                }
+                QImageWriter writer(dir.filePath(fileName(i, size, options.format)), options.format);
+                writer.setQuality(options.quality);
+                if (!writer.write(thumbnail)) {
+                    errors[i] = QString("%1: %2").arg(writer.fileName(), writer.errorString());
+                    break;
+                }
+            }
+        }
+
+        if (progress) {
+            progress->done.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    QStringList messages;
+    for (const QString &error : errors) {
+        if (!error.isEmpty()) {
+            messages.append(error);
+        }
+    }
+    if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+        return messages;
+    }
+
+    // Manifest for reviewing alt texts next to the images
+    QFile manifest(dir.filePath("crops.csv"));
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        messages.append(QString("Cannot write %1").arg(manifest.fileName()));
+        return messages;
+    }
+    auto field = [](QString text) {
+        return "\"" + text.replace("\"", "\"\"") + "\"";
+    };
+    QTextStream out(&manifest);
+    out << "index,file,url,alt,title\n";
+    for (int i = 0; i < areas.size(); ++i) {
+        out << i + 1 << ',' << field(fileName(i, options.sizes.value(0), options.format)) << ','
+            << field(areas.at(i).url) << ',' << field(areas.at(i).altText) << ','
+            << field(areas.at(i).title) << '\n';
+    }
+    return messages;
+}
@@ -0,0 +1,57 @@
+#ifndef CROPEXPORTER_H
+#define CROPEXPORTER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "MapArea.h"
+
+// Cuts the bounding box of every area out of the image and writes it as a
+// thumbnail at one or more sizes, plus a crops.csv listing each file with
+// its URL, alt text and title.
+//
+// Crops are copied out of the loaded image. Given only a path, they are read
+// from the file with a clip rectangle where the format supports it. Areas
+// are spread over the thread pool and each worker holds one crop at a time,
+// which bounds memory by the number of threads rather than the number of
+// hotspots.
+class CropExporter
+{
+public:
+    struct Options {
+        QString directory;
+        QByteArray format = "png";
+        QVector<int> sizes{0};  // longest edge of each thumbnail; 0 keeps the crop's size
+        bool mask = true;       // clear pixels outside circles and polygons
+        int quality = 90;
+    };
+
+    // Shared with the GUI thread while running
+    struct Progress {
+        std::atomic<int> done{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    // png, jpg and webp, if the Qt image plugins can write them
+    static QList<QByteArray> supportedFormats();
+
+    // Areas must be in image pixel coordinates. image may be null, in which
+    // case crops are decoded from imagePath. Returns error messages, or an
+    // empty list if every file was written. Safe to call off the GUI thread.
+    static QStringList run(const QImage &image, const QString &imagePath, const QVector<MapArea> &areas,
+                           const Options &options, Progress *progress = nullptr);
+
+    static QString fileName(int index, int size, const QByteArray &format);
+
+private:
+    static QImage crop(const QImage &image, const QString &imagePath, const QRect &rect);
+    static QImage masked(const QImage &crop, const MapArea &area, const QPoint &origin);
+    static QImage flattened(const QImage &crop);
+    static QRectF bounds(const MapArea &area);
+};
+
+#endif // CROPEXPORTER_H
@@ -0,0 +1,166 @@
+#include "EdgeMap.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QThreadPool>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EDGEMAP_SSE2 1
+#endif
+
+// Sobel magnitude (|gx| + |gy|) / 4, saturated to 255, for pixels [x0, x1) of
+// the row between above and below.
+static void sobelRow(const uchar *above, const uchar *row, const uchar *below,
+                     int x0, int x1, quint8 *out)
+{
+    int x = x0;
+
+#ifdef EDGEMAP_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    auto load = [zero](const uchar *p) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+
+    for (; x + 8 <= x1; x += 8) {
+        __m128i a0 = load(above + x - 1), b0 = load(above + x), c0 = load(above + x + 1);
+        __m128i a1 = load(row + x - 1), c1 = load(row + x + 1);
+        __m128i a2 = load(below + x - 1), b2 = load(below + x), c2 = load(below + x + 1);
+
+        __m128i right = _mm_add_epi16(_mm_add_epi16(c0, c2), _mm_slli_epi16(c1, 1));
+        __m128i left = _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_slli_epi16(a1, 1));
+        __m128i gx = _mm_sub_epi16(right, left);
+
+        __m128i bottom = _mm_add_epi16(_mm_add_epi16(a2, c2), _mm_slli_epi16(b2, 1));
+        __m128i top = _mm_add_epi16(_mm_add_epi16(a0, c0), _mm_slli_epi16(b0, 1));
+        __m128i gy = _mm_sub_epi16(bottom, top);
+
+        __m128i absX = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+        __m128i absY = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+        __m128i mag = _mm_srli_epi16(_mm_add_epi16(absX, absY), 2);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x - x0), _mm_packus_epi16(mag, zero));
+    }
+#endif
+
+    for (; x < x1; ++x) {
+        int gx = (above[x + 1] + 2 * row[x + 1] + below[x + 1])
+               - (above[x - 1] + 2 * row[x - 1] + below[x - 1]);
+        int gy = (below[x - 1] + 2 * below[x] + below[x + 1])
+               - (above[x - 1] + 2 * above[x] + above[x + 1]);
+        out[x - x0] = static_cast<quint8>(qMin(255, (std::abs(gx) + std::abs(gy)) >> 2));
+    }
+}
+
+EdgeMap::EdgeMap(const QImage &image)
+    : m_image(image)
+    , m_size(image.size())
+{
+    m_tilesX = (m_size.width() + TileSize - 1) / TileSize;
+    m_tilesY = (m_size.height() + TileSize - 1) / TileSize;
+    m_tiles.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+}
+
+std::shared_ptr<EdgeMap> EdgeMap::buildAsync(const QImage &image)
+{
+    std::shared_ptr<EdgeMap> map(new EdgeMap(image));
+    if (image.isNull()) {
+        return map;
+    }
+
+    QThreadPool::globalInstance()->start([map]() {
+        TRACE_SCOPE("EdgeMap::build");
+        parallelFor(static_cast<int>(map->m_tiles.size()), [&map](int tileIndex) {
+            if (!map->m_cancelled.load(std::memory_order_relaxed)) {
+                map->buildTile(tileIndex);
+            }
+        });
+        map->m_image = QImage(); // the source is no longer needed
+        if (!map->m_cancelled.load(std::memory_order_relaxed)) {
+            map->m_ready.store(true, std::memory_order_release);
+        }
+    });
+
+    return map;
+}
+
+void EdgeMap::buildTile(int tileIndex)
+{
+    const int tileX = (tileIndex % m_tilesX) * TileSize;
+    const int tileY = (tileIndex / m_tilesX) * TileSize;
+    const int width = qMin(TileSize, m_size.width() - tileX);
+    const int height = qMin(TileSize, m_size.height() - tileY);
+
+    // Convert only this tile plus a one pixel border
+    QRect source = QRect(tileX - 1, tileY - 1, width + 2, height + 2)
+                       .intersected(QRect(QPoint(0, 0), m_size));
+    QImage gray = m_image.copy(source).convertToFormat(QImage::Format_Grayscale8);
+
+    std::vector<quint8> &tile = m_tiles[tileIndex];
+    tile.assign(static_cast<size_t>(TileSize) * TileSize, 0);
+
+    // Pixels on the image border have no full neighbourhood and stay 0
+    const int x0 = qMax(tileX, 1);
+    const int x1 = qMin(tileX + width, m_size.width() - 1);
+    const int y0 = qMax(tileY, 1);
+    const int y1 = qMin(tileY + height, m_size.height() - 1);
+
+    for (int y = y0; y < y1; ++y) {
+        const uchar *row = gray.constScanLine(y - source.top());
+        const uchar *above = gray.constScanLine(y - 1 - source.top());
+        const uchar *below = gray.constScanLine(y + 1 - source.top());
+        quint8 *out = tile.data() + static_cast<size_t>(y - tileY) * TileSize + (x0 - tileX);
+        sobelRow(above - source.left(), row - source.left(), below - source.left(), x0, x1, out);
+    }
+}
+
+int EdgeMap::magnitude(int x, int y) const
+{
+    if (!isReady() || x < 0 || y < 0 || x >= m_size.width() || y >= m_size.height()) {
+        return 0;
+    }
+
+    const std::vector<quint8> &tile = m_tiles[static_cast<size_t>(y / TileSize) * m_tilesX + x / TileSize];
+    return tile[static_cast<size_t>(y % TileSize) * TileSize + x % TileSize];
+}
+
+bool EdgeMap::snap(const QPointF &pos, qreal radius, int threshold, QPointF *snapped) const
+{
+    if (!isReady()) {
+        return false;
+    }
+
+    const int cx = static_cast<int>(std::floor(pos.x()));
+    const int cy = static_cast<int>(std::floor(pos.y()));
+    const int r = qBound(1, static_cast<int>(std::ceil(radius)), MaxSnapRadius);
+    const qreal falloff = 1.0 / (r + 1);
+
+    qreal bestScore = 0;
+    QPoint best(-1, -1);
+
+    for (int y = qMax(0, cy - r); y <= qMin(m_size.height() - 1, cy + r); ++y) {
+        for (int x = qMax(0, cx - r); x <= qMin(m_size.width() - 1, cx + r); ++x) {
+            int mag = magnitude(x, y);
+            if (mag < threshold) {
+                continue;
+            }
+            qreal distance = std::sqrt(qreal((x - cx) * (x - cx) + (y - cy) * (y - cy)));
+            if (distance > r) {
+                continue;
+            }
+            qreal score = mag * (1.0 - distance * falloff);
+            if (score > bestScore) {
+                bestScore = score;
+                best = QPoint(x, y);
+            }
+        }
+    }
+
+    if (best.x() < 0) {
+        return false;
+    }
+
+    *snapped = QPointF(best.x() + 0.5, best.y() + 0.5);
+    return true;
+}
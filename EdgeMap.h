@@ -0,0 +1,50 @@
+#ifndef EDGEMAP_H
+#define EDGEMAP_H
+
+#include <QImage>
+#include <QPointF>
+#include <QSize>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Gradient-magnitude (Sobel) map of an image, stored as 8-bit tiles so it
+// scales to very large images. Built on the thread pool; queries are cheap
+// enough to run on every mouse move once isReady() returns true.
+class EdgeMap
+{
+public:
+    static constexpr int TileSize = 256;
+    // Caps the work per query when a screen-space radius is used zoomed out
+    static constexpr int MaxSnapRadius = 32;
+
+    // Starts building in the background and returns immediately
+    static std::shared_ptr<EdgeMap> buildAsync(const QImage &image);
+
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+    QSize size() const { return m_size; }
+
+    // Edge strength at a pixel (0..255). Returns 0 before the map is ready.
+    int magnitude(int x, int y) const;
+
+    // Finds the strongest edge within radius of pos, preferring nearer pixels.
+    // radius is in image pixels, at most MaxSnapRadius. Returns false if
+    // nothing reaches threshold.
+    bool snap(const QPointF &pos, qreal radius, int threshold, QPointF *snapped) const;
+
+private:
+    explicit EdgeMap(const QImage &image);
+    void buildTile(int tileIndex);
+
+    QImage m_image;
+    QSize m_size;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    std::vector<std::vector<quint8>> m_tiles;
+    std::atomic<bool> m_ready{false};
+    std::atomic<bool> m_cancelled{false};
+};
+
+#endif // EDGEMAP_H
@@ -0,0 +1,246 @@
+#include "Geometry.h"
+#include <QVector>
+#include <QPair>
+#include <cmath>
+
+namespace Geometry {
+
+qreal distanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    const qreal dx = b.x() - a.x();
+    const qreal dy = b.y() - a.y();
+    const qreal lengthSquared = dx * dx + dy * dy;
+
+    if (lengthSquared <= 0) {
+        return std::hypot(p.x() - a.x(), p.y() - a.y());
+    }
+
+    qreal t = ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / lengthSquared;
+    t = qBound(0.0, t, 1.0);
+    return std::hypot(p.x() - (a.x() + t * dx), p.y() - (a.y() + t * dy));
+}
+
+QPolygonF simplifyPolyline(const QPolygonF &polyline, qreal tolerance)
+{
+    const int n = static_cast<int>(polyline.size());
+    if (n < 3 || tolerance <= 0) {
+        return polyline;
+    }
+
+    // Iterative to survive contours with hundreds of thousands of points
+    QVector<bool> keep(n, false);
+    keep[0] = true;
+    keep[n - 1] = true;
+
+    QVector<QPair<int, int>> stack;
+    stack.append(qMakePair(0, n - 1));
+
+    while (!stack.isEmpty()) {
+        QPair<int, int> range = stack.takeLast();
+        const QPointF &a = polyline.at(range.first);
+        const QPointF &b = polyline.at(range.second);
+
+        qreal maxDistance = 0;
+        int index = -1;
+        for (int i = range.first + 1; i < range.second; ++i) {
+            qreal d = distanceToSegment(polyline.at(i), a, b);
+            if (d > maxDistance) {
+                maxDistance = d;
+                index = i;
+            }
+        }
+
+        if (index >= 0 && maxDistance > tolerance) {
+            keep[index] = true;
+            stack.append(qMakePair(range.first, index));
+            stack.append(qMakePair(index, range.second));
+        }
+    }
+
+    QPolygonF result;
+    for (int i = 0; i < n; ++i) {
+        if (keep.at(i)) {
+            result.append(polyline.at(i));
+        }
+    }
+    return result;
+}
+
+QPolygonF simplifyPolygon(const QPolygonF &polygon, qreal tolerance)
+{
+    const int n = static_cast<int>(polygon.size());
+    if (n < 4 || tolerance <= 0) {
+        return polygon;
+    }
+
+    // Split the ring at the point farthest from the first one and simplify
+    // both halves as polylines
+    int far = 0;
+    qreal maxDistance = -1;
+    for (int i = 1; i < n; ++i) {
+        qreal d = std::hypot(polygon.at(i).x() - polygon.at(0).x(),
+                             polygon.at(i).y() - polygon.at(0).y());
+        if (d > maxDistance) {
+            maxDistance = d;
+            far = i;
+        }
+    }
+
+    QPolygonF first(polygon.mid(0, far + 1));
+    QPolygonF second(polygon.mid(far));
+    second.append(polygon.at(0));
+
+    QPolygonF result = simplifyPolyline(first, tolerance);
+    QPolygonF tail = simplifyPolyline(second, tolerance);
+    // Skip the shared split point and the repeated first point
+    for (int i = 1; i < tail.size() - 1; ++i) {
+        result.append(tail.at(i));
+    }
+
+    if (result.size() < 3) {
+        return polygon;
+    }
+    return result;
+}
+
+void StreamingSimplifier::reset(qreal tolerance)
+{
+    m_tolerance = tolerance;
+    m_committed.clear();
+    m_pending.clear();
+}
+
+bool StreamingSimplifier::addPoint(const QPointF &point)
+{
+    if (m_committed.isEmpty()) {
+        m_committed.append(point);
+        return true;
+    }
+    if (!m_pending.isEmpty() && m_pending.last() == point) {
+        return false;
+    }
+
+    // Can the segment from the anchor to the new point still stand in for
+    // everything seen since the anchor?
+    const QPointF anchor = m_committed.last();
+    bool fits = m_pending.size() < MaxPending;
+    for (int i = 0; fits && i < m_pending.size(); ++i) {
+        fits = distanceToSegment(m_pending.at(i), anchor, point) <= m_tolerance;
+    }
+
+    if (fits || m_pending.isEmpty()) {
+        m_pending.append(point);
+        return false;
+    }
+
+    m_committed.append(m_pending.last());
+    m_pending.clear();
+    m_pending.append(point);
+    return true;
+}
+
+QPolygonF StreamingSimplifier::result() const
+{
+    QPolygonF path = m_committed;
+    if (!m_pending.isEmpty()) {
+        path.append(m_pending.last());
+    }
+    return path;
+}
+
+static qreal orientation(const QPointF &a, const QPointF &b, const QPointF &c)
+{
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+static QRectF segmentBounds(const QPointF &a, const QPointF &b)
+{
+    return QRectF(QPointF(qMin(a.x(), b.x()), qMin(a.y(), b.y())),
+                  QPointF(qMax(a.x(), b.x()), qMax(a.y(), b.y())));
+}
+
+// Closed ranges, so degenerate (zero-width) segment bounds still intersect
+static bool boundsTouch(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right()
+        && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+bool segmentsCross(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d)
+{
+    const qreal d1 = orientation(c, d, a);
+    const qreal d2 = orientation(c, d, b);
+    const qreal d3 = orientation(a, b, c);
+    const qreal d4 = orientation(a, b, d);
+    return ((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0))
+        && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0));
+}
+
+bool polygonsOverlap(const QPolygonF &a, const QPolygonF &b)
+{
+    const int na = static_cast<int>(a.size());
+    const int nb = static_cast<int>(b.size());
+    if (na < 3 || nb < 3) {
+        return false;
+    }
+
+    const QRectF region = a.boundingRect().intersected(b.boundingRect());
+    if (region.isEmpty()) {
+        return false;
+    }
+
+    // Only edges reaching into the shared bounding region can cross
+    QVector<int> edgesB;
+    for (int j = 0; j < nb; ++j) {
+        if (boundsTouch(segmentBounds(b.at(j), b.at((j + 1) % nb)), region)) {
+            edgesB.append(j);
+        }
+    }
+    for (int i = 0; i < na; ++i) {
+        const QPointF &p1 = a.at(i);
+        const QPointF &p2 = a.at((i + 1) % na);
+        const QRectF edgeBounds = segmentBounds(p1, p2);
+        if (!boundsTouch(edgeBounds, region)) {
+            continue;
+        }
+        for (int j : edgesB) {
+            const QPointF &q1 = b.at(j);
+            const QPointF &q2 = b.at((j + 1) % nb);
+            if (boundsTouch(edgeBounds, segmentBounds(q1, q2)) && segmentsCross(p1, p2, q1, q2)) {
+                return true;
+            }
+        }
+    }
+
+    // No crossings: either one contains the other or they are disjoint
+    for (const QPointF &p : a) {
+        if (region.contains(p) && b.containsPoint(p, Qt::OddEvenFill)) {
+            return true;
+        }
+    }
+    for (const QPointF &p : b) {
+        if (region.contains(p) && a.containsPoint(p, Qt::OddEvenFill)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool polygonOverlapsCircle(const QPolygonF &polygon, const QPointF &center, qreal radius)
+{
+    const int n = static_cast<int>(polygon.size());
+    if (n < 3 || radius <= 0) {
+        return false;
+    }
+    if (polygon.containsPoint(center, Qt::OddEvenFill)) {
+        return true;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (distanceToSegment(center, polygon.at(i), polygon.at((i + 1) % n)) < radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Geometry
@@ -0,0 +1,63 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <QPolygonF>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+// Polygon helpers shared by the detection, drawing and export code
+namespace Geometry {
+
+// Distance from p to the segment a-b
+qreal distanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b);
+
+// Douglas-Peucker simplification of an open polyline; endpoints are kept
+QPolygonF simplifyPolyline(const QPolygonF &polyline, qreal tolerance);
+
+// Douglas-Peucker simplification of a closed polygon (first point not repeated)
+QPolygonF simplifyPolygon(const QPolygonF &polygon, qreal tolerance);
+
+// True if segments a-b and c-d cross at a single interior point; touching
+// endpoints and collinear overlaps do not count
+bool segmentsCross(const QPointF &a, const QPointF &b, const QPointF &c, const QPointF &d);
+
+// True if the interiors of two closed polygons overlap. Polygons that only
+// share boundary points are not considered overlapping.
+bool polygonsOverlap(const QPolygonF &a, const QPolygonF &b);
+
+// True if a closed polygon and a circle overlap
+bool polygonOverlapsCircle(const QPolygonF &polygon, const QPointF &center, qreal radius);
+
+// Simplifies a stream of points as they arrive. A point is committed only
+// once a later point shows that skipping it would move the path by more than
+// the tolerance, so the committed path grows by the points that matter and
+// the work per incoming point stays bounded.
+class StreamingSimplifier
+{
+public:
+    explicit StreamingSimplifier(qreal tolerance = 1.0) : m_tolerance(tolerance) {}
+
+    void reset(qreal tolerance);
+
+    // Returns true if the point caused a new committed point
+    bool addPoint(const QPointF &point);
+
+    const QPolygonF &committed() const { return m_committed; }
+    bool hasTail() const { return !m_pending.isEmpty(); }
+    QPointF tail() const { return m_pending.isEmpty() ? QPointF() : m_pending.last(); }
+
+    // Committed points plus the latest point
+    QPolygonF result() const;
+
+private:
+    static constexpr int MaxPending = 256;
+
+    qreal m_tolerance;
+    QPolygonF m_committed;
+    QVector<QPointF> m_pending; // raw points since the last committed one
+};
+
+} // namespace Geometry
+
+#endif // GEOMETRY_H
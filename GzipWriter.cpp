@@ -0,0 +1,146 @@
+#include "GzipWriter.h"
+#include <QtEndian>
+#include <array>
+
+#ifndef HAVE_ZLIB
+namespace {
+
+// Header with no name, time or extra fields, "unknown" OS
+const char GzipHeader[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+
+} // namespace
+#endif
+
+GzipWriter::GzipWriter(const QString &filePath, int level)
+    : m_file(filePath)
+    , m_level(qBound(1, level, 9))
+{
+}
+
+GzipWriter::~GzipWriter()
+{
+#ifdef HAVE_ZLIB
+    if (m_open) {
+        deflateEnd(&m_stream);
+    }
+#endif
+}
+
+quint32 GzipWriter::crc32(quint32 crc, const char *data, qint64 size)
+{
+    static const std::array<quint32, 256> table = []() {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uchar>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool GzipWriter::open()
+{
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+#ifdef HAVE_ZLIB
+    m_stream = z_stream();
+    // 16 + 15 window bits asks zlib for the gzip container
+    if (deflateInit2(&m_stream, m_level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        m_error = "Cannot initialise compression";
+        m_file.close();
+        return false;
+    }
+#endif
+    m_open = true;
+    return true;
+}
+
+#ifdef HAVE_ZLIB
+bool GzipWriter::deflateInto(int flush)
+{
+    char buffer[64 * 1024];
+    int status;
+    do {
+        m_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        m_stream.avail_out = sizeof(buffer);
+        status = deflate(&m_stream, flush);
+        if (status == Z_STREAM_ERROR) {
+            m_error = "Compression failed";
+            return false;
+        }
+        const qint64 produced = sizeof(buffer) - m_stream.avail_out;
+        if (produced > 0 && m_file.write(buffer, produced) != produced) {
+            m_error = m_file.errorString();
+            return false;
+        }
+    } while (m_stream.avail_out == 0);
+    return true;
+}
+#endif
+
+bool GzipWriter::write(const QByteArray &data)
+{
+    if (!m_open) {
+        return false;
+    }
+#ifdef HAVE_ZLIB
+    m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    m_stream.avail_in = static_cast<uInt>(data.size());
+    return deflateInto(Z_NO_FLUSH);
+#else
+    m_crc = crc32(m_crc, data.constData(), data.size());
+    m_pending.append(data);
+    return true;
+#endif
+}
+
+bool GzipWriter::close()
+{
+    if (!m_open) {
+        return false;
+    }
+    m_open = false;
+
+#ifdef HAVE_ZLIB
+    m_stream.next_in = nullptr;
+    m_stream.avail_in = 0;
+    const bool ok = deflateInto(Z_FINISH);
+    deflateEnd(&m_stream);
+    m_file.close();
+    return ok;
+#else
+    // qCompress output is a 4-byte length, a 2-byte zlib header, the raw
+    // deflate stream and a 4-byte Adler-32; gzip wants just the stream
+    const QByteArray compressed = qCompress(m_pending, m_level);
+    if (compressed.size() < 10) {
+        m_error = "Compression failed";
+        m_file.close();
+        return false;
+    }
+
+    char trailer[8];
+    qToLittleEndian<quint32>(m_crc, trailer);
+    qToLittleEndian<quint32>(static_cast<quint32>(m_pending.size()), trailer + 4);
+
+    bool ok = m_file.write(GzipHeader, sizeof(GzipHeader)) == sizeof(GzipHeader);
+    ok = ok && m_file.write(compressed.constData() + 6, compressed.size() - 10) == compressed.size() - 10;
+    ok = ok && m_file.write(trailer, sizeof(trailer)) == sizeof(trailer);
+    if (!ok) {
+        m_error = m_file.errorString();
+    }
+    m_pending.clear();
+    m_file.close();
+    return ok;
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef GZIPWRITER_H
+#define GZIPWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Writes a .gz file as data is appended, for hosts that serve precompressed
+// files next to the originals.
+//
+// With zlib available at build time each write is deflated straight into
+// the file. Without it the data is collected, compressed with qCompress on
+// close and rewrapped from the zlib to the gzip container.
+class GzipWriter
+{
+public:
+    explicit GzipWriter(const QString &filePath, int level = 9);
+    ~GzipWriter();
+
+    GzipWriter(const GzipWriter &) = delete;
+    GzipWriter &operator=(const GzipWriter &) = delete;
+
+    bool open();
+    bool write(const QByteArray &data);
+    // Finishes the stream; the file is incomplete until this succeeds
+    bool close();
+
+    QString errorString() const { return m_error; }
+
+    static quint32 crc32(quint32 crc, const char *data, qint64 size);
+
+private:
+    QFile m_file;
+    int m_level;
+    QString m_error;
+    bool m_open = false;
+#ifdef HAVE_ZLIB
+    z_stream m_stream;
+    bool deflateInto(int flush);
+#else
+    QByteArray m_pending;
+    quint32 m_crc = 0;
+#endif
+};
+
+#endif // GZIPWRITER_H
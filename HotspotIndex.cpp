@@ -0,0 +1,174 @@
+#include "HotspotIndex.h"
+#include "HotspotItem.h"
+#include <algorithm>
+#include <cmath>
+
+HotspotIndex::HotspotIndex(qreal cellSize)
+    : m_cellSize(cellSize)
+{
+}
+
+QRect HotspotIndex::cellRange(const QRectF &rect) const
+{
+    return QRect(QPoint(static_cast<int>(std::floor(rect.left() / m_cellSize)),
+                        static_cast<int>(std::floor(rect.top() / m_cellSize))),
+                 QPoint(static_cast<int>(std::floor(rect.right() / m_cellSize)),
+                        static_cast<int>(std::floor(rect.bottom() / m_cellSize))));
+}
+
+quint64 HotspotIndex::cellKey(int x, int y)
+{
+    return (static_cast<quint64>(static_cast<quint32>(x)) << 32) | static_cast<quint32>(y);
+}
+
+void HotspotIndex::link(HotspotItem *hotspot, const Entry &entry)
+{
+    if (entry.large) {
+        m_large.append(hotspot);
+        return;
+    }
+    for (int y = entry.cells.top(); y <= entry.cells.bottom(); ++y) {
+        for (int x = entry.cells.left(); x <= entry.cells.right(); ++x) {
+            m_cells[cellKey(x, y)].append(hotspot);
+        }
+    }
+}
+
+void HotspotIndex::unlink(HotspotItem *hotspot, const Entry &entry)
+{
+    if (entry.large) {
+        m_large.removeOne(hotspot);
+        return;
+    }
+    for (int y = entry.cells.top(); y <= entry.cells.bottom(); ++y) {
+        for (int x = entry.cells.left(); x <= entry.cells.right(); ++x) {
+            auto it = m_cells.find(cellKey(x, y));
+            if (it != m_cells.end()) {
+                it->removeOne(hotspot);
+                if (it->isEmpty()) {
+                    m_cells.erase(it);
+                }
+            }
+        }
+    }
+}
+
+void HotspotIndex::insert(HotspotItem *hotspot)
+{
+    if (m_entries.contains(hotspot)) {
+        update(hotspot);
+        return;
+    }
+
+    const QRectF sceneBounds = hotspot->mapRectToScene(hotspot->boundingRect());
+    Entry entry;
+    entry.cells = cellRange(sceneBounds);
+    entry.serial = m_nextSerial++;
+    entry.large = static_cast<qint64>(entry.cells.width()) * entry.cells.height() > MaxCellsPerItem;
+    link(hotspot, entry);
+    m_entries.insert(hotspot, entry);
+    m_bounds = m_bounds.isNull() ? sceneBounds : m_bounds.united(sceneBounds);
+}
+
+void HotspotIndex::update(HotspotItem *hotspot)
+{
+    auto it = m_entries.find(hotspot);
+    if (it == m_entries.end()) {
+        insert(hotspot);
+        return;
+    }
+
+    const QRectF sceneBounds = hotspot->mapRectToScene(hotspot->boundingRect());
+    Entry entry = it.value();
+    const QRect cells = cellRange(sceneBounds);
+    if (cells != entry.cells) {
+        unlink(hotspot, entry);
+        entry.cells = cells;
+        entry.large = static_cast<qint64>(cells.width()) * cells.height() > MaxCellsPerItem;
+        link(hotspot, entry);
+        it.value() = entry;
+    }
+    m_bounds = m_bounds.united(sceneBounds);
+}
+
+void HotspotIndex::remove(HotspotItem *hotspot)
+{
+    auto it = m_entries.find(hotspot);
+    if (it == m_entries.end()) {
+        return;
+    }
+    unlink(hotspot, it.value());
+    m_entries.erase(it);
+}
+
+void HotspotIndex::clear()
+{
+    m_entries.clear();
+    m_cells.clear();
+    m_large.clear();
+    m_bounds = QRectF();
+}
+
+QVector<HotspotItem*> HotspotIndex::query(const QRectF &rect) const
+{
+    const QRect cells = cellRange(rect);
+    QVector<QPair<quint64, HotspotItem*>> found;
+
+    auto consider = [&](HotspotItem *hotspot) {
+        found.append(qMakePair(m_entries.value(hotspot).serial, hotspot));
+    };
+
+    const qint64 cellCount = static_cast<qint64>(cells.width()) * cells.height();
+    if (cellCount > static_cast<qint64>(m_cells.size())) {
+        // Cheaper to walk the occupied cells than the requested range
+        for (auto it = m_cells.constBegin(); it != m_cells.constEnd(); ++it) {
+            const int x = static_cast<qint32>(it.key() >> 32);
+            const int y = static_cast<qint32>(it.key() & 0xffffffffu);
+            if (cells.contains(x, y)) {
+                for (HotspotItem *hotspot : it.value()) {
+                    consider(hotspot);
+                }
+            }
+        }
+    } else {
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                auto it = m_cells.constFind(cellKey(x, y));
+                if (it != m_cells.constEnd()) {
+                    for (HotspotItem *hotspot : it.value()) {
+                        consider(hotspot);
+                    }
+                }
+            }
+        }
+    }
+    for (HotspotItem *hotspot : m_large) {
+        consider(hotspot);
+    }
+
+    // Items spanning several cells show up once per cell
+    std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    QVector<HotspotItem*> result;
+    result.reserve(found.size());
+    quint64 previous = ~0ULL;
+    for (const auto &entry : found) {
+        if (entry.first != previous
+            && rect.intersects(entry.second->mapRectToScene(entry.second->boundingRect()))) {
+            result.append(entry.second);
+        }
+        previous = entry.first;
+    }
+    return result;
+}
+
+HotspotItem *HotspotIndex::topmostAt(const QPointF &scenePos) const
+{
+    const QVector<HotspotItem*> candidates = query(QRectF(scenePos - QPointF(0.5, 0.5), QSizeF(1, 1)));
+    for (int i = candidates.size() - 1; i >= 0; --i) {
+        HotspotItem *hotspot = candidates.at(i);
+        if (hotspot->contains(hotspot->mapFromScene(scenePos))) {
+            return hotspot;
+        }
+    }
+    return nullptr;
+}
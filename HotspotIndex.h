@@ -0,0 +1,58 @@
+#ifndef HOTSPOTINDEX_H
+#define HOTSPOTINDEX_H
+
+#include <QHash>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+class HotspotItem;
+
+// Uniform grid over scene space mapping cells to the hotspots whose bounds
+// touch them. Used for hit testing and for culling in the batched renderer
+// without going through QGraphicsScene's own index. Hotspots remember the
+// order they were inserted in, which is also their stacking order.
+class HotspotIndex
+{
+public:
+    explicit HotspotIndex(qreal cellSize = 128.0);
+
+    void insert(HotspotItem *hotspot);
+    void update(HotspotItem *hotspot);
+    void remove(HotspotItem *hotspot);
+    void clear();
+
+    // Hotspots whose bounds intersect rect, bottom-most first
+    QVector<HotspotItem*> query(const QRectF &rect) const;
+
+    // Top-most hotspot whose shape contains the scene position
+    HotspotItem *topmostAt(const QPointF &scenePos) const;
+
+    // Union of all bounds inserted since the last clear()
+    QRectF bounds() const { return m_bounds; }
+
+private:
+    // Hotspots covering more cells than this go in a list that every query checks
+    static constexpr int MaxCellsPerItem = 4096;
+
+    struct Entry {
+        QRect cells;
+        quint64 serial = 0;
+        bool large = false;
+    };
+
+    QRect cellRange(const QRectF &rect) const;
+    static quint64 cellKey(int x, int y);
+    void link(HotspotItem *hotspot, const Entry &entry);
+    void unlink(HotspotItem *hotspot, const Entry &entry);
+
+    qreal m_cellSize;
+    QHash<HotspotItem*, Entry> m_entries;
+    QHash<quint64, QVector<HotspotItem*>> m_cells;
+    QVector<HotspotItem*> m_large;
+    quint64 m_nextSerial = 0;
+    QRectF m_bounds;
+};
+
+#endif // HOTSPOTINDEX_H
@@ -1,6 +1,9 @@
 #include "HotspotItem.h"
+#include "MapArea.h"
+#include "TraceRecorder.h"
 #include <QGraphicsSceneMouseEvent>
 #include <QCursor>
+#include <QTransform>
 #include <cmath>
 
 HotspotItem::HotspotItem(HotspotShape shape, QGraphicsItem *parent)
@@ -11,10 +14,34 @@ HotspotItem::HotspotItem(HotspotShape shape, QGraphicsItem *parent)
     m_id = QUuid::createUuid().toString(QUuid::WithoutBraces).left(8);
     setFlag(QGraphicsItem::ItemIsSelectable);
     setFlag(QGraphicsItem::ItemIsMovable);
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
     setAcceptHoverEvents(true);
     setCursor(Qt::OpenHandCursor);
 }
 
+HotspotItem *HotspotItem::fromArea(const MapArea &area)
+{
+    HotspotItem *hotspot = new HotspotItem(area.shape);
+    hotspot->setUrl(area.url);
+    hotspot->setAltText(area.altText);
+    hotspot->setTitle(area.title);
+
+    switch (area.shape) {
+    case HotspotShape::Rectangle:
+        hotspot->setRect(area.rect);
+        break;
+    case HotspotShape::Circle:
+        hotspot->setCenter(area.center);
+        hotspot->setRadius(area.radius);
+        break;
+    case HotspotShape::Polygon:
+        hotspot->setPolygon(area.polygon);
+        hotspot->closePolygon();
+        break;
+    }
+    return hotspot;
+}
+
 void HotspotItem::setRect(const QRectF &rect)
 {
     prepareGeometryChange();
@@ -37,12 +64,39 @@ void HotspotItem::setPolygon(const QPolygonF &polygon)
 {
     prepareGeometryChange();
     m_polygon = polygon;
+    m_polygonBounds = polygon.boundingRect();
 }
 
 void HotspotItem::addPolygonPoint(const QPointF &point)
 {
     prepareGeometryChange();
     m_polygon.append(point);
+    extendPolygonBounds(point);
+}
+
+void HotspotItem::movePolygonPoint(int index, const QPointF &point)
+{
+    if (index < 0 || index >= m_polygon.size()) {
+        return;
+    }
+    prepareGeometryChange();
+    m_polygon[index] = point;
+    // Bounds may now be slightly too large, which is harmless for painting;
+    // setPolygon() restores the exact bounds
+    extendPolygonBounds(point);
+}
+
+void HotspotItem::extendPolygonBounds(const QPointF &point)
+{
+    if (m_polygon.size() == 1) {
+        m_polygonBounds = QRectF(point, QSizeF(0, 0));
+        return;
+    }
+    qreal left = qMin(m_polygonBounds.left(), point.x());
+    qreal top = qMin(m_polygonBounds.top(), point.y());
+    qreal right = qMax(m_polygonBounds.right(), point.x());
+    qreal bottom = qMax(m_polygonBounds.bottom(), point.y());
+    m_polygonBounds = QRectF(QPointF(left, top), QPointF(right, bottom));
 }
 
 void HotspotItem::closePolygon()
@@ -114,33 +168,146 @@ QString HotspotItem::generateAreaTag() const
     return tag;
 }
 
+QRectF HotspotItem::prototypeBounds() const
+{
+    switch (m_shape) {
+    case HotspotShape::Rectangle:
+        return m_rect;
+    case HotspotShape::Circle:
+        return QRectF(m_center.x() - m_radius, m_center.y() - m_radius, m_radius * 2, m_radius * 2);
+    case HotspotShape::Polygon:
+        return m_polygonBounds;
+    }
+    return QRectF();
+}
+
+void HotspotItem::scaleGeometry(qreal sx, qreal sy)
+{
+    const QTransform scale = QTransform::fromScale(sx, sy);
+    setRect(scale.mapRect(m_rect));
+    setCenter(scale.map(m_center));
+    setRadius(m_radius * std::sqrt(std::abs(sx * sy)));
+    setPolygon(scale.map(m_polygon));
+
+    if (isInstanced()) {
+        QVector<Instance> instances = m_instances;
+        for (Instance &instance : instances) {
+            instance.offset = scale.map(instance.offset);
+        }
+        setInstances(instances);
+    }
+}
+
 QRectF HotspotItem::boundingRect() const
 {
     const qreal padding = 4;
 
+    QRectF bounds = prototypeBounds();
+    if (isInstanced()) {
+        bounds = QRectF(bounds.topLeft() + m_instanceOffsetBounds.topLeft(),
+                        bounds.bottomRight() + m_instanceOffsetBounds.bottomRight());
+    }
+    return bounds.adjusted(-padding, -padding, padding, padding);
+}
+
+void HotspotItem::setInstances(const QVector<Instance> &instances)
+{
+    prepareGeometryChange();
+    m_instances = instances;
+    m_instanceOffsetBounds = QRectF();
+    if (m_instances.isEmpty()) {
+        return;
+    }
+
+    QPointF minOffset = m_instances.first().offset;
+    QPointF maxOffset = minOffset;
+    for (const Instance &instance : m_instances) {
+        minOffset.setX(qMin(minOffset.x(), instance.offset.x()));
+        minOffset.setY(qMin(minOffset.y(), instance.offset.y()));
+        maxOffset.setX(qMax(maxOffset.x(), instance.offset.x()));
+        maxOffset.setY(qMax(maxOffset.y(), instance.offset.y()));
+    }
+    m_instanceOffsetBounds = QRectF(minOffset, maxOffset);
+}
+
+void HotspotItem::setGridInstances(int rows, int columns, const QPointF &step, int firstRow, int firstColumn)
+{
+    QVector<Instance> instances;
+    instances.reserve(rows * columns);
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            Instance instance;
+            instance.offset = QPointF(c * step.x(), r * step.y());
+            instance.row = firstRow + r;
+            instance.column = firstColumn + c;
+            instances.append(instance);
+        }
+    }
+    // A 1x1 grid is just the plain hotspot
+    setInstances(instances.size() > 1 ? instances : QVector<Instance>());
+}
+
+int HotspotItem::instanceAt(const QPointF &point) const
+{
+    if (!isInstanced()) {
+        return prototypeContains(point) ? 0 : -1;
+    }
+    const QRectF bounds = prototypeBounds();
+    for (int i = 0; i < m_instances.size(); ++i) {
+        const QPointF local = point - m_instances.at(i).offset;
+        if (bounds.contains(local) && prototypeContains(local)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString HotspotItem::expandTemplate(const QString &text, int index) const
+{
+    if (!isInstanced()) {
+        return text;
+    }
+    return expandTemplate(text, m_instances.at(index), index);
+}
+
+QString HotspotItem::expandTemplate(const QString &text, const Instance &instance, int index)
+{
+    if (!text.contains('{')) {
+        return text;
+    }
+    QString result = text;
+    result.replace("{row}", QString::number(instance.row));
+    result.replace("{col}", QString::number(instance.column));
+    result.replace("{index}", QString::number(index + 1));
+    return result;
+}
+
+bool HotspotItem::prototypeContains(const QPointF &point) const
+{
     switch (m_shape) {
     case HotspotShape::Rectangle:
-        return m_rect.adjusted(-padding, -padding, padding, padding);
-    case HotspotShape::Circle: {
-        QRectF r(m_center.x() - m_radius - padding,
-                 m_center.y() - m_radius - padding,
-                 (m_radius + padding) * 2,
-                 (m_radius + padding) * 2);
-        return r;
-    }
+        return m_rect.contains(point);
+    case HotspotShape::Circle:
+        return std::hypot(point.x() - m_center.x(), point.y() - m_center.y()) <= m_radius;
     case HotspotShape::Polygon:
-        return m_polygon.boundingRect().adjusted(-padding, -padding, padding, padding);
+        return m_polygon.containsPoint(point, Qt::OddEvenFill);
     }
-    return QRectF();
+    return false;
+}
+
+bool HotspotItem::contains(const QPointF &point) const
+{
+    // Avoids building a path of every instance for each hit test
+    return instanceAt(point) >= 0;
 }
 
 void HotspotItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    Q_UNUSED(option)
     Q_UNUSED(widget)
 
-    painter->setRenderHint(QPainter::Antialiasing);
+    TRACE_SCOPE("HotspotItem::paint");
 
+    // Antialiasing follows the view, which turns it off while navigating
     QColor fillColor = m_color;
     QColor borderColor = m_color.darker(120);
     borderColor.setAlpha(200);
@@ -151,30 +318,40 @@ void HotspotItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
     }
 
     QPen pen(borderColor, 2, Qt::SolidLine);
+    if (m_conflicting) {
+        pen = QPen(QColor(230, 40, 40, 230), 2, Qt::DashLine);
+    }
     painter->setPen(pen);
     painter->setBrush(fillColor);
 
-    switch (m_shape) {
-    case HotspotShape::Rectangle:
-        painter->drawRect(m_rect);
-        break;
-    case HotspotShape::Circle:
-        painter->drawEllipse(m_center, m_radius, m_radius);
-        break;
-    case HotspotShape::Polygon:
-        if (m_polygonClosed) {
-            painter->drawPolygon(m_polygon);
+    if (isInstanced()) {
+        // Every instance in one call with shared pen and brush; instances
+        // outside the exposed area are skipped
+        const QRectF exposed = option->exposedRect;
+        const QRectF bounds = prototypeBounds().adjusted(-2, -2, 2, 2);
+        if (m_shape == HotspotShape::Rectangle) {
+            QVector<QRectF> rects;
+            rects.reserve(m_instances.size());
+            for (const Instance &instance : m_instances) {
+                if (exposed.intersects(bounds.translated(instance.offset))) {
+                    rects.append(m_rect.translated(instance.offset));
+                }
+            }
+            painter->drawRects(rects);
         } else {
-            painter->drawPolyline(m_polygon);
-            // Draw points
-            painter->setBrush(borderColor);
-            for (const QPointF &pt : m_polygon) {
-                painter->drawEllipse(pt, 4, 4);
+            for (const Instance &instance : m_instances) {
+                if (exposed.intersects(bounds.translated(instance.offset))) {
+                    painter->translate(instance.offset);
+                    paintPrototype(painter, borderColor);
+                    painter->translate(-instance.offset);
+                }
             }
         }
-        break;
+        return;
     }
 
+    paintPrototype(painter, borderColor);
+
     // Draw label
     if (!m_title.isEmpty() || !m_url.isEmpty()) {
         QString label = m_title.isEmpty() ? m_url : m_title;
@@ -193,7 +370,7 @@ void HotspotItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
             textPos = m_center;
             break;
         case HotspotShape::Polygon:
-            textPos = m_polygon.boundingRect().center();
+            textPos = m_polygonBounds.center();
             break;
         }
 
@@ -216,6 +393,30 @@ void HotspotItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
     }
 }
 
+void HotspotItem::paintPrototype(QPainter *painter, const QColor &borderColor)
+{
+    switch (m_shape) {
+    case HotspotShape::Rectangle:
+        painter->drawRect(m_rect);
+        break;
+    case HotspotShape::Circle:
+        painter->drawEllipse(m_center, m_radius, m_radius);
+        break;
+    case HotspotShape::Polygon:
+        if (m_polygonClosed) {
+            painter->drawPolygon(m_polygon);
+        } else {
+            painter->drawPolyline(m_polygon);
+            // Draw points
+            painter->setBrush(borderColor);
+            for (const QPointF &pt : m_polygon) {
+                painter->drawEllipse(pt, 4, 4);
+            }
+        }
+        break;
+    }
+}
+
 QPainterPath HotspotItem::shape() const
 {
     QPainterPath path;
@@ -232,6 +433,13 @@ QPainterPath HotspotItem::shape() const
         break;
     }
 
+    if (isInstanced()) {
+        QPainterPath all;
+        for (const Instance &instance : m_instances) {
+            all.addPath(path.translated(instance.offset));
+        }
+        return all;
+    }
     return path;
 }
 
@@ -241,6 +449,14 @@ void HotspotItem::setSelected(bool selected)
     update();
 }
 
+void HotspotItem::setConflicting(bool conflicting)
+{
+    if (m_conflicting != conflicting) {
+        m_conflicting = conflicting;
+        update();
+    }
+}
+
 void HotspotItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
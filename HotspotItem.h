@@ -9,6 +9,7 @@
 #include <QStyleOptionGraphicsItem>
 #include <QString>
 #include <QPolygonF>
+#include <QVector>
 #include <QUuid>
 
 enum class HotspotShape {
@@ -17,11 +18,16 @@ enum class HotspotShape {
     Polygon
 };
 
+struct MapArea;
+
 class HotspotItem : public QGraphicsItem
 {
 public:
     explicit HotspotItem(HotspotShape shape, QGraphicsItem *parent = nullptr);
 
+    // New hotspot with an area's shape and attributes, coordinates as given
+    static HotspotItem *fromArea(const MapArea &area);
+
     void setUrl(const QString &url) { m_url = url; }
     QString url() const { return m_url; }
 
@@ -48,10 +54,40 @@ public:
     // For polygon
     void setPolygon(const QPolygonF &polygon);
     void addPolygonPoint(const QPointF &point);
+    void movePolygonPoint(int index, const QPointF &point);
     QPolygonF polygon() const { return m_polygon; }
     void closePolygon();
     bool isPolygonClosed() const { return m_polygonClosed; }
 
+    // Instancing: the shape above acts as a prototype drawn once per
+    // instance offset, so thousands of identical shapes share one geometry
+    // and one item. {row}, {col} and {index} in the URL, alt text and title
+    // are replaced per instance on export.
+    struct Instance {
+        QPointF offset;
+        int row = 0;
+        int column = 0;
+    };
+    void setInstances(const QVector<Instance> &instances);
+    const QVector<Instance> &instances() const { return m_instances; }
+    bool isInstanced() const { return !m_instances.isEmpty(); }
+    int instanceCount() const { return isInstanced() ? static_cast<int>(m_instances.size()) : 1; }
+    // Rows run down and columns across, step apart, numbered from firstRow/firstColumn
+    void setGridInstances(int rows, int columns, const QPointF &step, int firstRow = 1, int firstColumn = 1);
+    // Instance containing a point in item coordinates, or -1
+    int instanceAt(const QPointF &point) const;
+    QPointF instanceOffset(int index) const { return isInstanced() ? m_instances.at(index).offset : QPointF(); }
+    QString expandTemplate(const QString &text, int index) const;
+    static QString expandTemplate(const QString &text, const Instance &instance, int index);
+
+    // Bounds of the prototype shape in item coordinates
+    QRectF prototypeBounds() const;
+
+    // Scales the shape and instance offsets about the item origin. Circles
+    // stay circles, with the radius scaled by the geometric mean
+    // of sx and sy.
+    void scaleGeometry(qreal sx, qreal sy);
+
     // Generate HTML coords attribute
     QString generateCoords() const;
     QString generateShapeName() const;
@@ -61,10 +97,15 @@ public:
     QRectF boundingRect() const override;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
     QPainterPath shape() const override;
+    bool contains(const QPointF &point) const override;
 
     void setSelected(bool selected);
     bool isItemSelected() const { return m_selected; }
 
+    // Marks the hotspot as overlapping another one
+    void setConflicting(bool conflicting);
+    bool isConflicting() const { return m_conflicting; }
+
     void setColor(const QColor &color) { m_color = color; }
     QColor color() const { return m_color; }
 
@@ -74,6 +115,10 @@ protected:
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
+    void extendPolygonBounds(const QPointF &point);
+    bool prototypeContains(const QPointF &point) const;
+    void paintPrototype(QPainter *painter, const QColor &borderColor);
+
     QString m_id;
     QString m_url;
     QString m_altText;
@@ -81,6 +126,7 @@ private:
     HotspotShape m_shape;
     QColor m_color;
     bool m_selected = false;
+    bool m_conflicting = false;
 
     // Rectangle data
     QRectF m_rect;
@@ -91,8 +137,13 @@ private:
 
     // Polygon data
     QPolygonF m_polygon;
+    QRectF m_polygonBounds;
     bool m_polygonClosed = false;
 
+    // Instances
+    QVector<Instance> m_instances;
+    QRectF m_instanceOffsetBounds;
+
     // Dragging
     QPointF m_dragStart;
     bool m_dragging = false;
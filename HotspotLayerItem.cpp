@@ -0,0 +1,118 @@
+#include "HotspotLayerItem.h"
+#include "HotspotIndex.h"
+#include "HotspotItem.h"
+#include "TraceRecorder.h"
+#include <QHash>
+#include <QPainter>
+#include <QPainterPath>
+#include <QStyleOptionGraphicsItem>
+
+HotspotLayerItem::HotspotLayerItem(const HotspotIndex *index, QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , m_index(index)
+{
+    setFlag(ItemUsesExtendedStyleOption);
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+void HotspotLayerItem::refresh()
+{
+    // Leave room for the 2px outline
+    const QRectF bounds = m_index->bounds().adjusted(-2, -2, 2, 2);
+    if (bounds != m_bounds) {
+        prepareGeometryChange();
+        m_bounds = bounds;
+    }
+    update();
+}
+
+QRectF HotspotLayerItem::boundingRect() const
+{
+    return m_bounds;
+}
+
+void HotspotLayerItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget)
+
+    TRACE_SCOPE("HotspotLayerItem::paint");
+
+    const QRectF exposed = option->exposedRect;
+    const QVector<HotspotItem*> visible = m_index->query(exposed);
+
+    struct Batch {
+        QColor color;
+        bool conflicting = false;
+        QVector<QRectF> rects;
+        QPainterPath path;
+    };
+    QVector<Batch> batches;
+    QHash<quint64, int> batchForStyle;
+
+    for (HotspotItem *hotspot : visible) {
+        // Hotspots in the scene are being edited and draw themselves
+        if (hotspot->scene()) {
+            continue;
+        }
+
+        const quint64 style = (static_cast<quint64>(hotspot->color().rgba()) << 1) | hotspot->isConflicting();
+        auto it = batchForStyle.constFind(style);
+        int batchIndex;
+        if (it == batchForStyle.constEnd()) {
+            batchIndex = batches.size();
+            batchForStyle.insert(style, batchIndex);
+            Batch batch;
+            batch.color = hotspot->color();
+            batch.conflicting = hotspot->isConflicting();
+            batch.path.setFillRule(Qt::WindingFill);
+            batches.append(batch);
+        } else {
+            batchIndex = it.value();
+        }
+        Batch &batch = batches[batchIndex];
+
+        const QRectF prototype = hotspot->prototypeBounds().adjusted(-2, -2, 2, 2);
+        for (int i = 0; i < hotspot->instanceCount(); ++i) {
+            const QPointF offset = hotspot->pos() + hotspot->instanceOffset(i);
+            if (hotspot->isInstanced() && !exposed.intersects(prototype.translated(offset))) {
+                continue;
+            }
+            switch (hotspot->hotspotShape()) {
+            case HotspotShape::Rectangle:
+                batch.rects.append(hotspot->rect().normalized().translated(offset));
+                break;
+            case HotspotShape::Circle:
+                batch.path.addEllipse(hotspot->center() + offset, hotspot->radius(), hotspot->radius());
+                break;
+            case HotspotShape::Polygon:
+                batch.path.addPolygon(hotspot->polygon().translated(offset));
+                batch.path.closeSubpath();
+                break;
+            }
+        }
+    }
+
+    // Groups are drawn one after another, so where hotspots of different
+    // colours overlap the stacking order is not kept. Overlaps are flagged
+    // as conflicts anyway.
+    if (visible.size() > ANTIALIAS_LIMIT) {
+        painter->setRenderHint(QPainter::Antialiasing, false);
+    }
+    for (const Batch &batch : batches) {
+        QColor borderColor = batch.color.darker(120);
+        borderColor.setAlpha(200);
+        QPen pen(borderColor, 2, Qt::SolidLine);
+        if (batch.conflicting) {
+            pen = QPen(QColor(230, 40, 40, 230), 2, Qt::DashLine);
+        }
+        painter->setPen(pen);
+        painter->setBrush(batch.color);
+
+        if (!batch.rects.isEmpty()) {
+            painter->drawRects(batch.rects);
+        }
+        if (!batch.path.isEmpty()) {
+            painter->drawPath(batch.path);
+        }
+    }
+}
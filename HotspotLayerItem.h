@@ -0,0 +1,31 @@
+#ifndef HOTSPOTLAYERITEM_H
+#define HOTSPOTLAYERITEM_H
+
+#include <QGraphicsItem>
+
+class HotspotIndex;
+
+// Draws every hotspot that is not itself in the scene as one item. Visible
+// hotspots come from the editor's spatial index and are grouped by fill
+// colour and conflict state, so each group takes one drawRects and one
+// drawPath call however many hotspots it holds. Labels are not drawn.
+class HotspotLayerItem : public QGraphicsItem
+{
+public:
+    explicit HotspotLayerItem(const HotspotIndex *index, QGraphicsItem *parent = nullptr);
+
+    // Call after hotspots are added, moved or removed
+    void refresh();
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    const HotspotIndex *m_index;
+    QRectF m_bounds;
+
+    // Above this many visible hotspots edges are drawn without antialiasing
+    static constexpr int ANTIALIAS_LIMIT = 2000;
+};
+
+#endif // HOTSPOTLAYERITEM_H
@@ -0,0 +1,544 @@
+#include "HtmlMapImporter.h"
+#include "Parallel.h"
+#include "ProjectFile.h"
+#include "TraceRecorder.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSet>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct Attribute {
+    const char *nameBegin;
+    const char *nameEnd;
+    const char *valueBegin;
+    const char *valueEnd;
+
+    bool is(const char *name) const
+    {
+        const int length = static_cast<int>(nameEnd - nameBegin);
+        return static_cast<int>(std::strlen(name)) == length && qstrnicmp(nameBegin, name, length) == 0;
+    }
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+inline bool isNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == ':';
+}
+
+// Case-insensitive search for needle, which must be lower case
+const char *findNoCase(const char *p, const char *end, const char *needle)
+{
+    const int length = static_cast<int>(std::strlen(needle));
+    while (end - p >= length) {
+        p = static_cast<const char*>(std::memchr(p, needle[0], end - p - length + 1));
+        if (!p) {
+            return nullptr;
+        }
+        if (qstrnicmp(p, needle, length) == 0) {
+            return p;
+        }
+        ++p;
+    }
+    return nullptr;
+}
+
+const char *find(const char *p, const char *end, const char *needle)
+{
+    const int length = static_cast<int>(std::strlen(needle));
+    while (end - p >= length) {
+        p = static_cast<const char*>(std::memchr(p, needle[0], end - p - length + 1));
+        if (!p) {
+            return nullptr;
+        }
+        if (std::memcmp(p, needle, length) == 0) {
+            return p;
+        }
+        ++p;
+    }
+    return nullptr;
+}
+
+// Reads attributes up to the closing '>' and returns the position after it.
+// Attributes are only collected when a list is given.
+const char *scanAttributes(const char *p, const char *end, std::vector<Attribute> *attributes)
+{
+    while (p < end) {
+        while (p < end && (isSpace(*p) || *p == '/')) {
+            ++p;
+        }
+        if (p >= end) {
+            break;
+        }
+        if (*p == '>') {
+            return p + 1;
+        }
+
+        Attribute attribute;
+        attribute.nameBegin = p;
+        while (p < end && !isSpace(*p) && *p != '=' && *p != '>' && *p != '/') {
+            ++p;
+        }
+        attribute.nameEnd = p;
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+
+        attribute.valueBegin = attribute.valueEnd = p;
+        if (p < end && *p == '=') {
+            ++p;
+            while (p < end && isSpace(*p)) {
+                ++p;
+            }
+            if (p < end && (*p == '"' || *p == '\'')) {
+                const char quote = *p++;
+                const char *close = static_cast<const char*>(std::memchr(p, quote, end - p));
+                attribute.valueBegin = p;
+                attribute.valueEnd = close ? close : end;
+                p = close ? close + 1 : end;
+            } else {
+                attribute.valueBegin = p;
+                while (p < end && !isSpace(*p) && *p != '>') {
+                    ++p;
+                }
+                attribute.valueEnd = p;
+            }
+        }
+        if (attributes && attribute.nameEnd > attribute.nameBegin) {
+            attributes->push_back(attribute);
+        }
+    }
+    return end;
+}
+
+const Attribute *findAttribute(const std::vector<Attribute> &attributes, const char *name)
+{
+    for (const Attribute &attribute : attributes) {
+        if (attribute.is(name)) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+struct ImageUse {
+    QString source;
+    QSize size;
+};
+
+// Coordinate lists are separated by commas and/or whitespace
+QVector<qreal> parseNumbers(const QString &text)
+{
+    QVector<qreal> values;
+    char buffer[64];
+    int length = 0;
+    auto flush = [&]() {
+        if (length > 0) {
+            buffer[length] = '\0';
+            values.append(std::strtod(buffer, nullptr));
+            length = 0;
+        }
+    };
+    for (const QChar c : text) {
+        const char ch = c.toLatin1();
+        if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' || ch == '+' || ch == 'e' || ch == 'E') {
+            if (length < static_cast<int>(sizeof(buffer)) - 1) {
+                buffer[length++] = ch;
+            }
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return values;
+}
+
+} // namespace
+
+QString HtmlMapImporter::decodeEntities(const char *begin, const char *end)
+{
+    const char *amp = static_cast<const char*>(std::memchr(begin, '&', end - begin));
+    if (!amp) {
+        return QString::fromUtf8(begin, static_cast<int>(end - begin));
+    }
+
+    QByteArray out;
+    out.reserve(static_cast<int>(end - begin));
+    const char *p = begin;
+    while (amp) {
+        out.append(p, static_cast<int>(amp - p));
+        const char *semicolon = static_cast<const char*>(std::memchr(amp, ';', qMin<ptrdiff_t>(end - amp, 12)));
+        uint code = 0;
+        if (semicolon) {
+            const QByteArray name(amp + 1, static_cast<int>(semicolon - amp - 1));
+            bool ok = false;
+            if (name.startsWith("#x") || name.startsWith("#X")) {
+                code = name.mid(2).toUInt(&ok, 16);
+            } else if (name.startsWith('#')) {
+                code = name.mid(1).toUInt(&ok, 10);
+            } else if (name == "amp") {
+                code = '&';
+            } else if (name == "lt") {
+                code = '<';
+            } else if (name == "gt") {
+                code = '>';
+            } else if (name == "quot") {
+                code = '"';
+            } else if (name == "apos") {
+                code = '\'';
+            } else if (name == "nbsp") {
+                code = 0xA0;
+            }
+            if (name.startsWith('#') && !ok) {
+                code = 0;
+            }
+        }
+        if (code > 0 && code <= 0x10FFFF) {
+            const char32_t ch = code;
+            out.append(QString::fromUcs4(&ch, 1).toUtf8());
+            p = semicolon + 1;
+        } else {
+            // Unknown entity; keep it as written
+            out.append('&');
+            p = amp + 1;
+        }
+        amp = static_cast<const char*>(std::memchr(p, '&', end - p));
+    }
+    out.append(p, static_cast<int>(end - p));
+    return QString::fromUtf8(out);
+}
+
+bool HtmlMapImporter::parseArea(const QString &shapeName, const QString &coords, MapArea *area)
+{
+    const QString shape = shapeName.trimmed().toLower();
+    const QVector<qreal> values = parseNumbers(coords);
+
+    // A missing shape means rect, as in browsers
+    if (shape.isEmpty() || shape == "rect" || shape == "rectangle") {
+        if (values.size() < 4) {
+            return false;
+        }
+        area->shape = HotspotShape::Rectangle;
+        area->rect = QRectF(QPointF(values[0], values[1]), QPointF(values[2], values[3])).normalized();
+        return true;
+    }
+    if (shape == "circle" || shape == "circ") {
+        if (values.size() < 3) {
+            return false;
+        }
+        area->shape = HotspotShape::Circle;
+        area->center = QPointF(values[0], values[1]);
+        area->radius = values[2];
+        return true;
+    }
+    if (shape == "poly" || shape == "polygon") {
+        if (values.size() < 6) {
+            return false;
+        }
+        area->shape = HotspotShape::Polygon;
+        area->polygon.reserve(values.size() / 2);
+        for (int i = 0; i + 1 < values.size(); i += 2) {
+            area->polygon.append(QPointF(values[i], values[i + 1]));
+        }
+        return true;
+    }
+    return false;
+}
+
+HtmlMapImporter::Result HtmlMapImporter::parse(const QByteArray &html)
+{
+    TRACE_SCOPE("HtmlMapImporter::parse");
+
+    Result result;
+    QHash<QString, ImageUse> images;
+    std::vector<Attribute> attributes;
+    int current = -1;
+    int skippedAreas = 0;
+
+    auto value = [&attributes](const char *name) {
+        const Attribute *attribute = findAttribute(attributes, name);
+        return attribute ? decodeEntities(attribute->valueBegin, attribute->valueEnd) : QString();
+    };
+
+    const char *p = html.constData();
+    const char *end = p + html.size();
+    while (p < end) {
+        p = static_cast<const char*>(std::memchr(p, '<', end - p));
+        if (!p) {
+            break;
+        }
+        ++p;
+
+        // Comments, doctype and processing instructions
+        if (end - p >= 3 && std::memcmp(p, "!--", 3) == 0) {
+            const char *close = find(p + 3, end, "-->");
+            p = close ? close + 3 : end;
+            continue;
+        }
+        if (p < end && (*p == '!' || *p == '?')) {
+            const char *close = static_cast<const char*>(std::memchr(p, '>', end - p));
+            p = close ? close + 1 : end;
+            continue;
+        }
+
+        const bool closing = p < end && *p == '/';
+        if (closing) {
+            ++p;
+        }
+        const char *nameBegin = p;
+        while (p < end && isNameChar(*p)) {
+            ++p;
+        }
+        const int nameLength = static_cast<int>(p - nameBegin);
+        if (nameLength == 0) {
+            continue;   // a literal '<' in text
+        }
+        auto nameIs = [nameBegin, nameLength](const char *name) {
+            return static_cast<int>(std::strlen(name)) == nameLength && qstrnicmp(nameBegin, name, nameLength) == 0;
+        };
+
+        const bool wanted = !closing && (nameIs("area") || nameIs("map") || nameIs("img"));
+        attributes.clear();
+        p = scanAttributes(p, end, wanted ? &attributes : nullptr);
+
+        if (closing) {
+            if (nameIs("map")) {
+                current = -1;
+            }
+            continue;
+        }
+
+        // Raw text elements may contain anything that looks like markup
+        if (nameIs("script") || nameIs("style")) {
+            const char *close = findNoCase(p, end, nameIs("script") ? "</script" : "</style");
+            p = close ? close : end;
+            continue;
+        }
+
+        if (nameIs("map")) {
+            ImportedMap map;
+            map.name = value("name");
+            if (map.name.isEmpty()) {
+                map.name = value("id");
+            }
+            result.maps.append(map);
+            current = result.maps.size() - 1;
+        } else if (nameIs("img")) {
+            QString usemap = value("usemap").trimmed();
+            if (usemap.startsWith('#')) {
+                usemap.remove(0, 1);
+            }
+            if (!usemap.isEmpty() && !images.contains(usemap)) {
+                ImageUse use;
+                use.source = value("src").trimmed();
+                use.size = QSize(value("width").toInt(), value("height").toInt());
+                images.insert(usemap, use);
+            }
+        } else if (nameIs("area")) {
+            MapArea area;
+            if (current < 0 || !parseArea(value("shape"), value("coords"), &area)) {
+                ++skippedAreas;
+                continue;
+            }
+            area.url = value("href");
+            if (area.url == "#") {
+                area.url.clear();
+            }
+            area.altText = value("alt");
+            area.title = value("title");
+            result.maps[current].areas.append(area);
+        }
+    }
+
+    for (ImportedMap &map : result.maps) {
+        const auto it = images.constFind(map.name);
+        if (it != images.constEnd()) {
+            map.imageSource = it->source;
+            map.declaredSize = it->size;
+        }
+    }
+    if (skippedAreas > 0) {
+        result.warnings.append(QString("Skipped %1 <area> tags outside a <map>, with shape=\"default\" or with "
+                                       "too few coordinates").arg(skippedAreas));
+    }
+    return result;
+}
+
+HtmlMapImporter::Result HtmlMapImporter::parseFile(const QString &filePath, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return Result();
+    }
+
+    // Parse straight from the mapped file where possible
+    const qint64 size = file.size();
+    if (uchar *data = size > 0 ? file.map(0, size) : nullptr) {
+        const Result result = parse(QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(size)));
+        file.unmap(data);
+        return result;
+    }
+    return parse(file.readAll());
+}
+
+QPointF HtmlMapImporter::scaleFor(const ImportedMap &map, const QSize &imageSize)
+{
+    if (imageSize.isEmpty() || map.declaredSize.width() <= 0 || map.declaredSize.height() <= 0) {
+        return QPointF(1, 1);
+    }
+    return QPointF(qreal(imageSize.width()) / map.declaredSize.width(),
+                   qreal(imageSize.height()) / map.declaredSize.height());
+}
+
+MapArea HtmlMapImporter::scaled(const MapArea &area, const QPointF &scale)
+{
+    if (scale == QPointF(1, 1)) {
+        return area;
+    }
+    MapArea result = area;
+    result.rect = QRectF(area.rect.left() * scale.x(), area.rect.top() * scale.y(),
+                         area.rect.width() * scale.x(), area.rect.height() * scale.y());
+    result.center = QPointF(area.center.x() * scale.x(), area.center.y() * scale.y());
+    result.radius = area.radius * (scale.x() + scale.y()) / 2;
+    for (QPointF &pt : result.polygon) {
+        pt = QPointF(pt.x() * scale.x(), pt.y() * scale.y());
+    }
+    return result;
+}
+
+QStringList HtmlMapImporter::convertToProjects(const QString &path, const QString &outputDirectory, bool *ok)
+{
+    TRACE_SCOPE("HtmlMapImporter::convertToProjects");
+
+    QStringList pages;
+    const QFileInfo info(path);
+    if (info.isDir()) {
+        const QDir dir(path);
+        for (const QString &name : dir.entryList({"*.html", "*.htm"}, QDir::Files, QDir::Name)) {
+            pages.append(dir.filePath(name));
+        }
+    } else {
+        pages.append(path);
+    }
+    if (!outputDirectory.isEmpty()) {
+        QDir().mkpath(outputDirectory);
+    }
+
+    // Projects are named after their page, with the extension kept only where
+    // two pages (a.html and a.htm) would otherwise write the same file
+    QHash<QString, int> baseNames;
+    for (const QString &page : pages) {
+        ++baseNames[QFileInfo(page).completeBaseName().toLower()];
+    }
+    QStringList stems;
+    for (const QString &page : pages) {
+        const QFileInfo info(page);
+        stems.append(baseNames.value(info.completeBaseName().toLower()) > 1 ? info.fileName()
+                                                                            : info.completeBaseName());
+    }
+
+    std::vector<QString> lines(pages.size());
+    std::vector<char> failed(pages.size(), 0);
+    parallelFor(pages.size(), [&](int i) {
+        const QFileInfo page(pages.at(i));
+        QString error;
+        const Result result = parseFile(page.filePath(), &error);
+        if (!error.isEmpty()) {
+            lines[i] = QString("%1: %2").arg(page.fileName(), error);
+            failed[i] = 1;
+            return;
+        }
+
+        QStringList written;
+        QSet<QString> usedNames;
+        int areaCount = 0;
+        for (const ImportedMap &map : result.maps) {
+            if (map.areas.isEmpty()) {
+                continue;
+            }
+
+            // Image paths in the project are absolute, as the editor saves them
+            QString imagePath;
+            QSize imageSize;
+            if (!map.imageSource.isEmpty()) {
+                imagePath = QDir::cleanPath(page.dir().absoluteFilePath(map.imageSource));
+                imageSize = QImageReader(imagePath).size();
+            }
+            const QPointF scale = scaleFor(map, imageSize);
+
+            QJsonArray hotspots;
+            for (const MapArea &area : map.areas) {
+                hotspots.append(ProjectFile::areaToJson(scaled(area, scale)));
+            }
+            areaCount += map.areas.size();
+
+            QJsonObject project;
+            project["imagePath"] = imagePath;
+            project["mapName"] = map.name;
+            project["hotspots"] = hotspots;
+
+            // The map name comes from the page, so only a safe subset of it
+            // goes into the file name
+            QString baseName = stems.at(i);
+            if (result.maps.size() > 1) {
+                static const QRegularExpression unsafe("[^A-Za-z0-9_-]+");
+                QString suffix = QString(map.name).replace(unsafe, "-");
+                if (suffix.isEmpty() || suffix == "-") {
+                    suffix = QString::number(written.size() + 1);
+                }
+                const QString name = suffix;
+                for (int n = 2; usedNames.contains(suffix.toLower()); ++n) {
+                    suffix = QString("%1-%2").arg(name).arg(n);
+                }
+                usedNames.insert(suffix.toLower());
+                baseName += "-" + suffix;
+            }
+            const QDir target(outputDirectory.isEmpty() ? page.absolutePath() : outputDirectory);
+            QFile file(target.filePath(baseName + ".imap"));
+            if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(project).toJson()) < 0) {
+                lines[i] = QString("%1: cannot write %2").arg(page.fileName(), file.fileName());
+                failed[i] = 1;
+                return;
+            }
+            written.append(QFileInfo(file).fileName());
+        }
+
+        if (written.isEmpty()) {
+            lines[i] = QString("%1: no image maps found").arg(page.fileName());
+        } else {
+            lines[i] = QString("%1: %2 areas -> %3").arg(page.fileName()).arg(areaCount).arg(written.join(", "));
+        }
+        for (const QString &warning : result.warnings) {
+            lines[i] += "\n  " + warning;
+        }
+    });
+
+    QStringList report;
+    bool allOk = true;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        report.append(lines[i]);
+        allOk = allOk && !failed[i];
+    }
+    if (ok) {
+        *ok = allOk && !pages.isEmpty();
+    }
+    return report;
+}
@@ -0,0 +1,55 @@
+#ifndef HTMLMAPIMPORTER_H
+#define HTMLMAPIMPORTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "MapArea.h"
+
+// Reads <map> elements back out of existing HTML pages.
+//
+// The page is tokenized in one forward pass over the raw UTF-8 bytes, read
+// through a memory map. Only <img>, <map>, </map> and <area> tags have
+// their attributes decoded; everything else, including comments and the
+// contents of <script> and <style>, is skipped with a byte search, so
+// multi-megabyte pages import in about the time it takes to read them.
+class HtmlMapImporter
+{
+public:
+    struct ImportedMap {
+        QString name;
+        QString imageSource;    // src of the <img> using the map, if any
+        QSize declaredSize;     // its width and height attributes, if given
+        QVector<MapArea> areas; // coordinates as written in the page
+    };
+
+    struct Result {
+        QVector<ImportedMap> maps;
+        QStringList warnings;
+    };
+
+    static Result parse(const QByteArray &html);
+    static Result parseFile(const QString &filePath, QString *error = nullptr);
+
+    // Scale from page coordinates to pixels of an image of imageSize,
+    // taking the <img> width and height into account
+    static QPointF scaleFor(const ImportedMap &map, const QSize &imageSize);
+
+    static MapArea scaled(const MapArea &area, const QPointF &scale);
+
+    // Converts a page, or every .html/.htm file in a directory, to .imap
+    // projects in outputDirectory (next to each page when empty). Pages are
+    // converted in parallel. A page with several maps gets one project per
+    // map, named after the page and a sanitised map name. Returns one line
+    // per page for the report.
+    static QStringList convertToProjects(const QString &path, const QString &outputDirectory, bool *ok = nullptr);
+
+private:
+    static QString decodeEntities(const char *begin, const char *end);
+    static bool parseArea(const QString &shape, const QString &coords, MapArea *area);
+};
+
+#endif // HTMLMAPIMPORTER_H
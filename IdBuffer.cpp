@@ -0,0 +1,203 @@
+#include "IdBuffer.h"
+#include "HotspotIndex.h"
+#include "HotspotItem.h"
+#include "Rasterizer.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cstring>
+
+IdBuffer::IdBuffer(const QSize &size, const HotspotIndex *index)
+    : m_size(size)
+    , m_index(index)
+    , m_tilesX((size.width() + TileSize - 1) / TileSize)
+    , m_tiles(static_cast<size_t>(m_tilesX) * ((size.height() + TileSize - 1) / TileSize))
+{
+    markAllDirty();
+}
+
+void IdBuffer::markDirty(const QRectF &sceneRect)
+{
+    const QRect region = sceneRect.toAlignedRect().intersected(QRect(QPoint(0, 0), m_size));
+    if (region.isEmpty()) {
+        return;
+    }
+    for (const QRect &existing : m_dirty) {
+        if (existing.contains(region)) {
+            return;
+        }
+    }
+    m_dirty.append(region);
+
+    // Many small regions are cheaper to handle as one
+    if (m_dirty.size() > MAX_DIRTY_RECTS) {
+        QRect merged;
+        for (const QRect &rect : m_dirty) {
+            merged = merged.united(rect);
+        }
+        m_dirty = {merged};
+    }
+}
+
+void IdBuffer::markAllDirty()
+{
+    m_dirty = {QRect(QPoint(0, 0), m_size)};
+    if (m_size.isEmpty()) {
+        m_dirty.clear();
+    }
+}
+
+void IdBuffer::updateHotspot(HotspotItem *hotspot)
+{
+    markDirty(m_rasterBounds.value(hotspot));
+    markDirty(hotspot->mapRectToScene(hotspot->boundingRect()));
+}
+
+void IdBuffer::removeHotspot(HotspotItem *hotspot)
+{
+    markDirty(m_rasterBounds.take(hotspot));
+    auto it = m_slotRanges.find(hotspot);
+    if (it != m_slotRanges.end()) {
+        for (int i = 0; i < it->second; ++i) {
+            m_slots[it->first + i] = Hit();
+        }
+        m_liveSlots -= it->second;
+        m_slotRanges.erase(it);
+    }
+}
+
+int IdBuffer::slotsFor(HotspotItem *hotspot)
+{
+    const int count = hotspot->instanceCount();
+    auto it = m_slotRanges.find(hotspot);
+    if (it != m_slotRanges.end()) {
+        if (it->second == count) {
+            return it->first;
+        }
+        // Instance count changed; the whole hotspot is dirty so nothing
+        // outside the flushed regions still refers to the old range
+        for (int i = 0; i < it->second; ++i) {
+            m_slots[it->first + i] = Hit();
+        }
+        m_liveSlots -= it->second;
+    }
+
+    const int first = m_slots.size();
+    for (int i = 0; i < count; ++i) {
+        m_slots.append(Hit{hotspot, i});
+    }
+    m_slotRanges.insert(hotspot, qMakePair(first, count));
+    m_liveSlots += count;
+    return first;
+}
+
+void IdBuffer::flush(const QList<HotspotItem*> &documentOrder)
+{
+    if (m_dirty.isEmpty()) {
+        return;
+    }
+
+    TRACE_SCOPE("IdBuffer::flush");
+
+    // Freed slots are only reclaimed by a full rebuild
+    if (m_slots.size() > 2 * m_liveSlots + 4096) {
+        m_slots.clear();
+        m_slotRanges.clear();
+        m_liveSlots = 0;
+        markAllDirty();
+    }
+
+    QHash<HotspotItem*, int> order;
+    order.reserve(documentOrder.size());
+    for (int i = 0; i < documentOrder.size(); ++i) {
+        order.insert(documentOrder.at(i), i);
+    }
+
+    const QVector<QRect> dirty = m_dirty;
+    m_dirty.clear();
+    for (const QRect &region : dirty) {
+        rasterize(region, order);
+    }
+}
+
+void IdBuffer::rasterize(const QRect &region, const QHash<HotspotItem*, int> &order)
+{
+    clearRegion(region);
+
+    // Last in the document first, so earlier areas overwrite later ones
+    QVector<HotspotItem*> hotspots = m_index->query(QRectF(region));
+    std::sort(hotspots.begin(), hotspots.end(), [&order](HotspotItem *a, HotspotItem *b) {
+        return order.value(a) > order.value(b);
+    });
+
+    for (HotspotItem *hotspot : hotspots) {
+        const int firstSlot = slotsFor(hotspot);
+        const QRectF prototype = hotspot->prototypeBounds();
+        for (int i = hotspot->instanceCount() - 1; i >= 0; --i) {
+            const QPointF offset = hotspot->pos() + hotspot->instanceOffset(i);
+            if (!prototype.translated(offset).intersects(QRectF(region))) {
+                continue;
+            }
+            const quint32 value = static_cast<quint32>(firstSlot + i + 1);
+            auto span = [this, value](int y, int x0, int x1) { fillSpan(y, x0, x1, value); };
+            switch (hotspot->hotspotShape()) {
+            case HotspotShape::Rectangle:
+                Rasterizer::fillRect(hotspot->rect().translated(offset), region, span);
+                break;
+            case HotspotShape::Circle:
+                Rasterizer::fillCircle(hotspot->center() + offset, hotspot->radius(), region, span);
+                break;
+            case HotspotShape::Polygon:
+                Rasterizer::fillPolygon(hotspot->polygon().translated(offset), region, span);
+                break;
+            }
+        }
+        m_rasterBounds.insert(hotspot, hotspot->mapRectToScene(hotspot->boundingRect()));
+    }
+}
+
+void IdBuffer::clearRegion(const QRect &region)
+{
+    for (int ty = region.top() / TileSize; ty <= region.bottom() / TileSize; ++ty) {
+        for (int tx = region.left() / TileSize; tx <= region.right() / TileSize; ++tx) {
+            std::unique_ptr<quint32[]> &tile = m_tiles[static_cast<size_t>(ty) * m_tilesX + tx];
+            if (!tile) {
+                continue;
+            }
+            const QRect part = region.intersected(QRect(tx * TileSize, ty * TileSize, TileSize, TileSize));
+            for (int y = part.top(); y <= part.bottom(); ++y) {
+                quint32 *row = tile.get() + (y - ty * TileSize) * TileSize + (part.left() - tx * TileSize);
+                std::memset(row, 0, sizeof(quint32) * part.width());
+            }
+        }
+    }
+}
+
+void IdBuffer::fillSpan(int y, int x0, int x1, quint32 value)
+{
+    const size_t rowTiles = static_cast<size_t>(y / TileSize) * m_tilesX;
+    const int localY = y % TileSize;
+    while (x0 < x1) {
+        const int tx = x0 / TileSize;
+        const int end = qMin(x1, (tx + 1) * TileSize);
+        std::unique_ptr<quint32[]> &tile = m_tiles[rowTiles + tx];
+        if (!tile) {
+            tile.reset(new quint32[TileSize * TileSize]());
+        }
+        std::fill_n(tile.get() + localY * TileSize + (x0 - tx * TileSize), end - x0, value);
+        x0 = end;
+    }
+}
+
+IdBuffer::Hit IdBuffer::at(const QPoint &pixel) const
+{
+    if (pixel.x() < 0 || pixel.y() < 0 || pixel.x() >= m_size.width() || pixel.y() >= m_size.height()) {
+        return Hit();
+    }
+    const std::unique_ptr<quint32[]> &tile =
+        m_tiles[static_cast<size_t>(pixel.y() / TileSize) * m_tilesX + pixel.x() / TileSize];
+    if (!tile) {
+        return Hit();
+    }
+    const quint32 value = tile[(pixel.y() % TileSize) * TileSize + pixel.x() % TileSize];
+    return value ? m_slots.at(static_cast<int>(value) - 1) : Hit();
+}
@@ -0,0 +1,76 @@
+#ifndef IDBUFFER_H
+#define IDBUFFER_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+class HotspotIndex;
+class HotspotItem;
+
+// Per-pixel map of which <area> a browser would pick for a click: every
+// hotspot instance is rasterized in reverse export order, so where areas
+// overlap the first one in the HTML ends up on top. Looking up the area
+// under the cursor is then a single read however many hotspots there are.
+//
+// Tiles are allocated on first write, so empty parts of large images cost
+// nothing. Changed hotspots only mark their old and new bounds dirty, and
+// flush() re-rasterizes just those regions.
+class IdBuffer
+{
+public:
+    static constexpr int TileSize = 256;
+
+    struct Hit {
+        HotspotItem *hotspot = nullptr;
+        int instance = -1;
+    };
+
+    IdBuffer(const QSize &size, const HotspotIndex *index);
+
+    QSize size() const { return m_size; }
+
+    // Added, moved or reshaped; re-rasterized on the next flush
+    void updateHotspot(HotspotItem *hotspot);
+    void removeHotspot(HotspotItem *hotspot);
+    void markAllDirty();
+    bool isDirty() const { return !m_dirty.isEmpty(); }
+
+    // Brings dirty regions up to date; documentOrder is the export order
+    void flush(const QList<HotspotItem*> &documentOrder);
+
+    // Area at a pixel; call flush() first after changes
+    Hit at(const QPoint &pixel) const;
+
+private:
+    void markDirty(const QRectF &sceneRect);
+    void rasterize(const QRect &region, const QHash<HotspotItem*, int> &order);
+    void clearRegion(const QRect &region);
+    void fillSpan(int y, int x0, int x1, quint32 value);
+    int slotsFor(HotspotItem *hotspot);
+
+    QSize m_size;
+    const HotspotIndex *m_index;
+    int m_tilesX;
+    std::vector<std::unique_ptr<quint32[]>> m_tiles;
+
+    // Pixel value v > 0 refers to m_slots[v - 1]; each hotspot owns a
+    // contiguous range of slots, one per instance
+    QVector<Hit> m_slots;
+    QHash<HotspotItem*, QPair<int, int>> m_slotRanges; // first slot, count
+    int m_liveSlots = 0;
+
+    // Scene bounds each hotspot was last rasterized with
+    QHash<HotspotItem*, QRectF> m_rasterBounds;
+    QVector<QRect> m_dirty;
+
+    static constexpr int MAX_DIRTY_RECTS = 64;
+};
+
+#endif // IDBUFFER_H
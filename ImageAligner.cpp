@@ -0,0 +1,535 @@
+#include "ImageAligner.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QRect>
+#include <QSize>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGEALIGNER_SSE2 1
+#endif
+
+namespace {
+
+constexpr int BASE_SIZE = 1024;         // longest side of the finest level searched
+constexpr int COARSE_SIZE = 64;         // and of the coarsest
+constexpr int MIN_PLANE_SIZE = 8;
+constexpr double MAX_SCALE_CHANGE = 1.5;
+constexpr double SCALE_STEP = 1.04;
+constexpr int CANDIDATES = 3;
+constexpr int LEVEL_RADIUS = 2;         // shifts tried around a candidate on each finer level
+constexpr double MIN_OVERLAP = 0.4;     // of the smaller image
+constexpr double FLAT_VARIANCE = 1e-4;  // per pixel; flat areas match anything
+constexpr double NO_MATCH = -2;
+
+constexpr int PATCH_SIZE = 64;          // longest side of a region when refining
+constexpr double PATCH_MARGIN = 0.25;   // context around a region, of its size
+constexpr double SEARCH_RADIUS = 0.15;  // how far a region may move, of its size
+constexpr double MIN_SEARCH_RADIUS = 3;
+
+// Grayscale 0..1
+struct Plane
+{
+    int width = 0;
+    int height = 0;
+    std::vector<float> pixels;
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+    float *row(int y) { return pixels.data() + static_cast<size_t>(y) * width; }
+    const float *row(int y) const { return pixels.data() + static_cast<size_t>(y) * width; }
+};
+
+// Summed-area tables of the values and their squares, one row and column
+// larger than the plane
+struct Integral
+{
+    Integral() = default;
+
+    explicit Integral(const Plane &plane)
+        : stride(plane.width + 1)
+        , sum(static_cast<size_t>(stride) * (plane.height + 1), 0.0)
+        , squares(sum.size(), 0.0)
+    {
+        for (int y = 0; y < plane.height; ++y) {
+            const float *src = plane.row(y);
+            const double *sumAbove = &sum[static_cast<size_t>(y) * stride];
+            const double *squaresAbove = &squares[static_cast<size_t>(y) * stride];
+            double *sumRow = &sum[static_cast<size_t>(y + 1) * stride];
+            double *squaresRow = &squares[static_cast<size_t>(y + 1) * stride];
+            double rowSum = 0;
+            double rowSquares = 0;
+            for (int x = 0; x < plane.width; ++x) {
+                rowSum += src[x];
+                rowSquares += double(src[x]) * src[x];
+                sumRow[x + 1] = sumAbove[x + 1] + rowSum;
+                squaresRow[x + 1] = squaresAbove[x + 1] + rowSquares;
+            }
+        }
+    }
+
+    static double rect(const std::vector<double> &table, int stride, int x0, int y0, int x1, int y1)
+    {
+        return table[static_cast<size_t>(y1) * stride + x1] - table[static_cast<size_t>(y0) * stride + x1]
+             - table[static_cast<size_t>(y1) * stride + x0] + table[static_cast<size_t>(y0) * stride + x0];
+    }
+
+    int stride = 0;
+    std::vector<double> sum;
+    std::vector<double> squares;
+};
+
+Plane toPlane(const QImage &image)
+{
+    const QImage gray = image.convertToFormat(QImage::Format_Grayscale8);
+    Plane plane;
+    plane.width = gray.width();
+    plane.height = gray.height();
+    plane.pixels.resize(static_cast<size_t>(plane.width) * plane.height);
+    for (int y = 0; y < plane.height; ++y) {
+        const uchar *src = gray.constScanLine(y);
+        float *dst = plane.row(y);
+        for (int x = 0; x < plane.width; ++x) {
+            dst[x] = src[x] * (1.0f / 255);
+        }
+    }
+    return plane;
+}
+
+// Part of an image, smooth-scaled to size
+Plane toPlane(const QImage &image, const QRect &rect, const QSize &size)
+{
+    QImage part = rect == image.rect() ? image : image.copy(rect);
+    if (part.size() != size) {
+        part = part.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return toPlane(part);
+}
+
+// Half size, averaging 2x2 blocks
+Plane reduced(const Plane &src)
+{
+    Plane dst;
+    dst.width = src.width / 2;
+    dst.height = src.height / 2;
+    dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height);
+    for (int y = 0; y < dst.height; ++y) {
+        const float *a = src.row(2 * y);
+        const float *b = src.row(2 * y + 1);
+        float *out = dst.row(y);
+        for (int x = 0; x < dst.width; ++x) {
+            out[x] = 0.25f * (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1]);
+        }
+    }
+    return dst;
+}
+
+// Bilinear, with pixel centres aligned; meant for factors between 0.5 and 2
+Plane resampled(const Plane &src, int width, int height)
+{
+    Plane dst;
+    dst.width = width;
+    dst.height = height;
+    dst.pixels.resize(static_cast<size_t>(width) * height);
+
+    auto taps = [](int size, int srcSize, std::vector<int> &first, std::vector<float> &weight) {
+        first.resize(size);
+        weight.resize(size);
+        const float step = float(srcSize) / size;
+        for (int i = 0; i < size; ++i) {
+            const float pos = qBound(0.0f, (i + 0.5f) * step - 0.5f, float(srcSize - 1));
+            first[i] = qMin(int(pos), srcSize - 2 < 0 ? 0 : srcSize - 2);
+            weight[i] = srcSize > 1 ? pos - first[i] : 0.0f;
+        }
+    };
+    std::vector<int> xs, ys;
+    std::vector<float> wx, wy;
+    taps(width, src.width, xs, wx);
+    taps(height, src.height, ys, wy);
+
+    const int nextColumn = src.width > 1 ? 1 : 0;
+    for (int y = 0; y < height; ++y) {
+        const float *a = src.row(ys[y]);
+        const float *b = src.row(qMin(ys[y] + 1, src.height - 1));
+        const float fy = wy[y];
+        float *out = dst.row(y);
+        for (int x = 0; x < width; ++x) {
+            const int i = xs[x];
+            const float top = a[i] + (a[i + nextColumn] - a[i]) * wx[x];
+            const float bottom = b[i] + (b[i + nextColumn] - b[i]) * wx[x];
+            out[x] = top + (bottom - top) * fy;
+        }
+    }
+    return dst;
+}
+
+float dot(const float *a, const float *b, int n)
+{
+    int i = 0;
+    float sum = 0;
+
+#ifdef IMAGEALIGNER_SSE2
+    // Two accumulators hide the add latency
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// NCC of a with its top-left at (dx, dy) on b, over the part where they
+// overlap. NO_MATCH if that part is smaller than minOverlap or flat.
+double ncc(const Plane &a, const Integral &ia, const Plane &b, const Integral &ib, int dx, int dy, qint64 minOverlap)
+{
+    const int x0 = std::max(0, dx);
+    const int y0 = std::max(0, dy);
+    const int x1 = std::min(b.width, dx + a.width);
+    const int y1 = std::min(b.height, dy + a.height);
+    if (x1 <= x0 || y1 <= y0) {
+        return NO_MATCH;
+    }
+    const qint64 n = qint64(x1 - x0) * (y1 - y0);
+    if (n < minOverlap) {
+        return NO_MATCH;
+    }
+
+    const double sumA = Integral::rect(ia.sum, ia.stride, x0 - dx, y0 - dy, x1 - dx, y1 - dy);
+    const double squaresA = Integral::rect(ia.squares, ia.stride, x0 - dx, y0 - dy, x1 - dx, y1 - dy);
+    const double sumB = Integral::rect(ib.sum, ib.stride, x0, y0, x1, y1);
+    const double squaresB = Integral::rect(ib.squares, ib.stride, x0, y0, x1, y1);
+    const double varianceA = squaresA - sumA * sumA / n;
+    const double varianceB = squaresB - sumB * sumB / n;
+    if (varianceA < FLAT_VARIANCE * n || varianceB < FLAT_VARIANCE * n) {
+        return NO_MATCH;
+    }
+
+    double sumAB = 0;
+    const int length = x1 - x0;
+    for (int y = y0; y < y1; ++y) {
+        sumAB += dot(a.row(y - dy) + (x0 - dx), b.row(y) + x0, length);
+    }
+    return (sumAB - sumA * sumB / n) / std::sqrt(varianceA * varianceB);
+}
+
+// Offset of the peak of a parabola through three neighbouring scores
+double subPixel(double left, double centre, double right)
+{
+    if (left <= NO_MATCH || right <= NO_MATCH) {
+        return 0;
+    }
+    const double curvature = left - 2 * centre + right;
+    if (curvature >= 0) {
+        return 0;
+    }
+    return qBound(-0.5, 0.5 * (left - right) / curvature, 0.5);
+}
+
+std::vector<Plane> pyramid(const QImage &image, double factor, int minSize)
+{
+    std::vector<Plane> levels;
+    const QSize size(qMax(1, qRound(image.width() * factor)), qMax(1, qRound(image.height() * factor)));
+    levels.push_back(toPlane(image, image.rect(), size));
+    while (qMax(levels.back().width, levels.back().height) > minSize
+           && qMin(levels.back().width, levels.back().height) >= 2 * MIN_PLANE_SIZE) {
+        levels.push_back(reduced(levels.back()));
+    }
+    return levels;
+}
+
+struct Candidate
+{
+    double scale = 1;
+    int dx = 0;
+    int dy = 0;
+    double score = NO_MATCH;
+};
+
+// Placement of the old image on one level of the new one. The old image is
+// scaled by scale times the level's own factor, so a shift (dx, dy) on the
+// level is (dx / kx, dy / ky) in new image pixels.
+struct Level
+{
+    const Plane *plane;
+    Integral integral;
+    double kx;
+    double ky;
+};
+
+struct Search
+{
+    std::vector<Plane> oldLevels;
+    QSize oldSize;
+
+    Plane scaledOld(const Level &level, double scale) const
+    {
+        const int width = qRound(oldSize.width() * level.kx * scale);
+        const int height = qRound(oldSize.height() * level.ky * scale);
+        if (width < MIN_PLANE_SIZE || height < MIN_PLANE_SIZE) {
+            return Plane();
+        }
+        // The smallest level at least as large keeps bilinear within its range
+        size_t i = oldLevels.size() - 1;
+        while (i > 0 && (oldLevels[i].width < width || oldLevels[i].height < height)) {
+            --i;
+        }
+        return resampled(oldLevels[i], width, height);
+    }
+
+    static qint64 minOverlap(const Plane &a, const Plane &b)
+    {
+        return qint64(MIN_OVERLAP * std::min(qint64(a.width) * a.height, qint64(b.width) * b.height));
+    }
+};
+
+} // namespace
+
+ImageAligner::Result ImageAligner::estimate(const QImage &oldImage, const QImage &newImage, Progress *progress)
+{
+    TRACE_SCOPE("ImageAligner::estimate");
+
+    Result result;
+    if (oldImage.isNull() || newImage.isNull()) {
+        return result;
+    }
+    auto cancelled = [progress]() {
+        return progress && progress->cancelled.load(std::memory_order_relaxed);
+    };
+
+    // Scales are tried around both "same content, resized canvas" and
+    // "same pixel size, content moved"
+    const double ratio = std::sqrt(double(newImage.width()) * newImage.height()
+                                   / (double(oldImage.width()) * oldImage.height()));
+    const double lowScale = std::min(1.0, ratio) / MAX_SCALE_CHANGE;
+    const double highScale = std::max(1.0, ratio) * MAX_SCALE_CHANGE;
+
+    const double newFactor = std::min(1.0, double(BASE_SIZE) / qMax(newImage.width(), newImage.height()));
+    // Enough resolution for the largest scale tried on the finest level
+    const double oldFactor = std::min(1.0, newFactor * highScale);
+    const std::vector<Plane> newLevels = pyramid(newImage, newFactor, COARSE_SIZE);
+    Search search;
+    search.oldLevels = pyramid(oldImage, oldFactor, MIN_PLANE_SIZE);
+    search.oldSize = oldImage.size();
+
+    auto makeLevel = [&](int index) {
+        const Plane &plane = newLevels[index];
+        return Level{&plane, Integral(plane), double(plane.width) / newImage.width(),
+                     double(plane.height) / newImage.height()};
+    };
+
+    // Coarsest level: every scale in range, every shift that overlaps enough
+    const int coarse = int(newLevels.size()) - 1;
+    Level level = makeLevel(coarse);
+    const int steps = qMax(2, int(std::ceil(std::log(highScale / lowScale) / std::log(SCALE_STEP))) + 1);
+    double logStep = std::log(highScale / lowScale) / (steps - 1);
+    std::vector<Candidate> coarseBest(steps);
+
+    parallelFor(steps, [&](int i) {
+        Candidate &best = coarseBest[i];
+        best.scale = lowScale * std::exp(i * logStep);
+        const Plane a = search.scaledOld(level, best.scale);
+        if (a.isEmpty() || cancelled()) {
+            return;
+        }
+        const Integral ia(a);
+        const Plane &b = *level.plane;
+        const qint64 minOverlap = Search::minOverlap(a, b);
+        for (int dy = 1 - a.height; dy < b.height; ++dy) {
+            // Checked per row so Cancel does not wait out a whole scale
+            if (cancelled()) {
+                return;
+            }
+            for (int dx = 1 - a.width; dx < b.width; ++dx) {
+                const double score = ncc(a, ia, b, level.integral, dx, dy, minOverlap);
+                if (score > best.score) {
+                    best.dx = dx;
+                    best.dy = dy;
+                    best.score = score;
+                }
+            }
+        }
+    });
+    if (cancelled()) {
+        return result;
+    }
+
+    // Keep the best few, skipping neighbours of scales already kept
+    std::vector<int> order(steps);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&coarseBest](int a, int b) {
+        return coarseBest[a].score > coarseBest[b].score;
+    });
+    std::vector<Candidate> candidates;
+    std::vector<int> kept;
+    for (int i : order) {
+        if (coarseBest[i].score <= NO_MATCH || int(candidates.size()) == CANDIDATES) {
+            break;
+        }
+        if (std::any_of(kept.begin(), kept.end(), [i](int k) { return std::abs(k - i) <= 1; })) {
+            continue;
+        }
+        kept.push_back(i);
+        candidates.push_back(coarseBest[i]);
+    }
+    if (candidates.empty()) {
+        return result;
+    }
+
+    // Each finer level: double the shifts, halve the scale step, and try the
+    // neighbourhood of every candidate
+    const int side = 2 * LEVEL_RADIUS + 1;
+    for (int index = coarse - 1; index >= 0; --index) {
+        if (cancelled()) {
+            return result;
+        }
+        const Level coarser = std::move(level);
+        level = makeLevel(index);
+        logStep /= 2;
+
+        for (Candidate &candidate : candidates) {
+            const double scales[3] = {candidate.scale * std::exp(-logStep), candidate.scale,
+                                      candidate.scale * std::exp(logStep)};
+            Plane planes[3];
+            Integral integrals[3];
+            parallelFor(3, [&](int s) {
+                planes[s] = search.scaledOld(level, scales[s]);
+                integrals[s] = Integral(planes[s]);
+            });
+
+            const int centreX = qRound(candidate.dx * level.kx / coarser.kx);
+            const int centreY = qRound(candidate.dy * level.ky / coarser.ky);
+            std::vector<double> scores(3 * side * side, NO_MATCH);
+            parallelFor(int(scores.size()), [&](int task) {
+                const int s = task / (side * side);
+                const int dx = centreX + task % side - LEVEL_RADIUS;
+                const int dy = centreY + (task / side) % side - LEVEL_RADIUS;
+                if (!planes[s].isEmpty()) {
+                    scores[task] = ncc(planes[s], integrals[s], *level.plane, level.integral, dx, dy,
+                                       Search::minOverlap(planes[s], *level.plane));
+                }
+            });
+
+            const int best = int(std::max_element(scores.begin(), scores.end()) - scores.begin());
+            candidate.scale = scales[best / (side * side)];
+            candidate.dx = centreX + best % side - LEVEL_RADIUS;
+            candidate.dy = centreY + (best / side) % side - LEVEL_RADIUS;
+            candidate.score = scores[best];
+        }
+    }
+
+    const Candidate best = *std::max_element(candidates.begin(), candidates.end(),
+                                             [](const Candidate &a, const Candidate &b) {
+                                                 return a.score < b.score;
+                                             });
+    if (best.score <= NO_MATCH) {
+        return result;
+    }
+
+    // Sub-pixel shift on the finest level
+    const Plane a = search.scaledOld(level, best.scale);
+    const Integral ia(a);
+    const qint64 minOverlap = Search::minOverlap(a, *level.plane);
+    auto scoreAt = [&](int dx, int dy) {
+        return ncc(a, ia, *level.plane, level.integral, dx, dy, minOverlap);
+    };
+    const double subX = subPixel(scoreAt(best.dx - 1, best.dy), best.score, scoreAt(best.dx + 1, best.dy));
+    const double subY = subPixel(scoreAt(best.dx, best.dy - 1), best.score, scoreAt(best.dx, best.dy + 1));
+
+    result.transform.scale = best.scale;
+    result.transform.offset = QPointF((best.dx + subX) / level.kx, (best.dy + subY) / level.ky);
+    result.score = best.score;
+    result.confident = best.score >= MinScore;
+    return result;
+}
+
+QVector<ImageAligner::Refinement> ImageAligner::refine(const QImage &oldImage, const QImage &newImage,
+                                                       const Transform &transform, const QVector<QRectF> &regions,
+                                                       Progress *progress)
+{
+    TRACE_SCOPE("ImageAligner::refine");
+
+    QVector<Refinement> refinements(regions.size());
+    parallelFor(regions.size(), [&](int i) {
+        if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // The region with some context, and where it should be in the new image
+        const QRectF &region = regions.at(i);
+        const qreal margin = qMax<qreal>(MIN_SEARCH_RADIUS, PATCH_MARGIN * qMax(region.width(), region.height()));
+        const QRect source = region.adjusted(-margin, -margin, margin, margin).toAlignedRect() & oldImage.rect();
+        if (source.width() < MIN_PLANE_SIZE || source.height() < MIN_PLANE_SIZE) {
+            return;
+        }
+        const QRectF predicted = transform.map(QRectF(source));
+        const qreal radius = qMax<qreal>(MIN_SEARCH_RADIUS, SEARCH_RADIUS * qMax(predicted.width(), predicted.height()));
+        const QRect window = predicted.adjusted(-radius, -radius, radius, radius).toAlignedRect() & newImage.rect();
+
+        // Matched at a size where the region is at most PATCH_SIZE across
+        const qreal factor = qMin<qreal>(1, PATCH_SIZE / qMax(predicted.width(), predicted.height()));
+        const QSize windowSize(qMax(1, qRound(window.width() * factor)), qMax(1, qRound(window.height() * factor)));
+        const qreal fx = qreal(windowSize.width()) / qMax(1, window.width());
+        const qreal fy = qreal(windowSize.height()) / qMax(1, window.height());
+        const QSize patchSize(qRound(predicted.width() * fx), qRound(predicted.height() * fy));
+        if (patchSize.width() < MIN_PLANE_SIZE || patchSize.height() < MIN_PLANE_SIZE
+            || patchSize.width() >= windowSize.width() || patchSize.height() >= windowSize.height()) {
+            return;
+        }
+
+        const Plane a = toPlane(oldImage, source, patchSize);
+        const Plane b = toPlane(newImage, window, windowSize);
+        const Integral ia(a);
+        const Integral ib(b);
+        const int columns = b.width - a.width + 1;
+        const int rows = b.height - a.height + 1;
+        const qint64 fullOverlap = qint64(a.width) * a.height;
+
+        std::vector<double> scores(static_cast<size_t>(columns) * rows);
+        int best = 0;
+        for (int dy = 0; dy < rows; ++dy) {
+            if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            for (int dx = 0; dx < columns; ++dx) {
+                const int index = dy * columns + dx;
+                scores[index] = ncc(a, ia, b, ib, dx, dy, fullOverlap);
+                if (scores[index] > scores[best]) {
+                    best = index;
+                }
+            }
+        }
+
+        Refinement &refinement = refinements[i];
+        refinement.score = scores[best];
+        const int bestX = best % columns;
+        const int bestY = best / columns;
+        // A peak on the edge of the window may carry on outside it
+        if (refinement.score < MinRefineScore || bestX == 0 || bestY == 0 || bestX == columns - 1
+            || bestY == rows - 1) {
+            return;
+        }
+
+        const double subX = subPixel(scores[best - 1], scores[best], scores[best + 1]);
+        const double subY = subPixel(scores[best - columns], scores[best], scores[best + columns]);
+        const QPointF expected((predicted.left() - window.left()) * fx, (predicted.top() - window.top()) * fy);
+        const QPointF shift(bestX + subX - expected.x(), bestY + subY - expected.y());
+        // Within half a patch pixel is resampling error, not movement
+        if (std::abs(shift.x()) >= 0.5 || std::abs(shift.y()) >= 0.5) {
+            refinement.shift = QPointF(shift.x() / fx, shift.y() / fy);
+        }
+        refinement.accepted = true;
+    });
+    return refinements;
+}
@@ -0,0 +1,62 @@
+#ifndef IMAGEALIGNER_H
+#define IMAGEALIGNER_H
+
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include <atomic>
+
+// Finds where the content of an image ended up in a revised version of it,
+// so hotspots drawn on the old image can follow.
+//
+// The transform is a uniform scale plus a shift, which covers re-exports at
+// another size, re-crops and moved layouts. It is searched coarse to fine on
+// grayscale pyramids of both images by normalized cross-correlation (NCC):
+// every scale in range and every shift on the coarsest level, then only the
+// best few candidates in small steps on each finer one. Window sums come
+// from summed-area tables, so each shift costs one dot product per row,
+// done four floats at a time with SSE2 where available.
+class ImageAligner
+{
+public:
+    struct Transform {
+        qreal scale = 1;
+        QPointF offset;
+
+        QPointF map(const QPointF &point) const { return point * scale + offset; }
+        QRectF map(const QRectF &rect) const { return QRectF(map(rect.topLeft()), rect.size() * scale); }
+    };
+
+    struct Result {
+        Transform transform;
+        qreal score = -1;       // NCC of the images where they overlap, -1 to 1
+        bool confident = false; // score reached MinScore
+    };
+
+    // Correction for one region on top of the global transform
+    struct Refinement {
+        QPointF shift;          // new image pixels
+        qreal score = -1;
+        bool accepted = false;
+    };
+
+    // Shared with the GUI thread while running
+    struct Progress {
+        std::atomic<bool> cancelled{false};
+    };
+
+    // Safe to call off the GUI thread
+    static Result estimate(const QImage &oldImage, const QImage &newImage, Progress *progress = nullptr);
+
+    // Looks for each region of the old image (old image pixels) in a small
+    // window around where transform puts it. Corrections are only accepted
+    // for a clear match inside the window.
+    static QVector<Refinement> refine(const QImage &oldImage, const QImage &newImage, const Transform &transform,
+                                      const QVector<QRectF> &regions, Progress *progress = nullptr);
+
+    static constexpr qreal MinScore = 0.5;
+    static constexpr qreal MinRefineScore = 0.8;
+};
+
+#endif // IMAGEALIGNER_H
@@ -1,12 +1,20 @@
 #include "ImageMapEditor.h"
+#include "HotspotLayerItem.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QPainter>
 #include <QMouseEvent>
+#include <QResizeEvent>
 #include <QWheelEvent>
 #include <QKeyEvent>
 #include <QScrollBar>
 #include <QFileInfo>
 #include <QClipboard>
 #include <QApplication>
+#include <QScreen>
+#include <QtMath>
 #include <cmath>
+#include <vector>
 
 ImageMapEditor::ImageMapEditor(QWidget *parent)
     : QGraphicsView(parent)
@@ -25,22 +33,76 @@ ImageMapEditor::ImageMapEditor(QWidget *parent)
     setFrameShape(QFrame::NoFrame);
 
     setMouseTracking(true);
+
+    m_moveTimer = new QTimer(this);
+    m_moveTimer->setSingleShot(true);
+    m_moveTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_moveTimer, &QTimer::timeout, this, &ImageMapEditor::processPendingMove);
+
+    m_zoomAnimation = new QVariantAnimation(this);
+    m_zoomAnimation->setDuration(ZOOM_ANIMATION_MS);
+    m_zoomAnimation->setEasingCurve(QEasingCurve::OutCubic);
+    connect(m_zoomAnimation, &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
+        beginFastRendering();
+        m_zoomFactor = value.toReal();
+        setTransform(QTransform::fromScale(m_zoomFactor, m_zoomFactor));
+        emit viewChanged();
+    });
+
+    m_refineTimer = new QTimer(this);
+    m_refineTimer->setSingleShot(true);
+    m_refineTimer->setInterval(REFINE_DELAY_MS);
+    connect(m_refineTimer, &QTimer::timeout, this, &ImageMapEditor::refineRendering);
+
+    m_overlapAnalyzer = new OverlapAnalyzer(this);
+    connect(m_overlapAnalyzer, &OverlapAnalyzer::conflictsChanged, this, [this]() {
+        for (HotspotItem *hotspot : m_hotspots) {
+            hotspot->setConflicting(m_overlapAnalyzer->hasConflicts(hotspot));
+        }
+        if (m_layerItem) {
+            m_layerItem->update();
+        }
+    });
 }
 
 bool ImageMapEditor::loadImage(const QString &filePath)
 {
-    QPixmap pixmap(filePath);
-    if (pixmap.isNull()) {
+    TRACE_SCOPE("ImageMapEditor::loadImage");
+
+    QImage image(filePath);
+    if (image.isNull()) {
         return false;
     }
 
+    loadDecodedImage(filePath, image);
+    return true;
+}
+
+// The formats a raster pixmap keeps as they are, so it can share the buffer
+static QImage pixmapFormat(const QImage &image)
+{
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                         : QImage::Format_RGB32);
+}
+
+void ImageMapEditor::loadDecodedImage(const QString &filePath, const QImage &image)
+{
     m_imagePath = filePath;
-    setImage(pixmap);
+    applyImage(QPixmap::fromImage(pixmapFormat(image)));
     emit imageLoaded(filePath);
-    return true;
 }
 
 void ImageMapEditor::setImage(const QPixmap &pixmap)
+{
+    applyImage(pixmap);
+}
+
+void ImageMapEditor::setImage(const QImage &image)
+{
+    applyImage(QPixmap::fromImage(pixmapFormat(image)));
+}
+
+void ImageMapEditor::applyImage(const QPixmap &pixmap)
 {
     if (m_imageItem) {
         m_scene->removeItem(m_imageItem);
@@ -49,9 +111,25 @@ void ImageMapEditor::setImage(const QPixmap &pixmap)
 
     m_imageItem = m_scene->addPixmap(pixmap);
     m_imageItem->setZValue(-1000);
+    m_imageItem->setTransformationMode(m_fastRendering ? Qt::FastTransformation : Qt::SmoothTransformation);
     m_scene->setSceneRect(pixmap.rect());
+    // A raster pixmap hands out its own buffer here, so the image read by
+    // snapping, the wand and the exporters is not a second copy of it
+    m_sourceImage = pixmap.toImage();
+
+    // Gradient map for edge snapping is built in the background
+    if (m_edgeMap) {
+        m_edgeMap->cancel();
+    }
+    m_edgeMap = EdgeMap::buildAsync(m_sourceImage);
+    m_hasSnapIndicator = false;
+
+    if (m_idBuffer) {
+        m_idBuffer.reset(new IdBuffer(m_sourceImage.size(), &m_index));
+    }
 
     zoomFit();
+    emit imageChanged();
 }
 
 QPixmap ImageMapEditor::image() const
@@ -77,25 +155,82 @@ void ImageMapEditor::setCurrentTool(EditorTool tool)
     case EditorTool::DrawRect:
     case EditorTool::DrawCircle:
     case EditorTool::DrawPolygon:
+    case EditorTool::MagicWand:
+    case EditorTool::Lasso:
         setCursor(Qt::CrossCursor);
         break;
     }
+
+    emit toolChanged(tool);
 }
 
 void ImageMapEditor::addHotspot(HotspotItem *hotspot)
 {
-    m_scene->addItem(hotspot);
+    if (!m_batchedRendering) {
+        m_scene->addItem(hotspot);
+    }
     m_hotspots.append(hotspot);
+    m_index.insert(hotspot);
+    m_overlapAnalyzer->updateHotspot(hotspot);
+    if (m_idBuffer) {
+        m_idBuffer->updateHotspot(hotspot);
+    }
+    refreshLayer();
     emit hotspotAdded(hotspot);
 }
 
+void ImageMapEditor::addHotspots(const QList<HotspotItem*> &hotspots, int index)
+{
+    if (hotspots.isEmpty()) {
+        return;
+    }
+
+    if (index < 0 || index > m_hotspots.size()) {
+        index = m_hotspots.size();
+    }
+    m_hotspots.reserve(m_hotspots.size() + hotspots.size());
+    for (HotspotItem *hotspot : hotspots) {
+        if (!m_batchedRendering) {
+            m_scene->addItem(hotspot);
+        }
+        m_hotspots.insert(index++, hotspot);
+        m_index.insert(hotspot);
+        if (m_idBuffer) {
+            m_idBuffer->updateHotspot(hotspot);
+        }
+    }
+    refreshLayer();
+    // A large batch is cheaper to check with one full sweep
+    if (hotspots.size() * 2 > m_hotspots.size()) {
+        m_overlapAnalyzer->setHotspots(m_hotspots);
+    } else {
+        for (HotspotItem *hotspot : hotspots) {
+            m_overlapAnalyzer->updateHotspot(hotspot);
+        }
+    }
+    emit hotspotsAdded(hotspots);
+}
+
 void ImageMapEditor::removeHotspot(HotspotItem *hotspot)
 {
     if (m_selectedHotspot == hotspot) {
         m_selectedHotspot = nullptr;
     }
+    m_selection.removeOne(hotspot);
     m_hotspots.removeOne(hotspot);
-    m_scene->removeItem(hotspot);
+    m_index.remove(hotspot);
+    m_overlapAnalyzer->removeHotspot(hotspot);
+    if (m_idBuffer) {
+        m_idBuffer->removeHotspot(hotspot);
+        if (m_browserHover.hotspot == hotspot) {
+            m_browserHover = IdBuffer::Hit();
+            m_browserHoverOutline.clear();
+        }
+    }
+    if (hotspot->scene()) {
+        m_scene->removeItem(hotspot);
+    }
+    refreshLayer();
     emit hotspotRemoved(hotspot);
     delete hotspot;
 }
@@ -103,26 +238,180 @@ void ImageMapEditor::removeHotspot(HotspotItem *hotspot)
 void ImageMapEditor::clearAllHotspots()
 {
     for (HotspotItem *hotspot : m_hotspots) {
-        m_scene->removeItem(hotspot);
+        if (hotspot->scene()) {
+            m_scene->removeItem(hotspot);
+        }
         delete hotspot;
     }
     m_hotspots.clear();
+    m_index.clear();
+    refreshLayer();
     m_selectedHotspot = nullptr;
+    m_selection.clear();
+    m_overlapAnalyzer->clear();
+    if (m_idBuffer) {
+        m_idBuffer.reset(new IdBuffer(m_sourceImage.size(), &m_index));
+        m_browserHover = IdBuffer::Hit();
+        m_browserHoverOutline.clear();
+    }
+    emit hotspotsCleared();
 }
 
 void ImageMapEditor::selectHotspot(HotspotItem *hotspot)
 {
-    if (m_selectedHotspot) {
-        m_selectedHotspot->setSelected(false);
+    setSelectedHotspots(hotspot ? QList<HotspotItem*>{hotspot} : QList<HotspotItem*>());
+}
+
+void ImageMapEditor::setSelectedHotspots(const QList<HotspotItem*> &hotspots)
+{
+    const QList<HotspotItem*> previous = m_selection;
+    for (HotspotItem *hotspot : previous) {
+        if (!hotspots.contains(hotspot)) {
+            hotspot->setSelected(false);
+        }
+    }
+    m_selection = hotspots;
+    for (HotspotItem *hotspot : m_selection) {
+        hotspot->setSelected(true);
     }
 
-    m_selectedHotspot = hotspot;
+    if (m_batchedRendering) {
+        for (HotspotItem *hotspot : previous) {
+            syncBatchedItem(hotspot);
+        }
+        for (HotspotItem *hotspot : m_selection) {
+            syncBatchedItem(hotspot);
+        }
+        m_layerItem->update();
+    }
 
-    if (hotspot) {
-        hotspot->setSelected(true);
+    if (!m_selection.contains(m_selectedHotspot)) {
+        m_selectedHotspot = m_selection.isEmpty() ? nullptr : m_selection.first();
+    }
+
+    emit hotspotSelected(m_selectedHotspot);
+    emit selectionChanged(m_selection);
+}
+
+void ImageMapEditor::arrangeInGrid(HotspotItem *hotspot, int rows, int columns, const QPointF &step,
+                                   int firstRow, int firstColumn)
+{
+    TRACE_SCOPE("ImageMapEditor::arrangeInGrid");
+
+    hotspot->setGridInstances(rows, columns, step, firstRow, firstColumn);
+    m_index.update(hotspot);
+    m_overlapAnalyzer->updateHotspot(hotspot);
+    if (m_idBuffer) {
+        m_idBuffer->updateHotspot(hotspot);
+    }
+    refreshLayer();
+    emit hotspotChanged(hotspot);
+}
+
+void ImageMapEditor::transformHotspots(const QList<HotspotItem*> &hotspots, const QVector<QTransform> &transforms)
+{
+    TRACE_SCOPE("ImageMapEditor::transformHotspots");
+
+    for (int i = 0; i < hotspots.size(); ++i) {
+        HotspotItem *hotspot = hotspots.at(i);
+        const QTransform &transform = transforms.at(i);
+        // Scene points are pos + local, so the scale also applies to the local geometry
+        hotspot->setPos(transform.map(hotspot->pos()));
+        hotspot->scaleGeometry(transform.m11(), transform.m22());
+        m_index.update(hotspot);
+        m_overlapAnalyzer->updateHotspot(hotspot);
+        if (m_idBuffer) {
+            m_idBuffer->updateHotspot(hotspot);
+        }
     }
+    refreshLayer();
+    emit hotspotsTransformed(hotspots);
+}
 
-    emit hotspotSelected(hotspot);
+QVector<QPolygonF> ImageMapEditor::hotspotOutlines(const HotspotItem *hotspot, int instance)
+{
+    QPolygonF outline;
+    switch (hotspot->hotspotShape()) {
+    case HotspotShape::Rectangle:
+        outline = QPolygonF(hotspot->rect().normalized());
+        break;
+    case HotspotShape::Circle: {
+        const qreal radius = hotspot->radius();
+        const int segments = qBound(16, qCeil(2 * M_PI * radius / CIRCLE_SEGMENT_PX), 720);
+        outline.reserve(segments);
+        for (int i = 0; i < segments; ++i) {
+            const qreal angle = 2 * M_PI * i / segments;
+            outline.append(hotspot->center() + QPointF(radius * std::cos(angle), radius * std::sin(angle)));
+        }
+        break;
+    }
+    case HotspotShape::Polygon:
+        outline = hotspot->polygon();
+        break;
+    }
+
+    if (instance >= 0) {
+        return {outline.translated(hotspot->pos() + hotspot->instanceOffset(instance))};
+    }
+
+    QVector<QPolygonF> outlines;
+    outlines.reserve(hotspot->instanceCount());
+    for (int i = 0; i < hotspot->instanceCount(); ++i) {
+        outlines.append(outline.translated(hotspot->pos() + hotspot->instanceOffset(i)));
+    }
+    return outlines;
+}
+
+QList<HotspotItem*> ImageMapEditor::combineSelectedHotspots(PolygonBoolean::Operation operation)
+{
+    TRACE_SCOPE("ImageMapEditor::combineSelectedHotspots");
+
+    if (m_selection.size() < 2) {
+        return QList<HotspotItem*>();
+    }
+
+    HotspotItem *primary = m_selectedHotspot ? m_selectedHotspot : m_selection.first();
+    QVector<QPolygonF> rings = hotspotOutlines(primary);
+    for (const HotspotItem *hotspot : m_selection) {
+        if (hotspot != primary) {
+            rings = PolygonBoolean::apply(rings, hotspotOutlines(hotspot), operation);
+        }
+        if (rings.isEmpty()) {
+            return QList<HotspotItem*>();
+        }
+    }
+
+    const QVector<QPolygonF> polygons = PolygonBoolean::toAreaPolygons(rings, BOOLEAN_TOLERANCE_PX);
+    if (polygons.isEmpty()) {
+        return QList<HotspotItem*>();
+    }
+
+    QList<HotspotItem*> created;
+    for (const QPolygonF &polygon : polygons) {
+        HotspotItem *hotspot = new HotspotItem(HotspotShape::Polygon);
+        hotspot->setPolygon(polygon);
+        hotspot->closePolygon();
+        hotspot->setUrl(primary->url());
+        hotspot->setAltText(primary->altText());
+        hotspot->setTitle(primary->title());
+        hotspot->setColor(primary->color());
+        created.append(hotspot);
+    }
+
+    // Take the earliest document position among the sources
+    int index = m_hotspots.size();
+    for (HotspotItem *hotspot : m_selection) {
+        index = qMin(index, static_cast<int>(m_hotspots.indexOf(hotspot)));
+    }
+
+    const QList<HotspotItem*> sources = m_selection;
+    selectHotspot(nullptr);
+    for (HotspotItem *hotspot : sources) {
+        removeHotspot(hotspot);
+    }
+    addHotspots(created, index);
+    setSelectedHotspots(created);
+    return created;
 }
 
 void ImageMapEditor::deleteSelectedHotspot()
@@ -132,8 +421,10 @@ void ImageMapEditor::deleteSelectedHotspot()
     }
 }
 
-QString ImageMapEditor::generateImageMapHtml(const QString &mapName) const
+QString ImageMapEditor::generateImageMapHtml(const QString &mapName, ExportStats *stats) const
 {
+    TRACE_SCOPE("ImageMapEditor::generateImageMapHtml");
+
     if (!m_imageItem || m_hotspots.isEmpty()) {
         return QString();
     }
@@ -151,47 +442,191 @@ QString ImageMapEditor::generateImageMapHtml(const QString &mapName) const
         outputHeight = STANDARD_HEIGHT;
     }
 
+    const bool minified = m_exportMinified;
+    const QString indent = minified ? QString() : QString("  ");
     QStringList html;
-    html << QString("<img src=\"%1\" width=\"%2\" height=\"%3\" usemap=\"#%4\" alt=\"Image Map\">")
-                .arg(imageName.toHtmlEscaped())
-                .arg(outputWidth)
-                .arg(outputHeight)
-                .arg(mapName.toHtmlEscaped());
-    html << QString("<map name=\"%1\">").arg(mapName.toHtmlEscaped());
+    html << "<img " + QStringList{MapArea::attribute("src", imageName, minified),
+                                  MapArea::attribute("width", QString::number(outputWidth), minified),
+                                  MapArea::attribute("height", QString::number(outputHeight), minified),
+                                  MapArea::attribute("usemap", "#" + mapName, minified),
+                                  MapArea::attribute("alt", "Image Map", minified)}.join(' ') + ">";
+    html << "<map " + MapArea::attribute("name", mapName, minified) + ">";
+
+    // Area tags are independent, so build them in parallel chunks
+    const QVector<MapArea> areas = mapAreas();
+    const qreal tolerance = m_exportSimplify ? m_exportTolerance : -1;
+    const int count = areas.size();
+    const int chunks = (count + AREA_CHUNK_SIZE - 1) / AREA_CHUNK_SIZE;
+    std::vector<QString> tags(count);
+    std::vector<ExportStats> chunkStats(stats ? chunks : 0);
+
+    parallelFor(chunks, [&](int chunk) {
+        const int begin = chunk * AREA_CHUNK_SIZE;
+        const int end = qMin(count, begin + AREA_CHUNK_SIZE);
+        for (int i = begin; i < end; ++i) {
+            const MapArea &area = areas.at(i);
+            if (!stats || area.shape != HotspotShape::Polygon) {
+                tags[i] = indent + area.generateAreaTag(tolerance, minified);
+                if (stats) {
+                    const qint64 bytes = tags[i].toUtf8().size();
+                    chunkStats[chunk].exportedBytes += bytes;
+                    chunkStats[chunk].originalBytes += bytes;
+                }
+                continue;
+            }
 
-    for (const HotspotItem *hotspot : m_hotspots) {
-        html << "  " + generateAreaTagForHotspot(hotspot);
-    }
+            // Simplified once, for both the tag and the vertex count
+            ExportStats &s = chunkStats[chunk];
+            const QVector<QPoint> points = area.exportPolygon(tolerance);
+            const QString coords = MapArea::polygonCoords(points);
+            tags[i] = indent + area.generateAreaTag(coords, minified);
+            const qint64 bytes = tags[i].toUtf8().size();
+            s.exportedBytes += bytes;
+            s.originalBytes += bytes;
+            s.exportedVertices += points.size();
+            s.originalVertices += area.polygon.size();
+            if (tolerance >= 0) {
+                // Only the coords differ from the unsimplified tag; they are ASCII
+                s.originalBytes += MapArea::attribute("coords", area.generateCoords(-1), minified).size()
+                                   - MapArea::attribute("coords", coords, minified).size();
+            }
+        }
+    });
 
+    for (QString &tag : tags) {
+        html << tag;
+    }
     html << "</map>";
 
-    return html.join("\n");
+    QString result = html.join(minified ? QString() : QString("\n"));
+    if (stats) {
+        *stats = ExportStats();
+        for (const ExportStats &s : chunkStats) {
+            stats->originalBytes += s.originalBytes;
+            stats->exportedBytes += s.exportedBytes;
+            stats->originalVertices += s.originalVertices;
+            stats->exportedVertices += s.exportedVertices;
+        }
+        // Markup outside the area tags is the same either way
+        const qint64 shared = result.toUtf8().size() - stats->exportedBytes;
+        stats->originalBytes += shared;
+        stats->exportedBytes += shared;
+    }
+    return result;
+}
+
+void ImageMapEditor::setExportSimplification(bool enabled, qreal tolerance)
+{
+    m_exportSimplify = enabled;
+    m_exportTolerance = qMax<qreal>(0, tolerance);
 }
 
 void ImageMapEditor::zoomIn()
 {
-    m_zoomFactor *= 1.25;
-    setTransform(QTransform::fromScale(m_zoomFactor, m_zoomFactor));
+    animateZoomTo((m_zoomAnimation->state() == QAbstractAnimation::Running ? m_targetZoom : m_zoomFactor) * ZOOM_STEP);
 }
 
 void ImageMapEditor::zoomOut()
 {
-    m_zoomFactor /= 1.25;
-    setTransform(QTransform::fromScale(m_zoomFactor, m_zoomFactor));
+    animateZoomTo((m_zoomAnimation->state() == QAbstractAnimation::Running ? m_targetZoom : m_zoomFactor) / ZOOM_STEP);
 }
 
 void ImageMapEditor::zoomFit()
 {
     if (!m_imageItem) return;
 
+    m_zoomAnimation->stop();
     fitInView(m_imageItem, Qt::KeepAspectRatio);
     m_zoomFactor = transform().m11();
+    emit viewChanged();
 }
 
 void ImageMapEditor::zoomReset()
 {
+    m_zoomAnimation->stop();
     m_zoomFactor = 1.0;
     setTransform(QTransform());
+    emit viewChanged();
+}
+
+void ImageMapEditor::setZoomFactor(qreal factor)
+{
+    m_zoomAnimation->stop();
+    m_zoomFactor = factor;
+    setTransform(QTransform::fromScale(m_zoomFactor, m_zoomFactor));
+    emit viewChanged();
+}
+
+QRectF ImageMapEditor::visibleSceneRect() const
+{
+    return mapToScene(viewport()->rect()).boundingRect();
+}
+
+void ImageMapEditor::animateZoomTo(qreal factor)
+{
+    // Restarting from the current value keeps repeated steps smooth; the
+    // target accumulates so fast wheel spins are not lost
+    m_targetZoom = factor;
+    m_zoomAnimation->stop();
+    m_zoomAnimation->setStartValue(m_zoomFactor);
+    m_zoomAnimation->setEndValue(m_targetZoom);
+    m_zoomAnimation->start();
+}
+
+void ImageMapEditor::setAdaptiveQuality(bool enabled)
+{
+    m_adaptiveQuality = enabled;
+    if (!enabled) {
+        m_refineTimer->stop();
+        refineRendering();
+    }
+}
+
+void ImageMapEditor::beginFastRendering()
+{
+    if (!m_adaptiveQuality) {
+        return;
+    }
+    if (!m_fastRendering) {
+        m_fastRendering = true;
+        setRenderHint(QPainter::Antialiasing, false);
+        setRenderHint(QPainter::SmoothPixmapTransform, false);
+        if (m_imageItem) {
+            m_imageItem->setTransformationMode(Qt::FastTransformation);
+        }
+    }
+    m_refineTimer->start();
+}
+
+void ImageMapEditor::refineRendering()
+{
+    if (m_zoomAnimation->state() == QAbstractAnimation::Running) {
+        m_refineTimer->start();
+        return;
+    }
+    if (!m_fastRendering) {
+        return;
+    }
+    m_fastRendering = false;
+    setRenderHint(QPainter::Antialiasing);
+    setRenderHint(QPainter::SmoothPixmapTransform);
+    if (m_imageItem) {
+        m_imageItem->setTransformationMode(Qt::SmoothTransformation);
+    }
+    viewport()->update();
+}
+
+void ImageMapEditor::scrollContentsBy(int dx, int dy)
+{
+    beginFastRendering();
+    QGraphicsView::scrollContentsBy(dx, dy);
+    emit viewChanged();
+}
+
+void ImageMapEditor::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    emit viewChanged();
 }
 
 void ImageMapEditor::setClipboardMode(bool enabled)
@@ -204,11 +639,54 @@ void ImageMapEditor::setClipboardMode(bool enabled)
     }
 }
 
+void ImageMapEditor::setEdgeSnapEnabled(bool enabled)
+{
+    m_edgeSnapEnabled = enabled;
+    if (!enabled && m_hasSnapIndicator) {
+        m_hasSnapIndicator = false;
+        viewport()->update();
+    }
+}
+
+bool ImageMapEditor::isEdgeMapReady() const
+{
+    return m_edgeMap && m_edgeMap->isReady();
+}
+
+QPointF ImageMapEditor::snapToEdge(const QPointF &scenePos, bool *snapped) const
+{
+    QPointF result = scenePos;
+    bool found = false;
+
+    if (m_edgeSnapEnabled && m_edgeMap) {
+        // The search radius is constant in screen pixels, up to the map's
+        // cap in image pixels when zoomed far out
+        qreal radius = SNAP_RADIUS_PX / qMax(m_zoomFactor, 0.01);
+        found = m_edgeMap->snap(scenePos, radius, SNAP_THRESHOLD, &result);
+    }
+
+    if (snapped) {
+        *snapped = found;
+    }
+    return found ? result : scenePos;
+}
+
+bool ImageMapEditor::snapsToEdges() const
+{
+    return (m_currentTool == EditorTool::DrawRect || m_currentTool == EditorTool::DrawCircle
+            || m_currentTool == EditorTool::DrawPolygon) && !m_clipboardMode;
+}
+
 void ImageMapEditor::setScreenStandardMode(bool enabled)
 {
     m_screenStandardMode = enabled;
 }
 
+QSize ImageMapEditor::outputSize() const
+{
+    return toOutputRect(QRectF(QPointF(0, 0), QSizeF(m_sourceImage.size()))).size().toSize();
+}
+
 QPointF ImageMapEditor::toOutputCoords(const QPointF &scenePos) const
 {
     if (!m_screenStandardMode || !m_imageItem) {
@@ -272,10 +750,30 @@ QPolygonF ImageMapEditor::toOutputPolygon(const QPolygonF &polygon) const
 
 void ImageMapEditor::mousePressEvent(QMouseEvent *event)
 {
+    // The press position supersedes any move still waiting for its frame
+    m_movePending = false;
+    m_moveTimer->stop();
+
     QPointF scenePos = mapToScene(event->pos());
+    if (snapsToEdges()) {
+        scenePos = snapToEdge(scenePos);
+    }
     QPointF outputPos = toOutputCoords(scenePos);
     emit coordinatesChanged(outputPos);
 
+    // Nothing is edited while testing; hotspot items do not see the click
+    if (m_idBuffer) {
+        if (event->button() == Qt::LeftButton) {
+            updateBrowserHover(scenePos);
+            if (m_browserHover.hotspot) {
+                emit browserLinkClicked(m_browserHover.hotspot->expandTemplate(m_browserHover.hotspot->url(),
+                                                                               m_browserHover.instance));
+            }
+        }
+        event->accept();
+        return;
+    }
+
     // Handle clipboard mode
     if (m_clipboardMode && event->button() == Qt::LeftButton) {
         QString coords = QString("%1,%2").arg(qRound(outputPos.x())).arg(qRound(outputPos.y()));
@@ -288,7 +786,26 @@ void ImageMapEditor::mousePressEvent(QMouseEvent *event)
         switch (m_currentTool) {
         case EditorTool::Select: {
             HotspotItem *item = hotspotAt(scenePos);
-            selectHotspot(item);
+            if (item && (event->modifiers() & (Qt::ShiftModifier | Qt::ControlModifier))) {
+                QList<HotspotItem*> selection = m_selection;
+                if (!selection.removeOne(item)) {
+                    selection.append(item);
+                }
+                setSelectedHotspots(selection);
+            } else {
+                selectHotspot(item);
+            }
+            // The scene drags every item it has selected, which Ctrl+click
+            // extends alongside m_selection
+            m_pressedPositions.clear();
+            for (HotspotItem *hotspot : m_selection) {
+                m_pressedPositions.insert(hotspot, hotspot->pos());
+            }
+            for (QGraphicsItem *selected : m_scene->selectedItems()) {
+                if (HotspotItem *hotspot = dynamic_cast<HotspotItem*>(selected)) {
+                    m_pressedPositions.insert(hotspot, hotspot->pos());
+                }
+            }
             break;
         }
         case EditorTool::DrawRect: {
@@ -320,6 +837,33 @@ void ImageMapEditor::mousePressEvent(QMouseEvent *event)
             }
             break;
         }
+        case EditorTool::MagicWand: {
+            if (m_sourceImage.isNull()) {
+                break;
+            }
+            m_isDrawing = true;
+            m_drawStart = scenePos;
+            m_currentDrawingItem = new HotspotItem(HotspotShape::Polygon);
+            m_currentDrawingItem->closePolygon();
+            m_scene->addItem(m_currentDrawingItem);
+            m_magicWand.reset(m_sourceImage, QPoint(static_cast<int>(std::floor(scenePos.x())),
+                                                    static_cast<int>(std::floor(scenePos.y()))));
+            updateMagicWand(m_wandBaseTolerance);
+            break;
+        }
+        case EditorTool::Lasso: {
+            m_isDrawing = true;
+            // Tolerance is constant in screen pixels
+            m_lassoSimplifier.reset(LASSO_TOLERANCE_PX / qMax(m_zoomFactor, 0.01));
+            m_lassoSimplifier.addPoint(scenePos);
+            m_currentDrawingItem = new HotspotItem(HotspotShape::Polygon);
+            m_currentDrawingItem->addPolygonPoint(scenePos);
+            m_currentDrawingItem->closePolygon();
+            m_lassoSyncedCount = 1;
+            m_lassoPreviewHasTail = false;
+            m_scene->addItem(m_currentDrawingItem);
+            break;
+        }
         }
     } else if (event->button() == Qt::RightButton) {
         if (m_isDrawing && m_currentTool == EditorTool::DrawPolygon) {
@@ -332,9 +876,107 @@ void ImageMapEditor::mousePressEvent(QMouseEvent *event)
 
 void ImageMapEditor::mouseMoveEvent(QMouseEvent *event)
 {
-    QPointF scenePos = mapToScene(event->pos());
-    QPointF outputPos = toOutputCoords(scenePos);
-    emit coordinatesChanged(outputPos);
+    // Coalesce moves to one update per displayed frame, always using the
+    // latest position
+    m_pendingMovePos = mapToScene(event->pos());
+    m_movePending = true;
+
+    // The lasso keeps every raw point; only its preview is coalesced
+    if (m_isDrawing && m_currentTool == EditorTool::Lasso) {
+        m_lassoSimplifier.addPoint(m_pendingMovePos);
+    }
+
+    int frameInterval = frameIntervalMs();
+    qint64 sinceLastUpdate = m_lastMoveUpdate.isValid() ? m_lastMoveUpdate.elapsed() : frameInterval;
+    if (sinceLastUpdate >= frameInterval) {
+        m_moveTimer->stop();
+        processPendingMove();
+    } else if (!m_moveTimer->isActive()) {
+        m_moveTimer->start(static_cast<int>(frameInterval - sinceLastUpdate));
+    }
+
+    QGraphicsView::mouseMoveEvent(event);
+}
+
+void ImageMapEditor::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && m_isDrawing) {
+        if (m_currentTool == EditorTool::DrawRect || m_currentTool == EditorTool::DrawCircle
+            || m_currentTool == EditorTool::MagicWand) {
+            // Final geometry comes from the exact release position, not from
+            // whatever move was last coalesced
+            m_pendingMovePos = mapToScene(event->pos());
+            m_movePending = true;
+            m_moveTimer->stop();
+            processPendingMove();
+            finishCurrentDrawing();
+        } else if (m_currentTool == EditorTool::Lasso && m_currentDrawingItem) {
+            m_moveTimer->stop();
+            m_movePending = false;
+            m_lassoSimplifier.addPoint(mapToScene(event->pos()));
+            m_currentDrawingItem->setPolygon(m_lassoSimplifier.result());
+            finishCurrentDrawing();
+        }
+        // Polygon continues until right-click or double-click
+    }
+
+    if (m_idBuffer) {
+        event->accept();
+        return;
+    }
+
+    QGraphicsView::mouseReleaseEvent(event);
+
+    if (event->button() == Qt::LeftButton && m_currentTool == EditorTool::Select) {
+        QList<HotspotItem*> moved;
+        for (auto it = m_pressedPositions.constBegin(); it != m_pressedPositions.constEnd(); ++it) {
+            if (m_hotspots.contains(it.key()) && it.key()->pos() != it.value()) {
+                moved.append(it.key());
+            }
+        }
+        m_pressedPositions.clear();
+        for (HotspotItem *hotspot : moved) {
+            m_index.update(hotspot);
+            m_overlapAnalyzer->updateHotspot(hotspot);
+            if (m_idBuffer) {
+                m_idBuffer->updateHotspot(hotspot);
+            }
+        }
+        if (!moved.isEmpty()) {
+            refreshLayer();
+        }
+        if (moved.size() == 1) {
+            emit hotspotChanged(moved.first());
+        } else if (moved.size() > 1) {
+            emit hotspotsTransformed(moved);
+        }
+    }
+}
+
+void ImageMapEditor::processPendingMove()
+{
+    if (!m_movePending) {
+        return;
+    }
+    m_movePending = false;
+    m_lastMoveUpdate.start();
+
+    if (m_idBuffer) {
+        emit coordinatesChanged(toOutputCoords(m_pendingMovePos));
+        updateBrowserHover(m_pendingMovePos);
+        return;
+    }
+
+    // The readout and indicator show the point a click would really place
+    bool snapped = false;
+    const QPointF scenePos = snapsToEdges() ? snapToEdge(m_pendingMovePos, &snapped) : m_pendingMovePos;
+    emit coordinatesChanged(toOutputCoords(scenePos));
+
+    if (snapped || m_hasSnapIndicator) {
+        m_hasSnapIndicator = snapped;
+        m_snapIndicatorPos = scenePos;
+        viewport()->update();
+    }
 
     if (m_isDrawing && m_currentDrawingItem) {
         switch (m_currentTool) {
@@ -354,24 +996,72 @@ void ImageMapEditor::mouseMoveEvent(QMouseEvent *event)
         case EditorTool::DrawPolygon:
             // Polygon points are added on click
             break;
+        case EditorTool::MagicWand: {
+            // Dragging right widens the tolerance, dragging left narrows it
+            qreal dragPx = (m_pendingMovePos.x() - m_drawStart.x()) * m_zoomFactor;
+            int tolerance = qBound(0, m_wandBaseTolerance + qRound(dragPx / WAND_DRAG_PX_PER_STEP), 255);
+            if (tolerance != m_wandTolerance) {
+                updateMagicWand(tolerance);
+            }
+            break;
+        }
+        case EditorTool::Lasso:
+            syncLassoPreview();
+            break;
         default:
             break;
         }
     }
-
-    QGraphicsView::mouseMoveEvent(event);
 }
 
-void ImageMapEditor::mouseReleaseEvent(QMouseEvent *event)
+void ImageMapEditor::syncLassoPreview()
 {
-    if (event->button() == Qt::LeftButton && m_isDrawing) {
-        if (m_currentTool == EditorTool::DrawRect || m_currentTool == EditorTool::DrawCircle) {
-            finishCurrentDrawing();
+    // The preview holds the committed points followed by one floating tail
+    // point, so each update only touches the points that changed
+    const QPolygonF &committed = m_lassoSimplifier.committed();
+    bool hasTail = m_lassoPreviewHasTail;
+
+    for (int i = m_lassoSyncedCount; i < committed.size(); ++i) {
+        if (hasTail) {
+            m_currentDrawingItem->movePolygonPoint(i, committed.at(i));
+            hasTail = false;
+        } else {
+            m_currentDrawingItem->addPolygonPoint(committed.at(i));
         }
-        // Polygon continues until right-click or double-click
     }
+    m_lassoSyncedCount = static_cast<int>(committed.size());
 
-    QGraphicsView::mouseReleaseEvent(event);
+    if (m_lassoSimplifier.hasTail()) {
+        if (hasTail) {
+            m_currentDrawingItem->movePolygonPoint(m_lassoSyncedCount, m_lassoSimplifier.tail());
+        } else {
+            m_currentDrawingItem->addPolygonPoint(m_lassoSimplifier.tail());
+            hasTail = true;
+        }
+    }
+    m_lassoPreviewHasTail = hasTail;
+    m_currentDrawingItem->update();
+}
+
+void ImageMapEditor::updateMagicWand(int tolerance)
+{
+    if (!m_currentDrawingItem) {
+        return;
+    }
+
+    m_wandTolerance = tolerance;
+    m_currentDrawingItem->setPolygon(m_magicWand.select(tolerance));
+    m_currentDrawingItem->update();
+    emit magicWandToleranceChanged(tolerance);
+}
+
+int ImageMapEditor::frameIntervalMs() const
+{
+    qreal refreshRate = screen() ? screen()->refreshRate() : 60.0;
+    if (refreshRate <= 0) {
+        refreshRate = 60.0;
+    }
+    return qMax(1, qRound(1000.0 / refreshRate));
 }
 
 void ImageMapEditor::mouseDoubleClickEvent(QMouseEvent *event)
@@ -387,11 +1077,10 @@ void ImageMapEditor::mouseDoubleClickEvent(QMouseEvent *event)
 void ImageMapEditor::wheelEvent(QWheelEvent *event)
 {
     if (event->modifiers() & Qt::ControlModifier) {
-        if (event->angleDelta().y() > 0) {
-            zoomIn();
-        } else {
-            zoomOut();
-        }
+        // One notch is 120 units; touchpads send smaller deltas more often
+        const qreal notches = event->angleDelta().y() / 120.0;
+        const qreal base = m_zoomAnimation->state() == QAbstractAnimation::Running ? m_targetZoom : m_zoomFactor;
+        animateZoomTo(base * std::pow(ZOOM_STEP, notches));
         event->accept();
     } else {
         QGraphicsView::wheelEvent(event);
@@ -419,6 +1108,8 @@ void ImageMapEditor::keyPressEvent(QKeyEvent *event)
 
 void ImageMapEditor::drawBackground(QPainter *painter, const QRectF &rect)
 {
+    TRACE_SCOPE("ImageMapEditor::drawBackground");
+
     QGraphicsView::drawBackground(painter, rect);
 
     // Draw checkerboard pattern for transparency
@@ -441,6 +1132,33 @@ void ImageMapEditor::drawBackground(QPainter *painter, const QRectF &rect)
     }
 }
 
+void ImageMapEditor::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+
+    if (!m_browserHoverOutline.isEmpty()) {
+        painter->save();
+        painter->setPen(QPen(QColor(255, 140, 0), 0));
+        painter->setBrush(QColor(255, 140, 0, 90));
+        painter->drawPolygon(m_browserHoverOutline);
+        painter->restore();
+    }
+
+    if (!m_hasSnapIndicator) {
+        return;
+    }
+
+    // Marker stays the same size on screen regardless of zoom
+    qreal size = 5.0 / qMax(m_zoomFactor, 0.01);
+    painter->save();
+    painter->setPen(QPen(QColor(166, 227, 161), 0));
+    painter->setBrush(Qt::NoBrush);
+    painter->drawEllipse(m_snapIndicatorPos, size, size);
+    painter->drawLine(m_snapIndicatorPos - QPointF(size * 2, 0), m_snapIndicatorPos + QPointF(size * 2, 0));
+    painter->drawLine(m_snapIndicatorPos - QPointF(0, size * 2), m_snapIndicatorPos + QPointF(0, size * 2));
+    painter->restore();
+}
+
 void ImageMapEditor::finishCurrentDrawing()
 {
     if (!m_currentDrawingItem) {
@@ -459,6 +1177,8 @@ void ImageMapEditor::finishCurrentDrawing()
         validShape = m_currentDrawingItem->radius() > 5;
         break;
     case EditorTool::DrawPolygon:
+    case EditorTool::MagicWand:
+    case EditorTool::Lasso:
         validShape = m_currentDrawingItem->polygon().size() >= 3;
         if (validShape) {
             m_currentDrawingItem->closePolygon();
@@ -470,6 +1190,9 @@ void ImageMapEditor::finishCurrentDrawing()
 
     if (validShape) {
         m_hotspots.append(m_currentDrawingItem);
+        m_index.insert(m_currentDrawingItem);
+        m_overlapAnalyzer->updateHotspot(m_currentDrawingItem);
+        refreshLayer();
         emit hotspotAdded(m_currentDrawingItem);
         selectHotspot(m_currentDrawingItem);
     } else {
@@ -479,6 +1202,7 @@ void ImageMapEditor::finishCurrentDrawing()
 
     m_currentDrawingItem = nullptr;
     m_isDrawing = false;
+    m_magicWand.clear();
 }
 
 void ImageMapEditor::cancelCurrentDrawing()
@@ -489,73 +1213,166 @@ void ImageMapEditor::cancelCurrentDrawing()
         m_currentDrawingItem = nullptr;
     }
     m_isDrawing = false;
+    m_magicWand.clear();
 }
 
 HotspotItem* ImageMapEditor::hotspotAt(const QPointF &scenePos)
 {
-    QList<QGraphicsItem*> items = m_scene->items(scenePos);
-    for (QGraphicsItem *item : items) {
-        HotspotItem *hotspot = dynamic_cast<HotspotItem*>(item);
-        if (hotspot) {
-            return hotspot;
+    TRACE_SCOPE("ImageMapEditor::hotspotAt");
+
+    // The spatial index also covers hotspots that are not in the scene
+    return m_index.topmostAt(scenePos);
+}
+
+void ImageMapEditor::setBatchedRendering(bool enabled)
+{
+    if (enabled == m_batchedRendering) {
+        return;
+    }
+    m_batchedRendering = enabled;
+
+    if (enabled) {
+        m_layerItem = new HotspotLayerItem(&m_index);
+        // Above the image, below the hotspots still in the scene
+        m_layerItem->setZValue(-1);
+        m_scene->addItem(m_layerItem);
+        for (HotspotItem *hotspot : m_hotspots) {
+            syncBatchedItem(hotspot);
+        }
+        m_layerItem->refresh();
+    } else {
+        m_scene->removeItem(m_layerItem);
+        delete m_layerItem;
+        m_layerItem = nullptr;
+        // Re-add in document order so stacking matches the export
+        for (HotspotItem *hotspot : m_hotspots) {
+            if (hotspot->scene()) {
+                m_scene->removeItem(hotspot);
+            }
+        }
+        for (HotspotItem *hotspot : m_hotspots) {
+            m_scene->addItem(hotspot);
         }
     }
-    return nullptr;
 }
 
-QString ImageMapEditor::generateAreaTagForHotspot(const HotspotItem *hotspot) const
+void ImageMapEditor::setBrowserTestMode(bool enabled)
 {
-    QString shapeName;
-    QStringList coords;
-    
-    switch (hotspot->hotspotShape()) {
-    case HotspotShape::Rectangle: {
-        shapeName = "rect";
-        QRectF r = hotspot->rect().translated(hotspot->pos());
-        QRectF outputRect = toOutputRect(r);
-        coords << QString::number(qRound(outputRect.left()))
-               << QString::number(qRound(outputRect.top()))
-               << QString::number(qRound(outputRect.right()))
-               << QString::number(qRound(outputRect.bottom()));
-        break;
-    }
-    case HotspotShape::Circle: {
-        shapeName = "circle";
-        QPointF c = hotspot->center() + hotspot->pos();
-        QPointF outputCenter = toOutputCoords(c);
-        qreal outputRadius = toOutputRadius(hotspot->radius());
-        coords << QString::number(qRound(outputCenter.x()))
-               << QString::number(qRound(outputCenter.y()))
-               << QString::number(qRound(outputRadius));
-        break;
+    if (enabled == isBrowserTestMode()) {
+        return;
     }
-    case HotspotShape::Polygon: {
-        shapeName = "poly";
-        for (const QPointF &pt : hotspot->polygon()) {
-            QPointF p = pt + hotspot->pos();
-            QPointF outputPt = toOutputCoords(p);
-            coords << QString::number(qRound(outputPt.x()))
-                   << QString::number(qRound(outputPt.y()));
+
+    if (enabled) {
+        if (m_isDrawing) {
+            cancelCurrentDrawing();
         }
-        break;
+        selectHotspot(nullptr);
+        m_hasSnapIndicator = false;
+        m_idBuffer.reset(new IdBuffer(m_sourceImage.size(), &m_index));
+        setCursor(Qt::ArrowCursor);
+    } else {
+        m_idBuffer.reset();
+        m_browserHover = IdBuffer::Hit();
+        m_browserHoverOutline.clear();
+        emit browserHoverChanged(nullptr, QString());
+        setCurrentTool(m_currentTool); // restores the tool's cursor
     }
+    viewport()->update();
+}
+
+void ImageMapEditor::updateBrowserHover(const QPointF &scenePos)
+{
+    // The buffer only re-rasterizes what changed since the last lookup
+    m_idBuffer->flush(m_hotspots);
+    const IdBuffer::Hit hit = m_idBuffer->at(QPoint(qFloor(scenePos.x()), qFloor(scenePos.y())));
+    if (hit.hotspot == m_browserHover.hotspot && hit.instance == m_browserHover.instance) {
+        return;
     }
-    
-    QString tag = QString("<area shape=\"%1\" coords=\"%2\" href=\"%3\"")
-                      .arg(shapeName)
-                      .arg(coords.join(","))
-                      .arg(hotspot->url().isEmpty() ? "#" : hotspot->url().toHtmlEscaped());
 
-    if (!hotspot->altText().isEmpty()) {
-        tag += QString(" alt=\"%1\"").arg(hotspot->altText().toHtmlEscaped());
-    } else {
-        tag += " alt=\"\"";
+    m_browserHover = hit;
+    m_browserHoverOutline.clear();
+    QString url;
+    if (hit.hotspot) {
+        m_browserHoverOutline = hotspotOutlines(hit.hotspot, hit.instance).value(0);
+        url = hit.hotspot->expandTemplate(hit.hotspot->url(), hit.instance);
+    }
+    setCursor(hit.hotspot ? Qt::PointingHandCursor : Qt::ArrowCursor);
+    viewport()->update();
+    emit browserHoverChanged(hit.hotspot, url);
+}
+
+void ImageMapEditor::syncBatchedItem(HotspotItem *hotspot)
+{
+    const bool live = !m_batchedRendering || m_selection.contains(hotspot);
+    if (live && !hotspot->scene()) {
+        m_scene->addItem(hotspot);
+    } else if (!live && hotspot->scene()) {
+        m_scene->removeItem(hotspot);
+    }
+}
+
+void ImageMapEditor::refreshLayer()
+{
+    if (m_layerItem) {
+        m_layerItem->refresh();
     }
+}
 
-    if (!hotspot->title().isEmpty()) {
-        tag += QString(" title=\"%1\"").arg(hotspot->title().toHtmlEscaped());
+void ImageMapEditor::appendMapAreas(const HotspotItem *hotspot, QVector<MapArea> &areas, bool outputCoords) const
+{
+    // One area per instance; a plain hotspot is a single instance at offset 0
+    for (int i = 0; i < hotspot->instanceCount(); ++i) {
+        const QPointF offset = hotspot->pos() + hotspot->instanceOffset(i);
+
+        MapArea area;
+        area.shape = hotspot->hotspotShape();
+        area.url = hotspot->expandTemplate(hotspot->url(), i);
+        area.altText = hotspot->expandTemplate(hotspot->altText(), i);
+        area.title = hotspot->expandTemplate(hotspot->title(), i);
+
+        switch (area.shape) {
+        case HotspotShape::Rectangle:
+            area.rect = hotspot->rect().translated(offset);
+            break;
+        case HotspotShape::Circle:
+            area.center = hotspot->center() + offset;
+            area.radius = hotspot->radius();
+            break;
+        case HotspotShape::Polygon:
+            area.polygon = hotspot->polygon().translated(offset);
+            break;
+        }
+        if (outputCoords) {
+            area.rect = toOutputRect(area.rect);
+            area.center = toOutputCoords(area.center);
+            area.radius = toOutputRadius(area.radius);
+            area.polygon = toOutputPolygon(area.polygon);
+        }
+        areas.append(area);
     }
+}
 
-    tag += ">";
-    return tag;
+QVector<MapArea> ImageMapEditor::mapAreas() const
+{
+    return collectAreas(true);
+}
+
+QVector<MapArea> ImageMapEditor::imageAreas() const
+{
+    return collectAreas(false);
+}
+
+QVector<MapArea> ImageMapEditor::collectAreas(bool outputCoords) const
+{
+    int count = 0;
+    for (const HotspotItem *hotspot : m_hotspots) {
+        count += hotspot->instanceCount();
+    }
+
+    QVector<MapArea> areas;
+    areas.reserve(count);
+    for (const HotspotItem *hotspot : m_hotspots) {
+        appendMapAreas(hotspot, areas, outputCoords);
+    }
+    return areas;
 }
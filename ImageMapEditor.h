@@ -4,16 +4,33 @@
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
+#include <QHash>
 #include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVariantAnimation>
+#include <memory>
 #include "HotspotItem.h"
+#include "HotspotIndex.h"
+#include "IdBuffer.h"
+#include "MagicWand.h"
+#include "EdgeMap.h"
+#include "Geometry.h"
+#include "MapArea.h"
+#include "OverlapAnalyzer.h"
+#include "PolygonBoolean.h"
 
 enum class EditorTool {
     Select,
     DrawRect,
     DrawCircle,
-    DrawPolygon
+    DrawPolygon,
+    MagicWand,
+    Lasso
 };
 
+class HotspotLayerItem;
+
 class ImageMapEditor : public QGraphicsView
 {
     Q_OBJECT
@@ -22,36 +39,124 @@ public:
     explicit ImageMapEditor(QWidget *parent = nullptr);
 
     bool loadImage(const QString &filePath);
+    // Same for an image already decoded, e.g. in the background
+    void loadDecodedImage(const QString &filePath, const QImage &image);
     void setImage(const QPixmap &pixmap);
+    void setImage(const QImage &image);
     QPixmap image() const;
+    QImage sourceImage() const { return m_sourceImage; }
     QString imagePath() const { return m_imagePath; }
 
     void setCurrentTool(EditorTool tool);
     EditorTool currentTool() const { return m_currentTool; }
 
     QList<HotspotItem*> hotspots() const { return m_hotspots; }
+    // Hotspots whose bounds meet a scene rectangle, bottom-most first
+    QVector<HotspotItem*> hotspotsIn(const QRectF &sceneRect) const { return m_index.query(sceneRect); }
     HotspotItem* selectedHotspot() const { return m_selectedHotspot; }
 
     void addHotspot(HotspotItem *hotspot);
+    // Adds many hotspots at once and emits a single hotspotsAdded signal.
+    // They are inserted at index in document order, or appended if index < 0.
+    void addHotspots(const QList<HotspotItem*> &hotspots, int index = -1);
     void removeHotspot(HotspotItem *hotspot);
     void clearAllHotspots();
 
     void selectHotspot(HotspotItem *hotspot);
     void deleteSelectedHotspot();
 
-    QString generateImageMapHtml(const QString &mapName = "imagemap") const;
+    // Shift/Ctrl+click adds to the selection; selectedHotspot() is the
+    // primary hotspot shown in the properties panel
+    QList<HotspotItem*> selectedHotspots() const { return m_selection; }
+    void setSelectedHotspots(const QList<HotspotItem*> &hotspots);
+
+    // Replaces the selected hotspots with the polygons of their union or
+    // intersection, or of the primary hotspot minus the others. The new
+    // hotspots take the primary's place and properties. Returns them, or an
+    // empty list (leaving the selection alone) if the result is empty.
+    QList<HotspotItem*> combineSelectedHotspots(PolygonBoolean::Operation operation);
+
+    // Repeats a hotspot's shape over a rows x columns grid of instances,
+    // step apart in scene pixels. Its URL, alt text and title become
+    // templates ({row}, {col}, {index}).
+    void arrangeInGrid(HotspotItem *hotspot, int rows, int columns, const QPointF &step,
+                       int firstRow = 1, int firstColumn = 1);
+
+    // Maps each hotspot through its transform (scale and shift only), e.g.
+    // to follow the content of a replaced image. Emits hotspotsTransformed.
+    void transformHotspots(const QList<HotspotItem*> &hotspots, const QVector<QTransform> &transforms);
+
+    // Draws unselected hotspots through a single layer item instead of one
+    // scene item each. Only selected hotspots stay in the scene, where they
+    // can be dragged and edited as usual.
+    void setBatchedRendering(bool enabled);
+    bool isBatchedRendering() const { return m_batchedRendering; }
+
+    // Simulates the exported map in a browser: hovering highlights the area a
+    // click would go to (the first matching <area>) and reports its URL.
+    // Hotspots cannot be edited in this mode.
+    void setBrowserTestMode(bool enabled);
+    bool isBrowserTestMode() const { return m_idBuffer != nullptr; }
+
+    // Tracks overlapping hotspots; conflicting ones are outlined in red
+    OverlapAnalyzer *overlapAnalyzer() const { return m_overlapAnalyzer; }
+
+    // Byte and polygon vertex counts of an export, with and without simplification
+    struct ExportStats {
+        qint64 originalBytes = 0;
+        qint64 exportedBytes = 0;
+        int originalVertices = 0;
+        int exportedVertices = 0;
+    };
+
+    QString generateImageMapHtml(const QString &mapName = "imagemap", ExportStats *stats = nullptr) const;
+
+    // Hotspots in document order, in output coordinates
+    QVector<MapArea> mapAreas() const;
+    // The same in image pixel coordinates, ignoring Screen Standard Mode
+    QVector<MapArea> imageAreas() const;
+
+    // Simplify exported polygons to within tolerance output pixels
+    void setExportSimplification(bool enabled, qreal tolerance);
+    bool isExportSimplificationEnabled() const { return m_exportSimplify; }
+    qreal exportTolerance() const { return m_exportTolerance; }
+
+    // No indentation or line breaks, and unquoted attributes where allowed
+    void setExportMinified(bool minified) { m_exportMinified = minified; }
+    bool isExportMinified() const { return m_exportMinified; }
 
     void zoomIn();
     void zoomOut();
     void zoomFit();
     void zoomReset();
+    qreal zoomFactor() const { return m_zoomFactor; }
+    void setZoomFactor(qreal factor);
+    QRectF visibleSceneRect() const;
+
+    // Draws with nearest-neighbour scaling and no antialiasing while the
+    // view pans or zooms, then redraws at full quality once it settles
+    void setAdaptiveQuality(bool enabled);
+    bool isAdaptiveQuality() const { return m_adaptiveQuality; }
 
     void setClipboardMode(bool enabled);
     bool isClipboardMode() const { return m_clipboardMode; }
 
+    // Snap the cursor and new vertices to strong image edges
+    void setEdgeSnapEnabled(bool enabled);
+    bool isEdgeSnapEnabled() const { return m_edgeSnapEnabled; }
+    bool isEdgeMapReady() const;
+    QPointF snapToEdge(const QPointF &scenePos, bool *snapped = nullptr) const;
+
+    // Starting colour tolerance of the magic wand; dragging adjusts it per use
+    void setMagicWandTolerance(int tolerance) { m_wandBaseTolerance = qBound(0, tolerance, 255); }
+    int magicWandTolerance() const { return m_wandBaseTolerance; }
+
     void setScreenStandardMode(bool enabled);
     bool isScreenStandardMode() const { return m_screenStandardMode; }
     
+    // Size of the image in output coordinates
+    QSize outputSize() const;
+
     // Convert scene coordinates to output coordinates (applies screen standard scaling if enabled)
     QPointF toOutputCoords(const QPointF &scenePos) const;
     QRectF toOutputRect(const QRectF &sceneRect) const;
@@ -59,12 +164,26 @@ public:
     QPolygonF toOutputPolygon(const QPolygonF &polygon) const;
 
 signals:
+    void toolChanged(EditorTool tool);
     void hotspotAdded(HotspotItem *hotspot);
+    void hotspotsAdded(const QList<HotspotItem*> &hotspots);
     void hotspotRemoved(HotspotItem *hotspot);
+    void hotspotChanged(HotspotItem *hotspot);
+    // Many hotspots moved at once; hotspotChanged is not emitted for each
+    void hotspotsTransformed(const QList<HotspotItem*> &hotspots);
     void hotspotSelected(HotspotItem *hotspot);
+    void selectionChanged(const QList<HotspotItem*> &hotspots);
     void imageLoaded(const QString &path);
+    void imageChanged();
+    void hotspotsCleared();
+    // The visible part of the scene moved or changed size
+    void viewChanged();
     void coordinatesChanged(const QPointF &pos);
     void coordinatesCopied(const QPointF &pos);
+    void magicWandToleranceChanged(int tolerance);
+    // Browser test mode; hotspot is null and url empty when over no area
+    void browserHoverChanged(HotspotItem *hotspot, const QString &url);
+    void browserLinkClicked(const QString &url);
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
@@ -74,29 +193,109 @@ protected:
     void wheelEvent(QWheelEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void drawBackground(QPainter *painter, const QRectF &rect) override;
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private:
+    void applyImage(const QPixmap &pixmap);
+    void animateZoomTo(qreal factor);
+    void beginFastRendering();
+    void refineRendering();
+    void processPendingMove();
+    // Only the drawing tools place snapped points; the clipboard copies raw ones
+    bool snapsToEdges() const;
+    void updateMagicWand(int tolerance);
+    void syncLassoPreview();
+    int frameIntervalMs() const;
     void finishCurrentDrawing();
     void cancelCurrentDrawing();
     HotspotItem* hotspotAt(const QPointF &scenePos);
-    QString generateAreaTagForHotspot(const HotspotItem *hotspot) const;
+    // Puts a hotspot in the scene or leaves it to the layer, by selection
+    void syncBatchedItem(HotspotItem *hotspot);
+    void updateBrowserHover(const QPointF &scenePos);
+    void refreshLayer();
+    QVector<MapArea> collectAreas(bool outputCoords) const;
+    void appendMapAreas(const HotspotItem *hotspot, QVector<MapArea> &areas, bool outputCoords = true) const;
+    // Scene-space outline of each instance, or of just one if instance >= 0
+    static QVector<QPolygonF> hotspotOutlines(const HotspotItem *hotspot, int instance = -1);
 
     QGraphicsScene *m_scene;
     QGraphicsPixmapItem *m_imageItem = nullptr;
     QString m_imagePath;
+    QImage m_sourceImage;
 
     EditorTool m_currentTool = EditorTool::Select;
     QList<HotspotItem*> m_hotspots;
     HotspotItem *m_selectedHotspot = nullptr;
+    QList<HotspotItem*> m_selection;
+    OverlapAnalyzer *m_overlapAnalyzer;
+    QHash<HotspotItem*, QPointF> m_pressedPositions; // everything a Select drag may move
+    HotspotIndex m_index;
+
+    // Batched rendering
+    bool m_batchedRendering = false;
+    HotspotLayerItem *m_layerItem = nullptr;
+
+    // Browser test mode
+    std::unique_ptr<IdBuffer> m_idBuffer;
+    IdBuffer::Hit m_browserHover;
+    QPolygonF m_browserHoverOutline;
 
     // Drawing state
     bool m_isDrawing = false;
     QPointF m_drawStart;
     HotspotItem *m_currentDrawingItem = nullptr;
 
+    // Mouse-move coalescing
+    QTimer *m_moveTimer = nullptr;
+    QElapsedTimer m_lastMoveUpdate;
+    QPointF m_pendingMovePos;
+    bool m_movePending = false;
+
     qreal m_zoomFactor = 1.0;
+    qreal m_targetZoom = 1.0;
+    QVariantAnimation *m_zoomAnimation = nullptr;
+    static constexpr qreal ZOOM_STEP = 1.25;
+    static constexpr int ZOOM_ANIMATION_MS = 160;
+
+    // Adaptive quality
+    bool m_adaptiveQuality = true;
+    bool m_fastRendering = false;
+    QTimer *m_refineTimer = nullptr;
+    static constexpr int REFINE_DELAY_MS = 200;
     bool m_clipboardMode = false;
     bool m_screenStandardMode = false;
+
+    // Export
+    bool m_exportSimplify = false;
+    qreal m_exportTolerance = 1.0;
+    bool m_exportMinified = false;
+    static constexpr int AREA_CHUNK_SIZE = 256;
+
+    // Boolean operations
+    static constexpr qreal BOOLEAN_TOLERANCE_PX = 0.5;
+    static constexpr qreal CIRCLE_SEGMENT_PX = 2.0;
+
+    // Magic wand
+    MagicWand m_magicWand;
+    int m_wandBaseTolerance = 32;
+    int m_wandTolerance = 32;
+    static constexpr qreal WAND_DRAG_PX_PER_STEP = 2.0;
+
+    // Lasso
+    Geometry::StreamingSimplifier m_lassoSimplifier;
+    int m_lassoSyncedCount = 0;
+    bool m_lassoPreviewHasTail = false;
+    static constexpr qreal LASSO_TOLERANCE_PX = 1.5;
+
+    // Edge snapping
+    std::shared_ptr<EdgeMap> m_edgeMap;
+    bool m_edgeSnapEnabled = false;
+    bool m_hasSnapIndicator = false;
+    QPointF m_snapIndicatorPos;
+    static constexpr qreal SNAP_RADIUS_PX = 8.0;
+    static constexpr int SNAP_THRESHOLD = 40;
     
     // Screen standard resolution
     static constexpr int STANDARD_WIDTH = 1920;
@@ -0,0 +1,347 @@
+#include "ImageWorkspace.h"
+#include "TraceRecorder.h"
+#include <QCollator>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+
+struct ImageWorkspace::Decode
+{
+    QString path;
+    qint64 bytes = 0; // counted against the budget
+    QImage image;
+    // Whoever claims the job decodes it: a pool thread, or activate() when
+    // the image is wanted before a thread got to it
+    std::atomic<bool> claimed{false};
+    std::atomic<bool> cancelled{false};
+    QSemaphore finished;
+};
+
+struct ImageWorkspace::Thumbnail
+{
+    QString path;
+    QImage image;
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+};
+
+ImageWorkspace::ImageWorkspace(QObject *parent)
+    : QObject(parent)
+{
+    // Leave the rest of the machine to prefetching and the editor
+    m_thumbnailPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
+    const QString cacheRoot = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheRoot.isEmpty() && QDir().mkpath(cacheRoot + "/thumbnails")) {
+        m_cacheDirectory = cacheRoot + "/thumbnails";
+    }
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(m_pollTimer, &QTimer::timeout, this, &ImageWorkspace::pollThumbnails);
+}
+
+ImageWorkspace::~ImageWorkspace()
+{
+    close();
+    m_thumbnailPool.clear();
+}
+
+bool ImageWorkspace::open(const QString &directory)
+{
+    TRACE_SCOPE("ImageWorkspace::open");
+
+    close();
+
+    QDir dir(directory);
+    if (!dir.exists()) {
+        return false;
+    }
+
+    QStringList filters;
+    for (const QByteArray &format : QImageReader::supportedImageFormats()) {
+        filters << "*." + QString::fromLatin1(format);
+    }
+    QStringList names = dir.entryList(filters, QDir::Files | QDir::Readable);
+
+    // img2 before img10, as a file manager would show them
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(names.begin(), names.end(), [&collator](const QString &a, const QString &b) {
+        return collator.compare(a, b) < 0;
+    });
+
+    for (const QString &name : names) {
+        m_paths << dir.absoluteFilePath(name);
+    }
+    m_directory = dir.absolutePath();
+    return !m_paths.isEmpty();
+}
+
+void ImageWorkspace::close()
+{
+    for (const std::shared_ptr<Decode> &job : m_decodes) {
+        job->cancelled.store(true, std::memory_order_relaxed);
+    }
+    m_decodes.clear();
+    for (const std::shared_ptr<Thumbnail> &job : m_thumbnails) {
+        job->cancelled.store(true, std::memory_order_relaxed);
+    }
+    m_thumbnails.clear();
+    m_pollTimer->stop();
+
+    m_paths.clear();
+    m_directory.clear();
+    m_current = -1;
+    m_direction = 1;
+}
+
+QImage ImageWorkspace::activate(int index)
+{
+    TRACE_SCOPE("ImageWorkspace::activate");
+
+    if (index < 0 || index >= m_paths.size()) {
+        return QImage();
+    }
+    if (m_current >= 0 && index != m_current) {
+        m_direction = index > m_current ? 1 : -1;
+    }
+    m_current = index;
+
+    std::shared_ptr<Decode> job = m_decodes.value(index);
+    if (!job) {
+        job = std::make_shared<Decode>();
+        job->path = m_paths[index];
+        job->claimed.store(true, std::memory_order_relaxed);
+        job->image = decode(job->path);
+        job->bytes = qint64(job->image.width()) * job->image.height() * 4;
+        job->finished.release();
+        m_decodes.insert(index, job);
+    } else if (!job->claimed.exchange(true)) {
+        // Queued but not started: decoding here beats waiting for a thread
+        job->image = decode(job->path);
+        job->finished.release();
+    } else {
+        job->finished.acquire();
+        job->finished.release();
+    }
+
+    QImage image = job->image;
+    prefetch();
+    return image;
+}
+
+void ImageWorkspace::prefetch()
+{
+    // Nearest first, ahead before behind, so when the budget runs out it is
+    // the least likely images that are left out
+    QVector<int> wanted{m_current};
+    for (int step = 1; step <= qMax(PREFETCH_AHEAD, PREFETCH_BEHIND); ++step) {
+        if (step <= PREFETCH_AHEAD) {
+            wanted << m_current + step * m_direction;
+        }
+        if (step <= PREFETCH_BEHIND) {
+            wanted << m_current - step * m_direction;
+        }
+    }
+
+    QHash<int, std::shared_ptr<Decode>> kept;
+    qint64 used = 0;
+    for (int index : wanted) {
+        if (index < 0 || index >= m_paths.size()) {
+            continue;
+        }
+
+        std::shared_ptr<Decode> job = m_decodes.take(index);
+        qint64 bytes = job ? job->bytes : 0;
+        if (!job) {
+            // The header is enough to know the decoded size
+            const QSize size = QImageReader(m_paths[index]).size();
+            if (!size.isValid()) {
+                continue;
+            }
+            bytes = qint64(size.width()) * size.height() * 4;
+        }
+
+        if (index != m_current && used + bytes > m_memoryBudget) {
+            if (job) {
+                job->cancelled.store(true, std::memory_order_relaxed);
+            }
+            continue;
+        }
+        used += bytes;
+        kept.insert(index, job ? job : startDecode(index, bytes));
+    }
+
+    // Outside the window: drop finished images, skip queued ones
+    for (const std::shared_ptr<Decode> &job : m_decodes) {
+        job->cancelled.store(true, std::memory_order_relaxed);
+    }
+    m_decodes = kept;
+}
+
+std::shared_ptr<ImageWorkspace::Decode> ImageWorkspace::startDecode(int index, qint64 bytes)
+{
+    auto job = std::make_shared<Decode>();
+    job->path = m_paths[index];
+    job->bytes = bytes;
+    QThreadPool::globalInstance()->start([job]() {
+        runDecode(*job);
+    });
+    return job;
+}
+
+void ImageWorkspace::runDecode(Decode &job)
+{
+    if (job.claimed.exchange(true)) {
+        return;
+    }
+    if (!job.cancelled.load(std::memory_order_relaxed)) {
+        TRACE_SCOPE("ImageWorkspace::prefetch");
+        job.image = decode(job.path);
+    }
+    job.finished.release();
+}
+
+QImage ImageWorkspace::decode(const QString &path)
+{
+    QImage image = QImageReader(path).read();
+    if (image.isNull()) {
+        return image;
+    }
+
+    // Converted here rather than on the GUI thread by QPixmap::fromImage
+    const QImage::Format format = image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                          : QImage::Format_RGB32;
+    if (image.format() != format) {
+        image = image.convertToFormat(format);
+    }
+    return image;
+}
+
+qint64 ImageWorkspace::memoryUsed() const
+{
+    qint64 used = 0;
+    for (const std::shared_ptr<Decode> &job : m_decodes) {
+        used += job->bytes;
+    }
+    return used;
+}
+
+void ImageWorkspace::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = qMax<qint64>(0, bytes);
+    if (m_current >= 0) {
+        prefetch();
+    }
+}
+
+QString ImageWorkspace::projectPath(const QString &imagePath)
+{
+    return imagePath + ".imap";
+}
+
+void ImageWorkspace::requestThumbnail(int index)
+{
+    if (index < 0 || index >= m_paths.size() || m_thumbnails.contains(index)) {
+        return;
+    }
+
+    auto job = std::make_shared<Thumbnail>();
+    job->path = m_paths[index];
+    const QString cacheDirectory = m_cacheDirectory;
+    m_thumbnailPool.start([job, cacheDirectory]() {
+        if (!job->cancelled.load(std::memory_order_relaxed)) {
+            TRACE_SCOPE("ImageWorkspace::thumbnail");
+            job->image = loadThumbnail(job->path, cacheDirectory);
+        }
+        job->done.store(true, std::memory_order_release);
+    });
+    m_thumbnails.insert(index, job);
+
+    if (!m_pollTimer->isActive()) {
+        m_pollTimer->start();
+    }
+}
+
+void ImageWorkspace::cancelThumbnailsOutside(int first, int last)
+{
+    for (auto it = m_thumbnails.begin(); it != m_thumbnails.end();) {
+        if (it.key() < first || it.key() > last) {
+            it.value()->cancelled.store(true, std::memory_order_relaxed);
+            it = m_thumbnails.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ImageWorkspace::pollThumbnails()
+{
+    QList<QPair<int, QImage>> ready;
+    for (auto it = m_thumbnails.begin(); it != m_thumbnails.end();) {
+        if (it.value()->done.load(std::memory_order_acquire)) {
+            ready.append(qMakePair(it.key(), it.value()->image));
+            it = m_thumbnails.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (m_thumbnails.isEmpty()) {
+        m_pollTimer->stop();
+    }
+
+    for (const auto &entry : ready) {
+        if (!entry.second.isNull()) {
+            emit thumbnailReady(entry.first, entry.second);
+        }
+    }
+}
+
+QImage ImageWorkspace::loadThumbnail(const QString &path, const QString &cacheDirectory)
+{
+    const QFileInfo info(path);
+    QString cachePath;
+    if (!cacheDirectory.isEmpty()) {
+        const QString key = info.absoluteFilePath() + '\n' + QString::number(info.size()) + '\n'
+                            + QString::number(info.lastModified().toMSecsSinceEpoch());
+        cachePath = cacheDirectory + '/'
+                    + QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex() + ".png";
+        QImage cached(cachePath);
+        if (!cached.isNull()) {
+            return cached;
+        }
+    }
+
+    QImageReader reader(path);
+    const QSize size = reader.size();
+    if (size.isValid() && (size.width() > ThumbnailSize || size.height() > ThumbnailSize)) {
+        // JPEG and some other decoders skip most of the work at a reduced size
+        reader.setScaledSize(size.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio)
+                                 .expandedTo(QSize(1, 1)));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return image;
+    }
+    if (image.width() > ThumbnailSize || image.height() > ThumbnailSize) {
+        image = image.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    if (!cachePath.isEmpty()) {
+        QSaveFile file(cachePath);
+        if (file.open(QIODevice::WriteOnly) && image.save(&file, "PNG")) {
+            file.commit();
+        }
+    }
+    return image;
+}
@@ -0,0 +1,93 @@
+#ifndef IMAGEWORKSPACE_H
+#define IMAGEWORKSPACE_H
+
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <memory>
+
+// A folder of images worked through in sequence, each with its own project
+// saved next to it (see projectPath).
+//
+// Images around the current one are decoded ahead of time on the thread
+// pool in the direction the user is moving, so stepping to the next or
+// previous image usually finds it already decoded. Prefetched images are
+// kept only while their estimated size fits the memory budget; anything
+// outside the window is dropped.
+//
+// Thumbnails are decoded at reduced size on a separate, smaller pool so they
+// never hold up a prefetch, and cached on disk keyed by path, size and
+// modification time.
+class ImageWorkspace : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageWorkspace(QObject *parent = nullptr);
+    ~ImageWorkspace() override;
+
+    // Lists the supported images in directory, sorted by name
+    bool open(const QString &directory);
+    void close();
+
+    QString directory() const { return m_directory; }
+    int count() const { return m_paths.size(); }
+    QString path(int index) const { return m_paths.value(index); }
+    int currentIndex() const { return m_current; }
+
+    // Makes index current and returns its image, at once when it was
+    // prefetched; then starts prefetching its neighbours
+    QImage activate(int index);
+
+    // Emits thumbnailReady when done; requests for indices outside
+    // [first, last] that have not started yet are dropped
+    void requestThumbnail(int index);
+    void cancelThumbnailsOutside(int first, int last);
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    qint64 memoryUsed() const;
+
+    // The project kept for an image in the workspace
+    static QString projectPath(const QString &imagePath);
+
+    static constexpr int ThumbnailSize = 96;
+
+signals:
+    void thumbnailReady(int index, const QImage &thumbnail);
+
+private:
+    struct Decode;
+    struct Thumbnail;
+
+    void prefetch();
+    std::shared_ptr<Decode> startDecode(int index, qint64 bytes);
+    void pollThumbnails();
+
+    static void runDecode(Decode &job);
+    static QImage decode(const QString &path);
+    static QImage loadThumbnail(const QString &path, const QString &cacheDirectory);
+
+    QString m_directory;
+    QStringList m_paths;
+    int m_current = -1;
+    int m_direction = 1;
+
+    QHash<int, std::shared_ptr<Decode>> m_decodes;
+    qint64 m_memoryBudget = 512ll * 1024 * 1024;
+
+    QThreadPool m_thumbnailPool;
+    QHash<int, std::shared_ptr<Thumbnail>> m_thumbnails;
+    QString m_cacheDirectory;
+    QTimer *m_pollTimer;
+
+    // Images on each side of the current one worth decoding ahead
+    static constexpr int PREFETCH_AHEAD = 2;
+    static constexpr int PREFETCH_BEHIND = 1;
+    static constexpr int POLL_INTERVAL_MS = 30;
+};
+
+#endif // IMAGEWORKSPACE_H
@@ -0,0 +1,345 @@
+#include "InputSession.h"
+#include "ProjectFile.h"
+#include <QCoreApplication>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QFile>
+#include <QJsonDocument>
+#include <QHash>
+#include <algorithm>
+
+static QString mouseEventType(QEvent::Type type)
+{
+    switch (type) {
+    case QEvent::MouseButtonPress: return "press";
+    case QEvent::MouseMove: return "move";
+    case QEvent::MouseButtonRelease: return "release";
+    case QEvent::MouseButtonDblClick: return "dblclick";
+    default: return QString();
+    }
+}
+
+static QEvent::Type mouseEventType(const QString &type)
+{
+    if (type == "press") return QEvent::MouseButtonPress;
+    if (type == "move") return QEvent::MouseMove;
+    if (type == "release") return QEvent::MouseButtonRelease;
+    if (type == "dblclick") return QEvent::MouseButtonDblClick;
+    return QEvent::None;
+}
+
+InputSessionRecorder::InputSessionRecorder(ImageMapEditor *editor, QObject *parent)
+    : QObject(parent)
+    , m_editor(editor)
+{
+    connect(m_editor, &ImageMapEditor::toolChanged, this, &InputSessionRecorder::onToolChanged);
+}
+
+void InputSessionRecorder::start()
+{
+    if (m_recording) {
+        return;
+    }
+
+    // Snapshot the starting state so the replay begins from the same scene
+    QPointF center = m_editor->mapToScene(m_editor->viewport()->rect().center());
+    m_header = QJsonObject();
+    m_header["version"] = 1;
+    m_header["imagePath"] = m_editor->imagePath();
+    m_header["viewportWidth"] = m_editor->viewport()->width();
+    m_header["viewportHeight"] = m_editor->viewport()->height();
+    m_header["zoom"] = m_editor->zoomFactor();
+    m_header["centerX"] = center.x();
+    m_header["centerY"] = center.y();
+    m_header["tool"] = static_cast<int>(m_editor->currentTool());
+    m_header["hotspots"] = ProjectFile::hotspotsToJson(m_editor->hotspots());
+
+    m_events = QJsonArray();
+    m_editor->viewport()->installEventFilter(this);
+    m_editor->installEventFilter(this);
+    m_clock.start();
+    m_recording = true;
+}
+
+void InputSessionRecorder::stop()
+{
+    if (!m_recording) {
+        return;
+    }
+
+    m_editor->viewport()->removeEventFilter(this);
+    m_editor->removeEventFilter(this);
+    m_recording = false;
+}
+
+bool InputSessionRecorder::save(const QString &filePath) const
+{
+    QJsonObject session = m_header;
+    session["events"] = m_events;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(session).toJson(QJsonDocument::Compact));
+    file.close();
+    return true;
+}
+
+void InputSessionRecorder::recordPropertyEdit(HotspotItem *hotspot)
+{
+    if (!m_recording) {
+        return;
+    }
+
+    QJsonObject event;
+    event["type"] = "property";
+    event["index"] = static_cast<int>(m_editor->hotspots().indexOf(hotspot));
+    event["url"] = hotspot->url();
+    event["alt"] = hotspot->altText();
+    event["title"] = hotspot->title();
+    append(event);
+}
+
+bool InputSessionRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_editor->viewport()) {
+        switch (event->type()) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseMove:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick: {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+            QPointF scenePos = m_editor->mapToScene(mouseEvent->pos());
+            QJsonObject e;
+            e["type"] = mouseEventType(event->type());
+            e["x"] = scenePos.x();
+            e["y"] = scenePos.y();
+            e["button"] = static_cast<int>(mouseEvent->button());
+            e["buttons"] = static_cast<int>(mouseEvent->buttons());
+            e["modifiers"] = static_cast<int>(mouseEvent->modifiers());
+            append(e);
+            break;
+        }
+        case QEvent::Wheel: {
+            QWheelEvent *wheelEvent = static_cast<QWheelEvent*>(event);
+            QPointF scenePos = m_editor->mapToScene(wheelEvent->position().toPoint());
+            QJsonObject e;
+            e["type"] = "wheel";
+            e["x"] = scenePos.x();
+            e["y"] = scenePos.y();
+            e["angleX"] = wheelEvent->angleDelta().x();
+            e["angleY"] = wheelEvent->angleDelta().y();
+            e["modifiers"] = static_cast<int>(wheelEvent->modifiers());
+            append(e);
+            break;
+        }
+        default:
+            break;
+        }
+    } else if (watched == m_editor && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        QJsonObject e;
+        e["type"] = "key";
+        e["key"] = keyEvent->key();
+        e["modifiers"] = static_cast<int>(keyEvent->modifiers());
+        e["text"] = keyEvent->text();
+        append(e);
+    }
+
+    return QObject::eventFilter(watched, event);
+}
+
+void InputSessionRecorder::onToolChanged(EditorTool tool)
+{
+    if (!m_recording) {
+        return;
+    }
+
+    QJsonObject event;
+    event["type"] = "tool";
+    event["tool"] = static_cast<int>(tool);
+    append(event);
+}
+
+void InputSessionRecorder::append(QJsonObject event)
+{
+    event["t"] = m_clock.nsecsElapsed() / 1.0e6;
+    m_events.append(event);
+}
+
+bool InputSessionReplayer::load(const QString &filePath, QString *errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) *errorMessage = QString("Cannot open session file %1").arg(filePath);
+        return false;
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    file.close();
+
+    if (!doc.isObject() || doc.object()["version"].toInt() != 1) {
+        if (errorMessage) *errorMessage = QString("Invalid session file %1").arg(filePath);
+        return false;
+    }
+
+    m_header = doc.object();
+    m_events = m_header.take("events").toArray();
+    return true;
+}
+
+bool InputSessionReplayer::prepare(ImageMapEditor *editor, const QString &imagePath, QString *errorMessage) const
+{
+    QString path = imagePath.isEmpty() ? this->imagePath() : imagePath;
+    if (!path.isEmpty() && !editor->loadImage(path)) {
+        if (errorMessage) *errorMessage = QString("Cannot load image %1").arg(path);
+        return false;
+    }
+
+    editor->resize(m_header["viewportWidth"].toInt(800), m_header["viewportHeight"].toInt(600));
+    editor->show();
+
+    editor->clearAllHotspots();
+    editor->addHotspots(ProjectFile::hotspotsFromJson(m_header["hotspots"].toArray()));
+
+    editor->setCurrentTool(static_cast<EditorTool>(m_header["tool"].toInt()));
+    editor->setZoomFactor(m_header["zoom"].toDouble(1.0));
+    editor->centerOn(QPointF(m_header["centerX"].toDouble(), m_header["centerY"].toDouble()));
+
+    QCoreApplication::processEvents();
+    return true;
+}
+
+QVector<InputSessionReplayer::Result> InputSessionReplayer::run(ImageMapEditor *editor) const
+{
+    QVector<Result> results;
+    results.reserve(m_events.size());
+
+    QElapsedTimer timer;
+    for (int i = 0; i < m_events.size(); ++i) {
+        QJsonObject e = m_events.at(i).toObject();
+        QString type = e["type"].toString();
+        QPointF viewPos = editor->mapFromScene(QPointF(e["x"].toDouble(), e["y"].toDouble()));
+        QPointF globalPos = editor->viewport()->mapToGlobal(viewPos.toPoint());
+        Qt::KeyboardModifiers modifiers(e["modifiers"].toInt());
+
+        Result result;
+        result.index = i;
+        result.type = type;
+
+        timer.start();
+
+        if (mouseEventType(type) != QEvent::None) {
+            QMouseEvent event(mouseEventType(type), viewPos, globalPos,
+                              static_cast<Qt::MouseButton>(e["button"].toInt()),
+                              Qt::MouseButtons(e["buttons"].toInt()), modifiers);
+            QCoreApplication::sendEvent(editor->viewport(), &event);
+        } else if (type == "wheel") {
+            QWheelEvent event(viewPos, globalPos, QPoint(),
+                              QPoint(e["angleX"].toInt(), e["angleY"].toInt()),
+                              Qt::NoButton, modifiers, Qt::NoScrollPhase, false);
+            QCoreApplication::sendEvent(editor->viewport(), &event);
+        } else if (type == "key") {
+            QKeyEvent event(QEvent::KeyPress, e["key"].toInt(), modifiers, e["text"].toString());
+            QCoreApplication::sendEvent(editor, &event);
+        } else if (type == "tool") {
+            editor->setCurrentTool(static_cast<EditorTool>(e["tool"].toInt()));
+        } else if (type == "property") {
+            // Sessions recorded before the index was stored edit the selection
+            HotspotItem *hotspot = editor->selectedHotspot();
+            if (e.contains("index")) {
+                const QList<HotspotItem*> hotspots = editor->hotspots();
+                const int index = e["index"].toInt(-1);
+                hotspot = index >= 0 && index < hotspots.size() ? hotspots.at(index) : nullptr;
+            }
+            if (hotspot) {
+                hotspot->setUrl(e["url"].toString());
+                hotspot->setAltText(e["alt"].toString());
+                hotspot->setTitle(e["title"].toString());
+                hotspot->update();
+            }
+        }
+
+        result.handlerNs = timer.nsecsElapsed();
+
+        // Flush deferred work (viewport repaints) so it is charged to this event
+        QCoreApplication::sendPostedEvents();
+        QCoreApplication::processEvents();
+
+        result.totalNs = timer.nsecsElapsed();
+        results.append(result);
+    }
+
+    return results;
+}
+
+static QJsonObject latencyStats(QVector<qint64> values)
+{
+    QJsonObject stats;
+    stats["count"] = static_cast<int>(values.size());
+    if (values.isEmpty()) {
+        return stats;
+    }
+
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        int last = static_cast<int>(values.size()) - 1;
+        int index = qBound(0, static_cast<int>(p * last + 0.5), last);
+        return values.at(index) / 1000.0;
+    };
+
+    qint64 sum = 0;
+    for (qint64 v : values) {
+        sum += v;
+    }
+
+    stats["meanUs"] = sum / 1000.0 / static_cast<int>(values.size());
+    stats["p50Us"] = percentile(0.50);
+    stats["p95Us"] = percentile(0.95);
+    stats["p99Us"] = percentile(0.99);
+    stats["maxUs"] = values.last() / 1000.0;
+    return stats;
+}
+
+QJsonObject InputSessionReplayer::report(const QVector<Result> &results)
+{
+    QJsonArray events;
+    QVector<qint64> all;
+    QHash<QString, QVector<qint64>> byType;
+
+    for (const Result &r : results) {
+        QJsonObject e;
+        e["index"] = r.index;
+        e["type"] = r.type;
+        e["handlerUs"] = r.handlerNs / 1000.0;
+        e["totalUs"] = r.totalNs / 1000.0;
+        events.append(e);
+
+        all.append(r.totalNs);
+        byType[r.type].append(r.totalNs);
+    }
+
+    QJsonObject perType;
+    for (auto it = byType.constBegin(); it != byType.constEnd(); ++it) {
+        perType[it.key()] = latencyStats(it.value());
+    }
+
+    QJsonObject report;
+    report["summary"] = latencyStats(all);
+    report["perType"] = perType;
+    report["events"] = events;
+    return report;
+}
+
+bool InputSessionReplayer::writeReport(const QVector<Result> &results, const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(report(results)).toJson());
+    file.close();
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef INPUTSESSION_H
+#define INPUTSESSION_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QVector>
+#include "ImageMapEditor.h"
+
+// Records the input stream of an editor (mouse, wheel, keys, tool changes and
+// property edits) as a timestamped .imrec JSON session. Positions are stored in
+// scene coordinates so a session replays identically at any window size.
+class InputSessionRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InputSessionRecorder(ImageMapEditor *editor, QObject *parent = nullptr);
+
+    void start();
+    void stop();
+    bool isRecording() const { return m_recording; }
+    int eventCount() const { return m_events.size(); }
+
+    bool save(const QString &filePath) const;
+
+    // Property edits happen outside the editor, so the owner reports them.
+    // The hotspot is stored by its index, since it may have been selected
+    // from outside the editor too.
+    void recordPropertyEdit(HotspotItem *hotspot);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void onToolChanged(EditorTool tool);
+    void append(QJsonObject event);
+
+    ImageMapEditor *m_editor;
+    bool m_recording = false;
+    QElapsedTimer m_clock;
+    QJsonObject m_header;
+    QJsonArray m_events;
+};
+
+// Replays a recorded session against an editor as fast as possible and measures
+// how long each event takes to process.
+class InputSessionReplayer
+{
+public:
+    struct Result {
+        int index = 0;
+        QString type;
+        qint64 handlerNs = 0; // time spent in the event handler
+        qint64 totalNs = 0;   // including posted work such as repaints
+    };
+
+    bool load(const QString &filePath, QString *errorMessage = nullptr);
+    QString imagePath() const { return m_header["imagePath"].toString(); }
+    int eventCount() const { return m_events.size(); }
+
+    // Loads the image and starting scene into the editor. An empty imagePath
+    // uses the path stored in the session.
+    bool prepare(ImageMapEditor *editor, const QString &imagePath = QString(),
+                 QString *errorMessage = nullptr) const;
+    QVector<Result> run(ImageMapEditor *editor) const;
+
+    static QJsonObject report(const QVector<Result> &results);
+    static bool writeReport(const QVector<Result> &results, const QString &filePath);
+
+private:
+    QJsonObject m_header;
+    QJsonArray m_events;
+};
+
+#endif // INPUTSESSION_H
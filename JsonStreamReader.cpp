@@ -0,0 +1,236 @@
+#include "JsonStreamReader.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <cstdlib>
+#include <cstring>
+
+JsonStreamReader::JsonStreamReader(const QByteArray &data)
+    : m_begin(data.constData())
+    , m_pos(data.constData())
+    , m_end(data.constData() + data.size())
+{
+    // Byte order mark
+    if (m_end - m_pos >= 3 && std::memcmp(m_pos, "\xEF\xBB\xBF", 3) == 0) {
+        m_pos += 3;
+    }
+}
+
+void JsonStreamReader::fail(const QString &message)
+{
+    if (m_error.isEmpty()) {
+        m_error = QString("%1 at offset %2").arg(message).arg(m_pos - m_begin);
+    }
+    m_pos = m_end;
+}
+
+void JsonStreamReader::skipSpace()
+{
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+        ++m_pos;
+    }
+}
+
+bool JsonStreamReader::expect(char c)
+{
+    skipSpace();
+    if (m_pos < m_end && *m_pos == c) {
+        ++m_pos;
+        return true;
+    }
+    fail(QString("Expected '%1'").arg(c));
+    return false;
+}
+
+const char *JsonStreamReader::skipString(const char *p) const
+{
+    // p is just past the opening quote
+    while (p < m_end) {
+        const char *q = static_cast<const char*>(std::memchr(p, '"', m_end - p));
+        if (!q) {
+            return nullptr;
+        }
+        // An escaped quote has an odd number of backslashes before it
+        int backslashes = 0;
+        for (const char *b = q - 1; b >= p && *b == '\\'; --b) {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            return q + 1;
+        }
+        p = q + 1;
+    }
+    return nullptr;
+}
+
+bool JsonStreamReader::beginObject()
+{
+    m_first = true;
+    return expect('{');
+}
+
+bool JsonStreamReader::beginArray()
+{
+    m_first = true;
+    return expect('[');
+}
+
+bool JsonStreamReader::nextKey(QString *key)
+{
+    skipSpace();
+    if (m_pos < m_end && *m_pos == '}') {
+        ++m_pos;
+        m_first = false;
+        return false;
+    }
+    if (!m_first && !expect(',')) {
+        return false;
+    }
+    m_first = false;
+    skipSpace();
+    const QString name = readString();
+    if (hasError() || !expect(':')) {
+        return false;
+    }
+    if (key) {
+        *key = name;
+    }
+    return true;
+}
+
+bool JsonStreamReader::nextElement()
+{
+    skipSpace();
+    if (m_pos >= m_end) {
+        fail("Unexpected end of data");
+        return false;
+    }
+    if (*m_pos == ']') {
+        ++m_pos;
+        m_first = false;
+        return false;
+    }
+    if (!m_first && !expect(',')) {
+        return false;
+    }
+    m_first = false;
+    return true;
+}
+
+void JsonStreamReader::skipValue()
+{
+    skipSpace();
+    if (m_pos >= m_end) {
+        fail("Unexpected end of data");
+        return;
+    }
+
+    if (*m_pos == '"') {
+        const char *after = skipString(m_pos + 1);
+        if (!after) {
+            fail("Unterminated string");
+            return;
+        }
+        m_pos = after;
+    } else if (*m_pos == '{' || *m_pos == '[') {
+        // Only brackets outside strings count
+        int depth = 0;
+        const char *p = m_pos;
+        while (p < m_end) {
+            const char c = *p;
+            if (c == '"') {
+                p = skipString(p + 1);
+                if (!p) {
+                    fail("Unterminated string");
+                    return;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    m_pos = p + 1;
+                    m_first = false;
+                    return;
+                }
+            }
+            ++p;
+        }
+        fail("Unterminated container");
+        return;
+    } else {
+        // Number, true, false or null
+        while (m_pos < m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']'
+               && *m_pos != ' ' && *m_pos != '\n' && *m_pos != '\r' && *m_pos != '\t') {
+            ++m_pos;
+        }
+    }
+    m_first = false;
+}
+
+QJsonObject JsonStreamReader::readObject()
+{
+    skipSpace();
+    if (m_pos >= m_end || *m_pos != '{') {
+        skipValue();
+        return QJsonObject();
+    }
+    const char *start = m_pos;
+    skipValue();
+    if (hasError()) {
+        return QJsonObject();
+    }
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(
+        QByteArray::fromRawData(start, static_cast<qsizetype>(m_pos - start)), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        m_pos = start + parseError.offset;
+        fail(parseError.errorString());
+        return QJsonObject();
+    }
+    return doc.object();
+}
+
+QString JsonStreamReader::readString()
+{
+    skipSpace();
+    if (m_pos >= m_end || *m_pos != '"') {
+        fail("Expected a string");
+        return QString();
+    }
+    const char *start = m_pos + 1;
+    const char *after = skipString(start);
+    if (!after) {
+        fail("Unterminated string");
+        return QString();
+    }
+    m_pos = after;
+    m_first = false;
+
+    const char *close = after - 1;
+    if (!std::memchr(start, '\\', close - start)) {
+        return QString::fromUtf8(start, static_cast<qsizetype>(close - start));
+    }
+
+    // Escapes are rare in keys and names; let Qt decode them
+    const QByteArray wrapped = "[" + QByteArray(start - 1, static_cast<qsizetype>(after - start + 1)) + "]";
+    return QJsonDocument::fromJson(wrapped).array().at(0).toString();
+}
+
+double JsonStreamReader::readNumber()
+{
+    skipSpace();
+    char buffer[64];
+    int length = 0;
+    while (m_pos < m_end && length < static_cast<int>(sizeof(buffer)) - 1
+           && *m_pos != '\0' && std::strchr("0123456789+-.eE", *m_pos) != nullptr) {
+        buffer[length++] = *m_pos++;
+    }
+    if (length == 0) {
+        skipValue();
+        return 0;
+    }
+    buffer[length] = '\0';
+    m_first = false;
+    return std::strtod(buffer, nullptr);
+}
@@ -0,0 +1,59 @@
+#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+// Forward-only cursor over a JSON document, for files too large to load
+// with QJsonDocument. Containers are walked one member at a time; only the
+// members the caller asks for are materialized, the rest are skipped by
+// scanning bytes, so memory use is bounded by the largest single element.
+//
+//     reader.beginObject();
+//     while (reader.nextKey(&key)) {
+//         if (key == "items" && reader.beginArray()) {
+//             while (reader.nextElement()) {
+//                 QJsonObject item = reader.readObject();
+//             }
+//         } else {
+//             reader.skipValue();
+//         }
+//     }
+class JsonStreamReader
+{
+public:
+    // The data must outlive the reader
+    explicit JsonStreamReader(const QByteArray &data);
+
+    bool beginObject();
+    // Next member key, or false after consuming the closing '}'
+    bool nextKey(QString *key);
+
+    bool beginArray();
+    // True if another element follows, false after consuming the closing ']'
+    bool nextElement();
+
+    // The value at the cursor
+    QJsonObject readObject();
+    QString readString();
+    double readNumber();
+    void skipValue();
+
+    bool hasError() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+
+private:
+    void skipSpace();
+    bool expect(char c);
+    const char *skipString(const char *p) const;
+    void fail(const QString &message);
+
+    const char *m_begin;
+    const char *m_pos;
+    const char *m_end;
+    bool m_first = true;    // no separator expected before the next member
+    QString m_error;
+};
+
+#endif // JSONSTREAMREADER_H
@@ -0,0 +1,198 @@
+#include "MagicWand.h"
+#include "Geometry.h"
+#include "RegionDetector.h"
+#include "TraceRecorder.h"
+#include <cstdlib>
+
+// Byte-per-pixel mask whose tiles are allocated on first write. A pixel is
+// empty, filled, or queued on the frontier for a larger tolerance.
+class MagicWand::TiledMask
+{
+public:
+    enum State : quint8 { Empty = 0, Filled = 1, Queued = 2 };
+
+    TiledMask(int width, int height)
+        : m_tilesX((width + TileSize - 1) / TileSize)
+        , m_tiles(static_cast<size_t>(m_tilesX) * ((height + TileSize - 1) / TileSize))
+    {
+    }
+
+    quint8 state(int x, int y) const
+    {
+        const std::unique_ptr<quint8[]> &tile = m_tiles[tileIndex(x, y)];
+        return tile ? tile[offset(x, y)] : Empty;
+    }
+
+    bool test(int x, int y) const
+    {
+        return state(x, y) == Filled;
+    }
+
+    void set(int x, int y, State state = Filled)
+    {
+        std::unique_ptr<quint8[]> &tile = m_tiles[tileIndex(x, y)];
+        if (!tile) {
+            tile.reset(new quint8[TileSize * TileSize]());
+        }
+        tile[offset(x, y)] = state;
+    }
+
+private:
+    size_t tileIndex(int x, int y) const
+    {
+        return static_cast<size_t>(y / TileSize) * m_tilesX + x / TileSize;
+    }
+
+    static int offset(int x, int y)
+    {
+        return (y % TileSize) * TileSize + x % TileSize;
+    }
+
+    int m_tilesX;
+    std::vector<std::unique_ptr<quint8[]>> m_tiles;
+};
+
+MagicWand::MagicWand() = default;
+
+MagicWand::~MagicWand() = default;
+
+void MagicWand::reset(const QImage &image, const QPoint &seed)
+{
+    clear();
+    if (!image.rect().contains(seed)) {
+        return;
+    }
+
+    m_image = image;
+    m_seed = seed;
+    const QImage::Format format = image.format();
+    m_direct = format == QImage::Format_RGB32 || format == QImage::Format_ARGB32
+               || format == QImage::Format_ARGB32_Premultiplied;
+    m_seedColor = m_direct ? reinterpret_cast<const QRgb*>(image.constScanLine(seed.y()))[seed.x()]
+                           : image.pixel(seed);
+}
+
+void MagicWand::clear()
+{
+    m_image = QImage();
+    m_mask.reset();
+    m_frontier.clear();
+    m_tolerance = -1;
+    m_filled = 0;
+}
+
+QPolygonF MagicWand::select(int tolerance, qreal simplifyTolerance)
+{
+    TRACE_SCOPE("MagicWand::select");
+
+    if (m_image.isNull()) {
+        return QPolygonF();
+    }
+
+    tolerance = qBound(0, tolerance, 255);
+    std::vector<QPoint> stack;
+    if (tolerance < m_tolerance || !m_mask) {
+        // A smaller region cannot be carved out of the fill; start over
+        m_mask.reset(new TiledMask(m_image.width(), m_image.height()));
+        m_frontier.assign(256, std::vector<QPoint>());
+        m_filled = 0;
+        stack.push_back(m_seed);
+    } else {
+        // Only the pixels that stopped the last fill can start a larger one
+        for (int d = m_tolerance + 1; d <= tolerance; ++d) {
+            for (const QPoint &p : m_frontier[d]) {
+                if (!m_mask->test(p.x(), p.y())) {
+                    stack.push_back(p);
+                }
+            }
+            std::vector<QPoint>().swap(m_frontier[d]);
+        }
+    }
+    m_tolerance = tolerance;
+    fill(std::move(stack));
+
+    if (m_filled == 0) {
+        return QPolygonF();
+    }
+
+    const TiledMask &mask = *m_mask;
+    QPolygonF outline = RegionDetector::traceContour(m_image.width(), m_image.height(), m_first,
+                                                     [&mask](int x, int y) { return mask.test(x, y); });
+    return Geometry::simplifyPolygon(outline, simplifyTolerance);
+}
+
+int MagicWand::difference(int x, int y) const
+{
+    const QRgb c = m_direct ? reinterpret_cast<const QRgb*>(m_image.constScanLine(y))[x] : m_image.pixel(x, y);
+    return qMax(qMax(std::abs(qRed(c) - qRed(m_seedColor)), std::abs(qGreen(c) - qGreen(m_seedColor))),
+                qMax(std::abs(qBlue(c) - qBlue(m_seedColor)), std::abs(qAlpha(c) - qAlpha(m_seedColor))));
+}
+
+void MagicWand::fill(std::vector<QPoint> stack)
+{
+    const int width = m_image.width();
+    const int height = m_image.height();
+    TiledMask &mask = *m_mask;
+
+    // True if the pixel joins the fill; pixels that are too different are
+    // remembered, once each, for a later, larger tolerance
+    auto accepts = [&](int x, int y) {
+        const quint8 state = mask.state(x, y);
+        if (state == TiledMask::Filled) {
+            return false;
+        }
+        const int d = difference(x, y);
+        if (d <= m_tolerance) {
+            return true;
+        }
+        if (state != TiledMask::Queued) {
+            mask.set(x, y, TiledMask::Queued);
+            m_frontier[d].push_back(QPoint(x, y));
+        }
+        return false;
+    };
+
+    // Scanline fill: each popped seed fills a whole horizontal span and pushes
+    // one seed per matching run on the rows above and below. Seeds are known
+    // to match, but may have been filled since they were pushed.
+    while (!stack.empty() && m_filled < MaxPixels) {
+        QPoint p = stack.back();
+        stack.pop_back();
+
+        const int y = p.y();
+        if (mask.test(p.x(), y)) {
+            continue;
+        }
+
+        int left = p.x();
+        while (left > 0 && accepts(left - 1, y)) {
+            --left;
+        }
+        int right = p.x();
+        while (right + 1 < width && accepts(right + 1, y)) {
+            ++right;
+        }
+
+        for (int x = left; x <= right; ++x) {
+            mask.set(x, y);
+        }
+        if (m_filled == 0 || y < m_first.y() || (y == m_first.y() && left < m_first.x())) {
+            m_first = QPoint(left, y);
+        }
+        m_filled += right - left + 1;
+
+        for (int ny = y - 1; ny <= y + 1; ny += 2) {
+            if (ny < 0 || ny >= height) {
+                continue;
+            }
+            bool inRun = false;
+            for (int x = left; x <= right; ++x) {
+                bool candidate = accepts(x, ny);
+                if (candidate && !inRun) {
+                    stack.push_back(QPoint(x, ny));
+                }
+                inRun = candidate;
+            }
+        }
+    }
+}
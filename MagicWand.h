@@ -0,0 +1,55 @@
+#ifndef MAGICWAND_H
+#define MAGICWAND_H
+
+#include <QImage>
+#include <QPoint>
+#include <QPolygonF>
+#include <memory>
+#include <vector>
+
+// Selects the similar-colour region around a seed pixel with a scanline flood
+// fill and returns its outline as a polygon in image coordinates. The visited
+// mask is allocated tile by tile and the outline is traced straight from the
+// tiles, so only the part of a very large image that the region actually
+// covers is touched.
+//
+// The fill is kept between calls to select(). Pixels that stopped it are kept
+// too, bucketed by their colour difference, so raising the tolerance grows
+// the previous fill from its edge instead of starting over.
+class MagicWand
+{
+public:
+    static constexpr int TileSize = 256;
+    static constexpr qint64 MaxPixels = 64LL * 1024 * 1024;
+
+    MagicWand();
+    ~MagicWand();
+
+    // Starts a new selection; nothing is filled until select()
+    void reset(const QImage &image, const QPoint &seed);
+
+    // Frees the fill
+    void clear();
+
+    // tolerance is the largest per-channel difference from the seed colour
+    // (0..255). Returns an empty polygon if the seed is outside the image.
+    QPolygonF select(int tolerance, qreal simplifyTolerance = 1.0);
+
+private:
+    class TiledMask;
+
+    void fill(std::vector<QPoint> stack);
+    int difference(int x, int y) const;
+
+    QImage m_image;
+    QPoint m_seed;
+    QRgb m_seedColor = 0;
+    bool m_direct = false;       // 32-bit pixels that can be read in place
+    int m_tolerance = -1;        // of the current fill, -1 before the first
+    std::unique_ptr<TiledMask> m_mask;
+    std::vector<std::vector<QPoint>> m_frontier; // rejected pixels by difference
+    qint64 m_filled = 0;
+    QPoint m_first;              // first filled pixel in raster order
+};
+
+#endif // MAGICWAND_H
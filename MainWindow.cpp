@@ -1,4 +1,19 @@
 #include "MainWindow.h"
+#include "AnnotationFormat.h"
+#include "BatchExporter.h"
+#include "CoverageAnalyzer.h"
+#include "CropExporter.h"
+#include "GzipWriter.h"
+#include "HtmlMapImporter.h"
+#include "ImageWorkspace.h"
+#include "InputSession.h"
+#include "MinimapWidget.h"
+#include "ProjectFile.h"
+#include "RegionDetector.h"
+#include "ResponsiveExporter.h"
+#include "ScriptMapExporter.h"
+#include "ThumbnailStrip.h"
+#include "TraceRecorder.h"
 #include <QMenuBar>
 #include <QStatusBar>
 #include <QFileDialog>
@@ -12,10 +27,58 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QStyle>
 #include <QScrollArea>
 #include <QSplitter>
 #include <QIcon>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QComboBox>
+#include <QProgressDialog>
+#include <QThreadPool>
+#include <QTimer>
+#include <QCloseEvent>
+#include <functional>
+#include <memory>
+
+// Shows progress for a task running on the pool without blocking the event
+// loop. onFinished runs on the GUI thread once the task has returned; after
+// Cancel the dialog goes away at once and the work in flight winds down in
+// the background. Task needs an atomic finished flag and progress.cancelled.
+template <typename Task>
+static void watchTask(QWidget *parent, const QString &label, int maximum, const std::shared_ptr<Task> &task,
+                      const std::function<int()> &value, const std::function<void()> &onFinished)
+{
+    auto *progressDialog = new QProgressDialog(label, "Cancel", 0, maximum, parent);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(300);
+    progressDialog->setAutoReset(false);
+    QObject::connect(progressDialog, &QProgressDialog::canceled, progressDialog, [task]() {
+        task->progress.cancelled.store(true, std::memory_order_relaxed);
+    });
+
+    auto *pollTimer = new QTimer(progressDialog);
+    QObject::connect(pollTimer, &QTimer::timeout, progressDialog,
+                     [progressDialog, pollTimer, task, value, onFinished]() {
+        if (!task->finished.load(std::memory_order_acquire)) {
+            if (value && !progressDialog->wasCanceled()) {
+                progressDialog->setValue(value());
+            }
+            return;
+        }
+        pollTimer->stop();
+        progressDialog->hide();
+        progressDialog->deleteLater();
+        onFinished();
+    });
+    pollTimer->start(50);
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -171,6 +234,9 @@ MainWindow::MainWindow(QWidget *parent)
     m_editor = new ImageMapEditor(this);
     setCentralWidget(m_editor);
 
+    m_sessionRecorder = new InputSessionRecorder(m_editor, this);
+    m_workspace = new ImageWorkspace(this);
+
     setupMenuBar();
     setupToolBar();
     setupDockWidgets();
@@ -178,10 +244,34 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Connect signals
     connect(m_editor, &ImageMapEditor::hotspotAdded, this, &MainWindow::onHotspotAdded);
+    connect(m_editor, &ImageMapEditor::hotspotsAdded, this, &MainWindow::onHotspotsAdded);
     connect(m_editor, &ImageMapEditor::hotspotRemoved, this, &MainWindow::onHotspotRemoved);
     connect(m_editor, &ImageMapEditor::hotspotSelected, this, &MainWindow::onHotspotSelected);
+    connect(m_editor, &ImageMapEditor::hotspotChanged, this, &MainWindow::onHotspotChanged);
+    connect(m_editor, &ImageMapEditor::hotspotsTransformed, this, [this]() {
+        if (HotspotItem *hotspot = m_editor->selectedHotspot()) {
+            m_coordsLabel->setText(QString("Coords: %1").arg(hotspot->generateCoords()));
+        }
+        updateCodePreview();
+    });
+    connect(m_editor->overlapAnalyzer(), &OverlapAnalyzer::conflictsChanged, this, &MainWindow::onConflictsChanged);
     connect(m_editor, &ImageMapEditor::coordinatesChanged, this, &MainWindow::onCoordinatesChanged);
     connect(m_editor, &ImageMapEditor::coordinatesCopied, this, &MainWindow::onCoordinatesCopied);
+    connect(m_editor, &ImageMapEditor::browserHoverChanged, this, [this](HotspotItem *hotspot, const QString &url) {
+        // Like a browser's status bar
+        if (hotspot) {
+            statusBar()->showMessage(url.isEmpty() ? QString("(no link)") : url);
+        } else {
+            statusBar()->clearMessage();
+        }
+    });
+    connect(m_editor, &ImageMapEditor::browserLinkClicked, this, [this](const QString &url) {
+        statusBar()->showMessage(url.isEmpty() ? QString("Clicked an area with no link")
+                                               : QString("Would open: %1").arg(url), 3000);
+    });
+    connect(m_editor, &ImageMapEditor::magicWandToleranceChanged, this, [this](int tolerance) {
+        statusBar()->showMessage(QString("Magic wand tolerance: %1").arg(tolerance), 1500);
+    });
 
     // Set initial tool
     setCurrentTool(EditorTool::Select);
@@ -191,6 +281,12 @@ MainWindow::~MainWindow()
 {
 }
 
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    saveWorkspaceProject();
+    QMainWindow::closeEvent(event);
+}
+
 void MainWindow::setupMenuBar()
 {
     QMenuBar *menuBar = this->menuBar();
@@ -202,12 +298,28 @@ void MainWindow::setupMenuBar()
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, this, &MainWindow::openImage);
 
+    QAction *replaceImageAction = fileMenu->addAction("Re&place Image and Re-align...");
+    replaceImageAction->setToolTip("Open a revised version of the image and move the hotspots to where its content went");
+    connect(replaceImageAction, &QAction::triggered, this, &MainWindow::replaceImage);
+
+    QAction *openFolderAction = fileMenu->addAction("Open &Folder...");
+    openFolderAction->setToolTip("Work through a folder of images, each with its own project");
+    connect(openFolderAction, &QAction::triggered, this, &MainWindow::openFolder);
+
     fileMenu->addSeparator();
 
     QAction *loadProjectAction = fileMenu->addAction("&Load Project...");
     loadProjectAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_O));
     connect(loadProjectAction, &QAction::triggered, this, &MainWindow::loadProject);
 
+    QAction *importHtmlAction = fileMenu->addAction("&Import HTML Map...");
+    importHtmlAction->setToolTip("Load the <map> of an existing HTML page for editing");
+    connect(importHtmlAction, &QAction::triggered, this, &MainWindow::importHtmlMap);
+
+    QAction *importAnnotationsAction = fileMenu->addAction("Import &Annotations...");
+    importAnnotationsAction->setToolTip("Load hotspots from a COCO JSON dataset or a GeoJSON file");
+    connect(importAnnotationsAction, &QAction::triggered, this, &MainWindow::importAnnotations);
+
     QAction *saveProjectAction = fileMenu->addAction("&Save Project...");
     saveProjectAction->setShortcut(QKeySequence::Save);
     connect(saveProjectAction, &QAction::triggered, this, &MainWindow::saveProject);
@@ -218,6 +330,24 @@ void MainWindow::setupMenuBar()
     exportAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_E));
     connect(exportAction, &QAction::triggered, this, &MainWindow::exportHtml);
 
+    QAction *exportScriptAction = fileMenu->addAction("Export as &Script Map...");
+    exportScriptAction->setToolTip("Packed geometry with a script instead of <area> tags; for very large maps");
+    connect(exportScriptAction, &QAction::triggered, this, &MainWindow::exportScriptMap);
+
+    QAction *exportAnnotationsAction = fileMenu->addAction("Export A&nnotations...");
+    exportAnnotationsAction->setToolTip("Save the hotspots as COCO JSON or GeoJSON");
+    connect(exportAnnotationsAction, &QAction::triggered, this, &MainWindow::exportAnnotations);
+
+    QAction *exportCropsAction = fileMenu->addAction("Export Hotspot &Crops...");
+    connect(exportCropsAction, &QAction::triggered, this, &MainWindow::exportCrops);
+
+    QAction *exportResponsiveAction = fileMenu->addAction("Export &Responsive Images...");
+    connect(exportResponsiveAction, &QAction::triggered, this, &MainWindow::exportResponsive);
+
+    QAction *exportBatchAction = fileMenu->addAction("Export &Batch from Template...");
+    exportBatchAction->setToolTip("Use these hotspots for many images of the same size, with links from a CSV file");
+    connect(exportBatchAction, &QAction::triggered, this, &MainWindow::exportBatch);
+
     fileMenu->addSeparator();
 
     QAction *exitAction = fileMenu->addAction("E&xit");
@@ -234,6 +364,33 @@ void MainWindow::setupMenuBar()
     QAction *clearAction = editMenu->addAction("&Clear All Hotspots");
     connect(clearAction, &QAction::triggered, this, &MainWindow::onClearAllHotspots);
 
+    editMenu->addSeparator();
+
+    QAction *autoDetectAction = editMenu->addAction("&Auto-Detect Regions...");
+    connect(autoDetectAction, &QAction::triggered, this, &MainWindow::onAutoDetectRegions);
+
+    editMenu->addSeparator();
+
+    QAction *unionAction = editMenu->addAction("&Union Selected");
+    connect(unionAction, &QAction::triggered, this, [this]() {
+        onCombineHotspots(PolygonBoolean::Operation::Union);
+    });
+
+    QAction *subtractAction = editMenu->addAction("&Subtract from Primary");
+    connect(subtractAction, &QAction::triggered, this, [this]() {
+        onCombineHotspots(PolygonBoolean::Operation::Difference);
+    });
+
+    QAction *intersectAction = editMenu->addAction("&Intersect Selected");
+    connect(intersectAction, &QAction::triggered, this, [this]() {
+        onCombineHotspots(PolygonBoolean::Operation::Intersection);
+    });
+
+    editMenu->addSeparator();
+
+    QAction *gridAction = editMenu->addAction("Duplicate as &Grid...");
+    connect(gridAction, &QAction::triggered, this, &MainWindow::onDuplicateAsGrid);
+
     // View menu
     QMenu *viewMenu = menuBar->addMenu("&View");
 
@@ -253,9 +410,62 @@ void MainWindow::setupMenuBar()
     zoomResetAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_1));
     connect(zoomResetAction, &QAction::triggered, m_editor, &ImageMapEditor::zoomReset);
 
+    viewMenu->addSeparator();
+
+    QAction *nextImageAction = viewMenu->addAction("&Next Image");
+    nextImageAction->setShortcut(QKeySequence(Qt::Key_PageDown));
+    connect(nextImageAction, &QAction::triggered, this, &MainWindow::showNextImage);
+
+    QAction *previousImageAction = viewMenu->addAction("&Previous Image");
+    previousImageAction->setShortcut(QKeySequence(Qt::Key_PageUp));
+    connect(previousImageAction, &QAction::triggered, this, &MainWindow::showPreviousImage);
+
+    viewMenu->addSeparator();
+
+    m_browserTestAction = viewMenu->addAction("Browser &Test Mode");
+    m_browserTestAction->setCheckable(true);
+    m_browserTestAction->setShortcut(QKeySequence(Qt::Key_F5));
+    m_browserTestAction->setToolTip("Hover and click the map as a browser would resolve it");
+    connect(m_browserTestAction, &QAction::toggled, this, [this](bool checked) {
+        m_editor->setBrowserTestMode(checked);
+        statusBar()->showMessage(checked ? "Browser test mode: hover an area to see where it links" : QString(), 3000);
+    });
+
+    QAction *adaptiveAction = viewMenu->addAction("&Fast Preview While Navigating");
+    adaptiveAction->setCheckable(true);
+    adaptiveAction->setChecked(m_editor->isAdaptiveQuality());
+    adaptiveAction->setToolTip("Skip smoothing while panning and zooming, then redraw at full quality");
+    connect(adaptiveAction, &QAction::toggled, m_editor, &ImageMapEditor::setAdaptiveQuality);
+
+    QAction *batchedAction = viewMenu->addAction("&Batched Rendering");
+    batchedAction->setCheckable(true);
+    batchedAction->setToolTip("Draw unselected hotspots as one layer; faster with many thousands of hotspots");
+    connect(batchedAction, &QAction::toggled, m_editor, &ImageMapEditor::setBatchedRendering);
+
     // Help menu
     QMenu *helpMenu = menuBar->addMenu("&Help");
 
+    QAction *recordTraceAction = helpMenu->addAction("&Record Performance Trace");
+    recordTraceAction->setCheckable(true);
+    recordTraceAction->setChecked(TraceRecorder::isEnabled());
+    connect(recordTraceAction, &QAction::toggled, this, [](bool checked) {
+        // A saved trace covers the latest recording only
+        if (checked) {
+            TraceRecorder::instance().clear();
+        }
+        TraceRecorder::instance().setEnabled(checked);
+    });
+
+    QAction *saveTraceAction = helpMenu->addAction("&Save Performance Trace...");
+    connect(saveTraceAction, &QAction::triggered, this, &MainWindow::saveTrace);
+
+    QAction *recordSessionAction = helpMenu->addAction("Record &Input Session");
+    recordSessionAction->setCheckable(true);
+    recordSessionAction->setToolTip("Record input events for replay with --replay");
+    connect(recordSessionAction, &QAction::toggled, this, &MainWindow::onRecordSessionToggled);
+
+    helpMenu->addSeparator();
+
     QAction *aboutAction = helpMenu->addAction("&About");
     connect(aboutAction, &QAction::triggered, this, [this]() {
         QMessageBox::about(this, "About Image Map Generator",
@@ -316,6 +526,18 @@ void MainWindow::setupToolBar()
     m_toolGroup->addAction(m_polygonAction);
     connect(m_polygonAction, &QAction::triggered, this, &MainWindow::onToolPolygon);
 
+    m_magicWandAction = toolBar->addAction(QIcon(":/icons/icons/magic-wand.svg"), "Wand");
+    m_magicWandAction->setCheckable(true);
+    m_magicWandAction->setToolTip("Magic wand: click a region to outline it (drag left/right to adjust tolerance)");
+    m_toolGroup->addAction(m_magicWandAction);
+    connect(m_magicWandAction, &QAction::triggered, this, &MainWindow::onToolMagicWand);
+
+    m_lassoAction = toolBar->addAction(QIcon(":/icons/icons/lasso.svg"), "Lasso");
+    m_lassoAction->setCheckable(true);
+    m_lassoAction->setToolTip("Draw freehand polygon hotspot (release to finish)");
+    m_toolGroup->addAction(m_lassoAction);
+    connect(m_lassoAction, &QAction::triggered, this, &MainWindow::onToolLasso);
+
     toolBar->addSeparator();
 
     // Clipboard mode toggle
@@ -330,6 +552,12 @@ void MainWindow::setupToolBar()
     m_screenStandardAction->setToolTip("Screen Standard Mode: Scale coordinates to 1920×1080");
     connect(m_screenStandardAction, &QAction::toggled, this, &MainWindow::onScreenStandardModeToggled);
 
+    // Edge snapping toggle
+    m_edgeSnapAction = toolBar->addAction(QIcon(":/icons/icons/snap.svg"), "Snap");
+    m_edgeSnapAction->setCheckable(true);
+    m_edgeSnapAction->setToolTip("Snap to Edges: Snap the cursor and new vertices to strong image edges");
+    connect(m_edgeSnapAction, &QAction::toggled, this, &MainWindow::onEdgeSnapToggled);
+
     toolBar->addSeparator();
 
     // Zoom buttons
@@ -418,6 +646,7 @@ void MainWindow::setupDockWidgets()
     hotspotsLayout->setSpacing(8);
 
     m_hotspotsList = new QListWidget();
+    m_hotspotsList->setSelectionMode(QAbstractItemView::ExtendedSelection);
     connect(m_hotspotsList, &QListWidget::itemSelectionChanged,
             this, &MainWindow::onHotspotListSelectionChanged);
     hotspotsLayout->addWidget(m_hotspotsList);
@@ -448,6 +677,43 @@ void MainWindow::setupDockWidgets()
     mapNameLayout->addWidget(m_mapNameEdit);
     codeLayout->addLayout(mapNameLayout);
 
+    QHBoxLayout *simplifyLayout = new QHBoxLayout();
+    m_simplifyCheck = new QCheckBox("Simplify polygons");
+    m_simplifyCheck->setToolTip("Drop polygon vertices that move the outline by less than the max deviation");
+    connect(m_simplifyCheck, &QCheckBox::toggled, this, &MainWindow::onExportSimplificationChanged);
+    simplifyLayout->addWidget(m_simplifyCheck);
+
+    m_simplifyToleranceSpin = new QDoubleSpinBox();
+    m_simplifyToleranceSpin->setRange(0.0, 20.0);
+    m_simplifyToleranceSpin->setSingleStep(0.5);
+    m_simplifyToleranceSpin->setValue(1.0);
+    m_simplifyToleranceSpin->setSuffix(" px");
+    m_simplifyToleranceSpin->setPrefix("Max deviation: ");
+    m_simplifyToleranceSpin->setEnabled(false);
+    connect(m_simplifyToleranceSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+            this, &MainWindow::onExportSimplificationChanged);
+    simplifyLayout->addWidget(m_simplifyToleranceSpin);
+
+    m_exportStatsLabel = new QLabel();
+    simplifyLayout->addWidget(m_exportStatsLabel);
+    simplifyLayout->addStretch();
+    codeLayout->addLayout(simplifyLayout);
+
+    QHBoxLayout *outputLayout = new QHBoxLayout();
+    m_minifyCheck = new QCheckBox("Minify");
+    m_minifyCheck->setToolTip("Leave out indentation and line breaks, and quotes where HTML allows");
+    connect(m_minifyCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        m_editor->setExportMinified(checked);
+        updateCodePreview();
+    });
+    outputLayout->addWidget(m_minifyCheck);
+
+    m_gzipCheck = new QCheckBox("Also write .gz");
+    m_gzipCheck->setToolTip("Save a gzip-compressed copy next to exported files, for servers that serve precompressed files");
+    outputLayout->addWidget(m_gzipCheck);
+    outputLayout->addStretch();
+    codeLayout->addLayout(outputLayout);
+
     m_codePreview = new QTextEdit();
     m_codePreview->setReadOnly(true);
     m_codePreview->setPlaceholderText("HTML code will appear here after adding hotspots...");
@@ -466,9 +732,72 @@ void MainWindow::setupDockWidgets()
     m_codeDock->setWidget(codeWidget);
     addDockWidget(Qt::BottomDockWidgetArea, m_codeDock);
 
-    // Stack the right docks
+    // Analysis dock
+    m_analysisDock = new QDockWidget("Coverage", this);
+    m_analysisDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+
+    QWidget *analysisWidget = new QWidget();
+    analysisWidget->setObjectName("dockContent");
+    QVBoxLayout *analysisLayout = new QVBoxLayout(analysisWidget);
+    analysisLayout->setContentsMargins(12, 12, 12, 12);
+    analysisLayout->setSpacing(8);
+
+    m_coverageLabel = new QLabel("No image loaded");
+    m_coverageLabel->setWordWrap(true);
+    analysisLayout->addWidget(m_coverageLabel);
+
+    m_coverageTable = new QTableWidget(0, 5);
+    m_coverageTable->setHorizontalHeaderLabels({"#", "Shape", "URL", "Area (px)", "Overlap (px)"});
+    m_coverageTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
+    m_coverageTable->verticalHeader()->hide();
+    m_coverageTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_coverageTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    analysisLayout->addWidget(m_coverageTable);
+
+    QHBoxLayout *analysisBtnLayout = new QHBoxLayout();
+    QPushButton *heatmapBtn = new QPushButton(QIcon(":/icons/icons/save.svg"), "Save Heatmap...");
+    heatmapBtn->setToolTip("Save an image with the areas no hotspot covers marked in red");
+    connect(heatmapBtn, &QPushButton::clicked, this, &MainWindow::saveCoverageHeatmap);
+    analysisBtnLayout->addWidget(heatmapBtn);
+    analysisBtnLayout->addStretch();
+    analysisLayout->addLayout(analysisBtnLayout);
+
+    m_analysisDock->setWidget(analysisWidget);
+    addDockWidget(Qt::BottomDockWidgetArea, m_analysisDock);
+    tabifyDockWidget(m_codeDock, m_analysisDock);
+    m_codeDock->raise();
+
+    m_coverage = new CoverageAnalyzer(this);
+    connect(m_coverage, &CoverageAnalyzer::statsReady, this, &MainWindow::onCoverageReady);
+    // Only analysed while the tab is showing
+    connect(m_analysisDock, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+        if (visible) {
+            requestCoverage();
+        }
+    });
+
+    // Navigator dock
+    m_navigatorDock = new QDockWidget("Navigator", this);
+    m_navigatorDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+    m_minimap = new MinimapWidget(m_editor);
+    m_navigatorDock->setWidget(m_minimap);
+    addDockWidget(Qt::RightDockWidgetArea, m_navigatorDock);
+
+    // Images dock, shown once a folder is opened
+    m_imagesDock = new QDockWidget("Images", this);
+    m_imagesDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable
+                              | QDockWidget::DockWidgetClosable);
+    m_thumbnailStrip = new ThumbnailStrip(m_workspace);
+    connect(m_thumbnailStrip, &ThumbnailStrip::imageActivated, this, &MainWindow::showWorkspaceImage);
+    m_imagesDock->setWidget(m_thumbnailStrip);
+    addDockWidget(Qt::BottomDockWidgetArea, m_imagesDock);
+    splitDockWidget(m_imagesDock, m_codeDock, Qt::Vertical);
+    m_imagesDock->hide();
+
+    // Stack the right docks, with the navigator above them
     tabifyDockWidget(m_propertiesDock, m_hotspotsDock);
     m_propertiesDock->raise();
+    splitDockWidget(m_navigatorDock, m_propertiesDock, Qt::Vertical);
 }
 
 void MainWindow::setupStatusBar()
@@ -494,6 +823,7 @@ void MainWindow::openImage()
         return;
     }
 
+    saveWorkspaceProject();
     if (m_editor->loadImage(filePath)) {
         QPixmap img = m_editor->image();
         m_imageInfoLabel->setText(QString("%1 × %2 px")
@@ -505,6 +835,234 @@ void MainWindow::openImage()
     }
 }
 
+void MainWindow::replaceImage()
+{
+    if (m_editor->sourceImage().isNull()) {
+        QMessageBox::information(this, "Replace Image", "Open the image the hotspots were drawn on first.");
+        return;
+    }
+
+    QString filePath = QFileDialog::getOpenFileName(this,
+                                                    "Replace Image",
+                                                    QFileInfo(m_editor->imagePath()).absolutePath(),
+                                                    "Images (*.png *.jpg *.jpeg *.gif *.bmp *.webp);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    const QImage newImage(filePath);
+    if (newImage.isNull()) {
+        QMessageBox::warning(this, "Error", "Failed to load image.");
+        return;
+    }
+
+    const QList<HotspotItem*> hotspots = m_editor->hotspots();
+    if (hotspots.isEmpty()) {
+        applyReplacedImage(filePath, newImage, hotspots, ImageAligner::Result(), {});
+        return;
+    }
+
+    const QImage oldImage = m_editor->sourceImage();
+    QVector<QRectF> regions;
+    regions.reserve(hotspots.size());
+    for (const HotspotItem *hotspot : hotspots) {
+        regions.append(hotspot->mapRectToScene(hotspot->boundingRect()));
+    }
+
+    // Runs on the pool; watchTask polls for completion
+    struct Task {
+        ImageAligner::Progress progress;
+        ImageAligner::Result result;
+        QVector<ImageAligner::Refinement> refinements;
+        std::atomic<bool> finished{false};
+    };
+    auto task = std::make_shared<Task>();
+    QThreadPool::globalInstance()->start([task, oldImage, newImage, regions]() {
+        task->result = ImageAligner::estimate(oldImage, newImage, &task->progress);
+        // Local corrections only make sense on top of a trusted transform
+        if (task->result.confident) {
+            task->refinements = ImageAligner::refine(oldImage, newImage, task->result.transform, regions,
+                                                     &task->progress);
+        }
+        task->finished.store(true, std::memory_order_release);
+    });
+
+    const qint64 oldImageKey = oldImage.cacheKey();
+    watchTask(this, "Aligning hotspots with the new image...", 0, task, nullptr,
+              [this, task, filePath, newImage, hotspots, oldImageKey]() {
+        if (task->progress.cancelled.load()) {
+            statusBar()->showMessage("Image replacement cancelled", 3000);
+            return;
+        }
+        // The dialog is window modal, but the hotspots must still be the ones measured
+        if (m_editor->sourceImage().cacheKey() != oldImageKey || m_editor->hotspots() != hotspots) {
+            statusBar()->showMessage("The image or its hotspots changed during alignment; nothing was replaced", 5000);
+            return;
+        }
+        applyReplacedImage(filePath, newImage, hotspots, task->result, task->refinements);
+    });
+}
+
+void MainWindow::applyReplacedImage(const QString &filePath, const QImage &image, const QList<HotspotItem*> &hotspots,
+                                    const ImageAligner::Result &result,
+                                    const QVector<ImageAligner::Refinement> &refinements)
+{
+    bool moveHotspots = !hotspots.isEmpty();
+    if (moveHotspots && result.score <= -1) {
+        if (QMessageBox::question(this, "Replace Image",
+                                  "No match was found between the old and the new image.\n\n"
+                                  "Replace it and keep the hotspots where they are?",
+                                  QMessageBox::Yes | QMessageBox::Cancel) != QMessageBox::Yes) {
+            return;
+        }
+        moveHotspots = false;
+    } else if (moveHotspots && !result.confident) {
+        const QMessageBox::StandardButton answer = QMessageBox::question(
+            this, "Replace Image",
+            QString("The new image matches the old one poorly (%1% similar), so the hotspots may not land "
+                    "in the right place.\n\nMove them anyway?").arg(qMax(0, qRound(result.score * 100))),
+            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+        if (answer == QMessageBox::Cancel) {
+            return;
+        }
+        moveHotspots = answer == QMessageBox::Yes;
+    }
+
+    m_editor->loadDecodedImage(filePath, image);
+    m_imageInfoLabel->setText(QString("%1 × %2 px").arg(image.width()).arg(image.height()));
+    setWindowTitle(QString("Image Map Generator - %1").arg(QFileInfo(filePath).fileName()));
+
+    if (!moveHotspots) {
+        updateCodePreview();
+        return;
+    }
+
+    const ImageAligner::Transform &transform = result.transform;
+    QVector<QTransform> transforms;
+    transforms.reserve(hotspots.size());
+    int refined = 0;
+    for (int i = 0; i < hotspots.size(); ++i) {
+        QPointF offset = transform.offset;
+        if (i < refinements.size() && refinements.at(i).accepted) {
+            offset += refinements.at(i).shift;
+            refined += refinements.at(i).shift.isNull() ? 0 : 1;
+        }
+        transforms.append(QTransform(transform.scale, 0, 0, transform.scale, offset.x(), offset.y()));
+    }
+    m_editor->transformHotspots(hotspots, transforms);
+
+    statusBar()->showMessage(QString("Moved %1 hotspots: scale %2, shift %3, %4 (%5% similar); %6 adjusted locally")
+                                 .arg(hotspots.size())
+                                 .arg(transform.scale, 0, 'f', 3)
+                                 .arg(transform.offset.x(), 0, 'f', 1)
+                                 .arg(transform.offset.y(), 0, 'f', 1)
+                                 .arg(qRound(result.score * 100))
+                                 .arg(refined), 8000);
+}
+
+void MainWindow::openFolder()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, "Open Folder", m_workspace->directory());
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    saveWorkspaceProject();
+    if (!m_workspace->open(directory)) {
+        m_thumbnailStrip->reload();
+        QMessageBox::warning(this, "Error", "No supported images found in this folder.");
+        return;
+    }
+
+    m_thumbnailStrip->reload();
+    m_imagesDock->show();
+    showWorkspaceImage(0);
+}
+
+void MainWindow::showNextImage()
+{
+    if (m_workspace->currentIndex() + 1 < m_workspace->count()) {
+        showWorkspaceImage(m_workspace->currentIndex() + 1);
+    }
+}
+
+void MainWindow::showPreviousImage()
+{
+    if (m_workspace->currentIndex() > 0) {
+        showWorkspaceImage(m_workspace->currentIndex() - 1);
+    }
+}
+
+void MainWindow::showWorkspaceImage(int index)
+{
+    if (index < 0 || index >= m_workspace->count()) {
+        return;
+    }
+    if (index == m_workspace->currentIndex() && m_editor->imagePath() == m_workspace->path(index)) {
+        return;
+    }
+
+    TRACE_SCOPE("MainWindow::showWorkspaceImage");
+
+    saveWorkspaceProject();
+
+    const QString imagePath = m_workspace->path(index);
+    QImage image = m_workspace->activate(index);
+    m_thumbnailStrip->setCurrentImage(index);
+    if (image.isNull()) {
+        statusBar()->showMessage(QString("Could not load %1").arg(QFileInfo(imagePath).fileName()), 3000);
+        return;
+    }
+
+    m_editor->clearAllHotspots();
+    m_editor->loadDecodedImage(imagePath, image);
+    m_mapNameEdit->setText("imagemap");
+
+    QFile file(ImageWorkspace::projectPath(imagePath));
+    if (file.exists()) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            QMessageBox::warning(this, "Error", "Failed to open project file.");
+        } else {
+            QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+            file.close();
+            if (doc.isObject()) {
+                QJsonObject project = doc.object();
+                m_mapNameEdit->setText(project["mapName"].toString("imagemap"));
+                m_editor->addHotspots(ProjectFile::hotspotsFromJson(project["hotspots"].toArray()));
+            } else {
+                statusBar()->showMessage("Invalid project file next to this image; starting empty", 3000);
+            }
+        }
+    }
+
+    m_imageInfoLabel->setText(QString("%1 × %2 px  (%3 of %4)")
+                                  .arg(image.width())
+                                  .arg(image.height())
+                                  .arg(index + 1)
+                                  .arg(m_workspace->count()));
+    setWindowTitle(QString("Image Map Generator - %1").arg(QFileInfo(imagePath).fileName()));
+    updateHotspotList();
+    updateCodePreview();
+}
+
+void MainWindow::saveWorkspaceProject()
+{
+    const int index = m_workspace->currentIndex();
+    if (index < 0 || m_editor->imagePath() != m_workspace->path(index)) {
+        return;
+    }
+
+    // Images nobody annotated get no project file, but emptying one that
+    // exists is still saved
+    const QString filePath = ImageWorkspace::projectPath(m_workspace->path(index));
+    if (m_editor->hotspots().isEmpty() && !QFileInfo::exists(filePath)) {
+        return;
+    }
+    if (!writeProjectFile(filePath)) {
+        QMessageBox::warning(this, "Error", QString("Failed to save %1.").arg(filePath));
+    }
+}
+
 void MainWindow::saveProject()
 {
     QString filePath = QFileDialog::getSaveFileName(this,
@@ -515,59 +1073,27 @@ void MainWindow::saveProject()
         return;
     }
 
+    TRACE_SCOPE("MainWindow::saveProject");
+
+    if (!writeProjectFile(filePath)) {
+        QMessageBox::warning(this, "Error", "Failed to save project.");
+    }
+}
+
+bool MainWindow::writeProjectFile(const QString &filePath)
+{
     QJsonObject project;
     project["imagePath"] = m_editor->imagePath();
     project["mapName"] = m_mapNameEdit->text();
-
-    QJsonArray hotspotsArray;
-    for (const HotspotItem *hotspot : m_editor->hotspots()) {
-        QJsonObject h;
-        h["shape"] = static_cast<int>(hotspot->hotspotShape());
-        h["url"] = hotspot->url();
-        h["alt"] = hotspot->altText();
-        h["title"] = hotspot->title();
-        h["posX"] = hotspot->pos().x();
-        h["posY"] = hotspot->pos().y();
-
-        switch (hotspot->hotspotShape()) {
-        case HotspotShape::Rectangle: {
-            QRectF r = hotspot->rect();
-            h["x"] = r.x();
-            h["y"] = r.y();
-            h["width"] = r.width();
-            h["height"] = r.height();
-            break;
-        }
-        case HotspotShape::Circle: {
-            h["centerX"] = hotspot->center().x();
-            h["centerY"] = hotspot->center().y();
-            h["radius"] = hotspot->radius();
-            break;
-        }
-        case HotspotShape::Polygon: {
-            QJsonArray points;
-            for (const QPointF &pt : hotspot->polygon()) {
-                QJsonObject p;
-                p["x"] = pt.x();
-                p["y"] = pt.y();
-                points.append(p);
-            }
-            h["points"] = points;
-            break;
-        }
-        }
-
-        hotspotsArray.append(h);
-    }
-    project["hotspots"] = hotspotsArray;
+    project["hotspots"] = ProjectFile::hotspotsToJson(m_editor->hotspots());
 
     QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(QJsonDocument(project).toJson());
-        file.close();
-    } else {
-        QMessageBox::warning(this, "Error", "Failed to save project.");
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
     }
+    file.write(QJsonDocument(project).toJson());
+    file.close();
+    return true;
 }
 
 void MainWindow::loadProject()
@@ -580,6 +1106,8 @@ void MainWindow::loadProject()
         return;
     }
 
+    TRACE_SCOPE("MainWindow::loadProject");
+
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         QMessageBox::warning(this, "Error", "Failed to open project file.");
@@ -613,109 +1141,756 @@ void MainWindow::loadProject()
     m_editor->clearAllHotspots();
 
     // Load hotspots
-    QJsonArray hotspotsArray = project["hotspots"].toArray();
-    for (const QJsonValue &val : hotspotsArray) {
-        QJsonObject h = val.toObject();
-        HotspotShape shape = static_cast<HotspotShape>(h["shape"].toInt());
-
-        HotspotItem *hotspot = new HotspotItem(shape);
-        hotspot->setUrl(h["url"].toString());
-        hotspot->setAltText(h["alt"].toString());
-        hotspot->setTitle(h["title"].toString());
-        hotspot->setPos(h["posX"].toDouble(), h["posY"].toDouble());
-
-        switch (shape) {
-        case HotspotShape::Rectangle: {
-            QRectF r(h["x"].toDouble(), h["y"].toDouble(),
-                     h["width"].toDouble(), h["height"].toDouble());
-            hotspot->setRect(r);
-            break;
-        }
-        case HotspotShape::Circle: {
-            hotspot->setCenter(QPointF(h["centerX"].toDouble(), h["centerY"].toDouble()));
-            hotspot->setRadius(h["radius"].toDouble());
-            break;
-        }
-        case HotspotShape::Polygon: {
-            QJsonArray points = h["points"].toArray();
-            for (const QJsonValue &pv : points) {
-                QJsonObject p = pv.toObject();
-                hotspot->addPolygonPoint(QPointF(p["x"].toDouble(), p["y"].toDouble()));
+    m_editor->addHotspots(ProjectFile::hotspotsFromJson(project["hotspots"].toArray()));
+
+    updateHotspotList();
+    updateCodePreview();
+}
+
+void MainWindow::importHtmlMap()
+{
+    QString filePath = QFileDialog::getOpenFileName(this,
+                                                    "Import HTML Map",
+                                                    QString(),
+                                                    "HTML Files (*.html *.htm);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    TRACE_SCOPE("MainWindow::importHtmlMap");
+
+    QString error;
+    const HtmlMapImporter::Result result = HtmlMapImporter::parseFile(filePath, &error);
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "Error", QString("Failed to read %1:\n%2").arg(filePath, error));
+        return;
+    }
+
+    QVector<HtmlMapImporter::ImportedMap> maps;
+    QStringList choices;
+    for (const HtmlMapImporter::ImportedMap &map : result.maps) {
+        if (!map.areas.isEmpty()) {
+            maps.append(map);
+            choices.append(QString("%1 (%2 areas)").arg(map.name.isEmpty() ? "unnamed" : map.name).arg(map.areas.size()));
+        }
+    }
+    if (maps.isEmpty()) {
+        QMessageBox::information(this, "Import HTML Map", "No image maps with areas were found in this page.");
+        return;
+    }
+
+    int chosen = 0;
+    if (maps.size() > 1) {
+        bool ok = false;
+        const QString choice = QInputDialog::getItem(this, "Import HTML Map", "The page has several maps. Import:",
+                                                     choices, 0, false, &ok);
+        if (!ok) {
+            return;
+        }
+        chosen = choices.indexOf(choice);
+    }
+    const HtmlMapImporter::ImportedMap &map = maps.at(chosen);
+
+    // The image is looked up relative to the page, as a browser would
+    if (!map.imageSource.isEmpty()) {
+        const QString imagePath = QDir::cleanPath(QFileInfo(filePath).dir().absoluteFilePath(map.imageSource));
+        if (m_editor->loadImage(imagePath)) {
+            QPixmap img = m_editor->image();
+            m_imageInfoLabel->setText(QString("%1 × %2 px").arg(img.width()).arg(img.height()));
+            setWindowTitle(QString("Image Map Generator - %1").arg(QFileInfo(imagePath).fileName()));
+        } else if (m_editor->sourceImage().isNull()) {
+            QMessageBox::warning(this, "Warning", QString("Could not load the image %1. Please open it manually.")
+                                                      .arg(map.imageSource));
+        }
+    }
+
+    m_mapNameEdit->setText(map.name.isEmpty() ? "imagemap" : map.name);
+    m_editor->clearAllHotspots();
+
+    const QPointF scale = HtmlMapImporter::scaleFor(map, m_editor->sourceImage().size());
+    QList<HotspotItem*> hotspots;
+    hotspots.reserve(map.areas.size());
+    for (const MapArea &area : map.areas) {
+        hotspots.append(HotspotItem::fromArea(HtmlMapImporter::scaled(area, scale)));
+    }
+    m_editor->addHotspots(hotspots);
+
+    updateHotspotList();
+    updateCodePreview();
+
+    QString message = QString("Imported %1 areas from %2").arg(hotspots.size()).arg(QFileInfo(filePath).fileName());
+    if (!result.warnings.isEmpty()) {
+        message += " — " + result.warnings.join("; ");
+    }
+    statusBar()->showMessage(message, 8000);
+}
+
+void MainWindow::importAnnotations()
+{
+    QString filePath = QFileDialog::getOpenFileName(this,
+                                                    "Import Annotations",
+                                                    QString(),
+                                                    "Annotations (*.json *.geojson);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    TRACE_SCOPE("MainWindow::importAnnotations");
+
+    QVector<AnnotationFormat::AnnotatedImage> images;
+    QString error;
+    if (!AnnotationFormat::read(filePath, &images, &error)) {
+        QMessageBox::warning(this, "Error", QString("Failed to read %1:\n%2").arg(filePath, error));
+        return;
+    }
+    if (images.isEmpty()) {
+        QMessageBox::information(this, "Import Annotations", "The file contains no images.");
+        return;
+    }
+
+    // A dataset covers many images; prefer the one that is open
+    int chosen = 0;
+    if (images.size() > 1) {
+        const QString current = QFileInfo(m_editor->imagePath()).fileName();
+        chosen = -1;
+        QStringList choices;
+        for (int i = 0; i < images.size(); ++i) {
+            if (!current.isEmpty() && QFileInfo(images.at(i).fileName).fileName() == current) {
+                chosen = i;
             }
-            hotspot->closePolygon();
-            break;
+            choices.append(QString("%1 (%2 annotations)").arg(images.at(i).fileName).arg(images.at(i).areas.size()));
+        }
+        if (chosen < 0) {
+            bool ok = false;
+            const QString choice = QInputDialog::getItem(this, "Import Annotations", "Import the annotations of:",
+                                                         choices, 0, false, &ok);
+            if (!ok) {
+                return;
+            }
+            chosen = choices.indexOf(choice);
         }
+    }
+    const AnnotationFormat::AnnotatedImage &image = images.at(chosen);
+
+    // Open the annotated image if it sits next to the file and nothing matching is open
+    if (!image.fileName.isEmpty() && QFileInfo(m_editor->imagePath()).fileName() != QFileInfo(image.fileName).fileName()) {
+        const QString imagePath = QFileInfo(filePath).dir().absoluteFilePath(image.fileName);
+        if (QFileInfo::exists(imagePath) && m_editor->loadImage(imagePath)) {
+            QPixmap img = m_editor->image();
+            m_imageInfoLabel->setText(QString("%1 × %2 px").arg(img.width()).arg(img.height()));
+            setWindowTitle(QString("Image Map Generator - %1").arg(QFileInfo(imagePath).fileName()));
         }
+    }
 
-        m_editor->addHotspot(hotspot);
+    m_editor->clearAllHotspots();
+    QList<HotspotItem*> hotspots;
+    hotspots.reserve(image.areas.size());
+    for (const MapArea &area : image.areas) {
+        hotspots.append(HotspotItem::fromArea(area));
     }
+    m_editor->addHotspots(hotspots);
 
     updateHotspotList();
     updateCodePreview();
+    statusBar()->showMessage(QString("Imported %1 annotations from %2")
+                                 .arg(hotspots.size()).arg(QFileInfo(filePath).fileName()), 5000);
 }
 
-void MainWindow::exportHtml()
+void MainWindow::exportAnnotations()
 {
-    QString html = m_editor->generateImageMapHtml(m_mapNameEdit->text());
-    if (html.isEmpty()) {
+    if (m_editor->hotspots().isEmpty()) {
         QMessageBox::information(this, "Export", "No hotspots to export. Draw some hotspots first!");
         return;
     }
 
+    QString selectedFilter;
     QString filePath = QFileDialog::getSaveFileName(this,
-                                                    "Export HTML",
+                                                    "Export Annotations",
                                                     QString(),
-                                                    "HTML Files (*.html);;All Files (*)");
+                                                    "COCO JSON (*.json);;GeoJSON (*.geojson)",
+                                                    &selectedFilter);
     if (filePath.isEmpty()) {
         return;
     }
 
+    AnnotationFormat::AnnotatedImage image;
+    image.fileName = QFileInfo(m_editor->imagePath()).fileName();
+    image.size = m_editor->sourceImage().size();
+    image.areas = m_editor->imageAreas();
+
+    const bool geoJson = selectedFilter.startsWith("GeoJSON") || filePath.endsWith(".geojson", Qt::CaseInsensitive);
+    const QByteArray data = geoJson ? AnnotationFormat::writeGeoJson(image) : AnnotationFormat::writeCoco({image});
+
     QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QString fullHtml = QString(
-                               "<!DOCTYPE html>\n"
-                               "<html lang=\"en\">\n"
-                               "<head>\n"
-                               "    <meta charset=\"UTF-8\">\n"
-                               "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
-                               "    <title>Image Map</title>\n"
-                               "</head>\n"
-                               "<body>\n"
-                               "    %1\n"
-                               "</body>\n"
-                               "</html>\n"
-                               ).arg(html);
-
-        file.write(fullHtml.toUtf8());
-        file.close();
-        QMessageBox::information(this, "Export", "HTML file exported successfully!");
+    if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size()) {
+        statusBar()->showMessage(QString("Exported %1 annotations to %2")
+                                     .arg(image.areas.size()).arg(QFileInfo(filePath).fileName()), 5000);
     } else {
-        QMessageBox::warning(this, "Error", "Failed to export HTML file.");
+        QMessageBox::warning(this, "Error", "Failed to export annotations.");
     }
 }
 
-void MainWindow::onToolSelect()
+// Minimal standalone page around exported markup
+static QString htmlDocument(const QString &body, bool minified)
 {
-    setCurrentTool(EditorTool::Select);
+    if (minified) {
+        return QString("<!DOCTYPE html><html lang=en><head><meta charset=UTF-8>"
+                       "<meta name=viewport content=\"width=device-width, initial-scale=1.0\">"
+                       "<title>Image Map</title></head><body>%1</body></html>\n").arg(body);
+    }
+    return QString(
+               "<!DOCTYPE html>\n"
+               "<html lang=\"en\">\n"
+               "<head>\n"
+               "    <meta charset=\"UTF-8\">\n"
+               "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
+               "    <title>Image Map</title>\n"
+               "</head>\n"
+               "<body>\n"
+               "    %1\n"
+               "</body>\n"
+               "</html>\n"
+               ).arg(body);
 }
 
-void MainWindow::onToolRect()
+bool MainWindow::writeExportFile(const QString &filePath, const QByteArray &bytes)
 {
-    setCurrentTool(EditorTool::DrawRect);
-}
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(this, "Error", QString("Failed to write %1:\n%2").arg(filePath, file.errorString()));
+        return false;
+    }
 
-void MainWindow::onToolCircle()
-{
-    setCurrentTool(EditorTool::DrawCircle);
-}
+    std::unique_ptr<GzipWriter> gzip;
+    if (m_gzipCheck->isChecked()) {
+        gzip.reset(new GzipWriter(filePath + ".gz"));
+        if (!gzip->open()) {
+            QMessageBox::warning(this, "Error", QString("Failed to write %1.gz:\n%2").arg(filePath, gzip->errorString()));
+            return false;
+        }
+    }
 
-void MainWindow::onToolPolygon()
-{
+    // Written in blocks so the compressed copy comes out of the same pass
+    for (qint64 offset = 0; offset < bytes.size(); offset += EXPORT_BLOCK_SIZE) {
+        const QByteArray block = QByteArray::fromRawData(bytes.constData() + offset,
+                                                         static_cast<int>(qMin<qint64>(EXPORT_BLOCK_SIZE, bytes.size() - offset)));
+        if (file.write(block) != block.size()) {
+            QMessageBox::warning(this, "Error", QString("Failed to write %1:\n%2").arg(filePath, file.errorString()));
+            return false;
+        }
+        if (gzip && !gzip->write(block)) {
+            QMessageBox::warning(this, "Error", QString("Failed to write %1.gz:\n%2").arg(filePath, gzip->errorString()));
+            return false;
+        }
+    }
+    file.close();
+
+    if (gzip && !gzip->close()) {
+        QMessageBox::warning(this, "Error", QString("Failed to write %1.gz:\n%2").arg(filePath, gzip->errorString()));
+        return false;
+    }
+    return true;
+}
+
+void MainWindow::exportHtml()
+{
+    QString html = m_editor->generateImageMapHtml(m_mapNameEdit->text());
+    if (html.isEmpty()) {
+        QMessageBox::information(this, "Export", "No hotspots to export. Draw some hotspots first!");
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(this,
+                                                    "Export HTML",
+                                                    QString(),
+                                                    "HTML Files (*.html);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    if (writeExportFile(filePath, htmlDocument(html, m_editor->isExportMinified()).toUtf8())) {
+        QMessageBox::information(this, "Export", "HTML file exported successfully!");
+    }
+}
+
+void MainWindow::exportScriptMap()
+{
+    const QVector<MapArea> areas = m_editor->mapAreas();
+    if (m_editor->sourceImage().isNull() || areas.isEmpty()) {
+        QMessageBox::information(this, "Export", "No hotspots to export. Draw some hotspots first!");
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(this,
+                                                    "Export Script Map",
+                                                    QString(),
+                                                    "HTML Files (*.html);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QString imageName = QFileInfo(m_editor->imagePath()).fileName();
+    if (imageName.isEmpty()) {
+        imageName = "image.png";
+    }
+    const qreal tolerance = m_editor->isExportSimplificationEnabled() ? m_editor->exportTolerance() : -1;
+    const QString html = ScriptMapExporter::generateHtml(areas, imageName, m_editor->outputSize(),
+                                                         m_mapNameEdit->text(), tolerance);
+
+    const QByteArray bytes = htmlDocument(html, m_editor->isExportMinified()).toUtf8();
+    if (writeExportFile(filePath, bytes)) {
+        statusBar()->showMessage(QString("Exported %1 areas as a script map (%2 KB)")
+                                     .arg(areas.size()).arg((bytes.size() + 1023) / 1024), 5000);
+    }
+}
+
+void MainWindow::exportCrops()
+{
+    if (m_editor->sourceImage().isNull() || m_editor->hotspots().isEmpty()) {
+        QMessageBox::information(this, "Export Crops", "Open an image and draw some hotspots first!");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Export Hotspot Crops");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    QLineEdit *folderEdit = new QLineEdit(QFileInfo(m_editor->imagePath()).absolutePath() + "/crops");
+    QPushButton *browseBtn = new QPushButton("Browse...");
+    connect(browseBtn, &QPushButton::clicked, &dialog, [&dialog, folderEdit]() {
+        QString folder = QFileDialog::getExistingDirectory(&dialog, "Crops Folder", folderEdit->text());
+        if (!folder.isEmpty()) {
+            folderEdit->setText(folder);
+        }
+    });
+    folderLayout->addWidget(folderEdit);
+    folderLayout->addWidget(browseBtn);
+    form->addRow("Folder:", folderLayout);
+
+    QComboBox *formatCombo = new QComboBox();
+    for (const QByteArray &format : CropExporter::supportedFormats()) {
+        formatCombo->addItem(QString::fromLatin1(format).toUpper(), format);
+    }
+    form->addRow("Format:", formatCombo);
+
+    QLineEdit *sizesEdit = new QLineEdit("256, 0");
+    sizesEdit->setToolTip("Longest edge of each thumbnail in pixels, comma separated; 0 keeps the full crop");
+    form->addRow("Sizes:", sizesEdit);
+
+    QSpinBox *qualitySpin = new QSpinBox();
+    qualitySpin->setRange(1, 100);
+    qualitySpin->setValue(90);
+    qualitySpin->setToolTip("Used by JPEG and WebP");
+    form->addRow("Quality:", qualitySpin);
+
+    QCheckBox *maskCheck = new QCheckBox("Clear pixels outside circles and polygons");
+    maskCheck->setChecked(true);
+    form->addRow(maskCheck);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    CropExporter::Options options;
+    options.directory = folderEdit->text();
+    options.format = formatCombo->currentData().toByteArray();
+    options.quality = qualitySpin->value();
+    options.mask = maskCheck->isChecked();
+    options.sizes.clear();
+    for (const QString &part : sizesEdit->text().split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int size = part.trimmed().toInt(&ok);
+        if (!ok || size < 0) {
+            QMessageBox::warning(this, "Export Crops", QString("\"%1\" is not a size.").arg(part.trimmed()));
+            return;
+        }
+        options.sizes.append(size);
+    }
+    if (options.sizes.isEmpty()) {
+        options.sizes.append(0);
+    }
+
+    const QVector<MapArea> areas = m_editor->imageAreas();
+    const QImage image = m_editor->sourceImage();
+    const QString imagePath = m_editor->imagePath();
+
+    // Runs on the pool; watchTask polls for progress and completion
+    struct Task {
+        CropExporter::Progress progress;
+        QStringList errors;
+        std::atomic<bool> finished{false};
+    };
+    auto task = std::make_shared<Task>();
+    QThreadPool::globalInstance()->start([task, image, imagePath, areas, options]() {
+        task->errors = CropExporter::run(image, imagePath, areas, options, &task->progress);
+        task->finished.store(true, std::memory_order_release);
+    });
+
+    // Cancelling only stops new crops; the ones being written finish first
+    const int count = areas.size();
+    watchTask(this, "Exporting crops...", count, task,
+              [task]() { return task->progress.done.load(std::memory_order_relaxed); },
+              [this, task, count, options]() {
+        if (task->progress.cancelled.load()) {
+            statusBar()->showMessage("Crop export cancelled", 3000);
+        } else if (!task->errors.isEmpty()) {
+            QMessageBox::warning(this, "Export Crops",
+                                 QString("%1 of %2 crops could not be written:\n\n%3")
+                                     .arg(task->errors.size())
+                                     .arg(count)
+                                     .arg(task->errors.mid(0, 10).join("\n")));
+        } else {
+            statusBar()->showMessage(QString("Exported %1 crops to %2").arg(count).arg(options.directory), 5000);
+        }
+    });
+}
+
+void MainWindow::exportResponsive()
+{
+    if (m_editor->sourceImage().isNull() || m_editor->hotspots().isEmpty()) {
+        QMessageBox::information(this, "Export Responsive Images", "Open an image and draw some hotspots first!");
+        return;
+    }
+
+    const QFileInfo imageInfo(m_editor->imagePath());
+    const QSize outputSize = m_editor->outputSize();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Export Responsive Images");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    QLineEdit *folderEdit = new QLineEdit(imageInfo.absolutePath() + "/responsive");
+    QPushButton *browseBtn = new QPushButton("Browse...");
+    connect(browseBtn, &QPushButton::clicked, &dialog, [&dialog, folderEdit]() {
+        QString folder = QFileDialog::getExistingDirectory(&dialog, "Output Folder", folderEdit->text());
+        if (!folder.isEmpty()) {
+            folderEdit->setText(folder);
+        }
+    });
+    folderLayout->addWidget(folderEdit);
+    folderLayout->addWidget(browseBtn);
+    form->addRow("Folder:", folderLayout);
+
+    QLineEdit *nameEdit = new QLineEdit(imageInfo.completeBaseName().isEmpty() ? "image" : imageInfo.completeBaseName());
+    form->addRow("Base name:", nameEdit);
+
+    QLineEdit *widthsEdit = new QLineEdit("480, 768, 1280, 1920");
+    widthsEdit->setToolTip(QString("Breakpoint widths in pixels, comma separated. Widths above %1 are skipped; "
+                                   "%1 is always included.").arg(outputSize.width()));
+    form->addRow("Widths:", widthsEdit);
+
+    QComboBox *formatCombo = new QComboBox();
+    for (const QByteArray &format : CropExporter::supportedFormats()) {
+        formatCombo->addItem(QString::fromLatin1(format).toUpper(), format);
+    }
+    formatCombo->setCurrentIndex(qMax(0, formatCombo->findData(QByteArray("jpg"))));
+    form->addRow("Format:", formatCombo);
+
+    QSpinBox *qualitySpin = new QSpinBox();
+    qualitySpin->setRange(1, 100);
+    qualitySpin->setValue(85);
+    qualitySpin->setToolTip("Used by JPEG and WebP");
+    form->addRow("Quality:", qualitySpin);
+
+    QLineEdit *sizesEdit = new QLineEdit("100vw");
+    sizesEdit->setToolTip("sizes attribute of the <img>, telling the browser how wide the image is shown");
+    form->addRow("Sizes:", sizesEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    ResponsiveExporter::Options options;
+    options.directory = folderEdit->text();
+    options.baseName = nameEdit->text().trimmed().isEmpty() ? "image" : nameEdit->text().trimmed();
+    options.format = formatCombo->currentData().toByteArray();
+    options.quality = qualitySpin->value();
+    options.sizes = sizesEdit->text().trimmed().isEmpty() ? "100vw" : sizesEdit->text().trimmed();
+    options.mapName = m_mapNameEdit->text();
+    options.simplifyTolerance = m_editor->isExportSimplificationEnabled() ? m_editor->exportTolerance() : -1;
+    options.widths.clear();
+    for (const QString &part : widthsEdit->text().split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int width = part.trimmed().toInt(&ok);
+        if (!ok || width <= 0) {
+            QMessageBox::warning(this, "Export Responsive Images", QString("\"%1\" is not a width.").arg(part.trimmed()));
+            return;
+        }
+        options.widths.append(width);
+    }
+
+    const QVector<MapArea> areas = m_editor->mapAreas();
+    const QImage image = m_editor->sourceImage();
+    const int variantCount = ResponsiveExporter::variants(outputSize, options).size();
+
+    // Runs on the pool; watchTask polls for progress and completion
+    struct Task {
+        ResponsiveExporter::Progress progress;
+        QStringList errors;
+        std::atomic<bool> finished{false};
+    };
+    auto task = std::make_shared<Task>();
+    QThreadPool::globalInstance()->start([task, image, outputSize, areas, options]() {
+        task->errors = ResponsiveExporter::run(image, outputSize, areas, options, &task->progress);
+        task->finished.store(true, std::memory_order_release);
+    });
+
+    // Cancelling takes effect between variants
+    watchTask(this, "Resizing images...", variantCount, task,
+              [task]() { return task->progress.done.load(std::memory_order_relaxed); },
+              [this, task, variantCount, options]() {
+        if (task->progress.cancelled.load()) {
+            statusBar()->showMessage("Responsive export cancelled", 3000);
+        } else if (!task->errors.isEmpty()) {
+            QMessageBox::warning(this, "Export Responsive Images", task->errors.mid(0, 10).join("\n"));
+        } else {
+            statusBar()->showMessage(QString("Exported %1 image sizes and %2.html to %3")
+                                         .arg(variantCount).arg(options.baseName, options.directory), 5000);
+        }
+    });
+}
+
+void MainWindow::exportBatch()
+{
+    const QVector<MapArea> areas = m_editor->mapAreas();
+    if (m_editor->sourceImage().isNull() || areas.isEmpty()) {
+        QMessageBox::information(this, "Export Batch", "Open an image and draw some hotspots first!");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Export Batch from Template");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QLabel *hint = new QLabel("The hotspots are applied to every image below, which must all have the same size. "
+                              "Write {column} in URLs, alt texts, titles or the map name to fill it in from "
+                              "that CSV column; {file} is the image's file name.");
+    hint->setWordWrap(true);
+    form->addRow(hint);
+
+    // Defaults to the open folder, if any
+    QListWidget *imageList = new QListWidget();
+    for (int i = 0; i < m_workspace->count(); ++i) {
+        imageList->addItem(m_workspace->path(i));
+    }
+    imageList->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    QHBoxLayout *imageBtnLayout = new QHBoxLayout();
+    QPushButton *addImagesBtn = new QPushButton("Add...");
+    connect(addImagesBtn, &QPushButton::clicked, &dialog, [&dialog, imageList, this]() {
+        const QStringList paths = QFileDialog::getOpenFileNames(&dialog, "Add Images",
+                                                                QFileInfo(m_editor->imagePath()).absolutePath(),
+                                                                "Images (*.png *.jpg *.jpeg *.gif *.bmp *.webp);;All Files (*)");
+        imageList->addItems(paths);
+    });
+    QPushButton *removeImagesBtn = new QPushButton("Remove");
+    connect(removeImagesBtn, &QPushButton::clicked, &dialog, [imageList]() {
+        qDeleteAll(imageList->selectedItems());
+    });
+    imageBtnLayout->addWidget(addImagesBtn);
+    imageBtnLayout->addWidget(removeImagesBtn);
+    imageBtnLayout->addStretch();
+    QVBoxLayout *imagesLayout = new QVBoxLayout();
+    imagesLayout->addWidget(imageList);
+    imagesLayout->addLayout(imageBtnLayout);
+    form->addRow("Images:", imagesLayout);
+
+    QHBoxLayout *csvLayout = new QHBoxLayout();
+    QLineEdit *csvEdit = new QLineEdit();
+    csvEdit->setPlaceholderText("Optional");
+    QPushButton *csvBrowseBtn = new QPushButton("Browse...");
+    connect(csvBrowseBtn, &QPushButton::clicked, &dialog, [&dialog, csvEdit]() {
+        QString path = QFileDialog::getOpenFileName(&dialog, "Values", csvEdit->text(), "CSV Files (*.csv);;All Files (*)");
+        if (!path.isEmpty()) {
+            csvEdit->setText(path);
+        }
+    });
+    csvLayout->addWidget(csvEdit);
+    csvLayout->addWidget(csvBrowseBtn);
+    form->addRow("Values (CSV):", csvLayout);
+
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    QLineEdit *folderEdit = new QLineEdit(QFileInfo(m_editor->imagePath()).absolutePath() + "/maps");
+    QPushButton *browseBtn = new QPushButton("Browse...");
+    connect(browseBtn, &QPushButton::clicked, &dialog, [&dialog, folderEdit]() {
+        QString folder = QFileDialog::getExistingDirectory(&dialog, "Output Folder", folderEdit->text());
+        if (!folder.isEmpty()) {
+            folderEdit->setText(folder);
+        }
+    });
+    folderLayout->addWidget(folderEdit);
+    folderLayout->addWidget(browseBtn);
+    form->addRow("Folder:", folderLayout);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    QStringList imagePaths;
+    for (int i = 0; i < imageList->count(); ++i) {
+        imagePaths << imageList->item(i)->text();
+    }
+    if (imagePaths.isEmpty()) {
+        QMessageBox::information(this, "Export Batch", "Add the images to export maps for.");
+        return;
+    }
+
+    QVector<QStringList> csv;
+    if (!csvEdit->text().isEmpty()) {
+        QString error;
+        if (!BatchExporter::readCsv(csvEdit->text(), &csv, &error)) {
+            QMessageBox::warning(this, "Export Batch", QString("Cannot read %1:\n%2").arg(csvEdit->text(), error));
+            return;
+        }
+    }
+
+    QStringList warnings;
+    const QVector<BatchExporter::Page> pages = BatchExporter::pages(imagePaths, csv, &warnings);
+    if (!warnings.isEmpty()
+        && QMessageBox::question(this, "Export Batch",
+                                 QString("The CSV file does not match the images:\n\n%1%2\n\nExport anyway?")
+                                     .arg(warnings.mid(0, 10).join("\n"))
+                                     .arg(warnings.size() > 10 ? QString("\n...") : QString()))
+               != QMessageBox::Yes) {
+        return;
+    }
+
+    const QSize imageSize = m_editor->sourceImage().size();
+    const QSize outputSize = m_editor->outputSize();
+    const QString mapName = m_mapNameEdit->text();
+    const qreal tolerance = m_editor->isExportSimplificationEnabled() ? m_editor->exportTolerance() : -1;
+    const bool minified = m_editor->isExportMinified();
+
+    BatchExporter::Options options;
+    options.directory = folderEdit->text();
+    options.document = htmlDocument("%1", minified);
+    options.gzip = m_gzipCheck->isChecked();
+
+    // Runs on the pool; watchTask polls for progress and completion
+    struct Task {
+        BatchExporter::Progress progress;
+        QStringList errors;
+        std::atomic<bool> finished{false};
+    };
+    auto task = std::make_shared<Task>();
+    QThreadPool::globalInstance()->start([task, areas, imageSize, outputSize, mapName, tolerance, minified, pages, options]() {
+        const BatchExporter::Template map = BatchExporter::makeTemplate(areas, imageSize, outputSize,
+                                                                        mapName, tolerance, minified);
+        task->errors = BatchExporter::run(map, pages, options, &task->progress);
+        task->finished.store(true, std::memory_order_release);
+    });
+
+    // Cancelling only stops new pages; the ones being written finish first
+    const int count = pages.size();
+    watchTask(this, "Exporting maps...", count, task,
+              [task]() { return task->progress.done.load(std::memory_order_relaxed); },
+              [this, task, count, options]() {
+        if (task->progress.cancelled.load()) {
+            statusBar()->showMessage("Batch export cancelled", 3000);
+        } else if (!task->errors.isEmpty()) {
+            QMessageBox::warning(this, "Export Batch",
+                                 QString("%1 of %2 maps could not be written:\n\n%3")
+                                     .arg(task->errors.size())
+                                     .arg(count)
+                                     .arg(task->errors.mid(0, 10).join("\n")));
+        } else {
+            statusBar()->showMessage(QString("Exported %1 maps to %2").arg(count).arg(options.directory), 5000);
+        }
+    });
+}
+
+void MainWindow::saveTrace()
+{
+    QString filePath = QFileDialog::getSaveFileName(this,
+                                                    "Save Performance Trace",
+                                                    QString(),
+                                                    "Trace Event JSON (*.json);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    if (TraceRecorder::instance().writeJson(filePath)) {
+        statusBar()->showMessage(QString("Trace saved to %1").arg(QFileInfo(filePath).fileName()), 3000);
+    } else {
+        QMessageBox::warning(this, "Error", "Failed to save trace file.");
+    }
+}
+
+void MainWindow::onRecordSessionToggled(bool checked)
+{
+    if (checked) {
+        m_sessionRecorder->start();
+        statusBar()->showMessage("Recording input session...", 2000);
+        return;
+    }
+
+    m_sessionRecorder->stop();
+
+    QString filePath = QFileDialog::getSaveFileName(this,
+                                                    "Save Input Session",
+                                                    QString(),
+                                                    "Input Session (*.imrec);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    if (m_sessionRecorder->save(filePath)) {
+        statusBar()->showMessage(QString("Saved %1 input events").arg(m_sessionRecorder->eventCount()), 3000);
+    } else {
+        QMessageBox::warning(this, "Error", "Failed to save input session.");
+    }
+}
+
+void MainWindow::onToolSelect()
+{
+    setCurrentTool(EditorTool::Select);
+}
+
+void MainWindow::onToolRect()
+{
+    setCurrentTool(EditorTool::DrawRect);
+}
+
+void MainWindow::onToolCircle()
+{
+    setCurrentTool(EditorTool::DrawCircle);
+}
+
+void MainWindow::onToolPolygon()
+{
     setCurrentTool(EditorTool::DrawPolygon);
 }
 
+void MainWindow::onToolMagicWand()
+{
+    setCurrentTool(EditorTool::MagicWand);
+}
+
+void MainWindow::onToolLasso()
+{
+    setCurrentTool(EditorTool::Lasso);
+}
+
 void MainWindow::setCurrentTool(EditorTool tool)
 {
+    // Picking a tool means going back to editing
+    m_browserTestAction->setChecked(false);
     m_editor->setCurrentTool(tool);
 
     switch (tool) {
@@ -731,6 +1906,12 @@ void MainWindow::setCurrentTool(EditorTool tool)
     case EditorTool::DrawPolygon:
         m_polygonAction->setChecked(true);
         break;
+    case EditorTool::MagicWand:
+        m_magicWandAction->setChecked(true);
+        break;
+    case EditorTool::Lasso:
+        m_lassoAction->setChecked(true);
+        break;
     }
 }
 
@@ -741,6 +1922,13 @@ void MainWindow::onHotspotAdded(HotspotItem *hotspot)
     updateCodePreview();
 }
 
+void MainWindow::onHotspotsAdded(const QList<HotspotItem*> &hotspots)
+{
+    Q_UNUSED(hotspots)
+    updateHotspotList();
+    updateCodePreview();
+}
+
 void MainWindow::onHotspotRemoved(HotspotItem *hotspot)
 {
     Q_UNUSED(hotspot)
@@ -748,6 +1936,27 @@ void MainWindow::onHotspotRemoved(HotspotItem *hotspot)
     updateCodePreview();
 }
 
+void MainWindow::onHotspotChanged(HotspotItem *hotspot)
+{
+    if (hotspot == m_editor->selectedHotspot()) {
+        m_coordsLabel->setText(QString("Coords: %1").arg(hotspot->generateCoords()));
+    }
+    updateCodePreview();
+}
+
+void MainWindow::onConflictsChanged()
+{
+    for (int i = 0; i < m_hotspotsList->count(); ++i) {
+        QListWidgetItem *item = m_hotspotsList->item(i);
+        updateConflictMarker(item, item->data(Qt::UserRole).value<HotspotItem*>());
+    }
+
+    const int pairs = m_editor->overlapAnalyzer()->conflicts().size();
+    if (pairs > 0) {
+        statusBar()->showMessage(QString("%1 overlapping hotspot pair(s)").arg(pairs), 3000);
+    }
+}
+
 void MainWindow::onHotspotSelected(HotspotItem *hotspot)
 {
     // Update properties panel
@@ -758,6 +1967,9 @@ void MainWindow::onHotspotSelected(HotspotItem *hotspot)
         case HotspotShape::Circle: shapeName = "Circle"; break;
         case HotspotShape::Polygon: shapeName = "Polygon"; break;
         }
+        if (hotspot->isInstanced()) {
+            shapeName += QString(" × %1 instances").arg(hotspot->instanceCount());
+        }
         m_shapeLabel->setText(QString("Shape: %1").arg(shapeName));
         m_coordsLabel->setText(QString("Coords: %1").arg(hotspot->generateCoords()));
 
@@ -793,7 +2005,7 @@ void MainWindow::onHotspotSelected(HotspotItem *hotspot)
     for (int i = 0; i < m_hotspotsList->count(); ++i) {
         QListWidgetItem *item = m_hotspotsList->item(i);
         HotspotItem *h = item->data(Qt::UserRole).value<HotspotItem*>();
-        item->setSelected(h == hotspot);
+        item->setSelected(m_editor->selectedHotspots().contains(h));
     }
     m_hotspotsList->blockSignals(false);
 
@@ -802,13 +2014,26 @@ void MainWindow::onHotspotSelected(HotspotItem *hotspot)
 
 void MainWindow::onHotspotListSelectionChanged()
 {
-    QList<QListWidgetItem*> selected = m_hotspotsList->selectedItems();
-    if (selected.isEmpty()) {
-        m_editor->selectHotspot(nullptr);
-    } else {
-        HotspotItem *hotspot = selected.first()->data(Qt::UserRole).value<HotspotItem*>();
-        m_editor->selectHotspot(hotspot);
+    QList<HotspotItem*> hotspots;
+    for (QListWidgetItem *item : m_hotspotsList->selectedItems()) {
+        hotspots.append(item->data(Qt::UserRole).value<HotspotItem*>());
+    }
+    m_editor->setSelectedHotspots(hotspots);
+}
+
+void MainWindow::onCombineHotspots(PolygonBoolean::Operation operation)
+{
+    if (m_editor->selectedHotspots().size() < 2) {
+        statusBar()->showMessage("Select at least two hotspots (Shift+click) to combine them", 3000);
+        return;
+    }
+
+    QList<HotspotItem*> created = m_editor->combineSelectedHotspots(operation);
+    if (created.isEmpty()) {
+        QMessageBox::information(this, "Combine Hotspots", "The result is empty; the hotspots were left unchanged.");
+        return;
     }
+    statusBar()->showMessage(QString("Created %1 polygon hotspot(s)").arg(created.size()), 3000);
 }
 
 void MainWindow::onDeleteHotspot()
@@ -833,6 +2058,161 @@ void MainWindow::onClearAllHotspots()
     }
 }
 
+void MainWindow::onAutoDetectRegions()
+{
+    QImage image = m_editor->sourceImage();
+    if (image.isNull()) {
+        QMessageBox::information(this, "Auto-Detect Regions", "Open an image first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Auto-Detect Regions");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QSpinBox *thresholdSpin = new QSpinBox();
+    thresholdSpin->setRange(-1, 255);
+    thresholdSpin->setValue(-1);
+    thresholdSpin->setSpecialValueText("Automatic");
+    thresholdSpin->setToolTip("Luminance separating regions from the background");
+    form->addRow("Threshold:", thresholdSpin);
+
+    QSpinBox *minAreaSpin = new QSpinBox();
+    minAreaSpin->setRange(1, 10000000);
+    minAreaSpin->setValue(64);
+    minAreaSpin->setSuffix(" px");
+    form->addRow("Minimum area:", minAreaSpin);
+
+    QDoubleSpinBox *toleranceSpin = new QDoubleSpinBox();
+    toleranceSpin->setRange(0.0, 50.0);
+    toleranceSpin->setSingleStep(0.5);
+    toleranceSpin->setValue(1.5);
+    toleranceSpin->setSuffix(" px");
+    toleranceSpin->setToolTip("Maximum distance between the traced outline and the simplified polygon");
+    form->addRow("Simplify tolerance:", toleranceSpin);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    RegionDetector::Options options;
+    options.threshold = thresholdSpin->value();
+    options.minArea = minAreaSpin->value();
+    options.tolerance = toleranceSpin->value();
+
+    // Runs on the pool; watchTask polls for completion
+    struct Task {
+        RegionDetector::Progress progress;
+        QVector<QPolygonF> regions;
+        std::atomic<bool> finished{false};
+    };
+    auto task = std::make_shared<Task>();
+    QThreadPool::globalInstance()->start([task, image, options]() {
+        task->regions = RegionDetector::detect(image, options, &task->progress);
+        task->finished.store(true, std::memory_order_release);
+    });
+
+    const qint64 imageKey = image.cacheKey();
+    watchTask(this, "Detecting regions...", 0, task, nullptr, [this, task, imageKey]() {
+        if (task->progress.cancelled.load()) {
+            statusBar()->showMessage("Region detection cancelled", 3000);
+            return;
+        }
+        if (m_editor->sourceImage().cacheKey() != imageKey) {
+            statusBar()->showMessage("The image changed during region detection; nothing was added", 5000);
+            return;
+        }
+
+        QList<HotspotItem*> hotspots;
+        hotspots.reserve(task->regions.size());
+        for (const QPolygonF &polygon : task->regions) {
+            HotspotItem *hotspot = new HotspotItem(HotspotShape::Polygon);
+            hotspot->setPolygon(polygon);
+            hotspot->closePolygon();
+            hotspots.append(hotspot);
+        }
+        m_editor->addHotspots(hotspots);
+
+        statusBar()->showMessage(QString("Detected %1 regions").arg(hotspots.size()), 3000);
+    });
+}
+
+void MainWindow::onDuplicateAsGrid()
+{
+    HotspotItem *hotspot = m_editor->selectedHotspot();
+    if (!hotspot) {
+        QMessageBox::information(this, "Duplicate as Grid", "Select the hotspot to repeat first.");
+        return;
+    }
+
+    const QRectF bounds = hotspot->prototypeBounds();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Duplicate as Grid");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QSpinBox *rowsSpin = new QSpinBox();
+    rowsSpin->setRange(1, 1000);
+    rowsSpin->setValue(10);
+    form->addRow("Rows:", rowsSpin);
+
+    QSpinBox *columnsSpin = new QSpinBox();
+    columnsSpin->setRange(1, 1000);
+    columnsSpin->setValue(10);
+    form->addRow("Columns:", columnsSpin);
+
+    QDoubleSpinBox *stepXSpin = new QDoubleSpinBox();
+    stepXSpin->setRange(-100000.0, 100000.0);
+    stepXSpin->setValue(qRound(bounds.width()) + 4);
+    stepXSpin->setSuffix(" px");
+    stepXSpin->setToolTip("Distance between neighbouring columns");
+    form->addRow("Column spacing:", stepXSpin);
+
+    QDoubleSpinBox *stepYSpin = new QDoubleSpinBox();
+    stepYSpin->setRange(-100000.0, 100000.0);
+    stepYSpin->setValue(qRound(bounds.height()) + 4);
+    stepYSpin->setSuffix(" px");
+    stepYSpin->setToolTip("Distance between neighbouring rows");
+    form->addRow("Row spacing:", stepYSpin);
+
+    QSpinBox *firstRowSpin = new QSpinBox();
+    firstRowSpin->setRange(0, 100000);
+    firstRowSpin->setValue(1);
+    form->addRow("First row number:", firstRowSpin);
+
+    QSpinBox *firstColumnSpin = new QSpinBox();
+    firstColumnSpin->setRange(0, 100000);
+    firstColumnSpin->setValue(1);
+    form->addRow("First column number:", firstColumnSpin);
+
+    QLineEdit *urlEdit = new QLineEdit(hotspot->url().contains('{') ? hotspot->url() : "/seat/{row}/{col}");
+    urlEdit->setToolTip("{row}, {col} and {index} are replaced for each instance");
+    form->addRow("URL template:", urlEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    hotspot->setUrl(urlEdit->text());
+    m_editor->arrangeInGrid(hotspot, rowsSpin->value(), columnsSpin->value(),
+                            QPointF(stepXSpin->value(), stepYSpin->value()),
+                            firstRowSpin->value(), firstColumnSpin->value());
+
+    updateHotspotList();
+    onHotspotSelected(hotspot);
+    statusBar()->showMessage(QString("Created %1 instances").arg(hotspot->instanceCount()), 3000);
+}
+
 void MainWindow::updateHotspotProperties()
 {
     HotspotItem *hotspot = m_editor->selectedHotspot();
@@ -845,12 +2225,16 @@ void MainWindow::updateHotspotProperties()
     hotspot->setTitle(m_titleEdit->text());
     hotspot->update();
 
+    m_sessionRecorder->recordPropertyEdit(hotspot);
+
     updateHotspotList();
     updateCodePreview();
 }
 
 void MainWindow::updateHotspotList()
 {
+    TRACE_SCOPE("MainWindow::updateHotspotList");
+
     m_hotspotsList->clear();
 
     for (HotspotItem *hotspot : m_editor->hotspots()) {
@@ -869,16 +2253,152 @@ void MainWindow::updateHotspotList()
             title = title.left(23) + "...";
         }
 
+        if (hotspot->isInstanced()) {
+            shapeName += QString(" ×%1").arg(hotspot->instanceCount());
+        }
+
         QListWidgetItem *item = new QListWidgetItem(QString("%1 - %2").arg(shapeName, title));
         item->setData(Qt::UserRole, QVariant::fromValue(hotspot));
+        updateConflictMarker(item, hotspot);
         m_hotspotsList->addItem(item);
     }
 }
 
+void MainWindow::updateConflictMarker(QListWidgetItem *item, HotspotItem *hotspot)
+{
+    const int overlaps = m_editor->overlapAnalyzer()->conflictsWith(hotspot).size();
+    const bool overlapsItself = m_editor->overlapAnalyzer()->overlapsItself(hotspot);
+    if (overlaps > 0 || overlapsItself) {
+        QStringList problems;
+        if (overlaps > 0) {
+            problems << QString("Overlaps %1 other hotspot(s); the one listed first wins in the browser")
+                            .arg(overlaps);
+        }
+        if (overlapsItself) {
+            problems << "Its instances overlap each other";
+        }
+        item->setForeground(QColor(240, 90, 90));
+        item->setToolTip(problems.join("\n"));
+    } else {
+        item->setData(Qt::ForegroundRole, QVariant());
+        item->setToolTip(QString());
+    }
+}
+
 void MainWindow::updateCodePreview()
 {
-    QString html = m_editor->generateImageMapHtml(m_mapNameEdit->text());
+    ImageMapEditor::ExportStats stats;
+    QString html = m_editor->generateImageMapHtml(m_mapNameEdit->text(), &stats);
     m_codePreview->setPlainText(html);
+    requestCoverage();
+
+    if (!m_editor->isExportSimplificationEnabled() || html.isEmpty()) {
+        m_exportStatsLabel->clear();
+        return;
+    }
+
+    auto formatSize = [](qint64 bytes) {
+        if (bytes >= 1024 * 1024) {
+            return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+        }
+        if (bytes >= 1024) {
+            return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+        }
+        return QString("%1 B").arg(bytes);
+    };
+
+    const qreal saved = stats.originalBytes > 0
+                            ? 100.0 * (stats.originalBytes - stats.exportedBytes) / stats.originalBytes
+                            : 0.0;
+    m_exportStatsLabel->setText(QString("%1 → %2 (-%3%), %4 → %5 vertices")
+                                    .arg(formatSize(stats.originalBytes))
+                                    .arg(formatSize(stats.exportedBytes))
+                                    .arg(saved, 0, 'f', 1)
+                                    .arg(stats.originalVertices)
+                                    .arg(stats.exportedVertices));
+}
+
+void MainWindow::onExportSimplificationChanged()
+{
+    m_simplifyToleranceSpin->setEnabled(m_simplifyCheck->isChecked());
+    m_editor->setExportSimplification(m_simplifyCheck->isChecked(), m_simplifyToleranceSpin->value());
+    updateCodePreview();
+}
+
+void MainWindow::requestCoverage()
+{
+    if (!m_analysisDock->isVisible() || m_editor->sourceImage().isNull()) {
+        return;
+    }
+    m_coverage->request(m_editor->mapAreas(), m_editor->outputSize(),
+                        m_editor->isExportSimplificationEnabled() ? m_editor->exportTolerance() : -1);
+}
+
+void MainWindow::onCoverageReady()
+{
+    const CoverageStats &stats = m_coverage->stats();
+    const qint64 total = stats.totalPixels();
+    const auto percent = [total](qint64 pixels) {
+        return total > 0 ? 100.0 * pixels / total : 0.0;
+    };
+    m_coverageLabel->setText(QString("Clickable: %1% (%2 of %3 px)  ·  Uncovered: %4%  ·  Overlapping: %5 px (%6%)")
+                                 .arg(percent(stats.coveredPixels), 0, 'f', 1)
+                                 .arg(stats.coveredPixels)
+                                 .arg(total)
+                                 .arg(percent(total - stats.coveredPixels), 0, 'f', 1)
+                                 .arg(stats.overlapPixels)
+                                 .arg(percent(stats.overlapPixels), 0, 'f', 2));
+
+    const QVector<MapArea> areas = m_editor->mapAreas();
+    if (areas.size() != stats.areas.size()) {
+        return; // hotspots changed since; a newer result is on its way
+    }
+
+    m_coverageTable->setUpdatesEnabled(false);
+    m_coverageTable->setRowCount(areas.size());
+    for (int i = 0; i < areas.size(); ++i) {
+        const CoverageStats::Area &area = stats.areas.at(i);
+        auto number = [](qint64 value) {
+            QTableWidgetItem *item = new QTableWidgetItem(QString::number(value));
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            return item;
+        };
+        m_coverageTable->setItem(i, 0, number(i + 1));
+        m_coverageTable->setItem(i, 1, new QTableWidgetItem(areas.at(i).generateShapeName()));
+        m_coverageTable->setItem(i, 2, new QTableWidgetItem(areas.at(i).url));
+        m_coverageTable->setItem(i, 3, number(area.pixels));
+        QTableWidgetItem *overlapItem = number(area.overlapPixels);
+        if (area.overlapPixels > 0) {
+            overlapItem->setForeground(QColor(230, 60, 60));
+        }
+        m_coverageTable->setItem(i, 4, overlapItem);
+    }
+    m_coverageTable->setUpdatesEnabled(true);
+}
+
+void MainWindow::saveCoverageHeatmap()
+{
+    if (m_coverage->stats().size.isEmpty()) {
+        QMessageBox::information(this, "Coverage", "Open an image to analyse first.");
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(this,
+                                                    "Save Coverage Heatmap",
+                                                    "coverage.png",
+                                                    "PNG Image (*.png);;All Files (*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    // Drawn over the image at its output size, like the exported map
+    const QImage background = m_editor->sourceImage().scaled(m_editor->outputSize(), Qt::IgnoreAspectRatio,
+                                                              Qt::SmoothTransformation);
+    if (!CoverageAnalyzer::renderHeatmap(m_coverage->stats(), background).save(filePath)) {
+        QMessageBox::warning(this, "Error", "Failed to save heatmap.");
+        return;
+    }
+    statusBar()->showMessage("Heatmap saved to " + filePath, 3000);
 }
 
 void MainWindow::onCoordinatesChanged(const QPointF &pos)
@@ -918,6 +2438,19 @@ void MainWindow::onScreenStandardModeToggled(bool checked)
     }
 }
 
+void MainWindow::onEdgeSnapToggled(bool checked)
+{
+    m_editor->setEdgeSnapEnabled(checked);
+
+    if (!checked) {
+        statusBar()->showMessage("Snap to edges OFF", 1500);
+    } else if (m_editor->isEdgeMapReady()) {
+        statusBar()->showMessage("Snap to edges ON", 2000);
+    } else {
+        statusBar()->showMessage("Snap to edges ON - edge map is still being computed", 3000);
+    }
+}
+
 void MainWindow::copyHtmlToClipboard()
 {
     QString html = m_codePreview->toPlainText();
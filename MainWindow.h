@@ -11,9 +11,19 @@
 #include <QLabel>
 #include <QActionGroup>
 #include <QGroupBox>
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QTableWidget>
 
+#include "ImageAligner.h"
 #include "ImageMapEditor.h"
 
+class InputSessionRecorder;
+class MinimapWidget;
+class CoverageAnalyzer;
+class ImageWorkspace;
+class ThumbnailStrip;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -22,32 +32,61 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    void closeEvent(QCloseEvent *event) override;
+
 private slots:
     void openImage();
+    void replaceImage();
+    void openFolder();
+    void showNextImage();
+    void showPreviousImage();
     void saveProject();
     void loadProject();
+    void importHtmlMap();
+    void importAnnotations();
+    void exportAnnotations();
     void exportHtml();
+    void exportScriptMap();
+    void exportCrops();
+    void exportResponsive();
+    void exportBatch();
+    void saveTrace();
+    void onRecordSessionToggled(bool checked);
 
     void onToolSelect();
     void onToolRect();
     void onToolCircle();
     void onToolPolygon();
+    void onToolMagicWand();
+    void onToolLasso();
 
     void onHotspotAdded(HotspotItem *hotspot);
+    void onHotspotsAdded(const QList<HotspotItem*> &hotspots);
     void onHotspotRemoved(HotspotItem *hotspot);
     void onHotspotSelected(HotspotItem *hotspot);
     void onHotspotListSelectionChanged();
+    void onHotspotChanged(HotspotItem *hotspot);
+    void onConflictsChanged();
 
     void onDeleteHotspot();
     void onClearAllHotspots();
+    void onAutoDetectRegions();
+    void onCombineHotspots(PolygonBoolean::Operation operation);
+    void onDuplicateAsGrid();
 
     void updateHotspotProperties();
     void updateCodePreview();
+    void onExportSimplificationChanged();
+    void requestCoverage();
+    void onCoverageReady();
+    void saveCoverageHeatmap();
 
     void onCoordinatesChanged(const QPointF &pos);
     void onCoordinatesCopied(const QPointF &pos);
     void onClipboardModeToggled(bool checked);
     void onScreenStandardModeToggled(bool checked);
+    void onEdgeSnapToggled(bool checked);
     void copyHtmlToClipboard();
 
 private:
@@ -56,23 +95,50 @@ private:
     void setupDockWidgets();
     void setupStatusBar();
     void updateHotspotList();
+    void updateConflictMarker(QListWidgetItem *item, HotspotItem *hotspot);
     void setCurrentTool(EditorTool tool);
+    // Writes an export, plus a .gz copy when that option is on
+    bool writeExportFile(const QString &filePath, const QByteArray &bytes);
+    bool writeProjectFile(const QString &filePath);
+    // Folder workspace: each image keeps its own project next to it
+    void showWorkspaceImage(int index);
+    void saveWorkspaceProject();
+    // Second half of replaceImage, once the alignment is known
+    void applyReplacedImage(const QString &filePath, const QImage &image, const QList<HotspotItem*> &hotspots,
+                            const ImageAligner::Result &result,
+                            const QVector<ImageAligner::Refinement> &refinements);
 
     ImageMapEditor *m_editor;
+    InputSessionRecorder *m_sessionRecorder;
 
     // Toolbar actions
     QAction *m_selectAction;
     QAction *m_rectAction;
     QAction *m_circleAction;
     QAction *m_polygonAction;
+    QAction *m_magicWandAction;
+    QAction *m_lassoAction;
     QAction *m_clipboardModeAction;
     QAction *m_screenStandardAction;
+    QAction *m_edgeSnapAction;
+    QAction *m_browserTestAction;
     QActionGroup *m_toolGroup;
 
     // Dock widgets
     QDockWidget *m_propertiesDock;
     QDockWidget *m_hotspotsDock;
     QDockWidget *m_codeDock;
+    QDockWidget *m_navigatorDock;
+    MinimapWidget *m_minimap;
+    QDockWidget *m_imagesDock;
+    ThumbnailStrip *m_thumbnailStrip;
+    ImageWorkspace *m_workspace;
+
+    // Coverage analysis
+    QDockWidget *m_analysisDock;
+    CoverageAnalyzer *m_coverage;
+    QLabel *m_coverageLabel;
+    QTableWidget *m_coverageTable;
 
     // Hotspots list
     QListWidget *m_hotspotsList;
@@ -87,6 +153,12 @@ private:
     // Code preview
     QTextEdit *m_codePreview;
     QLineEdit *m_mapNameEdit;
+    QCheckBox *m_simplifyCheck;
+    QDoubleSpinBox *m_simplifyToleranceSpin;
+    QLabel *m_exportStatsLabel;
+    QCheckBox *m_minifyCheck;
+    QCheckBox *m_gzipCheck;
+    static constexpr qint64 EXPORT_BLOCK_SIZE = 256 * 1024;
 
     // Status bar
     QLabel *m_coordsStatusLabel;
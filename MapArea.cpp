@@ -0,0 +1,154 @@
+#include "MapArea.h"
+#include "Geometry.h"
+
+static qint64 cross(const QPoint &a, const QPoint &b, const QPoint &c)
+{
+    return static_cast<qint64>(b.x() - a.x()) * (c.y() - a.y())
+         - static_cast<qint64>(b.y() - a.y()) * (c.x() - a.x());
+}
+
+static QVector<QPoint> roundPolygon(const QPolygonF &polygon)
+{
+    QVector<QPoint> points;
+    points.reserve(polygon.size());
+    for (const QPointF &pt : polygon) {
+        QPoint p(qRound(pt.x()), qRound(pt.y()));
+        if (points.isEmpty() || points.last() != p) {
+            points.append(p);
+        }
+    }
+    while (points.size() > 1 && points.first() == points.last()) {
+        points.removeLast();
+    }
+    return points;
+}
+
+QString MapArea::generateShapeName() const
+{
+    switch (shape) {
+    case HotspotShape::Rectangle: return "rect";
+    case HotspotShape::Circle: return "circle";
+    case HotspotShape::Polygon: return "poly";
+    }
+    return "rect";
+}
+
+QVector<QPoint> MapArea::exportPolygon(qreal simplifyTolerance) const
+{
+    if (simplifyTolerance < 0) {
+        QVector<QPoint> points;
+        points.reserve(polygon.size());
+        for (const QPointF &pt : polygon) {
+            points.append(QPoint(qRound(pt.x()), qRound(pt.y())));
+        }
+        return points;
+    }
+
+    QVector<QPoint> rounded = roundPolygon(Geometry::simplifyPolygon(polygon, simplifyTolerance));
+
+    // Drop vertices that sit on the line through their neighbours
+    QVector<QPoint> points;
+    points.reserve(rounded.size());
+    for (const QPoint &p : rounded) {
+        points.append(p);
+        while (points.size() >= 3 && cross(points.at(points.size() - 3), points.at(points.size() - 2), p) == 0) {
+            points.remove(points.size() - 2);
+        }
+    }
+    // ...including across the wrap-around
+    while (points.size() >= 3 && cross(points.at(points.size() - 2), points.last(), points.first()) == 0) {
+        points.removeLast();
+    }
+    while (points.size() >= 3 && cross(points.last(), points.first(), points.at(1)) == 0) {
+        points.removeFirst();
+    }
+
+    if (points.size() < 3) {
+        // Degenerate after simplification; keep the unsimplified outline
+        return roundPolygon(polygon);
+    }
+    return points;
+}
+
+QVector<int> MapArea::coordValues(qreal simplifyTolerance) const
+{
+    QVector<int> values;
+
+    switch (shape) {
+    case HotspotShape::Rectangle:
+        values << qRound(rect.left()) << qRound(rect.top()) << qRound(rect.right()) << qRound(rect.bottom());
+        break;
+    case HotspotShape::Circle:
+        values << qRound(center.x()) << qRound(center.y()) << qRound(radius);
+        break;
+    case HotspotShape::Polygon: {
+        const QVector<QPoint> points = exportPolygon(simplifyTolerance);
+        values.reserve(points.size() * 2);
+        for (const QPoint &p : points) {
+            values << p.x() << p.y();
+        }
+        break;
+    }
+    }
+
+    return values;
+}
+
+QString MapArea::generateCoords(qreal simplifyTolerance) const
+{
+    const QVector<int> values = coordValues(simplifyTolerance);
+    QStringList coords;
+    coords.reserve(values.size());
+    for (int value : values) {
+        coords << QString::number(value);
+    }
+    return coords.join(",");
+}
+
+QString MapArea::polygonCoords(const QVector<QPoint> &points)
+{
+    QStringList coords;
+    coords.reserve(points.size() * 2);
+    for (const QPoint &p : points) {
+        coords << QString::number(p.x()) << QString::number(p.y());
+    }
+    return coords.join(",");
+}
+
+QString MapArea::attribute(const QString &name, const QString &value, bool minified)
+{
+    if (!minified) {
+        return QString("%1=\"%2\"").arg(name, value.toHtmlEscaped());
+    }
+    if (value.isEmpty()) {
+        return name;
+    }
+    // Unquoted values may not contain whitespace, quotes, =, <, > or `
+    for (const QChar c : value) {
+        if (c.isSpace() || c == '"' || c == '\'' || c == '=' || c == '<' || c == '>' || c == '`') {
+            return QString("%1=\"%2\"").arg(name, value.toHtmlEscaped());
+        }
+    }
+    return name + "=" + QString(value).replace("&", "&amp;");
+}
+
+QString MapArea::generateAreaTag(qreal simplifyTolerance, bool minified) const
+{
+    return generateAreaTag(generateCoords(simplifyTolerance), minified);
+}
+
+QString MapArea::generateAreaTag(const QString &coords, bool minified) const
+{
+    QStringList tag;
+    tag << "<area"
+        << attribute("shape", generateShapeName(), minified)
+        << attribute("coords", coords, minified)
+        << attribute("href", url.isEmpty() ? "#" : url, minified)
+        << attribute("alt", altText, minified);
+
+    if (!title.isEmpty()) {
+        tag << attribute("title", title, minified);
+    }
+
+    return tag.join(' ') + ">";
+}
@@ -0,0 +1,49 @@
+#ifndef MAPAREA_H
+#define MAPAREA_H
+
+#include <QPolygonF>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include <QPoint>
+#include "HotspotItem.h"
+
+// Plain snapshot of one <area> in output coordinates (item position and screen
+// standard scaling already applied). Unlike HotspotItem it can be used freely
+// off the GUI thread.
+struct MapArea
+{
+    HotspotShape shape = HotspotShape::Rectangle;
+    QRectF rect;        // Rectangle
+    QPointF center;     // Circle
+    qreal radius = 0;   // Circle
+    QPolygonF polygon;  // Polygon
+
+    QString url;
+    QString altText;
+    QString title;
+
+    QString generateShapeName() const;
+
+    // simplifyTolerance < 0 writes every polygon vertex. Otherwise polygons
+    // are simplified to within that many output pixels, and vertices that
+    // round to a duplicate or collinear integer coordinate are dropped.
+    QString generateCoords(qreal simplifyTolerance = -1) const;
+    // The same values as integers
+    QVector<int> coordValues(qreal simplifyTolerance = -1) const;
+    // Minified tags leave attribute values unquoted where HTML allows it
+    // and write an empty alt as a bare attribute
+    QString generateAreaTag(qreal simplifyTolerance = -1, bool minified = false) const;
+    // Same tag with coords computed elsewhere, e.g. for a scaled copy of the map
+    QString generateAreaTag(const QString &coords, bool minified = false) const;
+
+    // name="value", or the shortest equivalent form when minified
+    static QString attribute(const QString &name, const QString &value, bool minified);
+
+    // Integer polygon vertices as written to the coords attribute
+    QVector<QPoint> exportPolygon(qreal simplifyTolerance = -1) const;
+    // coords attribute value for vertices from exportPolygon
+    static QString polygonCoords(const QVector<QPoint> &points);
+};
+
+#endif // MAPAREA_H
@@ -0,0 +1,320 @@
+#include "MinimapWidget.h"
+#include "ImageMapEditor.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QThreadPool>
+#include <atomic>
+
+struct MinimapWidget::Job
+{
+    QImage source;
+    QSize size;
+    QImage result;
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+};
+
+MinimapWidget::MinimapWidget(ImageMapEditor *editor, QWidget *parent)
+    : QWidget(parent)
+    , m_editor(editor)
+{
+    setMinimumSize(120, 90);
+    setCursor(Qt::PointingHandCursor);
+
+    m_overlayTimer = new QTimer(this);
+    m_overlayTimer->setSingleShot(true);
+    m_overlayTimer->setInterval(0);
+    connect(m_overlayTimer, &QTimer::timeout, this, &MinimapWidget::redrawOverlay);
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(m_pollTimer, &QTimer::timeout, this, &MinimapWidget::pollJob);
+
+    connect(editor, &ImageMapEditor::imageChanged, this, &MinimapWidget::onImageChanged);
+    connect(editor, &ImageMapEditor::hotspotAdded, this, [this](HotspotItem *hotspot) {
+        onHotspotsAdded(QList<HotspotItem*>{hotspot});
+    });
+    connect(editor, &ImageMapEditor::hotspotsAdded, this, &MinimapWidget::onHotspotsAdded);
+    connect(editor, &ImageMapEditor::hotspotRemoved, this, &MinimapWidget::onHotspotRemoved);
+    connect(editor, &ImageMapEditor::hotspotChanged, this, &MinimapWidget::onHotspotChanged);
+    connect(editor, &ImageMapEditor::hotspotsTransformed, this, [this](const QList<HotspotItem*> &hotspots) {
+        for (HotspotItem *hotspot : hotspots) {
+            onHotspotChanged(hotspot);
+        }
+    });
+    connect(editor, &ImageMapEditor::hotspotsCleared, this, &MinimapWidget::onHotspotsCleared);
+    connect(editor, &ImageMapEditor::viewChanged, this, [this]() { update(); });
+}
+
+MinimapWidget::~MinimapWidget()
+{
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+    }
+}
+
+QSize MinimapWidget::sizeHint() const
+{
+    return QSize(240, 180);
+}
+
+void MinimapWidget::onImageChanged()
+{
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+        m_job.reset();
+    }
+    m_pollTimer->stop();
+
+    const QImage image = m_editor->sourceImage();
+    m_sceneSize = image.size();
+    m_overview = QPixmap();
+    m_overviewSize = image.size().scaled(MaxOverviewSize, MaxOverviewSize, Qt::KeepAspectRatio);
+    if (image.width() <= MaxOverviewSize && image.height() <= MaxOverviewSize) {
+        m_overviewSize = image.size();
+    }
+
+    m_overlay = QImage();
+    if (!m_overviewSize.isEmpty()) {
+        m_overlay = QImage(m_overviewSize, QImage::Format_ARGB32_Premultiplied);
+        m_overlay.fill(Qt::transparent);
+
+        auto job = std::make_shared<Job>();
+        job->source = image; // implicitly shared, no copy
+        job->size = m_overviewSize;
+        m_job = job;
+        QThreadPool::globalInstance()->start([job]() {
+            TRACE_SCOPE("MinimapWidget::reduce");
+            QImage result = reduce(job->source, job->size);
+            job->source = QImage();
+            if (!job->cancelled.load(std::memory_order_relaxed)) {
+                job->result = result;
+            }
+            job->done.store(true, std::memory_order_release);
+        });
+        m_pollTimer->start();
+    }
+
+    // Hotspots carried over from the previous image are redrawn at the new scale
+    markDirty(QRectF(QPointF(0, 0), m_sceneSize));
+    update();
+}
+
+void MinimapWidget::pollJob()
+{
+    if (!m_job || !m_job->done.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::shared_ptr<Job> job = std::move(m_job);
+    m_pollTimer->stop();
+
+    m_overview = QPixmap::fromImage(job->result);
+    update();
+}
+
+QImage MinimapWidget::reduce(const QImage &image, const QSize &size)
+{
+    // Box filter: every output pixel averages the block of source pixels it
+    // covers, so each source pixel is read exactly once
+    QImage source = image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32_Premultiplied) {
+        source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    if (source.size() == size) {
+        return source;
+    }
+
+    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const int width = size.width();
+    const int height = size.height();
+
+    parallelFor(height, [&](int y) {
+        const int y0 = static_cast<int>(static_cast<qint64>(y) * sourceHeight / height);
+        const int y1 = qMax(y0 + 1, static_cast<int>(static_cast<qint64>(y + 1) * sourceHeight / height));
+        QRgb *out = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const int x0 = static_cast<int>(static_cast<qint64>(x) * sourceWidth / width);
+            const int x1 = qMax(x0 + 1, static_cast<int>(static_cast<qint64>(x + 1) * sourceWidth / width));
+            quint64 r = 0, g = 0, b = 0, a = 0;
+            for (int sy = y0; sy < y1; ++sy) {
+                const QRgb *row = reinterpret_cast<const QRgb*>(source.constScanLine(sy));
+                for (int sx = x0; sx < x1; ++sx) {
+                    const QRgb pixel = row[sx];
+                    r += qRed(pixel);
+                    g += qGreen(pixel);
+                    b += qBlue(pixel);
+                    a += qAlpha(pixel);
+                }
+            }
+            const quint64 count = static_cast<quint64>(y1 - y0) * (x1 - x0);
+            out[x] = qRgba(static_cast<int>(r / count), static_cast<int>(g / count),
+                           static_cast<int>(b / count), static_cast<int>(a / count));
+        }
+    });
+    return result;
+}
+
+void MinimapWidget::onHotspotsAdded(const QList<HotspotItem*> &hotspots)
+{
+    for (HotspotItem *hotspot : hotspots) {
+        markDirty(hotspot->mapRectToScene(hotspot->boundingRect()));
+    }
+}
+
+void MinimapWidget::onHotspotRemoved(HotspotItem *hotspot)
+{
+    markDirty(m_drawnBounds.take(hotspot));
+}
+
+void MinimapWidget::onHotspotChanged(HotspotItem *hotspot)
+{
+    markDirty(m_drawnBounds.value(hotspot));
+    markDirty(hotspot->mapRectToScene(hotspot->boundingRect()));
+}
+
+void MinimapWidget::onHotspotsCleared()
+{
+    m_drawnBounds.clear();
+    m_dirty = QRectF();
+    m_overlayTimer->stop();
+    if (!m_overlay.isNull()) {
+        m_overlay.fill(Qt::transparent);
+        m_overlayPixmap = QPixmap::fromImage(m_overlay);
+    }
+    update();
+}
+
+void MinimapWidget::markDirty(const QRectF &sceneRect)
+{
+    if (sceneRect.isEmpty()) {
+        return;
+    }
+    m_dirty = m_dirty.isEmpty() ? sceneRect : m_dirty.united(sceneRect);
+    m_overlayTimer->start();
+}
+
+void MinimapWidget::redrawOverlay()
+{
+    TRACE_SCOPE("MinimapWidget::redrawOverlay");
+
+    if (m_overlay.isNull() || m_dirty.isEmpty()) {
+        m_dirty = QRectF();
+        return;
+    }
+
+    const qreal scale = m_overviewSize.width() / m_sceneSize.width();
+    // Whole overlay pixels, so the cleared area and the redraw line up
+    const QRect pixels = QRectF(m_dirty.topLeft() * scale, m_dirty.bottomRight() * scale)
+                             .toAlignedRect().adjusted(-1, -1, 1, 1)
+                             .intersected(m_overlay.rect());
+    m_dirty = QRectF();
+    if (pixels.isEmpty()) {
+        return;
+    }
+    const QRectF sceneArea(QRectF(pixels).topLeft() / scale, QRectF(pixels).size() / scale);
+
+    QPainter painter(&m_overlay);
+    painter.setClipRect(pixels);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(pixels, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.scale(scale, scale);
+
+    for (HotspotItem *hotspot : m_editor->hotspotsIn(sceneArea)) {
+        QColor fill = hotspot->color();
+        fill.setAlpha(160);
+        // A cosmetic pen keeps hotspots smaller than a pixel visible
+        painter.setPen(QPen(hotspot->color().darker(150), 0));
+        painter.setBrush(fill);
+
+        for (int i = 0; i < hotspot->instanceCount(); ++i) {
+            const QPointF offset = hotspot->pos() + hotspot->instanceOffset(i);
+            switch (hotspot->hotspotShape()) {
+            case HotspotShape::Rectangle:
+                painter.drawRect(hotspot->rect().normalized().translated(offset));
+                break;
+            case HotspotShape::Circle:
+                painter.drawEllipse(hotspot->center() + offset, hotspot->radius(), hotspot->radius());
+                break;
+            case HotspotShape::Polygon:
+                painter.drawPolygon(hotspot->polygon().translated(offset));
+                break;
+            }
+        }
+        m_drawnBounds.insert(hotspot, hotspot->mapRectToScene(hotspot->boundingRect()));
+    }
+    painter.end();
+
+    m_overlayPixmap = QPixmap::fromImage(m_overlay);
+    update();
+}
+
+QRectF MinimapWidget::targetRect() const
+{
+    if (m_overviewSize.isEmpty()) {
+        return QRectF();
+    }
+    const QSizeF size = QSizeF(m_overviewSize).scaled(QSizeF(width() - 8, height() - 8), Qt::KeepAspectRatio);
+    return QRectF(QPointF((width() - size.width()) / 2, (height() - size.height()) / 2), size);
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(45, 45, 48));
+
+    const QRectF target = targetRect();
+    if (target.isEmpty()) {
+        return;
+    }
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    if (m_overview.isNull()) {
+        painter.fillRect(target, QColor(70, 70, 74));
+    } else {
+        painter.drawPixmap(target, m_overview, QRectF(m_overview.rect()));
+    }
+    if (!m_overlayPixmap.isNull()) {
+        painter.drawPixmap(target, m_overlayPixmap, QRectF(m_overlayPixmap.rect()));
+    }
+
+    // Visible part of the editor
+    const QRectF visible = m_editor->visibleSceneRect().intersected(QRectF(QPointF(0, 0), m_sceneSize));
+    if (!visible.isEmpty()) {
+        const qreal scale = target.width() / m_sceneSize.width();
+        const QRectF frame(target.topLeft() + visible.topLeft() * scale, visible.size() * scale);
+        painter.setPen(QPen(QColor(255, 140, 0), 1.5));
+        painter.setBrush(QColor(255, 140, 0, 40));
+        painter.drawRect(frame);
+    }
+}
+
+void MinimapWidget::centerEditorOn(const QPointF &widgetPos)
+{
+    const QRectF target = targetRect();
+    if (target.isEmpty()) {
+        return;
+    }
+    const qreal scale = m_sceneSize.width() / target.width();
+    m_editor->centerOn((widgetPos - target.topLeft()) * scale);
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        centerEditorOn(event->pos());
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        centerEditorOn(event->pos());
+    }
+}
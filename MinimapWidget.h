@@ -0,0 +1,75 @@
+#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QRectF>
+#include <QTimer>
+#include <QWidget>
+#include <memory>
+
+class ImageMapEditor;
+class HotspotItem;
+
+// Overview of the whole image with its hotspots and the editor's visible
+// area. Click or drag to move the view.
+//
+// The image is reduced once on the thread pool to at most MaxOverviewSize
+// pixels. Hotspots are drawn into a separate overlay of the same size; when
+// they change only the affected part of the overlay is redrawn, so painting
+// the widget is just two pixmap blits and a rectangle.
+class MinimapWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MinimapWidget(ImageMapEditor *editor, QWidget *parent = nullptr);
+    ~MinimapWidget() override;
+
+    QSize sizeHint() const override;
+
+    static constexpr int MaxOverviewSize = 512;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    struct Job;
+
+    void onImageChanged();
+    void pollJob();
+    void onHotspotsAdded(const QList<HotspotItem*> &hotspots);
+    void onHotspotRemoved(HotspotItem *hotspot);
+    void onHotspotChanged(HotspotItem *hotspot);
+    void onHotspotsCleared();
+    void markDirty(const QRectF &sceneRect);
+    void redrawOverlay();
+
+    // Where the overview is drawn in the widget, keeping its aspect ratio
+    QRectF targetRect() const;
+    void centerEditorOn(const QPointF &widgetPos);
+
+    static QImage reduce(const QImage &image, const QSize &size);
+
+    ImageMapEditor *m_editor;
+    QSizeF m_sceneSize;
+    QSize m_overviewSize;
+    QPixmap m_overview;
+    QImage m_overlay;
+    QPixmap m_overlayPixmap;
+
+    // Last drawn scene bounds, to clear hotspots that moved or went away
+    QHash<HotspotItem*, QRectF> m_drawnBounds;
+    QRectF m_dirty;
+    QTimer *m_overlayTimer;
+
+    std::shared_ptr<Job> m_job;
+    QTimer *m_pollTimer;
+
+    static constexpr int POLL_INTERVAL_MS = 30;
+};
+
+#endif // MINIMAPWIDGET_H
@@ -0,0 +1,458 @@
+#include "OverlapAnalyzer.h"
+#include "Geometry.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QThreadPool>
+#include <QtMath>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+struct OverlapAnalyzer::Job
+{
+    std::vector<std::pair<Id, Shape>> entries;
+    bool full = false;
+    QSet<Id> dirty;
+
+    // Overlapping pairs found; for incremental jobs, only those involving a
+    // dirty hotspot
+    std::vector<std::pair<Id, Id>> pairs;
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+};
+
+OverlapAnalyzer::OverlapAnalyzer(QObject *parent)
+    : QObject(parent)
+{
+    // Batches all changes made in one event loop iteration into one job
+    m_startTimer = new QTimer(this);
+    m_startTimer->setSingleShot(true);
+    m_startTimer->setInterval(0);
+    connect(m_startTimer, &QTimer::timeout, this, &OverlapAnalyzer::startJob);
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(m_pollTimer, &QTimer::timeout, this, &OverlapAnalyzer::pollJob);
+}
+
+OverlapAnalyzer::~OverlapAnalyzer()
+{
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+    }
+}
+
+void OverlapAnalyzer::setHotspots(const QList<HotspotItem*> &hotspots)
+{
+    if (m_job) {
+        m_job->cancelled.store(true, std::memory_order_relaxed);
+        m_job.reset();
+        m_pollTimer->stop();
+    }
+
+    m_shapes.clear();
+    m_shapes.reserve(hotspots.size());
+    for (const HotspotItem *hotspot : hotspots) {
+        m_shapes.insert(reinterpret_cast<Id>(hotspot), snapshot(hotspot));
+    }
+    m_conflicts.clear();
+    m_dirty.clear();
+    m_fullPending = true;
+
+    emit conflictsChanged();
+    schedule();
+}
+
+void OverlapAnalyzer::updateHotspot(HotspotItem *hotspot)
+{
+    const Id id = reinterpret_cast<Id>(hotspot);
+    m_shapes.insert(id, snapshot(hotspot));
+    m_dirty.insert(id);
+    schedule();
+}
+
+void OverlapAnalyzer::removeHotspot(HotspotItem *hotspot)
+{
+    const Id id = reinterpret_cast<Id>(hotspot);
+    m_shapes.remove(id);
+    m_dirty.remove(id);
+
+    const QSet<Id> neighbours = m_conflicts.take(id);
+    for (Id other : neighbours) {
+        auto it = m_conflicts.find(other);
+        if (it != m_conflicts.end()) {
+            it->remove(id);
+            if (it->isEmpty()) {
+                m_conflicts.erase(it);
+            }
+        }
+    }
+    if (!neighbours.isEmpty()) {
+        emit conflictsChanged();
+    }
+}
+
+void OverlapAnalyzer::clear()
+{
+    setHotspots(QList<HotspotItem*>());
+    m_fullPending = false;
+}
+
+QList<QPair<HotspotItem*, HotspotItem*>> OverlapAnalyzer::conflicts() const
+{
+    QList<QPair<HotspotItem*, HotspotItem*>> result;
+    for (auto it = m_conflicts.constBegin(); it != m_conflicts.constEnd(); ++it) {
+        for (Id other : it.value()) {
+            if (it.key() <= other) {
+                result.append(qMakePair(reinterpret_cast<HotspotItem*>(it.key()),
+                                        reinterpret_cast<HotspotItem*>(other)));
+            }
+        }
+    }
+    return result;
+}
+
+QList<HotspotItem*> OverlapAnalyzer::conflictsWith(HotspotItem *hotspot) const
+{
+    const Id id = reinterpret_cast<Id>(hotspot);
+    QList<HotspotItem*> result;
+    for (Id other : m_conflicts.value(id)) {
+        if (other != id) {
+            result.append(reinterpret_cast<HotspotItem*>(other));
+        }
+    }
+    return result;
+}
+
+bool OverlapAnalyzer::overlapsItself(HotspotItem *hotspot) const
+{
+    const Id id = reinterpret_cast<Id>(hotspot);
+    return m_conflicts.value(id).contains(id);
+}
+
+bool OverlapAnalyzer::hasConflicts(HotspotItem *hotspot) const
+{
+    return m_conflicts.contains(reinterpret_cast<Id>(hotspot));
+}
+
+OverlapAnalyzer::Shape OverlapAnalyzer::snapshot(const HotspotItem *hotspot)
+{
+    Shape s;
+    s.shape = hotspot->hotspotShape();
+    switch (s.shape) {
+    case HotspotShape::Rectangle:
+        s.rect = hotspot->rect().translated(hotspot->pos()).normalized();
+        s.bounds = s.rect;
+        break;
+    case HotspotShape::Circle:
+        s.center = hotspot->center() + hotspot->pos();
+        s.radius = hotspot->radius();
+        s.bounds = QRectF(s.center.x() - s.radius, s.center.y() - s.radius, 2 * s.radius, 2 * s.radius);
+        break;
+    case HotspotShape::Polygon:
+        s.polygon = hotspot->polygon().translated(hotspot->pos());
+        s.bounds = s.polygon.boundingRect();
+        break;
+    }
+    s.prototypeBounds = s.bounds;
+
+    if (hotspot->isInstanced()) {
+        s.offsets.reserve(hotspot->instances().size());
+        for (const HotspotItem::Instance &instance : hotspot->instances()) {
+            s.offsets.append(instance.offset);
+            s.bounds = s.bounds.united(s.prototypeBounds.translated(instance.offset));
+        }
+    }
+    return s;
+}
+
+OverlapAnalyzer::Shape OverlapAnalyzer::translated(const Shape &shape, const QPointF &offset)
+{
+    Shape s = shape;
+    s.offsets.clear();
+    s.prototypeBounds.translate(offset);
+    s.bounds = s.prototypeBounds;
+    s.rect.translate(offset);
+    s.center += offset;
+    s.polygon.translate(offset);
+    return s;
+}
+
+bool OverlapAnalyzer::shapesOverlap(const Shape &a, const Shape &b)
+{
+    if (a.offsets.isEmpty() && b.offsets.isEmpty()) {
+        return prototypesOverlap(a, b);
+    }
+
+    // Instanced: test each pair of instances whose boxes meet
+    const QVector<QPointF> offsetsA = a.offsets.isEmpty() ? QVector<QPointF>{QPointF()} : a.offsets;
+    const QVector<QPointF> offsetsB = b.offsets.isEmpty() ? QVector<QPointF>{QPointF()} : b.offsets;
+    for (const QPointF &da : offsetsA) {
+        const QRectF boundsA = a.prototypeBounds.translated(da);
+        if (!boundsA.intersects(b.bounds)) {
+            continue;
+        }
+        for (const QPointF &db : offsetsB) {
+            if (boundsA.intersects(b.prototypeBounds.translated(db))
+                && prototypesOverlap(translated(a, da), translated(b, db))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool OverlapAnalyzer::instancesOverlap(const Shape &shape)
+{
+    const qreal cellWidth = shape.prototypeBounds.width();
+    const qreal cellHeight = shape.prototypeBounds.height();
+    if (shape.offsets.size() < 2 || cellWidth <= 0 || cellHeight <= 0) {
+        return false;
+    }
+
+    // Two instances can only meet if their offsets differ by less than one
+    // instance in each direction, so by at most one cell
+    auto cellKey = [](qint64 column, qint64 row) {
+        return (static_cast<quint64>(column) << 32) ^ static_cast<quint32>(row);
+    };
+    QHash<quint64, QVector<int>> cells;
+    for (int i = 0; i < shape.offsets.size(); ++i) {
+        const QPointF &offset = shape.offsets.at(i);
+        cells[cellKey(qFloor(offset.x() / cellWidth), qFloor(offset.y() / cellHeight))].append(i);
+    }
+
+    for (int i = 0; i < shape.offsets.size(); ++i) {
+        const QPointF &offset = shape.offsets.at(i);
+        const qint64 column = qFloor(offset.x() / cellWidth);
+        const qint64 row = qFloor(offset.y() / cellHeight);
+        const QRectF box = shape.prototypeBounds.translated(offset);
+        for (qint64 dy = -1; dy <= 1; ++dy) {
+            for (qint64 dx = -1; dx <= 1; ++dx) {
+                const auto cell = cells.constFind(cellKey(column + dx, row + dy));
+                if (cell == cells.constEnd()) {
+                    continue;
+                }
+                for (int j : cell.value()) {
+                    if (j > i && box.intersects(shape.prototypeBounds.translated(shape.offsets.at(j)))
+                        && prototypesOverlap(translated(shape, offset), translated(shape, shape.offsets.at(j)))) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool OverlapAnalyzer::prototypesOverlap(const Shape &a, const Shape &b)
+{
+    // Callers have already checked that the bounding boxes overlap
+    const Shape &first = a.shape <= b.shape ? a : b;
+    const Shape &second = a.shape <= b.shape ? b : a;
+
+    if (second.shape == HotspotShape::Rectangle) {
+        return true;
+    }
+
+    if (second.shape == HotspotShape::Circle) {
+        if (first.shape == HotspotShape::Circle) {
+            const qreal dx = first.center.x() - second.center.x();
+            const qreal dy = first.center.y() - second.center.y();
+            return std::hypot(dx, dy) < first.radius + second.radius;
+        }
+        // Rectangle: nearest point of the rectangle to the centre
+        const qreal nx = qBound(first.rect.left(), second.center.x(), first.rect.right());
+        const qreal ny = qBound(first.rect.top(), second.center.y(), first.rect.bottom());
+        return std::hypot(second.center.x() - nx, second.center.y() - ny) < second.radius;
+    }
+
+    switch (first.shape) {
+    case HotspotShape::Rectangle:
+        return Geometry::polygonsOverlap(QPolygonF(first.rect), second.polygon);
+    case HotspotShape::Circle:
+        return Geometry::polygonOverlapsCircle(second.polygon, first.center, first.radius);
+    case HotspotShape::Polygon:
+        return Geometry::polygonsOverlap(first.polygon, second.polygon);
+    }
+    return false;
+}
+
+void OverlapAnalyzer::run(Job &job)
+{
+    TRACE_SCOPE("OverlapAnalyzer::run");
+
+    auto &entries = job.entries;
+    std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+        return a.second.bounds.left() < b.second.bounds.left();
+    });
+
+    // Boxes that merely touch are not overlaps
+    auto boundsOverlap = [](const QRectF &a, const QRectF &b) {
+        return a.left() < b.right() && b.left() < a.right()
+            && a.top() < b.bottom() && b.top() < a.bottom();
+    };
+
+    std::vector<std::pair<int, int>> candidates;
+    const int count = static_cast<int>(entries.size());
+
+    if (job.full) {
+        // Sweep along x, keeping the boxes whose x-range is still open
+        std::vector<int> active;
+        for (int i = 0; i < count; ++i) {
+            if ((i & 1023) == 0 && job.cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const QRectF &box = entries[i].second.bounds;
+            active.erase(std::remove_if(active.begin(), active.end(), [&](int j) {
+                return entries[j].second.bounds.right() <= box.left();
+            }), active.end());
+            for (int j : active) {
+                if (boundsOverlap(entries[j].second.bounds, box)) {
+                    candidates.emplace_back(j, i);
+                }
+            }
+            active.push_back(i);
+        }
+    } else {
+        // Anything overlapping a dirty box starts at most maxWidth before it
+        qreal maxWidth = 0;
+        for (const auto &entry : entries) {
+            maxWidth = qMax(maxWidth, entry.second.bounds.width());
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const Id id = entries[i].first;
+            if (!job.dirty.contains(id)) {
+                continue;
+            }
+            const QRectF &box = entries[i].second.bounds;
+            auto first = std::lower_bound(entries.begin(), entries.end(), box.left() - maxWidth,
+                                          [](const auto &entry, qreal left) {
+                                              return entry.second.bounds.left() < left;
+                                          });
+            for (int k = static_cast<int>(first - entries.begin());
+                 k < count && entries[k].second.bounds.left() < box.right(); ++k) {
+                const Id other = entries[k].first;
+                if (k == i || (job.dirty.contains(other) && other < id)) {
+                    continue;
+                }
+                if (boundsOverlap(entries[k].second.bounds, box)) {
+                    candidates.emplace_back(i, k);
+                }
+            }
+        }
+    }
+
+    // Instanced hotspots against themselves
+    std::vector<int> instanced;
+    for (int i = 0; i < count; ++i) {
+        if (entries[i].second.offsets.size() > 1 && (job.full || job.dirty.contains(entries[i].first))) {
+            instanced.push_back(i);
+        }
+    }
+    std::vector<char> selfOverlapping(instanced.size(), 0);
+    parallelFor(static_cast<int>(instanced.size()), [&](int k) {
+        if (!job.cancelled.load(std::memory_order_relaxed)) {
+            selfOverlapping[k] = instancesOverlap(entries[instanced[k]].second);
+        }
+    });
+    for (size_t k = 0; k < instanced.size(); ++k) {
+        if (selfOverlapping[k]) {
+            job.pairs.emplace_back(entries[instanced[k]].first, entries[instanced[k]].first);
+        }
+    }
+
+    // Exact tests are independent and dominate for detailed polygons
+    std::vector<char> overlapping(candidates.size(), 0);
+    const int candidateCount = static_cast<int>(candidates.size());
+    const int chunks = (candidateCount + EXACT_CHUNK_SIZE - 1) / EXACT_CHUNK_SIZE;
+    parallelFor(chunks, [&](int chunk) {
+        if (job.cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const int end = qMin(candidateCount, (chunk + 1) * EXACT_CHUNK_SIZE);
+        for (int c = chunk * EXACT_CHUNK_SIZE; c < end; ++c) {
+            overlapping[c] = shapesOverlap(entries[candidates[c].first].second,
+                                           entries[candidates[c].second].second);
+        }
+    });
+
+    for (int c = 0; c < candidateCount; ++c) {
+        if (overlapping[c]) {
+            job.pairs.emplace_back(entries[candidates[c].first].first, entries[candidates[c].second].first);
+        }
+    }
+    job.done.store(true, std::memory_order_release);
+}
+
+void OverlapAnalyzer::schedule()
+{
+    if (!m_job && !m_startTimer->isActive()) {
+        m_startTimer->start();
+    }
+}
+
+void OverlapAnalyzer::startJob()
+{
+    if (m_job || (!m_fullPending && m_dirty.isEmpty())) {
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->entries.reserve(m_shapes.size());
+    for (auto it = m_shapes.constBegin(); it != m_shapes.constEnd(); ++it) {
+        job->entries.emplace_back(it.key(), it.value());
+    }
+    job->full = m_fullPending;
+    if (!job->full) {
+        job->dirty = m_dirty;
+    }
+    m_fullPending = false;
+    m_dirty.clear();
+
+    m_job = job;
+    QThreadPool::globalInstance()->start([job]() {
+        run(*job);
+    });
+    m_pollTimer->start();
+}
+
+void OverlapAnalyzer::pollJob()
+{
+    if (!m_job || !m_job->done.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::shared_ptr<Job> job = std::move(m_job);
+    m_pollTimer->stop();
+
+    if (job->full) {
+        m_conflicts.clear();
+    } else {
+        for (Id id : job->dirty) {
+            const QSet<Id> neighbours = m_conflicts.take(id);
+            for (Id other : neighbours) {
+                auto it = m_conflicts.find(other);
+                if (it != m_conflicts.end()) {
+                    it->remove(id);
+                    if (it->isEmpty()) {
+                        m_conflicts.erase(it);
+                    }
+                }
+            }
+        }
+    }
+
+    // Hotspots removed while the job ran are dropped; ones changed meanwhile
+    // are already queued for the next job
+    for (const auto &pair : job->pairs) {
+        if (m_shapes.contains(pair.first) && m_shapes.contains(pair.second)) {
+            m_conflicts[pair.first].insert(pair.second);
+            m_conflicts[pair.second].insert(pair.first);
+        }
+    }
+
+    emit conflictsChanged();
+    startJob();
+}
@@ -0,0 +1,92 @@
+#ifndef OVERLAPANALYZER_H
+#define OVERLAPANALYZER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QPair>
+#include <QPolygonF>
+#include <QRectF>
+#include <QTimer>
+#include <QVector>
+#include <memory>
+#include "HotspotItem.h"
+
+// Finds hotspots whose shapes overlap. Browsers give overlapping <area>
+// elements to whichever comes first in the document, which is rarely what
+// the author intended.
+//
+// Candidate pairs come from a sweep-and-prune pass over the bounding boxes
+// and are confirmed with an exact shape test. The instances of an instanced
+// hotspot are also checked against each other, bucketed into a grid of
+// cells the size of one instance. Work runs on the thread pool:
+// the first pass covers every hotspot, after that only hotspots reported as
+// added, moved or removed are re-checked against their neighbours.
+class OverlapAnalyzer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OverlapAnalyzer(QObject *parent = nullptr);
+    ~OverlapAnalyzer() override;
+
+    // Replaces the tracked hotspots and re-checks all of them
+    void setHotspots(const QList<HotspotItem*> &hotspots);
+
+    // Added or changed geometry; re-checked on the next pass
+    void updateHotspot(HotspotItem *hotspot);
+    void removeHotspot(HotspotItem *hotspot);
+    void clear();
+
+    bool isBusy() const { return m_job != nullptr; }
+
+    QList<QPair<HotspotItem*, HotspotItem*>> conflicts() const;
+    // Other hotspots only; see overlapsItself for instances of one hotspot
+    QList<HotspotItem*> conflictsWith(HotspotItem *hotspot) const;
+    bool overlapsItself(HotspotItem *hotspot) const;
+    bool hasConflicts(HotspotItem *hotspot) const;
+
+signals:
+    void conflictsChanged();
+
+private:
+    using Id = quintptr;
+
+    struct Shape {
+        HotspotShape shape = HotspotShape::Rectangle;
+        QRectF bounds;          // all instances
+        QRectF prototypeBounds;
+        QRectF rect;
+        QPointF center;
+        qreal radius = 0;
+        QPolygonF polygon;
+        QVector<QPointF> offsets; // instance offsets, empty for a plain hotspot
+    };
+    struct Job;
+
+    static Shape snapshot(const HotspotItem *hotspot);
+    static bool shapesOverlap(const Shape &a, const Shape &b);
+    static bool prototypesOverlap(const Shape &a, const Shape &b);
+    static bool instancesOverlap(const Shape &shape);
+    static Shape translated(const Shape &shape, const QPointF &offset);
+    static void run(Job &job);
+
+    void schedule();
+    void startJob();
+    void pollJob();
+
+    QHash<Id, Shape> m_shapes;
+    QHash<Id, QSet<Id>> m_conflicts;    // symmetric; a hotspot lists itself if its instances overlap
+    QSet<Id> m_dirty;
+    bool m_fullPending = false;
+
+    std::shared_ptr<Job> m_job;
+    QTimer *m_startTimer;
+    QTimer *m_pollTimer;
+
+    static constexpr int POLL_INTERVAL_MS = 30;
+    static constexpr int EXACT_CHUNK_SIZE = 512;
+};
+
+#endif // OVERLAPANALYZER_H
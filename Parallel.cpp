@@ -0,0 +1,65 @@
+#include "Parallel.h"
+#include <QThreadPool>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct ParallelState
+{
+    std::function<void(int)> body;
+    int count = 0;
+    std::atomic<int> next{0};
+    int done = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    void work()
+    {
+        int completed = 0;
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            body(i);
+            ++completed;
+        }
+        if (completed > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done += completed;
+            if (done == count) {
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace
+
+void parallelFor(int count, const std::function<void(int)> &body)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int helpers = qMin(count, pool->maxThreadCount()) - 1;
+    if (helpers <= 0) {
+        for (int i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    // Helpers that start late find no work left and only drop their reference
+    auto state = std::make_shared<ParallelState>();
+    state->body = body;
+    state->count = count;
+
+    for (int i = 0; i < helpers; ++i) {
+        pool->start([state]() { state->work(); });
+    }
+    state->work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->done == state->count; });
+}
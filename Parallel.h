@@ -0,0 +1,11 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// Runs body(i) for every i in [0, count) on the global thread pool and waits
+// for all of them. The calling thread takes part in the work, so it is safe to
+// call from inside a pool task without risking starvation.
+void parallelFor(int count, const std::function<void(int)> &body);
+
+#endif // PARALLEL_H
@@ -0,0 +1,479 @@
+#include "PolygonBoolean.h"
+#include "Geometry.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Coordinates are snapped to 1/256 px so intersection points computed from
+// different edges land on the same vertex
+constexpr qreal Quantum = 256.0;
+constexpr qreal SideOffset = 0.25 / Quantum;
+constexpr qreal MinRingArea = 0.25;
+constexpr int ClassifyChunkSize = 1024;
+
+struct Segment {
+    QPointF a;
+    QPointF b;
+};
+
+qreal cross(const QPointF &u, const QPointF &v)
+{
+    return u.x() * v.y() - u.y() * v.x();
+}
+
+qreal dot(const QPointF &u, const QPointF &v)
+{
+    return u.x() * v.x() + u.y() * v.y();
+}
+
+QPair<qint64, qint64> snapKey(const QPointF &p)
+{
+    return qMakePair(static_cast<qint64>(std::llround(p.x() * Quantum)),
+                     static_cast<qint64>(std::llround(p.y() * Quantum)));
+}
+
+QPointF snap(const QPointF &p)
+{
+    const QPair<qint64, qint64> key = snapKey(p);
+    return QPointF(key.first / Quantum, key.second / Quantum);
+}
+
+// Even-odd point-in-polygon over a set of rings, with edges bucketed into
+// horizontal bands so each query only looks at nearby edges
+class RingIndex
+{
+public:
+    explicit RingIndex(const QVector<QPolygonF> &rings)
+    {
+        for (const QPolygonF &ring : rings) {
+            const int n = static_cast<int>(ring.size());
+            for (int i = 0; i < n; ++i) {
+                const QPointF &a = ring.at(i);
+                const QPointF &b = ring.at((i + 1) % n);
+                if (a.y() != b.y()) {
+                    m_edges.push_back({a, b});
+                }
+            }
+        }
+        if (m_edges.empty()) {
+            return;
+        }
+
+        m_minY = m_edges.front().a.y();
+        qreal maxY = m_minY;
+        for (const Segment &e : m_edges) {
+            m_minY = qMin(m_minY, qMin(e.a.y(), e.b.y()));
+            maxY = qMax(maxY, qMax(e.a.y(), e.b.y()));
+        }
+        const int bandCount = qBound(1, static_cast<int>(m_edges.size() / 4), 4096);
+        m_bandHeight = qMax((maxY - m_minY) / bandCount, 1.0 / Quantum);
+        m_bands.resize(bandCount);
+        for (int i = 0; i < static_cast<int>(m_edges.size()); ++i) {
+            const Segment &e = m_edges[i];
+            const int first = band(qMin(e.a.y(), e.b.y()));
+            const int last = band(qMax(e.a.y(), e.b.y()));
+            for (int k = first; k <= last; ++k) {
+                m_bands[k].push_back(i);
+            }
+        }
+    }
+
+    bool contains(const QPointF &p) const
+    {
+        if (m_bands.empty()) {
+            return false;
+        }
+        const qreal offset = p.y() - m_minY;
+        if (offset < 0 || offset > m_bandHeight * m_bands.size()) {
+            return false;
+        }
+
+        bool inside = false;
+        for (int i : m_bands[band(p.y())]) {
+            const Segment &e = m_edges[i];
+            if ((e.a.y() > p.y()) != (e.b.y() > p.y())) {
+                const qreal x = e.a.x() + (p.y() - e.a.y()) * (e.b.x() - e.a.x()) / (e.b.y() - e.a.y());
+                if (p.x() < x) {
+                    inside = !inside;
+                }
+            }
+        }
+        return inside;
+    }
+
+private:
+    int band(qreal y) const
+    {
+        return qBound(0, static_cast<int>((y - m_minY) / m_bandHeight), static_cast<int>(m_bands.size()) - 1);
+    }
+
+    std::vector<Segment> m_edges;
+    std::vector<std::vector<int>> m_bands;
+    qreal m_minY = 0;
+    qreal m_bandHeight = 1;
+};
+
+// Snaps ring vertices and drops repeated points and degenerate rings
+QVector<QPolygonF> cleanRings(const QVector<QPolygonF> &rings)
+{
+    QVector<QPolygonF> result;
+    for (const QPolygonF &ring : rings) {
+        QPolygonF cleaned;
+        cleaned.reserve(ring.size());
+        for (const QPointF &p : ring) {
+            QPointF s = snap(p);
+            if (cleaned.isEmpty() || cleaned.last() != s) {
+                cleaned.append(s);
+            }
+        }
+        while (cleaned.size() > 1 && cleaned.first() == cleaned.last()) {
+            cleaned.removeLast();
+        }
+        if (cleaned.size() >= 3) {
+            result.append(cleaned);
+        }
+    }
+    return result;
+}
+
+// Adds the split parameters where segments s and t touch or cross
+void intersect(const Segment &s, const Segment &t, std::vector<qreal> &splitsS, std::vector<qreal> &splitsT)
+{
+    const QPointF r = s.b - s.a;
+    const QPointF q = t.b - t.a;
+    const QPointF w = t.a - s.a;
+    const qreal denom = cross(r, q);
+    const qreal lenR = std::hypot(r.x(), r.y());
+    const qreal lenQ = std::hypot(q.x(), q.y());
+    if (lenR <= 0 || lenQ <= 0) {
+        return;
+    }
+
+    const qreal eps = 1.0 / Quantum;
+    if (std::abs(denom) > 1e-12 * lenR * lenQ) {
+        const qreal ts = cross(w, q) / denom;
+        const qreal tt = cross(w, r) / denom;
+        const qreal slackS = eps / lenR;
+        const qreal slackT = eps / lenQ;
+        if (ts >= -slackS && ts <= 1 + slackS && tt >= -slackT && tt <= 1 + slackT) {
+            splitsS.push_back(qBound(0.0, ts, 1.0));
+            splitsT.push_back(qBound(0.0, tt, 1.0));
+        }
+        return;
+    }
+
+    // Parallel: only collinear overlaps matter, split each at the other's ends
+    if (std::abs(cross(w, r)) / lenR > eps) {
+        return;
+    }
+    const qreal lenR2 = lenR * lenR;
+    const qreal lenQ2 = lenQ * lenQ;
+    for (const QPointF &p : {t.a, t.b}) {
+        const qreal u = dot(p - s.a, r) / lenR2;
+        if (u > 0 && u < 1) {
+            splitsS.push_back(u);
+        }
+    }
+    for (const QPointF &p : {s.a, s.b}) {
+        const qreal u = dot(p - t.a, q) / lenQ2;
+        if (u > 0 && u < 1) {
+            splitsT.push_back(u);
+        }
+    }
+}
+
+} // namespace
+
+qreal PolygonBoolean::signedArea(const QPolygonF &ring)
+{
+    const int n = static_cast<int>(ring.size());
+    qreal area = 0;
+    for (int i = 0; i < n; ++i) {
+        area += cross(ring.at(i), ring.at((i + 1) % n));
+    }
+    return area / 2;
+}
+
+QVector<QPolygonF> PolygonBoolean::apply(const QVector<QPolygonF> &a, const QVector<QPolygonF> &b,
+                                         Operation operation)
+{
+    TRACE_SCOPE("PolygonBoolean::apply");
+
+    const QVector<QPolygonF> ringsA = cleanRings(a);
+    const QVector<QPolygonF> ringsB = cleanRings(b);
+
+    std::vector<Segment> segments;
+    for (const QVector<QPolygonF> *rings : {&ringsA, &ringsB}) {
+        for (const QPolygonF &ring : *rings) {
+            const int n = static_cast<int>(ring.size());
+            for (int i = 0; i < n; ++i) {
+                segments.push_back({ring.at(i), ring.at((i + 1) % n)});
+            }
+        }
+    }
+    const int segmentCount = static_cast<int>(segments.size());
+    if (segmentCount == 0) {
+        return QVector<QPolygonF>();
+    }
+
+    // Sweep over x to find every touching or crossing pair of segments
+    std::vector<int> order(segmentCount);
+    for (int i = 0; i < segmentCount; ++i) {
+        order[i] = i;
+    }
+    auto minX = [&](int i) { return qMin(segments[i].a.x(), segments[i].b.x()); };
+    auto maxX = [&](int i) { return qMax(segments[i].a.x(), segments[i].b.x()); };
+    std::sort(order.begin(), order.end(), [&](int i, int j) { return minX(i) < minX(j); });
+
+    const qreal eps = 1.0 / Quantum;
+    std::vector<std::vector<qreal>> splits(segmentCount);
+    std::vector<int> active;
+    for (int i : order) {
+        const qreal left = minX(i);
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int j) {
+            return maxX(j) < left - eps;
+        }), active.end());
+
+        const qreal top = qMin(segments[i].a.y(), segments[i].b.y());
+        const qreal bottom = qMax(segments[i].a.y(), segments[i].b.y());
+        for (int j : active) {
+            if (qMax(segments[j].a.y(), segments[j].b.y()) < top - eps
+                || qMin(segments[j].a.y(), segments[j].b.y()) > bottom + eps) {
+                continue;
+            }
+            intersect(segments[i], segments[j], splits[i], splits[j]);
+        }
+        active.push_back(i);
+    }
+
+    // Split into a planar graph with shared vertices and unique edges
+    QHash<QPair<qint64, qint64>, int> vertexIds;
+    QVector<QPointF> vertices;
+    auto vertexFor = [&](const QPointF &p) {
+        const QPair<qint64, qint64> key = snapKey(p);
+        auto it = vertexIds.constFind(key);
+        if (it != vertexIds.constEnd()) {
+            return it.value();
+        }
+        const int id = static_cast<int>(vertices.size());
+        vertices.append(QPointF(key.first / Quantum, key.second / Quantum));
+        vertexIds.insert(key, id);
+        return id;
+    };
+
+    QSet<quint64> edgeKeys;
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < segmentCount; ++i) {
+        std::vector<qreal> &params = splits[i];
+        params.push_back(0);
+        params.push_back(1);
+        std::sort(params.begin(), params.end());
+
+        const Segment &s = segments[i];
+        int previous = -1;
+        for (qreal t : params) {
+            const int v = vertexFor(s.a + (s.b - s.a) * t);
+            if (previous >= 0 && v != previous) {
+                const quint64 key = (static_cast<quint64>(qMin(previous, v)) << 32) | static_cast<quint32>(qMax(previous, v));
+                if (!edgeKeys.contains(key)) {
+                    edgeKeys.insert(key);
+                    edges.emplace_back(previous, v);
+                }
+            }
+            previous = v;
+        }
+    }
+
+    // Keep the edges with result on exactly one side, directed so the
+    // result lies on their left
+    const RingIndex indexA(ringsA);
+    const RingIndex indexB(ringsB);
+    auto inResult = [operation](bool inA, bool inB) {
+        switch (operation) {
+        case Operation::Union: return inA || inB;
+        case Operation::Intersection: return inA && inB;
+        case Operation::Difference: return inA && !inB;
+        }
+        return false;
+    };
+
+    const int edgeCount = static_cast<int>(edges.size());
+    std::vector<signed char> direction(edgeCount, 0);
+    const int chunks = (edgeCount + ClassifyChunkSize - 1) / ClassifyChunkSize;
+    parallelFor(chunks, [&](int chunk) {
+        const int end = qMin(edgeCount, (chunk + 1) * ClassifyChunkSize);
+        for (int e = chunk * ClassifyChunkSize; e < end; ++e) {
+            const QPointF p1 = vertices.at(edges[e].first);
+            const QPointF p2 = vertices.at(edges[e].second);
+            const QPointF d = p2 - p1;
+            const qreal length = std::hypot(d.x(), d.y());
+            const QPointF normal(-d.y() / length * SideOffset, d.x() / length * SideOffset);
+            const QPointF mid = (p1 + p2) / 2;
+            const bool left = inResult(indexA.contains(mid + normal), indexB.contains(mid + normal));
+            const bool right = inResult(indexA.contains(mid - normal), indexB.contains(mid - normal));
+            if (left != right) {
+                direction[e] = left ? 1 : -1;
+            }
+        }
+    });
+
+    std::vector<std::pair<int, int>> directed;
+    std::vector<std::vector<int>> outgoing(vertices.size());
+    for (int e = 0; e < edgeCount; ++e) {
+        if (direction[e] == 0) {
+            continue;
+        }
+        std::pair<int, int> edge = edges[e];
+        if (direction[e] < 0) {
+            std::swap(edge.first, edge.second);
+        }
+        outgoing[edge.first].push_back(static_cast<int>(directed.size()));
+        directed.push_back(edge);
+    }
+
+    // Chain edges into rings. Where several rings touch at a vertex, take
+    // the first outgoing edge clockwise from the way back, which keeps
+    // following the boundary of the same piece of the result.
+    QVector<QPolygonF> result;
+    std::vector<bool> used(directed.size(), false);
+    for (int start = 0; start < static_cast<int>(directed.size()); ++start) {
+        if (used[start]) {
+            continue;
+        }
+        QPolygonF ring;
+        int current = start;
+        while (current >= 0 && !used[current]) {
+            used[current] = true;
+            const int from = directed[current].first;
+            const int to = directed[current].second;
+            ring.append(vertices.at(from));
+
+            const QPointF back = vertices.at(from) - vertices.at(to);
+            int next = -1;
+            qreal bestAngle = 0;
+            for (int candidate : outgoing[to]) {
+                if (used[candidate] && candidate != start) {
+                    continue;
+                }
+                const QPointF dir = vertices.at(directed[candidate].second) - vertices.at(to);
+                qreal angle = -std::atan2(cross(back, dir), dot(back, dir));
+                if (angle <= 0) {
+                    angle += 2 * M_PI;
+                }
+                if (next < 0 || angle < bestAngle) {
+                    next = candidate;
+                    bestAngle = angle;
+                }
+            }
+            current = next == start ? -1 : next;
+        }
+        if (ring.size() >= 3 && std::abs(signedArea(ring)) >= MinRingArea) {
+            result.append(ring);
+        }
+    }
+    return result;
+}
+
+QVector<QPolygonF> PolygonBoolean::toAreaPolygons(const QVector<QPolygonF> &rings, qreal tolerance)
+{
+    QVector<QPolygonF> outlines;
+    QVector<QPolygonF> holes;
+    for (const QPolygonF &ring : rings) {
+        QPolygonF simplified = Geometry::simplifyPolygon(ring, tolerance);
+        if (simplified.size() < 3) {
+            continue;
+        }
+        if (signedArea(simplified) > 0) {
+            outlines.append(simplified);
+        } else {
+            holes.append(simplified);
+        }
+    }
+
+    // Attach each hole to the smallest outline containing it
+    QVector<QVector<QPolygonF>> holesOf(outlines.size());
+    for (const QPolygonF &hole : holes) {
+        int owner = -1;
+        qreal ownerArea = 0;
+        for (int i = 0; i < outlines.size(); ++i) {
+            const qreal area = signedArea(outlines.at(i));
+            if (outlines.at(i).containsPoint(hole.first(), Qt::OddEvenFill) && (owner < 0 || area < ownerArea)) {
+                owner = i;
+                ownerArea = area;
+            }
+        }
+        if (owner >= 0) {
+            holesOf[owner].append(hole);
+        }
+    }
+
+    for (int i = 0; i < outlines.size(); ++i) {
+        QVector<QPolygonF> &ownHoles = holesOf[i];
+        auto rightmost = [](const QPolygonF &ring) {
+            int best = 0;
+            for (int k = 1; k < ring.size(); ++k) {
+                if (ring.at(k).x() > ring.at(best).x()) {
+                    best = k;
+                }
+            }
+            return best;
+        };
+        // Rightmost holes first, so each bridge only has to reach the outline
+        // or a hole that is already part of it
+        std::sort(ownHoles.begin(), ownHoles.end(), [&](const QPolygonF &h1, const QPolygonF &h2) {
+            return h1.at(rightmost(h1)).x() > h2.at(rightmost(h2)).x();
+        });
+
+        QPolygonF &outline = outlines[i];
+        for (const QPolygonF &hole : ownHoles) {
+            const int m = rightmost(hole);
+            const QPointF start = hole.at(m);
+
+            // Cast a ray to the right and bridge to where it first hits the
+            // outline; nothing lies between the two ends of that segment
+            int edge = -1;
+            qreal nearest = 0;
+            const int n = static_cast<int>(outline.size());
+            for (int k = 0; k < n; ++k) {
+                const QPointF &p = outline.at(k);
+                const QPointF &q = outline.at((k + 1) % n);
+                if ((p.y() > start.y()) == (q.y() > start.y())) {
+                    continue;
+                }
+                const qreal x = p.x() + (start.y() - p.y()) * (q.x() - p.x()) / (q.y() - p.y());
+                if (x >= start.x() && (edge < 0 || x < nearest)) {
+                    nearest = x;
+                    edge = k;
+                }
+            }
+            if (edge < 0) {
+                continue;
+            }
+            const QPointF hit(nearest, start.y());
+
+            QPolygonF joined;
+            joined.reserve(outline.size() + hole.size() + 3);
+            for (int k = 0; k <= edge; ++k) {
+                joined.append(outline.at(k));
+            }
+            joined.append(hit);
+            for (int k = 0; k <= hole.size(); ++k) {
+                joined.append(hole.at((m + k) % hole.size()));
+            }
+            joined.append(hit);
+            for (int k = edge + 1; k < n; ++k) {
+                joined.append(outline.at(k));
+            }
+            outline = joined;
+        }
+    }
+    return outlines;
+}
@@ -0,0 +1,37 @@
+#ifndef POLYGONBOOLEAN_H
+#define POLYGONBOOLEAN_H
+
+#include <QPolygonF>
+#include <QVector>
+
+// Union, intersection and difference of polygon sets. Each set is a list of
+// rings filled with the even-odd rule, so self-intersecting input is fine.
+//
+// All edges of both sets are split at their intersections (found with a
+// sweep over x) into a planar graph, every edge is classified by testing the
+// points just left and right of it against both sets with a banded
+// point-in-polygon index, and the edges separating result from non-result
+// are chained back into rings. This stays fast on outlines with many
+// thousands of vertices, where QPainterPath set operations do not.
+class PolygonBoolean
+{
+public:
+    enum class Operation {
+        Union,
+        Intersection,
+        Difference // a minus b
+    };
+
+    // Result rings: outlines have positive signed area, holes negative
+    static QVector<QPolygonF> apply(const QVector<QPolygonF> &a, const QVector<QPolygonF> &b,
+                                    Operation operation);
+
+    // Turns result rings into hole-free polygons for poly coords. Each ring is
+    // simplified to within tolerance, then each hole is joined to its outline
+    // with a zero-width bridge so it stays outside the clickable area.
+    static QVector<QPolygonF> toAreaPolygons(const QVector<QPolygonF> &rings, qreal tolerance);
+
+    static qreal signedArea(const QPolygonF &ring);
+};
+
+#endif // POLYGONBOOLEAN_H
@@ -0,0 +1,230 @@
+#include "ProjectFile.h"
+#include "HotspotItem.h"
+#include "MapArea.h"
+
+namespace ProjectFile {
+
+QJsonObject hotspotToJson(const HotspotItem *hotspot)
+{
+    QJsonObject h;
+    h["shape"] = static_cast<int>(hotspot->hotspotShape());
+    h["url"] = hotspot->url();
+    h["alt"] = hotspot->altText();
+    h["title"] = hotspot->title();
+    h["posX"] = hotspot->pos().x();
+    h["posY"] = hotspot->pos().y();
+
+    switch (hotspot->hotspotShape()) {
+    case HotspotShape::Rectangle: {
+        QRectF r = hotspot->rect();
+        h["x"] = r.x();
+        h["y"] = r.y();
+        h["width"] = r.width();
+        h["height"] = r.height();
+        break;
+    }
+    case HotspotShape::Circle: {
+        h["centerX"] = hotspot->center().x();
+        h["centerY"] = hotspot->center().y();
+        h["radius"] = hotspot->radius();
+        break;
+    }
+    case HotspotShape::Polygon: {
+        QJsonArray points;
+        for (const QPointF &pt : hotspot->polygon()) {
+            QJsonObject p;
+            p["x"] = pt.x();
+            p["y"] = pt.y();
+            points.append(p);
+        }
+        h["points"] = points;
+        break;
+    }
+    }
+
+    // Flat [dx, dy, row, col, ...] keeps large seat maps compact
+    if (hotspot->isInstanced()) {
+        QJsonArray instances;
+        for (const HotspotItem::Instance &instance : hotspot->instances()) {
+            instances.append(instance.offset.x());
+            instances.append(instance.offset.y());
+            instances.append(instance.row);
+            instances.append(instance.column);
+        }
+        h["instances"] = instances;
+    }
+
+    return h;
+}
+
+HotspotItem *hotspotFromJson(const QJsonObject &h)
+{
+    HotspotShape shape = static_cast<HotspotShape>(h["shape"].toInt());
+
+    HotspotItem *hotspot = new HotspotItem(shape);
+    hotspot->setUrl(h["url"].toString());
+    hotspot->setAltText(h["alt"].toString());
+    hotspot->setTitle(h["title"].toString());
+    hotspot->setPos(h["posX"].toDouble(), h["posY"].toDouble());
+
+    switch (shape) {
+    case HotspotShape::Rectangle: {
+        QRectF r(h["x"].toDouble(), h["y"].toDouble(),
+                 h["width"].toDouble(), h["height"].toDouble());
+        hotspot->setRect(r);
+        break;
+    }
+    case HotspotShape::Circle: {
+        hotspot->setCenter(QPointF(h["centerX"].toDouble(), h["centerY"].toDouble()));
+        hotspot->setRadius(h["radius"].toDouble());
+        break;
+    }
+    case HotspotShape::Polygon: {
+        QJsonArray points = h["points"].toArray();
+        QPolygonF polygon;
+        polygon.reserve(points.size());
+        for (const QJsonValue &pv : points) {
+            QJsonObject p = pv.toObject();
+            polygon.append(QPointF(p["x"].toDouble(), p["y"].toDouble()));
+        }
+        hotspot->setPolygon(polygon);
+        hotspot->closePolygon();
+        break;
+    }
+    }
+
+    const QJsonArray instances = h["instances"].toArray();
+    if (instances.size() >= 4) {
+        QVector<HotspotItem::Instance> list;
+        list.reserve(instances.size() / 4);
+        for (int i = 0; i + 3 < instances.size(); i += 4) {
+            HotspotItem::Instance instance;
+            instance.offset = QPointF(instances.at(i).toDouble(), instances.at(i + 1).toDouble());
+            instance.row = instances.at(i + 2).toInt();
+            instance.column = instances.at(i + 3).toInt();
+            list.append(instance);
+        }
+        hotspot->setInstances(list);
+    }
+
+    return hotspot;
+}
+
+QJsonArray hotspotsToJson(const QList<HotspotItem*> &hotspots)
+{
+    QJsonArray array;
+    for (const HotspotItem *hotspot : hotspots) {
+        array.append(hotspotToJson(hotspot));
+    }
+    return array;
+}
+
+QList<HotspotItem*> hotspotsFromJson(const QJsonArray &array)
+{
+    QList<HotspotItem*> hotspots;
+    hotspots.reserve(array.size());
+    for (const QJsonValue &val : array) {
+        hotspots.append(hotspotFromJson(val.toObject()));
+    }
+    return hotspots;
+}
+
+QJsonObject areaToJson(const MapArea &area)
+{
+    QJsonObject h;
+    h["shape"] = static_cast<int>(area.shape);
+    h["url"] = area.url;
+    h["alt"] = area.altText;
+    h["title"] = area.title;
+    h["posX"] = 0.0;
+    h["posY"] = 0.0;
+
+    switch (area.shape) {
+    case HotspotShape::Rectangle:
+        h["x"] = area.rect.x();
+        h["y"] = area.rect.y();
+        h["width"] = area.rect.width();
+        h["height"] = area.rect.height();
+        break;
+    case HotspotShape::Circle:
+        h["centerX"] = area.center.x();
+        h["centerY"] = area.center.y();
+        h["radius"] = area.radius;
+        break;
+    case HotspotShape::Polygon: {
+        QJsonArray points;
+        for (const QPointF &pt : area.polygon) {
+            QJsonObject p;
+            p["x"] = pt.x();
+            p["y"] = pt.y();
+            points.append(p);
+        }
+        h["points"] = points;
+        break;
+    }
+    }
+
+    return h;
+}
+
+QVector<MapArea> areasFromJson(const QJsonArray &array)
+{
+    QVector<MapArea> areas;
+    areas.reserve(array.size());
+    for (const QJsonValue &value : array) {
+        const QJsonObject h = value.toObject();
+
+        MapArea prototype;
+        prototype.shape = static_cast<HotspotShape>(h["shape"].toInt());
+        switch (prototype.shape) {
+        case HotspotShape::Rectangle:
+            prototype.rect = QRectF(h["x"].toDouble(), h["y"].toDouble(), h["width"].toDouble(), h["height"].toDouble());
+            break;
+        case HotspotShape::Circle:
+            prototype.center = QPointF(h["centerX"].toDouble(), h["centerY"].toDouble());
+            prototype.radius = h["radius"].toDouble();
+            break;
+        case HotspotShape::Polygon:
+            for (const QJsonValue &pv : h["points"].toArray()) {
+                const QJsonObject p = pv.toObject();
+                prototype.polygon.append(QPointF(p["x"].toDouble(), p["y"].toDouble()));
+            }
+            break;
+        }
+
+        const QString url = h["url"].toString();
+        const QString alt = h["alt"].toString();
+        const QString title = h["title"].toString();
+        const QPointF pos(h["posX"].toDouble(), h["posY"].toDouble());
+
+        // A plain hotspot is a single instance at offset 0
+        QVector<HotspotItem::Instance> instances;
+        const QJsonArray flat = h["instances"].toArray();
+        for (int i = 0; i + 3 < flat.size(); i += 4) {
+            HotspotItem::Instance instance;
+            instance.offset = QPointF(flat.at(i).toDouble(), flat.at(i + 1).toDouble());
+            instance.row = flat.at(i + 2).toInt();
+            instance.column = flat.at(i + 3).toInt();
+            instances.append(instance);
+        }
+        const bool instanced = !instances.isEmpty();
+        if (!instanced) {
+            instances.append(HotspotItem::Instance());
+        }
+
+        for (int i = 0; i < instances.size(); ++i) {
+            const QPointF offset = pos + instances.at(i).offset;
+            MapArea area = prototype;
+            area.rect.translate(offset);
+            area.center += offset;
+            area.polygon.translate(offset);
+            area.url = instanced ? HotspotItem::expandTemplate(url, instances.at(i), i) : url;
+            area.altText = instanced ? HotspotItem::expandTemplate(alt, instances.at(i), i) : alt;
+            area.title = instanced ? HotspotItem::expandTemplate(title, instances.at(i), i) : title;
+            areas.append(area);
+        }
+    }
+    return areas;
+}
+
+} // namespace ProjectFile
@@ -0,0 +1,29 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QList>
+#include <QVector>
+
+class HotspotItem;
+struct MapArea;
+
+// JSON (de)serialization of hotspots as stored in .imap project files
+namespace ProjectFile {
+
+QJsonObject hotspotToJson(const HotspotItem *hotspot);
+HotspotItem *hotspotFromJson(const QJsonObject &object);
+
+QJsonArray hotspotsToJson(const QList<HotspotItem*> &hotspots);
+QList<HotspotItem*> hotspotsFromJson(const QJsonArray &array);
+
+// Hotspot JSON straight from an area, for building projects off the GUI thread
+QJsonObject areaToJson(const MapArea &area);
+// Areas of stored hotspots in image pixels, one per instance, as the editor
+// would export them without Screen Standard scaling
+QVector<MapArea> areasFromJson(const QJsonArray &array);
+
+} // namespace ProjectFile
+
+#endif // PROJECTFILE_H
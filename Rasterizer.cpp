@@ -0,0 +1,120 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// First pixel whose centre is at or after coordinate v
+inline int firstCentreAtOrAfter(qreal v)
+{
+    return static_cast<int>(std::ceil(v - 0.5));
+}
+
+inline void emitSpan(int y, qreal left, qreal right, const QRect &clip, const Rasterizer::SpanFunction &span)
+{
+    const int x0 = qMax(firstCentreAtOrAfter(left), clip.left());
+    const int x1 = qMin(firstCentreAtOrAfter(right), clip.right() + 1);
+    if (x0 < x1) {
+        span(y, x0, x1);
+    }
+}
+
+} // namespace
+
+namespace Rasterizer {
+
+void fillRect(const QRectF &rect, const QRect &clip, const SpanFunction &span)
+{
+    const QRectF r = rect.normalized();
+    const int y0 = qMax(firstCentreAtOrAfter(r.top()), clip.top());
+    const int y1 = qMin(firstCentreAtOrAfter(r.bottom()), clip.bottom() + 1);
+    for (int y = y0; y < y1; ++y) {
+        emitSpan(y, r.left(), r.right(), clip, span);
+    }
+}
+
+void fillCircle(const QPointF &center, qreal radius, const QRect &clip, const SpanFunction &span)
+{
+    const int y0 = qMax(firstCentreAtOrAfter(center.y() - radius), clip.top());
+    const int y1 = qMin(firstCentreAtOrAfter(center.y() + radius), clip.bottom() + 1);
+    for (int y = y0; y < y1; ++y) {
+        const qreal dy = y + 0.5 - center.y();
+        const qreal half = std::sqrt(qMax(qreal(0), radius * radius - dy * dy));
+        emitSpan(y, center.x() - half, center.x() + half, clip, span);
+    }
+}
+
+void fillPolygon(const QPolygonF &polygon, const QRect &clip, const SpanFunction &span)
+{
+    struct Edge {
+        int firstRow;
+        int endRow; // exclusive
+        qreal x;    // at the centre of firstRow
+        qreal slope;
+    };
+
+    // Edge table sorted by first row; horizontal edges never cross a centre
+    std::vector<Edge> edges;
+    edges.reserve(polygon.size());
+    for (int i = 0; i < polygon.size(); ++i) {
+        QPointF a = polygon.at(i);
+        QPointF b = polygon.at((i + 1) % polygon.size());
+        if (a.y() > b.y()) {
+            std::swap(a, b);
+        }
+        const int firstRow = firstCentreAtOrAfter(a.y());
+        const int endRow = firstCentreAtOrAfter(b.y());
+        if (firstRow >= endRow || endRow <= clip.top() || firstRow > clip.bottom()) {
+            continue;
+        }
+        const qreal slope = (b.x() - a.x()) / (b.y() - a.y());
+        edges.push_back({firstRow, endRow, a.x() + (firstRow + 0.5 - a.y()) * slope, slope});
+    }
+    if (edges.empty()) {
+        return;
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.firstRow < b.firstRow; });
+
+    // Active edge list, stepped one row at a time
+    std::vector<Edge> active;
+    std::vector<qreal> crossings;
+    size_t next = 0;
+    int y = qMax(edges.front().firstRow, clip.top());
+    const int lastRow = clip.bottom();
+
+    while (y <= lastRow && (next < edges.size() || !active.empty())) {
+        while (next < edges.size() && edges[next].firstRow <= y) {
+            // Edges starting above the clip join already advanced to the current row
+            Edge edge = edges[next++];
+            edge.x += (y - edge.firstRow) * edge.slope;
+            active.push_back(edge);
+        }
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [y](const Edge &edge) { return edge.endRow <= y; }),
+                     active.end());
+        if (active.empty()) {
+            if (next >= edges.size()) {
+                break;
+            }
+            y = qMax(y + 1, edges[next].firstRow);
+            continue;
+        }
+
+        crossings.clear();
+        for (const Edge &edge : active) {
+            crossings.push_back(edge.x);
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            emitSpan(y, crossings[i], crossings[i + 1], clip, span);
+        }
+
+        for (Edge &edge : active) {
+            edge.x += edge.slope;
+        }
+        ++y;
+    }
+}
+
+} // namespace Rasterizer
@@ -0,0 +1,24 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <QPolygonF>
+#include <QRect>
+#include <QRectF>
+#include <functional>
+
+// Scanline filling of hotspot shapes into pixel spans. A pixel is covered
+// when its centre lies inside the shape, so shapes that share an edge never
+// both cover the same pixel. Polygons use the even-odd rule, like the
+// <area> hit test in most browsers.
+namespace Rasterizer {
+
+// Receives covered pixels x0 <= x < x1 of row y; rows arrive top to bottom
+using SpanFunction = std::function<void(int y, int x0, int x1)>;
+
+void fillRect(const QRectF &rect, const QRect &clip, const SpanFunction &span);
+void fillCircle(const QPointF &center, qreal radius, const QRect &clip, const SpanFunction &span);
+void fillPolygon(const QPolygonF &polygon, const QRect &clip, const SpanFunction &span);
+
+} // namespace Rasterizer
+
+#endif // RASTERIZER_H
@@ -0,0 +1,408 @@
+#include "RegionDetector.h"
+#include "Geometry.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace {
+
+const int kBandHeight = 64;
+
+// Neighbour offsets, clockwise starting west
+const int kDx[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+const int kDy[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+int findRoot(std::vector<int> &parent, int label)
+{
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// Keeps the smaller label as root so roots are always seen first in a scan
+void unite(std::vector<int> &parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+// Moore-neighbour tracing with Jacob's stopping criterion
+template <typename InRegion>
+QPolygonF traceBoundary(int width, int height, const QPoint &start, InRegion inRegion)
+{
+    // Direction index of a neighbour from its offset, [dy + 1][dx + 1]
+    static const int dirFromDelta[3][3] = { {1, 2, 3}, {0, -1, 4}, {7, 6, 5} };
+
+    QPolygonF contour;
+    contour.append(QPointF(start.x() + 0.5, start.y() + 0.5));
+
+    QPoint p = start;
+    int backtrack = 0; // west of the first pixel is outside the region
+    int firstMove = -1;
+    // Every boundary pixel is left at most once per direction
+    const qint64 maxSteps = 8LL * width * height + 16;
+
+    for (qint64 step = 0; step < maxSteps; ++step) {
+        int found = -1;
+        for (int k = 1; k <= 8; ++k) {
+            int d = (backtrack + k) & 7;
+            int x = p.x() + kDx[d];
+            int y = p.y() + kDy[d];
+            if (x >= 0 && y >= 0 && x < width && y < height && inRegion(x, y)) {
+                found = d;
+                break;
+            }
+        }
+        if (found < 0) {
+            break; // single pixel
+        }
+
+        // Jacob's criterion: done once the first move out of start repeats.
+        // Checking only for a return to start misses starts that are
+        // re-entered from another side, such as a diagonal-only start.
+        if (p == start) {
+            if (firstMove < 0) {
+                firstMove = found;
+            } else if (found == firstMove) {
+                break;
+            }
+        }
+
+        // The last neighbour examined before the hit is outside the region
+        int previous = (found + 7) & 7;
+        QPoint outside(p.x() + kDx[previous], p.y() + kDy[previous]);
+        p = QPoint(p.x() + kDx[found], p.y() + kDy[found]);
+        backtrack = dirFromDelta[outside.y() - p.y() + 1][outside.x() - p.x() + 1];
+        contour.append(QPointF(p.x() + 0.5, p.y() + 0.5));
+    }
+
+    // The last move led back into start, which is already the first point
+    if (contour.size() > 1 && contour.last() == contour.first()) {
+        contour.removeLast();
+    }
+    return contour;
+}
+
+int otsuThreshold(const std::array<qint64, 256> &histogram)
+{
+    qint64 total = 0;
+    double sum = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += histogram[i];
+        sum += static_cast<double>(i) * histogram[i];
+    }
+    if (total == 0) {
+        return 127;
+    }
+
+    double sumBackground = 0;
+    qint64 weightBackground = 0;
+    double bestVariance = -1;
+    int best = 127;
+
+    for (int t = 0; t < 256; ++t) {
+        weightBackground += histogram[t];
+        if (weightBackground == 0) {
+            continue;
+        }
+        qint64 weightForeground = total - weightBackground;
+        if (weightForeground == 0) {
+            break;
+        }
+        sumBackground += static_cast<double>(t) * histogram[t];
+        double meanBackground = sumBackground / weightBackground;
+        double meanForeground = (sum - sumBackground) / weightForeground;
+        double diff = meanBackground - meanForeground;
+        double variance = static_cast<double>(weightBackground) * weightForeground * diff * diff;
+        if (variance > bestVariance) {
+            bestVariance = variance;
+            best = t;
+        }
+    }
+    return best;
+}
+
+struct BandLabels
+{
+    int y0 = 0;
+    int y1 = 0;
+    int count = 0;
+    std::vector<int> area;       // per local label (1-based)
+    std::vector<qint64> first;   // raster index of each local label's first pixel
+};
+
+} // namespace
+
+QPolygonF RegionDetector::traceContour(const quint8 *mask, int width, int height, const QPoint &start)
+{
+    return traceBoundary(width, height, start, [mask, width](int x, int y) {
+        return mask[static_cast<size_t>(y) * width + x] != 0;
+    });
+}
+
+QPolygonF RegionDetector::traceContour(int width, int height, const QPoint &start,
+                                       const std::function<bool(int, int)> &inRegion)
+{
+    return traceBoundary(width, height, start, inRegion);
+}
+
+QVector<QPolygonF> RegionDetector::detect(const QImage &source, const Options &options, Progress *progress)
+{
+    TRACE_SCOPE("RegionDetector::detect");
+
+    auto cancelled = [progress]() {
+        return progress && progress->cancelled.load(std::memory_order_relaxed);
+    };
+
+    QVector<QPolygonF> regions;
+    if (source.isNull()) {
+        return regions;
+    }
+
+    QImage image = source;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32
+        && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    const qreal scale = qMin(1.0, static_cast<qreal>(options.maxWorkingSize) / qMax(image.width(), image.height()));
+    const int width = qMax(1, qRound(image.width() * scale));
+    const int height = qMax(1, qRound(image.height() * scale));
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+
+    std::vector<int> sourceX(width);
+    for (int x = 0; x < width; ++x) {
+        sourceX[x] = qMin(image.width() - 1, static_cast<int>((x + 0.5) / scale));
+    }
+
+    std::vector<BandLabels> bands((height + kBandHeight - 1) / kBandHeight);
+    const int bandCount = static_cast<int>(bands.size());
+    for (int b = 0; b < bandCount; ++b) {
+        bands[b].y0 = b * kBandHeight;
+        bands[b].y1 = qMin(height, bands[b].y0 + kBandHeight);
+    }
+
+    // Sample luminance at the working resolution; 0xFFFF marks transparent pixels
+    std::vector<quint16> luma(pixelCount);
+    std::vector<std::array<qint64, 256>> histograms(bandCount);
+    parallelFor(bandCount, [&](int b) {
+        std::array<qint64, 256> &histogram = histograms[b];
+        histogram.fill(0);
+        for (int y = bands[b].y0; y < bands[b].y1; ++y) {
+            int sy = qMin(image.height() - 1, static_cast<int>((y + 0.5) / scale));
+            const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(sy));
+            quint16 *out = luma.data() + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; ++x) {
+                QRgb pixel = line[sourceX[x]];
+                if (image.hasAlphaChannel() && qAlpha(pixel) < 128) {
+                    out[x] = 0xFFFF;
+                } else {
+                    int gray = qGray(pixel);
+                    out[x] = static_cast<quint16>(gray);
+                    ++histogram[gray];
+                }
+            }
+        }
+    });
+
+    if (cancelled()) {
+        return regions;
+    }
+
+    int threshold = options.threshold;
+    if (threshold < 0) {
+        std::array<qint64, 256> histogram{};
+        for (const auto &bandHistogram : histograms) {
+            for (int i = 0; i < 256; ++i) {
+                histogram[i] += bandHistogram[i];
+            }
+        }
+        threshold = otsuThreshold(histogram);
+    }
+
+    // Whichever side of the threshold dominates the image border is background
+    qint64 borderDark = 0;
+    qint64 borderLight = 0;
+    auto countBorder = [&](int x, int y) {
+        quint16 v = luma[static_cast<size_t>(y) * width + x];
+        if (v == 0xFFFF) return;
+        if (v <= threshold) ++borderDark; else ++borderLight;
+    };
+    for (int x = 0; x < width; ++x) {
+        countBorder(x, 0);
+        countBorder(x, height - 1);
+    }
+    for (int y = 0; y < height; ++y) {
+        countBorder(0, y);
+        countBorder(width - 1, y);
+    }
+    const bool darkForeground = borderLight >= borderDark;
+
+    // Threshold and label each band independently
+    std::vector<qint32> labels(pixelCount, 0);
+    parallelFor(bandCount, [&](int b) {
+        BandLabels &band = bands[b];
+        std::vector<int> parent(1, 0);
+
+        for (int y = band.y0; y < band.y1; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t index = static_cast<size_t>(y) * width + x;
+                quint16 v = luma[index];
+                bool foreground = v != 0xFFFF && (darkForeground ? v <= threshold : v > threshold);
+                if (!foreground) {
+                    continue;
+                }
+
+                int label = 0;
+                auto consider = [&](qint32 neighbour) {
+                    if (neighbour == 0) return;
+                    if (label == 0) label = neighbour;
+                    else if (neighbour != label) unite(parent, label, neighbour);
+                };
+                if (x > 0) consider(labels[index - 1]);
+                if (y > band.y0) {
+                    if (x > 0) consider(labels[index - width - 1]);
+                    consider(labels[index - width]);
+                    if (x + 1 < width) consider(labels[index - width + 1]);
+                }
+                if (label == 0) {
+                    label = static_cast<int>(parent.size());
+                    parent.push_back(label);
+                }
+                labels[index] = label;
+            }
+        }
+
+        std::vector<int> compact(parent.size(), 0);
+        for (size_t i = 1; i < parent.size(); ++i) {
+            int root = findRoot(parent, static_cast<int>(i));
+            if (compact[root] == 0) {
+                compact[root] = ++band.count;
+            }
+            compact[i] = compact[root];
+        }
+
+        band.area.assign(band.count + 1, 0);
+        band.first.assign(band.count + 1, -1);
+        for (int y = band.y0; y < band.y1; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t index = static_cast<size_t>(y) * width + x;
+                if (labels[index] == 0) continue;
+                int local = compact[labels[index]];
+                labels[index] = local;
+                if (band.first[local] < 0) band.first[local] = static_cast<qint64>(index);
+                ++band.area[local];
+            }
+        }
+    });
+
+    if (cancelled()) {
+        return regions;
+    }
+
+    // Merge components that continue across band boundaries
+    std::vector<int> offsets(bandCount, 0);
+    int totalLabels = 0;
+    for (int b = 0; b < bandCount; ++b) {
+        offsets[b] = totalLabels;
+        totalLabels += bands[b].count;
+    }
+
+    std::vector<int> parent(totalLabels + 1);
+    for (int i = 0; i <= totalLabels; ++i) {
+        parent[i] = i;
+    }
+    for (int b = 1; b < bandCount; ++b) {
+        const int y = bands[b].y0;
+        for (int x = 0; x < width; ++x) {
+            qint32 label = labels[static_cast<size_t>(y) * width + x];
+            if (label == 0) continue;
+            for (int dx = -1; dx <= 1; ++dx) {
+                int ux = x + dx;
+                if (ux < 0 || ux >= width) continue;
+                qint32 above = labels[static_cast<size_t>(y - 1) * width + ux];
+                if (above != 0) {
+                    unite(parent, offsets[b] + label, offsets[b - 1] + above);
+                }
+            }
+        }
+    }
+
+    std::vector<int> finalId(totalLabels + 1, 0);
+    int componentCount = 0;
+    for (int i = 1; i <= totalLabels; ++i) {
+        int root = findRoot(parent, i);
+        if (finalId[root] == 0) {
+            finalId[root] = ++componentCount;
+        }
+        finalId[i] = finalId[root];
+    }
+
+    std::vector<qint64> area(componentCount + 1, 0);
+    std::vector<qint64> first(componentCount + 1, -1);
+    for (int b = 0; b < bandCount; ++b) {
+        for (int local = 1; local <= bands[b].count; ++local) {
+            int id = finalId[offsets[b] + local];
+            area[id] += bands[b].area[local];
+            if (first[id] < 0) {
+                first[id] = bands[b].first[local]; // bands are visited top to bottom
+            }
+        }
+    }
+
+    parallelFor(bandCount, [&](int b) {
+        const size_t begin = static_cast<size_t>(bands[b].y0) * width;
+        const size_t end = static_cast<size_t>(bands[b].y1) * width;
+        for (size_t index = begin; index < end; ++index) {
+            if (labels[index] != 0) {
+                labels[index] = finalId[offsets[b] + labels[index]];
+            }
+        }
+    });
+
+    // Trace and simplify every sufficiently large component
+    const qreal minWorkingArea = qMax<qreal>(1.0, options.minArea * scale * scale);
+    std::vector<int> kept;
+    for (int id = 1; id <= componentCount; ++id) {
+        if (area[id] >= minWorkingArea) {
+            kept.push_back(id);
+        }
+    }
+    std::sort(kept.begin(), kept.end(), [&first](int a, int b) { return first[a] < first[b]; });
+
+    std::vector<QPolygonF> traced(kept.size());
+    parallelFor(static_cast<int>(kept.size()), [&](int i) {
+        if (cancelled()) {
+            return;
+        }
+        const qint32 id = kept[i];
+        QPoint start(static_cast<int>(first[id] % width), static_cast<int>(first[id] / width));
+        QPolygonF contour = traceBoundary(width, height, start, [&labels, width, id](int x, int y) {
+            return labels[static_cast<size_t>(y) * width + x] == id;
+        });
+
+        for (QPointF &pt : contour) {
+            pt /= scale;
+        }
+        traced[i] = Geometry::simplifyPolygon(contour, options.tolerance);
+    });
+
+    if (cancelled()) {
+        return regions;
+    }
+    for (const QPolygonF &polygon : traced) {
+        if (polygon.size() >= 3) {
+            regions.append(polygon);
+        }
+    }
+    return regions;
+}
@@ -0,0 +1,43 @@
+#ifndef REGIONDETECTOR_H
+#define REGIONDETECTOR_H
+
+#include <QImage>
+#include <QPolygonF>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+// Finds distinct regions in an image and returns their outlines as simplified
+// polygons in image coordinates. The image is thresholded against its
+// background, split into horizontal bands that are labelled in parallel, the
+// bands' components are merged, and each component's outer contour is traced
+// and simplified in parallel.
+class RegionDetector
+{
+public:
+    struct Options {
+        int threshold = -1;          // luminance threshold, -1 picks one automatically (Otsu)
+        int minArea = 64;            // smallest region kept, in image pixels
+        qreal tolerance = 1.5;       // simplification tolerance, in image pixels
+        int maxWorkingSize = 4096;   // larger images are analysed at this resolution
+    };
+
+    // Shared with the GUI thread while running
+    struct Progress {
+        std::atomic<bool> cancelled{false};
+    };
+
+    // Safe to call off the GUI thread. Returns no regions once cancelled.
+    static QVector<QPolygonF> detect(const QImage &image, const Options &options, Progress *progress = nullptr);
+
+    // Traces the outer boundary of the 8-connected region of non-zero mask
+    // pixels containing start, which must be the region's first pixel in
+    // raster order. Returned points are pixel centres.
+    static QPolygonF traceContour(const quint8 *mask, int width, int height, const QPoint &start);
+
+    // Same for a region given by a predicate, such as a sparse mask
+    static QPolygonF traceContour(int width, int height, const QPoint &start,
+                                  const std::function<bool(int, int)> &inRegion);
+};
+
+#endif // REGIONDETECTOR_H
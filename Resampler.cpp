@@ -0,0 +1,161 @@
+#include "Resampler.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QtMath>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr int WeightBits = 14;
+constexpr int Lobes = 3;
+
+qreal lanczos(qreal x)
+{
+    x = std::abs(x);
+    if (x < 1e-8) {
+        return 1.0;
+    }
+    if (x >= Lobes) {
+        return 0.0;
+    }
+    const qreal px = M_PI * x;
+    return Lobes * std::sin(px) * std::sin(px / Lobes) / (px * px);
+}
+
+// Source taps and weights of every destination pixel along one axis
+struct Filter {
+    std::vector<int> first;     // first source index per destination pixel
+    std::vector<int> count;     // taps per destination pixel
+    std::vector<qint16> weights; // taps * destination pixels, row-major
+    int taps = 0;
+};
+
+Filter buildFilter(int sourceSize, int destSize)
+{
+    const qreal scale = qreal(destSize) / sourceSize;
+    // Downscaling widens the filter so every source pixel contributes
+    const qreal support = scale < 1.0 ? Lobes / scale : Lobes;
+    const qreal filterScale = scale < 1.0 ? scale : 1.0;
+
+    Filter filter;
+    filter.taps = qCeil(support) * 2 + 1;
+    filter.first.resize(destSize);
+    filter.count.resize(destSize);
+    filter.weights.assign(static_cast<size_t>(destSize) * filter.taps, 0);
+
+    std::vector<qreal> raw(filter.taps);
+    for (int d = 0; d < destSize; ++d) {
+        const qreal center = (d + 0.5) / scale;
+        const int first = qMax(0, qFloor(center - support));
+        const int last = qMin(sourceSize - 1, qCeil(center + support));
+        const int count = qMin(last - first + 1, filter.taps);
+
+        qreal sum = 0;
+        for (int i = 0; i < count; ++i) {
+            raw[i] = lanczos((first + i + 0.5 - center) * filterScale);
+            sum += raw[i];
+        }
+
+        // Normalise in fixed point, putting the rounding error on the
+        // largest tap so the weights sum to exactly one
+        qint16 *weights = filter.weights.data() + static_cast<size_t>(d) * filter.taps;
+        int total = 0;
+        int largest = 0;
+        for (int i = 0; i < count; ++i) {
+            weights[i] = static_cast<qint16>(qRound(raw[i] / sum * (1 << WeightBits)));
+            total += weights[i];
+            if (weights[i] > weights[largest]) {
+                largest = i;
+            }
+        }
+        weights[largest] = static_cast<qint16>(weights[largest] + (1 << WeightBits) - total);
+
+        filter.first[d] = first;
+        filter.count[d] = count;
+    }
+    return filter;
+}
+
+inline uchar clampChannel(qint32 value)
+{
+    value = (value + (1 << (WeightBits - 1))) >> WeightBits;
+    return static_cast<uchar>(qBound(0, value, 255));
+}
+
+} // namespace
+
+namespace Resampler {
+
+QImage resize(const QImage &image, const QSize &size)
+{
+    TRACE_SCOPE("Resampler::resize");
+
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    const QImage source = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    if (source.size() == size) {
+        return source;
+    }
+
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const int width = size.width();
+    const int height = size.height();
+
+    // Horizontal pass: every source row to the new width
+    const Filter horizontal = buildFilter(sourceWidth, width);
+    QImage wide(width, sourceHeight, QImage::Format_ARGB32_Premultiplied);
+    parallelFor(sourceHeight, [&](int y) {
+        const uchar *in = source.constScanLine(y);
+        uchar *out = wide.scanLine(y);
+        for (int x = 0; x < width; ++x) {
+            const qint16 *weights = horizontal.weights.data() + static_cast<size_t>(x) * horizontal.taps;
+            const uchar *taps = in + horizontal.first[x] * 4;
+            qint32 acc[4] = {0, 0, 0, 0};
+            for (int i = 0; i < horizontal.count[x]; ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    acc[c] += weights[i] * taps[i * 4 + c];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = clampChannel(acc[c]);
+            }
+        }
+    });
+
+    // Vertical pass: whole rows at a time, so the inner loop runs along
+    // contiguous memory
+    const Filter vertical = buildFilter(sourceHeight, height);
+    QImage result(width, height, QImage::Format_ARGB32_Premultiplied);
+    parallelFor(height, [&](int y) {
+        std::vector<qint32> acc(static_cast<size_t>(width) * 4, 0);
+        const qint16 *weights = vertical.weights.data() + static_cast<size_t>(y) * vertical.taps;
+        for (int i = 0; i < vertical.count[y]; ++i) {
+            const uchar *in = wide.constScanLine(vertical.first[y] + i);
+            const qint32 weight = weights[i];
+            qint32 *a = acc.data();
+            for (int x = 0; x < width * 4; ++x) {
+                a[x] += weight * in[x];
+            }
+        }
+        uchar *out = result.scanLine(y);
+        for (int x = 0; x < width * 4; ++x) {
+            out[x] = clampChannel(acc[x]);
+        }
+    });
+
+    // Negative lobes can push colour above alpha; keep premultiplied valid
+    parallelFor(height, [&](int y) {
+        QRgb *row = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const int alpha = qAlpha(row[x]);
+            row[x] = qRgba(qMin(qRed(row[x]), alpha), qMin(qGreen(row[x]), alpha),
+                           qMin(qBlue(row[x]), alpha), alpha);
+        }
+    });
+    return result;
+}
+
+} // namespace Resampler
@@ -0,0 +1,19 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QImage>
+#include <QSize>
+
+// High-quality image scaling for export, where QImage::scaled's smooth mode
+// (a box/bilinear filter) softens downscaled images noticeably
+namespace Resampler {
+
+// Separable Lanczos-3 resize in premultiplied ARGB. Filter weights are
+// precomputed once per output column and row as 14-bit fixed point, so the
+// inner loops are plain integer multiply-adds the compiler vectorizes; rows
+// of both passes are spread over the thread pool.
+QImage resize(const QImage &image, const QSize &size);
+
+} // namespace Resampler
+
+#endif // RESAMPLER_H
@@ -0,0 +1,246 @@
+#include "ResponsiveExporter.h"
+#include "Parallel.h"
+#include "Resampler.h"
+#include "TraceRecorder.h"
+#include <QDir>
+#include <QFile>
+#include <QImageWriter>
+#include <QPainter>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr int AreaChunkSize = 256;
+
+// Quoted JavaScript string literal that is also safe inside <script>
+QString jsString(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("\\", "\\\\").replace("\"", "\\\"").replace("<", "\\u003c").replace("\n", "\\n");
+    return "\"" + escaped + "\"";
+}
+
+} // namespace
+
+QVector<ResponsiveExporter::Variant> ResponsiveExporter::variants(const QSize &outputSize, const Options &options)
+{
+    QVector<int> widths;
+    for (int width : options.widths) {
+        if (width > 0 && width < outputSize.width()) {
+            widths.append(width);
+        }
+    }
+    widths.append(outputSize.width());
+    std::sort(widths.begin(), widths.end());
+    widths.erase(std::unique(widths.begin(), widths.end()), widths.end());
+
+    const QString extension = QString::fromLatin1(options.format);
+    QVector<Variant> result;
+    for (int width : widths) {
+        Variant variant;
+        variant.width = width;
+        variant.height = qMax(1, qRound(qreal(outputSize.height()) * width / outputSize.width()));
+        variant.fileName = QString("%1-%2.%3").arg(options.baseName).arg(width).arg(extension);
+        result.append(variant);
+    }
+    return result;
+}
+
+QVector<QStringList> ResponsiveExporter::coordinateSets(const QVector<MapArea> &areas, const QSize &outputSize,
+                                                        const QVector<Variant> &variants, qreal simplifyTolerance)
+{
+    TRACE_SCOPE("ResponsiveExporter::coordinateSets");
+
+    const int count = areas.size();
+    std::vector<std::vector<QString>> coords(variants.size(), std::vector<QString>(count));
+    const int chunks = (count + AreaChunkSize - 1) / AreaChunkSize;
+
+    parallelFor(chunks, [&](int chunk) {
+        const int end = qMin(count, (chunk + 1) * AreaChunkSize);
+        QVector<qreal> values;
+        for (int i = chunk * AreaChunkSize; i < end; ++i) {
+            const MapArea &area = areas.at(i);
+
+            // Full-size values, computed once per area
+            values.clear();
+            switch (area.shape) {
+            case HotspotShape::Rectangle:
+                values << area.rect.left() << area.rect.top() << area.rect.right() << area.rect.bottom();
+                break;
+            case HotspotShape::Circle:
+                values << area.center.x() << area.center.y() << area.radius;
+                break;
+            case HotspotShape::Polygon:
+                for (const QPoint &p : area.exportPolygon(simplifyTolerance)) {
+                    values << p.x() << p.y();
+                }
+                break;
+            }
+
+            for (int v = 0; v < variants.size(); ++v) {
+                const qreal scaleX = qreal(variants.at(v).width) / outputSize.width();
+                const qreal scaleY = qreal(variants.at(v).height) / outputSize.height();
+                QStringList parts;
+                parts.reserve(values.size());
+                for (int k = 0; k < values.size(); ++k) {
+                    // Odd values are y, except a circle's radius which follows x
+                    const bool vertical = k % 2 == 1 && !(area.shape == HotspotShape::Circle && k == 2);
+                    parts << QString::number(qRound(values.at(k) * (vertical ? scaleY : scaleX)));
+                }
+                coords[v][i] = parts.join(",");
+            }
+        }
+    });
+
+    QVector<QStringList> sets;
+    sets.reserve(variants.size());
+    for (const std::vector<QString> &set : coords) {
+        QStringList list;
+        list.reserve(count);
+        for (const QString &c : set) {
+            list.append(c);
+        }
+        sets.append(list);
+    }
+    return sets;
+}
+
+QString ResponsiveExporter::generateHtml(const QVector<MapArea> &areas, const QVector<Variant> &variants,
+                                         const QVector<QStringList> &coordinateSets, const Options &options)
+{
+    if (variants.isEmpty() || coordinateSets.size() != variants.size()) {
+        return QString();
+    }
+
+    const Variant &largest = variants.last();
+    const QString mapName = options.mapName.toHtmlEscaped();
+
+    QStringList srcset;
+    QStringList widths;
+    for (const Variant &variant : variants) {
+        srcset << QString("%1 %2w").arg(variant.fileName.toHtmlEscaped()).arg(variant.width);
+        widths << QString::number(variant.width);
+    }
+
+    QStringList html;
+    html << QString("<img src=\"%1\" srcset=\"%2\" sizes=\"%3\" width=\"%4\" height=\"%5\" "
+                    "style=\"max-width:100%;height:auto\" usemap=\"#%6\" alt=\"Image Map\">")
+                .arg(largest.fileName.toHtmlEscaped())
+                .arg(srcset.join(", "))
+                .arg(options.sizes.toHtmlEscaped())
+                .arg(largest.width)
+                .arg(largest.height)
+                .arg(mapName);
+    html << QString("<map name=\"%1\">").arg(mapName);
+    const QStringList &fullSize = coordinateSets.last();
+    for (int i = 0; i < areas.size(); ++i) {
+        html << "  " + areas.at(i).generateAreaTag(fullSize.at(i));
+    }
+    html << "</map>";
+
+    // One coords string per area per breakpoint; the smallest set at least
+    // as wide as the image is scaled the rest of the way
+    QStringList sets;
+    for (const QStringList &set : coordinateSets) {
+        QStringList quoted;
+        quoted.reserve(set.size());
+        for (const QString &coords : set) {
+            quoted << "\"" + coords + "\"";
+        }
+        sets << "[" + quoted.join(",") + "]";
+    }
+    const QString name = jsString(options.mapName);
+    html << "<script>";
+    html << "(function () {";
+    html << "  var widths = [" + widths.join(",") + "];";
+    html << "  var sets = [" + sets.join(",\n    ") + "];";
+    html << "  var img = document.querySelector('img[usemap=\"#' + " + name + " + '\"]');";
+    html << "  var map = document.querySelector('map[name=\"' + " + name + " + '\"]');";
+    html << "  if (!img || !map) return;";
+    html << "  function update() {";
+    html << "    var w = img.clientWidth, i = 0;";
+    html << "    if (!w) return;";
+    html << "    while (i < widths.length - 1 && widths[i] < w) i++;";
+    html << "    var s = w / widths[i], areas = map.areas;";
+    html << "    for (var j = 0; j < areas.length && j < sets[i].length; j++) {";
+    html << "      areas[j].coords = s === 1 ? sets[i][j] : sets[i][j].split(\",\").map(function (v) {";
+    html << "        return Math.round(v * s);";
+    html << "      }).join(\",\");";
+    html << "    }";
+    html << "  }";
+    html << "  img.addEventListener(\"load\", update);";
+    html << "  window.addEventListener(\"resize\", update);";
+    html << "  update();";
+    html << "})();";
+    html << "</script>";
+
+    return html.join("\n");
+}
+
+QStringList ResponsiveExporter::run(const QImage &image, const QSize &outputSize, const QVector<MapArea> &areas,
+                                    const Options &options, Progress *progress)
+{
+    TRACE_SCOPE("ResponsiveExporter::run");
+
+    if (image.isNull() || outputSize.isEmpty()) {
+        return {"No image to export"};
+    }
+    const QDir dir(options.directory);
+    if (!dir.exists() && !QDir().mkpath(options.directory)) {
+        return {QString("Cannot create folder %1").arg(options.directory)};
+    }
+
+    const QVector<Variant> sizes = variants(outputSize, options);
+    const bool opaque = options.format == "jpg" || options.format == "jpeg";
+    QStringList messages;
+
+    // One variant at a time; the resampler already uses every thread
+    for (const Variant &variant : sizes) {
+        if (progress && progress->cancelled.load(std::memory_order_relaxed)) {
+            return messages;
+        }
+
+        QImage scaled = Resampler::resize(image, QSize(variant.width, variant.height));
+        if (opaque && scaled.hasAlphaChannel()) {
+            QImage flat(scaled.size(), QImage::Format_RGB32);
+            flat.fill(Qt::white);
+            QPainter painter(&flat);
+            painter.drawImage(0, 0, scaled);
+            painter.end();
+            scaled = flat;
+        }
+
+        QImageWriter writer(dir.filePath(variant.fileName), options.format);
+        writer.setQuality(options.quality);
+        if (!writer.write(scaled)) {
+            messages.append(QString("%1: %2").arg(writer.fileName(), writer.errorString()));
+        }
+
+        if (progress) {
+            progress->done.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const QVector<QStringList> sets = coordinateSets(areas, outputSize, sizes, options.simplifyTolerance);
+    QFile file(dir.filePath(options.baseName + ".html"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        messages.append(QString("Cannot write %1").arg(file.fileName()));
+        return messages;
+    }
+    const QString html = QString(
+                             "<!DOCTYPE html>\n"
+                             "<html lang=\"en\">\n"
+                             "<head>\n"
+                             "    <meta charset=\"UTF-8\">\n"
+                             "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
+                             "    <title>Image Map</title>\n"
+                             "</head>\n"
+                             "<body>\n"
+                             "%1\n"
+                             "</body>\n"
+                             "</html>\n"
+                             ).arg(generateHtml(areas, sizes, sets, options));
+    file.write(html.toUtf8());
+    return messages;
+}
@@ -0,0 +1,65 @@
+#ifndef RESPONSIVEEXPORTER_H
+#define RESPONSIVEEXPORTER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "MapArea.h"
+
+// Writes the image at several widths for srcset, together with the HTML
+// for a map that follows whichever width the browser is showing.
+//
+// Coordinates for every variant come from one pass over the areas: each
+// polygon is simplified once at full size and only the scaling and rounding
+// are repeated per variant. The <map> carries the full-size coordinates and
+// a short script swaps in the set for the breakpoint nearest the rendered
+// width, scaling the remainder, so the map also works with scripts off.
+class ResponsiveExporter
+{
+public:
+    struct Options {
+        QString directory;
+        QString baseName = "image";
+        QByteArray format = "jpg";
+        int quality = 85;
+        QVector<int> widths{480, 768, 1280, 1920};
+        QString mapName = "imagemap";
+        QString sizes = "100vw";        // sizes attribute of the <img>
+        qreal simplifyTolerance = -1;
+    };
+
+    struct Variant {
+        int width = 0;
+        int height = 0;
+        QString fileName;
+    };
+
+    // Shared with the GUI thread while running
+    struct Progress {
+        std::atomic<int> done{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    // Requested widths that do not upscale, plus the full output width
+    static QVector<Variant> variants(const QSize &outputSize, const Options &options);
+
+    // coords attribute of every area for every variant, indexed [variant][area].
+    // Areas are in output coordinates.
+    static QVector<QStringList> coordinateSets(const QVector<MapArea> &areas, const QSize &outputSize,
+                                               const QVector<Variant> &variants, qreal simplifyTolerance);
+
+    static QString generateHtml(const QVector<MapArea> &areas, const QVector<Variant> &variants,
+                                const QVector<QStringList> &coordinateSets, const Options &options);
+
+    // Resizes the image to every variant and writes the images plus
+    // <baseName>.html. Returns error messages, or an empty list if everything
+    // was written. Safe to call off the GUI thread.
+    static QStringList run(const QImage &image, const QSize &outputSize, const QVector<MapArea> &areas,
+                           const Options &options, Progress *progress = nullptr);
+};
+
+#endif // RESPONSIVEEXPORTER_H
@@ -0,0 +1,216 @@
+#include "ScriptMapExporter.h"
+#include "Parallel.h"
+#include "TraceRecorder.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr int AreaChunkSize = 256;
+
+// Runtime for the packed map; %1 is the JSON object built in generateHtml
+const char *const Runtime = R"JS((function () {
+  var data = %1;
+  var img = document.getElementById(data.id), overlay = document.getElementById(data.id + "-overlay");
+  if (!img) return;
+
+  function decode(text, Type) {
+    var bin = atob(text), bytes = new Uint8Array(bin.length);
+    for (var i = 0; i < bin.length; i++) bytes[i] = bin.charCodeAt(i);
+    return new Type(bytes.buffer);
+  }
+  var shapes = decode(data.shapes, Uint8Array);
+  var offsets = decode(data.offsets, Uint32Array);
+  var coords = decode(data.coords, data.int16 ? Int16Array : Int32Array);
+  var n = shapes.length, W = data.width, H = data.height;
+
+  // Uniform grid with about one area per cell; each cell lists its areas
+  // in document order so the first hit is the one a browser would pick
+  var cell = Math.max(8, Math.ceil(Math.sqrt(W * H / Math.max(1, n))));
+  var cols = Math.max(1, Math.ceil(W / cell)), rows = Math.max(1, Math.ceil(H / cell));
+  var boxes = new Int32Array(n * 4), starts = new Uint32Array(cols * rows + 1);
+  function clampCol(v) { return Math.min(cols - 1, Math.max(0, Math.floor(v / cell))); }
+  function clampRow(v) { return Math.min(rows - 1, Math.max(0, Math.floor(v / cell))); }
+  for (var i = 0; i < n; i++) {
+    var b = offsets[i], e = offsets[i + 1], x0, y0, x1, y1;
+    if (shapes[i] === 1) {
+      x0 = coords[b] - coords[b + 2]; x1 = coords[b] + coords[b + 2];
+      y0 = coords[b + 1] - coords[b + 2]; y1 = coords[b + 1] + coords[b + 2];
+    } else {
+      x0 = y0 = Infinity; x1 = y1 = -Infinity;
+      for (var k = b; k < e; k += 2) {
+        x0 = Math.min(x0, coords[k]); x1 = Math.max(x1, coords[k]);
+        y0 = Math.min(y0, coords[k + 1]); y1 = Math.max(y1, coords[k + 1]);
+      }
+    }
+    if (!(x1 >= 0 && y1 >= 0 && x0 <= W && y0 <= H)) { boxes[i * 4] = -1; continue; }
+    boxes[i * 4] = clampCol(x0); boxes[i * 4 + 1] = clampRow(y0);
+    boxes[i * 4 + 2] = clampCol(x1); boxes[i * 4 + 3] = clampRow(y1);
+    for (var r = boxes[i * 4 + 1]; r <= boxes[i * 4 + 3]; r++)
+      for (var c = boxes[i * 4]; c <= boxes[i * 4 + 2]; c++) starts[r * cols + c + 1]++;
+  }
+  for (var s = 0; s < cols * rows; s++) starts[s + 1] += starts[s];
+  var items = new Uint32Array(starts[cols * rows]), fill = starts.slice(0, cols * rows);
+  for (var i = 0; i < n; i++) {
+    if (boxes[i * 4] < 0) continue;
+    for (var r = boxes[i * 4 + 1]; r <= boxes[i * 4 + 3]; r++)
+      for (var c = boxes[i * 4]; c <= boxes[i * 4 + 2]; c++) items[fill[r * cols + c]++] = i;
+  }
+
+  function contains(i, x, y) {
+    var b = offsets[i], e = offsets[i + 1];
+    if (shapes[i] === 0)
+      return x >= Math.min(coords[b], coords[b + 2]) && x <= Math.max(coords[b], coords[b + 2])
+          && y >= Math.min(coords[b + 1], coords[b + 3]) && y <= Math.max(coords[b + 1], coords[b + 3]);
+    if (shapes[i] === 1) {
+      var dx = x - coords[b], dy = y - coords[b + 1];
+      return dx * dx + dy * dy <= coords[b + 2] * coords[b + 2];
+    }
+    var inside = false;
+    for (var k = b, j = e - 2; k < e; j = k, k += 2) {
+      var xi = coords[k], yi = coords[k + 1], xj = coords[j], yj = coords[j + 1];
+      if ((yi > y) !== (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) inside = !inside;
+    }
+    return inside;
+  }
+  function hit(x, y) {
+    if (x < 0 || y < 0 || x > W || y > H) return -1;
+    var s = clampRow(y) * cols + clampCol(x);
+    for (var k = starts[s]; k < starts[s + 1]; k++)
+      if (contains(items[k], x, y)) return items[k];
+    return -1;
+  }
+
+  var current = -1;
+  function highlight(i) {
+    if (!overlay) return;
+    overlay.width = img.clientWidth; overlay.height = img.clientHeight;
+    if (i < 0) return;
+    var g = overlay.getContext("2d"), s = img.clientWidth / W, b = offsets[i], e = offsets[i + 1];
+    g.setTransform(s, 0, 0, s, 0, 0);
+    g.beginPath();
+    if (shapes[i] === 0) g.rect(coords[b], coords[b + 1], coords[b + 2] - coords[b], coords[b + 3] - coords[b + 1]);
+    else if (shapes[i] === 1) g.arc(coords[b], coords[b + 1], coords[b + 2], 0, 2 * Math.PI);
+    else { for (var k = b; k < e; k += 2) g.lineTo(coords[k], coords[k + 1]); g.closePath(); }
+    g.fillStyle = "rgba(0, 120, 215, 0.2)"; g.fill();
+    g.lineWidth = 2 / s; g.strokeStyle = "rgba(0, 120, 215, 0.9)"; g.stroke();
+  }
+  function areaAt(event) {
+    var rect = img.getBoundingClientRect();
+    return hit((event.clientX - rect.left) * W / rect.width, (event.clientY - rect.top) * H / rect.height);
+  }
+  img.addEventListener("mousemove", function (event) {
+    var i = areaAt(event);
+    if (i === current) return;
+    current = i;
+    img.style.cursor = i >= 0 ? "pointer" : "";
+    img.title = i >= 0 ? (data.titles[i] || data.alts[i]) : "";
+    highlight(i);
+  });
+  img.addEventListener("mouseleave", function () { current = -1; img.style.cursor = ""; highlight(-1); });
+  img.addEventListener("click", function (event) {
+    var i = areaAt(event);
+    if (i >= 0 && data.urls[i] && data.urls[i] !== "#") window.location.href = data.urls[i];
+  });
+})();)JS";
+
+template <typename T>
+void appendLittleEndian(QByteArray &bytes, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian(value, buffer);
+    bytes.append(buffer, sizeof(T));
+}
+
+} // namespace
+
+ScriptMapExporter::Packed ScriptMapExporter::pack(const QVector<MapArea> &areas, qreal simplifyTolerance)
+{
+    TRACE_SCOPE("ScriptMapExporter::pack");
+
+    const int count = areas.size();
+    std::vector<QVector<int>> values(count);
+    const int chunks = (count + AreaChunkSize - 1) / AreaChunkSize;
+    parallelFor(chunks, [&](int chunk) {
+        const int end = qMin(count, (chunk + 1) * AreaChunkSize);
+        for (int i = chunk * AreaChunkSize; i < end; ++i) {
+            values[i] = areas.at(i).coordValues(simplifyTolerance);
+        }
+    });
+
+    Packed packed;
+    quint32 total = 0;
+    for (const QVector<int> &v : values) {
+        total += v.size();
+        for (int value : v) {
+            if (value < std::numeric_limits<qint16>::min() || value > std::numeric_limits<qint16>::max()) {
+                packed.int16 = false;
+            }
+        }
+    }
+
+    packed.shapes.reserve(count);
+    packed.offsets.reserve((count + 1) * 4);
+    packed.coords.reserve(total * (packed.int16 ? 2 : 4));
+    quint32 offset = 0;
+    for (int i = 0; i < count; ++i) {
+        packed.shapes.append(static_cast<char>(areas.at(i).shape == HotspotShape::Rectangle ? 0
+                                               : areas.at(i).shape == HotspotShape::Circle ? 1 : 2));
+        appendLittleEndian<quint32>(packed.offsets, offset);
+        for (int value : values[i]) {
+            if (packed.int16) {
+                appendLittleEndian<qint16>(packed.coords, static_cast<qint16>(value));
+            } else {
+                appendLittleEndian<qint32>(packed.coords, value);
+            }
+        }
+        offset += values[i].size();
+    }
+    appendLittleEndian<quint32>(packed.offsets, offset);
+    return packed;
+}
+
+QString ScriptMapExporter::generateHtml(const QVector<MapArea> &areas, const QString &imageName,
+                                        const QSize &outputSize, const QString &id, qreal simplifyTolerance)
+{
+    TRACE_SCOPE("ScriptMapExporter::generateHtml");
+
+    const Packed packed = pack(areas, simplifyTolerance);
+
+    QJsonArray urls, alts, titles;
+    for (const MapArea &area : areas) {
+        urls.append(area.url.isEmpty() ? QString("#") : area.url);
+        alts.append(area.altText);
+        titles.append(area.title);
+    }
+    QJsonObject data;
+    data["id"] = id;
+    data["width"] = outputSize.width();
+    data["height"] = outputSize.height();
+    data["int16"] = packed.int16;
+    data["shapes"] = QString::fromLatin1(packed.shapes.toBase64());
+    data["offsets"] = QString::fromLatin1(packed.offsets.toBase64());
+    data["coords"] = QString::fromLatin1(packed.coords.toBase64());
+    data["urls"] = urls;
+    data["alts"] = alts;
+    data["titles"] = titles;
+
+    // "</" would end the script element early
+    QString json = QString::fromUtf8(QJsonDocument(data).toJson(QJsonDocument::Compact));
+    json.replace("</", "<\\/");
+    const QString script = QString::fromLatin1(Runtime).arg(json);
+    return QString("<div style=\"position:relative;display:inline-block;max-width:100%\">\n"
+                   "  <img id=\"%1\" src=\"%2\" width=\"%3\" height=\"%4\" alt=\"Image Map\" "
+                   "style=\"display:block;max-width:100%;height:auto\">\n"
+                   "  <canvas id=\"%1-overlay\" style=\"position:absolute;left:0;top:0;pointer-events:none\"></canvas>\n"
+                   "</div>\n"
+                   "<script>\n")
+               .arg(id.toHtmlEscaped(), imageName.toHtmlEscaped())
+               .arg(outputSize.width())
+               .arg(outputSize.height())
+           + script + "\n</script>";
+}
@@ -0,0 +1,38 @@
+#ifndef SCRIPTMAPEXPORTER_H
+#define SCRIPTMAPEXPORTER_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include "MapArea.h"
+
+// Alternative to <map> for maps with tens of thousands of areas, which
+// browsers parse slowly and hit test one <area> at a time.
+//
+// The geometry is written as base64 typed arrays (shape kinds, coordinate
+// offsets and coordinates, 16-bit when they fit) next to a small runtime.
+// On load the runtime buckets every area into a uniform grid sized for
+// about one area per cell, so hover and click only test the few areas in
+// the cell under the pointer. Like a browser, the first area in document
+// order wins where areas overlap.
+class ScriptMapExporter
+{
+public:
+    struct Packed {
+        QByteArray shapes;      // one byte per area: 0 rect, 1 circle, 2 poly
+        QByteArray offsets;     // uint32 start of each area's coordinates, plus the end
+        QByteArray coords;      // int16 or int32 values as in the coords attribute
+        bool int16 = true;
+    };
+
+    // Little-endian, as typed arrays are on every platform browsers run on
+    static Packed pack(const QVector<MapArea> &areas, qreal simplifyTolerance);
+
+    // <img> with a highlight canvas and the runtime script. Areas are in
+    // output coordinates; id names the image element.
+    static QString generateHtml(const QVector<MapArea> &areas, const QString &imageName, const QSize &outputSize,
+                                const QString &id, qreal simplifyTolerance);
+};
+
+#endif // SCRIPTMAPEXPORTER_H
@@ -0,0 +1,128 @@
+#include "ThumbnailStrip.h"
+#include "ImageWorkspace.h"
+#include <QFileInfo>
+#include <QPixmap>
+#include <QScrollBar>
+#include <QSignalBlocker>
+
+ThumbnailStrip::ThumbnailStrip(ImageWorkspace *workspace, QWidget *parent)
+    : QListWidget(parent)
+    , m_workspace(workspace)
+{
+    const int size = ImageWorkspace::ThumbnailSize;
+    setViewMode(QListView::IconMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(false);
+    setMovement(QListView::Static);
+    setUniformItemSizes(true);
+    setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setIconSize(QSize(size, size));
+    setGridSize(QSize(size + 24, size + 32));
+    setTextElideMode(Qt::ElideMiddle);
+    setFixedHeight(size + 32 + horizontalScrollBar()->sizeHint().height() + 2 * frameWidth() + 4);
+
+    QPixmap placeholder(size, size);
+    placeholder.fill(QColor("#313244"));
+    m_placeholder = QIcon(placeholder);
+
+    m_requestTimer = new QTimer(this);
+    m_requestTimer->setSingleShot(true);
+    m_requestTimer->setInterval(0);
+    connect(m_requestTimer, &QTimer::timeout, this, &ThumbnailStrip::requestVisible);
+
+    connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &ThumbnailStrip::scheduleRequest);
+    connect(m_workspace, &ImageWorkspace::thumbnailReady, this, &ThumbnailStrip::onThumbnailReady);
+    connect(this, &QListWidget::currentRowChanged, this, [this](int row) {
+        if (row >= 0) {
+            emit imageActivated(row);
+        }
+    });
+}
+
+void ThumbnailStrip::reload()
+{
+    const QSignalBlocker blocker(this);
+    clear();
+    m_loaded.clear();
+
+    for (int i = 0; i < m_workspace->count(); ++i) {
+        const QString path = m_workspace->path(i);
+        auto *item = new QListWidgetItem(m_placeholder, QFileInfo(path).fileName(), this);
+        item->setToolTip(path);
+    }
+    scheduleRequest();
+}
+
+void ThumbnailStrip::setCurrentImage(int index)
+{
+    const QSignalBlocker blocker(this);
+    setCurrentRow(index);
+    if (QListWidgetItem *current = item(index)) {
+        scrollToItem(current, QAbstractItemView::PositionAtCenter);
+    }
+    scheduleRequest();
+}
+
+void ThumbnailStrip::resizeEvent(QResizeEvent *event)
+{
+    QListWidget::resizeEvent(event);
+    scheduleRequest();
+}
+
+void ThumbnailStrip::scheduleRequest()
+{
+    // Coalesces the scroll steps of one event loop pass
+    m_requestTimer->start();
+}
+
+void ThumbnailStrip::requestVisible()
+{
+    if (count() == 0) {
+        return;
+    }
+
+    const QRect area = viewport()->rect();
+    const int y = area.center().y();
+    QModelIndex firstIndex = indexAt(QPoint(area.left(), y));
+    QModelIndex lastIndex = indexAt(QPoint(area.right(), y));
+    const int first = firstIndex.isValid() ? firstIndex.row() : 0;
+    const int last = lastIndex.isValid() ? lastIndex.row() : count() - 1;
+
+    const int loadFirst = qMax(0, first - LOAD_MARGIN);
+    const int loadLast = qMin(count() - 1, last + LOAD_MARGIN);
+    m_workspace->cancelThumbnailsOutside(loadFirst, loadLast);
+
+    // Nearest the view first, so the pool works from the middle outwards
+    for (int i = first; i <= last; ++i) {
+        if (!m_loaded.contains(i)) {
+            m_workspace->requestThumbnail(i);
+        }
+    }
+    for (int step = 1; step <= LOAD_MARGIN; ++step) {
+        for (int i : {last + step, first - step}) {
+            if (i >= loadFirst && i <= loadLast && !m_loaded.contains(i)) {
+                m_workspace->requestThumbnail(i);
+            }
+        }
+    }
+
+    for (auto it = m_loaded.begin(); it != m_loaded.end();) {
+        if (*it < first - KEEP_MARGIN || *it > last + KEEP_MARGIN) {
+            if (QListWidgetItem *distant = item(*it)) {
+                distant->setIcon(m_placeholder);
+            }
+            it = m_loaded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ThumbnailStrip::onThumbnailReady(int index, const QImage &thumbnail)
+{
+    if (QListWidgetItem *ready = item(index)) {
+        ready->setIcon(QIcon(QPixmap::fromImage(thumbnail)));
+        m_loaded.insert(index);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef THUMBNAILSTRIP_H
+#define THUMBNAILSTRIP_H
+
+#include <QListWidget>
+#include <QSet>
+#include <QTimer>
+
+class ImageWorkspace;
+
+// A single row of thumbnails for the images in a workspace. Thumbnails are
+// only requested for the items in view plus a margin on each side, and
+// icons far out of view are released again, so folders with thousands of
+// images cost no more than the part on screen.
+class ThumbnailStrip : public QListWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailStrip(ImageWorkspace *workspace, QWidget *parent = nullptr);
+
+    // Rebuilds the items after the workspace opened a folder
+    void reload();
+    void setCurrentImage(int index);
+
+signals:
+    void imageActivated(int index);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void scheduleRequest();
+    void requestVisible();
+    void onThumbnailReady(int index, const QImage &thumbnail);
+
+    ImageWorkspace *m_workspace;
+    QIcon m_placeholder;
+    QSet<int> m_loaded;
+    QTimer *m_requestTimer;
+
+    // Items beyond each edge of the view to load ahead, and to keep
+    static constexpr int LOAD_MARGIN = 8;
+    static constexpr int KEEP_MARGIN = 64;
+};
+
+#endif // THUMBNAILSTRIP_H
@@ -0,0 +1,167 @@
+#include "TraceRecorder.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <algorithm>
+
+std::atomic<bool> TraceRecorder::s_enabled{false};
+
+struct TraceRecorder::ThreadBuffer
+{
+    static constexpr quint64 Capacity = 1 << 15; // must be a power of two
+
+    QString threadName;
+    int threadIndex = 0;
+
+    // A slot's sequence is odd while its event is being written and 2n + 2
+    // once event n is in it, so the reader can tell a complete event from a
+    // torn or overwritten one. The fields are relaxed atomics so copying a
+    // slot that is being written is not a data race.
+    struct Slot {
+        std::atomic<quint64> sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<qint64> startNs{0};
+        std::atomic<qint64> durationNs{0};
+    };
+
+    // Written only by the owning thread
+    std::atomic<quint64> head{0};
+    // Written only by clear(); events before it are ignored by the reader
+    std::atomic<quint64> tail{0};
+
+    Slot ring[Capacity];
+};
+
+TraceRecorder::TraceRecorder()
+{
+    m_clock.start();
+}
+
+TraceRecorder &TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+TraceRecorder::ThreadBuffer *TraceRecorder::localBuffer()
+{
+    thread_local ThreadBuffer *t_buffer = nullptr;
+    if (t_buffer) {
+        return t_buffer;
+    }
+
+    auto buffer = std::make_unique<ThreadBuffer>();
+    QCoreApplication *app = QCoreApplication::instance();
+    if (app && QThread::currentThread() == app->thread()) {
+        buffer->threadName = "GUI";
+    } else {
+        QString name = QThread::currentThread()->objectName();
+        buffer->threadName = name.isEmpty() ? QString("Worker") : name;
+    }
+
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    buffer->threadIndex = static_cast<int>(m_buffers.size()) + 1;
+    t_buffer = buffer.get();
+    m_buffers.push_back(std::move(buffer));
+    return t_buffer;
+}
+
+void TraceRecorder::record(const char *name, qint64 startNs, qint64 endNs)
+{
+    ThreadBuffer *buffer = localBuffer();
+    quint64 head = buffer->head.load(std::memory_order_relaxed);
+
+    ThreadBuffer::Slot &slot = buffer->ring[head & (ThreadBuffer::Capacity - 1)];
+    slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+    slot.sequence.store(2 * head + 2, std::memory_order_release);
+
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceRecorder::clear()
+{
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    for (const auto &buffer : m_buffers) {
+        buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+bool TraceRecorder::writeJson(const QString &filePath) const
+{
+    QJsonArray traceEvents;
+
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    for (const auto &buffer : m_buffers) {
+        QJsonObject meta;
+        meta["name"] = "thread_name";
+        meta["ph"] = "M";
+        meta["pid"] = 1;
+        meta["tid"] = buffer->threadIndex;
+        meta["args"] = QJsonObject{{"name", buffer->threadName}};
+        traceEvents.append(meta);
+
+        const quint64 capacity = ThreadBuffer::Capacity;
+        quint64 head = buffer->head.load(std::memory_order_acquire);
+        quint64 begin = std::max(buffer->tail.load(std::memory_order_relaxed),
+                                 head > capacity ? head - capacity : 0);
+
+        // Copy only slots that hold the expected event both before and after
+        // the copy; the owner may be writing or have wrapped around meanwhile
+        std::vector<Event> snapshot;
+        snapshot.reserve(head - begin);
+        for (quint64 i = begin; i < head; ++i) {
+            const ThreadBuffer::Slot &slot = buffer->ring[i & (capacity - 1)];
+            const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * i + 2) {
+                continue;
+            }
+            Event e;
+            e.name = slot.name.load(std::memory_order_relaxed);
+            e.startNs = slot.startNs.load(std::memory_order_relaxed);
+            e.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+                snapshot.push_back(e);
+            }
+        }
+
+        for (const Event &e : snapshot) {
+            if (!e.name) {
+                continue;
+            }
+            QJsonObject event;
+            event["name"] = QString::fromLatin1(e.name);
+            event["cat"] = "image-coord";
+            event["ph"] = "X";
+            event["ts"] = e.startNs / 1000.0;
+            event["dur"] = e.durationNs / 1000.0;
+            event["pid"] = 1;
+            event["tid"] = buffer->threadIndex;
+            traceEvents.append(event);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.close();
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QString>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Records scoped timing spans into per-thread ring buffers and writes them out
+// in the Chrome trace-event JSON format (chrome://tracing, Perfetto).
+//
+// Each thread owns its buffer and is the only writer, so recording a span is a
+// few relaxed stores bracketed by a per-slot sequence number that lets the
+// reader skip slots still being written. When tracing is disabled a span costs
+// a single relaxed atomic load.
+class TraceRecorder
+{
+public:
+    struct Event {
+        const char *name = nullptr;
+        qint64 startNs = 0;
+        qint64 durationNs = 0;
+    };
+
+    static TraceRecorder &instance();
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    void record(const char *name, qint64 startNs, qint64 endNs);
+
+    // Drops everything recorded so far; called when recording is switched on
+    void clear();
+
+    bool writeJson(const QString &filePath) const;
+
+private:
+    TraceRecorder();
+
+    struct ThreadBuffer;
+    ThreadBuffer *localBuffer();
+
+    static std::atomic<bool> s_enabled;
+
+    QElapsedTimer m_clock;
+    mutable std::mutex m_registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(TraceRecorder::isEnabled() ? name : nullptr)
+        , m_start(m_name ? TraceRecorder::instance().now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) {
+            TraceRecorder &recorder = TraceRecorder::instance();
+            recorder.record(m_name, m_start, recorder.now());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Name must be a string literal (only the pointer is stored)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+#endif // TRACERECORDER_H
@@ -1,16 +1,400 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QSet>
+#include <vector>
 #include "MainWindow.h"
+#include "AnnotationFormat.h"
+#include "CoverageAnalyzer.h"
+#include "HtmlMapImporter.h"
+#include "InputSession.h"
+#include "Parallel.h"
+#include "ProjectFile.h"
+#include "TraceRecorder.h"
+
+static int runReplay(const QString &sessionPath, const QString &imagePath, const QString &reportPath)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    InputSessionReplayer replayer;
+    QString error;
+    if (!replayer.load(sessionPath, &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+
+    ImageMapEditor editor;
+    if (!replayer.prepare(&editor, imagePath, &error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+
+    const QVector<InputSessionReplayer::Result> results = replayer.run(&editor);
+    QJsonObject report = InputSessionReplayer::report(results);
+
+    QJsonObject summary = report["summary"].toObject();
+    out << QString("Replayed %1 events").arg(summary["count"].toInt()) << Qt::endl;
+
+    QJsonObject perType = report["perType"].toObject();
+    for (auto it = perType.constBegin(); it != perType.constEnd(); ++it) {
+        QJsonObject stats = it.value().toObject();
+        out << QString("  %1: n=%2 mean=%3us p50=%4us p95=%5us max=%6us")
+                   .arg(it.key(), -9)
+                   .arg(stats["count"].toInt())
+                   .arg(stats["meanUs"].toDouble(), 0, 'f', 1)
+                   .arg(stats["p50Us"].toDouble(), 0, 'f', 1)
+                   .arg(stats["p95Us"].toDouble(), 0, 'f', 1)
+                   .arg(stats["maxUs"].toDouble(), 0, 'f', 1)
+            << Qt::endl;
+    }
+
+    if (!reportPath.isEmpty() && !InputSessionReplayer::writeReport(results, reportPath)) {
+        err << "Failed to write report " << reportPath << Qt::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int runAnalyze(const QString &projectPath, const QString &heatmapPath)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QFile file(projectPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "Failed to open project " << projectPath << Qt::endl;
+        return 1;
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isObject()) {
+        err << "Invalid project file " << projectPath << Qt::endl;
+        return 1;
+    }
+    const QJsonObject project = doc.object();
+
+    ImageMapEditor editor;
+    const QString imagePath = project["imagePath"].toString();
+    if (!editor.loadImage(imagePath)) {
+        err << "Failed to load image " << imagePath << Qt::endl;
+        return 1;
+    }
+    editor.addHotspots(ProjectFile::hotspotsFromJson(project["hotspots"].toArray()));
+
+    const QVector<MapArea> areas = editor.mapAreas();
+    const CoverageStats stats = CoverageAnalyzer::compute(areas, editor.outputSize());
+    const qint64 total = stats.totalPixels();
+    const auto percent = [total](qint64 pixels) {
+        return total > 0 ? 100.0 * pixels / total : 0.0;
+    };
+
+    out << QString("Image %1 x %2 px, %3 areas").arg(stats.size.width()).arg(stats.size.height()).arg(areas.size())
+        << Qt::endl;
+    out << QString("Covered:     %1 px (%2%)").arg(stats.coveredPixels).arg(percent(stats.coveredPixels), 0, 'f', 2)
+        << Qt::endl;
+    out << QString("Uncovered:   %1 px (%2%)").arg(total - stats.coveredPixels)
+                                             .arg(percent(total - stats.coveredPixels), 0, 'f', 2)
+        << Qt::endl;
+    out << QString("Overlapping: %1 px (%2%)").arg(stats.overlapPixels).arg(percent(stats.overlapPixels), 0, 'f', 2)
+        << Qt::endl;
+    out << "#\tshape\tarea_px\toverlap_px\turl" << Qt::endl;
+    for (int i = 0; i < areas.size(); ++i) {
+        out << QString("%1\t%2\t%3\t%4\t%5")
+                   .arg(i + 1)
+                   .arg(areas.at(i).generateShapeName())
+                   .arg(stats.areas.at(i).pixels)
+                   .arg(stats.areas.at(i).overlapPixels)
+                   .arg(areas.at(i).url)
+            << Qt::endl;
+    }
+
+    if (!heatmapPath.isEmpty()) {
+        const QImage background = editor.sourceImage().scaled(stats.size, Qt::IgnoreAspectRatio,
+                                                               Qt::SmoothTransformation);
+        if (!CoverageAnalyzer::renderHeatmap(stats, background).save(heatmapPath)) {
+            err << "Failed to write heatmap " << heatmapPath << Qt::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int runImportHtml(const QString &path, const QString &outputDirectory)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = false;
+    const QStringList report = HtmlMapImporter::convertToProjects(path, outputDirectory, &ok);
+    if (report.isEmpty()) {
+        err << "No HTML pages found in " << path << Qt::endl;
+        return 1;
+    }
+    for (const QString &line : report) {
+        out << line << Qt::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+// Projects are read in parallel; sizes come from the image headers only
+static int runExportAnnotations(const QStringList &projectPaths, const QString &cocoPath, const QString &geoJsonDir)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (projectPaths.isEmpty()) {
+        err << "No project files given" << Qt::endl;
+        return 1;
+    }
+
+    QVector<AnnotationFormat::AnnotatedImage> images(projectPaths.size());
+    AnnotationFormat::AnnotatedImage *entries = images.data();
+    std::vector<QString> errors(projectPaths.size());
+    parallelFor(projectPaths.size(), [&](int i) {
+        QFile file(projectPaths.at(i));
+        if (!file.open(QIODevice::ReadOnly)) {
+            errors[i] = "Failed to open project " + projectPaths.at(i);
+            return;
+        }
+        const QJsonObject project = QJsonDocument::fromJson(file.readAll()).object();
+        const QString imagePath = project["imagePath"].toString();
+        entries[i].fileName = QFileInfo(imagePath).fileName();
+        entries[i].size = QImageReader(imagePath).size();
+        entries[i].areas = ProjectFile::areasFromJson(project["hotspots"].toArray());
+    });
+    for (const QString &error : errors) {
+        if (!error.isEmpty()) {
+            err << error << Qt::endl;
+            return 1;
+        }
+    }
+
+    if (!cocoPath.isEmpty()) {
+        QFile file(cocoPath);
+        const QByteArray data = AnnotationFormat::writeCoco(images);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+            err << "Failed to write " << cocoPath << Qt::endl;
+            return 1;
+        }
+    }
+
+    if (!geoJsonDir.isEmpty()) {
+        QDir().mkpath(geoJsonDir);
+        std::vector<char> failed(images.size(), 0);
+        parallelFor(images.size(), [&](int i) {
+            QFile file(QDir(geoJsonDir).filePath(QFileInfo(projectPaths.at(i)).completeBaseName() + ".geojson"));
+            const QByteArray data = AnnotationFormat::writeGeoJson(images.at(i));
+            failed[i] = !file.open(QIODevice::WriteOnly) || file.write(data) != data.size();
+        });
+        for (size_t i = 0; i < failed.size(); ++i) {
+            if (failed[i]) {
+                err << "Failed to write GeoJSON for " << projectPaths.at(static_cast<int>(i)) << Qt::endl;
+                return 1;
+            }
+        }
+    }
+
+    int total = 0;
+    for (const AnnotationFormat::AnnotatedImage &image : images) {
+        total += image.areas.size();
+    }
+    out << QString("Exported %1 annotations from %2 projects").arg(total).arg(images.size()) << Qt::endl;
+    return 0;
+}
+
+// One project per annotated image, written in parallel
+static int runImportAnnotations(const QString &filePath, const QString &outputDirectory)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QVector<AnnotationFormat::AnnotatedImage> images;
+    QString error;
+    if (!AnnotationFormat::read(filePath, &images, &error)) {
+        err << "Failed to read " << filePath << ": " << error << Qt::endl;
+        return 1;
+    }
+
+    const QFileInfo info(filePath);
+    const QDir target(outputDirectory.isEmpty() ? info.absolutePath() : outputDirectory);
+    QDir().mkpath(target.absolutePath());
+
+    // Projects are named after their image. Where two images would share a
+    // name, such as train/001.jpg and val/001.jpg or a.jpg and a.png, their
+    // folders and extension are kept in it, and a number after that.
+    auto baseNameOf = [&info](const AnnotationFormat::AnnotatedImage &image) {
+        return image.fileName.isEmpty() ? info.completeBaseName() : QFileInfo(image.fileName).completeBaseName();
+    };
+    QHash<QString, int> baseNames;
+    for (const AnnotationFormat::AnnotatedImage &image : images) {
+        ++baseNames[baseNameOf(image).toLower()];
+    }
+    QStringList projectNames;
+    QSet<QString> usedNames;
+    for (const AnnotationFormat::AnnotatedImage &image : images) {
+        QString name = baseNameOf(image);
+        if (baseNames.value(name.toLower()) > 1 && !image.fileName.isEmpty()) {
+            name = QDir::cleanPath(image.fileName);
+            name.replace(QRegularExpression("[/\\\\:]+"), "-");
+        }
+        QString unique = name;
+        for (int n = 2; usedNames.contains(unique.toLower()); ++n) {
+            unique = QString("%1-%2").arg(name).arg(n);
+        }
+        usedNames.insert(unique.toLower());
+        projectNames.append(unique);
+    }
+
+    std::vector<char> failed(images.size(), 0);
+    parallelFor(images.size(), [&](int i) {
+        const AnnotationFormat::AnnotatedImage &image = images.at(i);
+        QJsonArray hotspots;
+        for (const MapArea &area : image.areas) {
+            hotspots.append(ProjectFile::areaToJson(area));
+        }
+        QJsonObject project;
+        project["imagePath"] = image.fileName.isEmpty() ? QString() : info.dir().absoluteFilePath(image.fileName);
+        project["mapName"] = "imagemap";
+        project["hotspots"] = hotspots;
+
+        QFile file(target.filePath(projectNames.at(i) + ".imap"));
+        failed[i] = !file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(project).toJson()) < 0;
+    });
+
+    int total = 0;
+    for (int i = 0; i < images.size(); ++i) {
+        total += images.at(i).areas.size();
+        if (failed[i]) {
+            err << "Failed to write the project for " << images.at(i).fileName << Qt::endl;
+            return 1;
+        }
+    }
+    out << QString("Imported %1 annotations into %2 projects").arg(total).arg(images.size()) << Qt::endl;
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    // Replays and analyses run headless unless a platform was chosen explicitly
+    for (int i = 1; i < argc; ++i) {
+        if ((qstrncmp(argv[i], "--replay", 8) == 0 || qstrncmp(argv[i], "--analyze", 9) == 0
+             || qstrncmp(argv[i], "--import-", 9) == 0 || qstrncmp(argv[i], "--export-", 9) == 0)
+            && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+            break;
+        }
+    }
+
     QApplication app(argc, argv);
 
     app.setApplicationName("Image Map Generator");
     app.setApplicationVersion("1.1.0");
     app.setOrganizationName("ImageCoord");
 
-    MainWindow window;
-    window.show();
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Create HTML image maps visually");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption traceOption("trace",
+                                   "Record performance spans and write them as trace-event JSON to <file> on exit.",
+                                   "file");
+    parser.addOption(traceOption);
+
+    QCommandLineOption replayOption("replay",
+                                    "Replay a recorded input session headlessly and report per-event latency.",
+                                    "session");
+    parser.addOption(replayOption);
+
+    QCommandLineOption replayImageOption("replay-image",
+                                         "Image to replay against instead of the one stored in the session.",
+                                         "image");
+    parser.addOption(replayImageOption);
+
+    QCommandLineOption replayReportOption("replay-report",
+                                          "Write per-event latencies of the replay as JSON to <file>.",
+                                          "file");
+    parser.addOption(replayReportOption);
+
+    QCommandLineOption analyzeOption("analyze",
+                                     "Print coverage and overlap statistics of a project's hotspots and exit.",
+                                     "project");
+    parser.addOption(analyzeOption);
+
+    QCommandLineOption heatmapOption("heatmap",
+                                     "With --analyze, write an image of the uncovered areas to <file>.",
+                                     "file");
+    parser.addOption(heatmapOption);
+
+    QCommandLineOption importHtmlOption("import-html",
+                                        "Convert the image maps of an HTML page, or of every page in a directory, "
+                                        "to .imap projects and exit.",
+                                        "path");
+    parser.addOption(importHtmlOption);
+
+    QCommandLineOption importOutputOption("import-output",
+                                          "With --import-html or --import-annotations, write the projects to <dir> "
+                                          "instead of next to the input.",
+                                          "dir");
+    parser.addOption(importOutputOption);
+
+    QCommandLineOption importAnnotationsOption("import-annotations",
+                                               "Convert a COCO JSON dataset or GeoJSON file to one .imap project "
+                                               "per image and exit.",
+                                               "file");
+    parser.addOption(importAnnotationsOption);
+
+    QCommandLineOption exportCocoOption("export-coco",
+                                        "Write the hotspots of the given projects as one COCO JSON dataset to <file> and exit.",
+                                        "file");
+    parser.addOption(exportCocoOption);
+
+    QCommandLineOption exportGeoJsonOption("export-geojson",
+                                           "Write the hotspots of each given project as GeoJSON into <dir> and exit.",
+                                           "dir");
+    parser.addOption(exportGeoJsonOption);
+    parser.addPositionalArgument("projects", "Projects for --export-coco and --export-geojson.", "[projects...]");
+
+    parser.process(app);
+
+    QString tracePath = parser.value(traceOption);
+    if (!tracePath.isEmpty()) {
+        TraceRecorder::instance().setEnabled(true);
+    }
+
+    int result = 0;
+    if (parser.isSet(replayOption)) {
+        result = runReplay(parser.value(replayOption),
+                           parser.value(replayImageOption),
+                           parser.value(replayReportOption));
+    } else if (parser.isSet(analyzeOption)) {
+        result = runAnalyze(parser.value(analyzeOption), parser.value(heatmapOption));
+    } else if (parser.isSet(importHtmlOption)) {
+        result = runImportHtml(parser.value(importHtmlOption), parser.value(importOutputOption));
+    } else if (parser.isSet(importAnnotationsOption)) {
+        result = runImportAnnotations(parser.value(importAnnotationsOption), parser.value(importOutputOption));
+    } else if (parser.isSet(exportCocoOption) || parser.isSet(exportGeoJsonOption)) {
+        result = runExportAnnotations(parser.positionalArguments(), parser.value(exportCocoOption),
+                                      parser.value(exportGeoJsonOption));
+    } else {
+        MainWindow window;
+        window.show();
+        result = app.exec();
+    }
+
+    if (!tracePath.isEmpty()) {
+        TraceRecorder::instance().writeJson(tracePath);
+    }
 
-    return app.exec();
+    return result;
 }
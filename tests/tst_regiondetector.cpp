@@ -0,0 +1,73 @@
+#include "RegionDetector.h"
+#include <QtTest>
+#include <vector>
+
+class TestRegionDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void traceSquare();
+    void traceDiagonalStart();
+    void traceSinglePixel();
+};
+
+namespace {
+
+// Rows of '#' for region pixels
+std::vector<quint8> maskFromRows(const QStringList &rows)
+{
+    std::vector<quint8> mask;
+    for (const QString &row : rows) {
+        for (QChar c : row) {
+            mask.push_back(c == '#' ? 1 : 0);
+        }
+    }
+    return mask;
+}
+
+} // namespace
+
+void TestRegionDetector::traceSquare()
+{
+    const QStringList rows = {"....",
+                              ".##.",
+                              ".##.",
+                              "...."};
+    const std::vector<quint8> mask = maskFromRows(rows);
+    const QPolygonF contour = RegionDetector::traceContour(mask.data(), 4, 4, QPoint(1, 1));
+
+    QCOMPARE(contour.size(), 4);
+    QCOMPARE(contour.first(), QPointF(1.5, 1.5));
+}
+
+void TestRegionDetector::traceDiagonalStart()
+{
+    // The start pixel touches the rest of the region only at its south-east
+    // corner, so the trace re-enters it from a different side than it left
+    const QStringList rows = {".#.....",
+                              "..###..",
+                              "..####.",
+                              "..###..",
+                              "......."};
+    const std::vector<quint8> mask = maskFromRows(rows);
+    const QPolygonF contour = RegionDetector::traceContour(mask.data(), 7, 5, QPoint(1, 0));
+
+    const QPolygonF expected = {QPointF(1.5, 0.5), QPointF(2.5, 1.5), QPointF(3.5, 1.5),
+                                QPointF(4.5, 1.5), QPointF(5.5, 2.5), QPointF(4.5, 3.5),
+                                QPointF(3.5, 3.5), QPointF(2.5, 3.5), QPointF(2.5, 2.5),
+                                QPointF(2.5, 1.5)};
+    QCOMPARE(contour, expected);
+}
+
+void TestRegionDetector::traceSinglePixel()
+{
+    const std::vector<quint8> mask = maskFromRows({"...", ".#.", "..."});
+    const QPolygonF contour = RegionDetector::traceContour(mask.data(), 3, 3, QPoint(1, 1));
+
+    QCOMPARE(contour.size(), 1);
+}
+
+QTEST_APPLESS_MAIN(TestRegionDetector)
+
+#include "tst_regiondetector.moc"